@@ -0,0 +1,789 @@
+/**
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * This is free software; see the Copyright file in the source distribution for precise wording.
+ *
+ * Copyright (C) 2002-2026 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+/**
+ * @brief XML Security Library micro benchmarks.
+ * @details The benchmarks are not a part of "make check", use "make bench"
+ * to build and run them:
+ *
+ *   xmlsec_benchmarks [benchmark-name]
+ *
+ * The results depend on the machine and the build flags, compare the numbers
+ * from the same machine and build only.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+#include <libxml/xpath.h>
+#include <libxml/xpathInternals.h>
+
+#define XMLSEC_PRIVATE 1
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/buffer.h>
+#include <xmlsec/errors.h>
+#include <xmlsec/keys.h>
+#include <xmlsec/keyinfo.h>
+#include <xmlsec/keysdata.h>
+#include <xmlsec/keysmngr.h>
+#include <xmlsec/nodeset.h>
+#include <xmlsec/private.h>
+#include <xmlsec/transforms.h>
+
+#ifdef XMLSEC_BENCHMARKS_OPENSSL
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <xmlsec/openssl/app.h>
+#include <xmlsec/openssl/crypto.h>
+#include <xmlsec/openssl/x509.h>
+#endif /* XMLSEC_BENCHMARKS_OPENSSL */
+
+#define BENCH_BUFFER_CHUNK_SIZE             (64 * 1024)
+#define BENCH_BUFFER_MAX_MB                 1024
+#define BENCH_BUFFER_MEMMOVE_MAX_MB         64
+#define BENCH_NODESET_MAX_NODES             100000
+#define BENCH_KEYS_STORE_KEYS_NUMBER        100000
+#define BENCH_KEYS_STORE_LOOKUPS_NUMBER     1000
+#define BENCH_CRL_REVOKED_NUMBER            100000
+#define BENCH_CRL_VERIFICATIONS_NUMBER      200
+#define BENCH_HMAC_SIGNATURES_NUMBER        100000
+#define BENCH_HMAC_DATA_SIZE                512
+
+typedef int (*benchFunction)(void);
+
+typedef struct _benchInfo {
+    const char*         name;
+    benchFunction       func;
+} benchInfo;
+
+static double
+benchElapsedMs(clock_t start) {
+    return(((double)(clock() - start) * 1000.0) / CLOCKS_PER_SEC);
+}
+
+/******************************************************************************
+ * buffers: drain a large buffer in binary chunk size pieces while appending
+ * to the tail like the transforms do; compare with moving the remaining data
+ * on every head removal
+  *****************************************************************************/
+/* returns the time to drain the buffer in ms or a negative value if an error occurs */
+static double
+benchBufferDrain(xmlSecSize size) {
+    xmlSecBufferPtr buf;
+    xmlSecByte chunk[BENCH_BUFFER_CHUNK_SIZE];
+    xmlSecSize ii;
+    clock_t start;
+    double ms = -1;
+
+    buf = xmlSecBufferCreate(size);
+    if(buf == NULL) {
+        return(-1);
+    }
+    if(xmlSecBufferSetSize(buf, size) < 0) {
+        goto done;
+    }
+    memset(xmlSecBufferGetData(buf), 'a', size);
+    memset(chunk, 'b', sizeof(chunk));
+
+    start = clock();
+    for(ii = 0; ii < size; ii += BENCH_BUFFER_CHUNK_SIZE) {
+        if(xmlSecBufferRemoveHead(buf, BENCH_BUFFER_CHUNK_SIZE) < 0) {
+            goto done;
+        }
+        if(((ii / BENCH_BUFFER_CHUNK_SIZE) % 2) == 0) {
+            if(xmlSecBufferAppend(buf, chunk, sizeof(chunk)) < 0) {
+                goto done;
+            }
+        }
+    }
+    ms = benchElapsedMs(start);
+
+done:
+    xmlSecBufferDestroy(buf);
+    return(ms);
+}
+
+/* the old head removal: move the remaining data and wipe the tail on every call */
+static double
+benchBufferDrainMemmove(xmlSecSize size) {
+    xmlSecByte* data;
+    xmlSecByte chunk[BENCH_BUFFER_CHUNK_SIZE];
+    xmlSecSize ii, cur;
+    clock_t start;
+    double ms;
+
+    /* the appended chunks never exceed the removed ones */
+    data = (xmlSecByte*)malloc(size);
+    if(data == NULL) {
+        return(-1);
+    }
+    memset(data, 'a', size);
+    memset(chunk, 'b', sizeof(chunk));
+
+    start = clock();
+    cur = size;
+    for(ii = 0; ii < size; ii += BENCH_BUFFER_CHUNK_SIZE) {
+        memmove(data, data + BENCH_BUFFER_CHUNK_SIZE, cur - BENCH_BUFFER_CHUNK_SIZE);
+        memset(data + cur - BENCH_BUFFER_CHUNK_SIZE, 0, BENCH_BUFFER_CHUNK_SIZE);
+        cur -= BENCH_BUFFER_CHUNK_SIZE;
+        if(((ii / BENCH_BUFFER_CHUNK_SIZE) % 2) == 0) {
+            memcpy(data + cur, chunk, sizeof(chunk));
+            cur += sizeof(chunk);
+        }
+    }
+    ms = benchElapsedMs(start);
+
+    free(data);
+    return(ms);
+}
+
+static int
+bench_buffer_drain(void) {
+    unsigned int mb;
+    double ms, memmoveMs;
+
+    for(mb = 16; mb <= BENCH_BUFFER_MAX_MB; mb *= 4) {
+        ms = benchBufferDrain((xmlSecSize)mb * 1024 * 1024);
+        if(ms < 0) {
+            fprintf(stderr, "Error: failed to drain %u MB buffer\n", mb);
+            return(-1);
+        }
+        if(mb > BENCH_BUFFER_MEMMOVE_MAX_MB) {
+            fprintf(stdout, "  %5u MB: xmlSecBufferRemoveHead %9.2f ms (%.4f ms per MB), memmove skipped\n",
+                mb, ms, ms / mb);
+            continue;
+        }
+        memmoveMs = benchBufferDrainMemmove((xmlSecSize)mb * 1024 * 1024);
+        if(memmoveMs < 0) {
+            fprintf(stderr, "Error: failed to allocate %u MB\n", mb);
+            return(-1);
+        }
+        fprintf(stdout, "  %5u MB: xmlSecBufferRemoveHead %9.2f ms (%.4f ms per MB), memmove %9.2f ms (%.4f ms per MB)\n",
+            mb, ms, ms / mb, memmoveMs, memmoveMs / mb);
+    }
+    return(0);
+}
+
+/******************************************************************************
+ * nodes sets: check every node of the document against a Normal set with every
+ * other node; compare with the linear scan of the nodes list
+  *****************************************************************************/
+/* returns the time to check all the nodes in ms or a negative value if an error occurs */
+static double
+benchNodeSetContains(int count, int linear) {
+    xmlDocPtr doc;
+    xmlNodePtr root, cur;
+    xmlNodeSetPtr nodes;
+    xmlSecNodeSetPtr nset = NULL;
+    clock_t start;
+    int ii, found = 0;
+    double ms = -1;
+
+    doc = xmlNewDoc(BAD_CAST "1.0");
+    if(doc == NULL) {
+        return(-1);
+    }
+    root = xmlNewDocNode(doc, NULL, BAD_CAST "Root", NULL);
+    if(root == NULL) {
+        xmlFreeDoc(doc);
+        return(-1);
+    }
+    xmlDocSetRootElement(doc, root);
+
+    nodes = xmlXPathNodeSetCreate(NULL);
+    if(nodes == NULL) {
+        xmlFreeDoc(doc);
+        return(-1);
+    }
+    for(ii = 0; ii < count; ++ii) {
+        cur = xmlNewChild(root, NULL, BAD_CAST "Item", NULL);
+        if(cur == NULL) {
+            xmlXPathFreeNodeSet(nodes);
+            goto done;
+        }
+        if(((ii % 2) == 0) && (xmlXPathNodeSetAddUnique(nodes, cur) < 0)) {
+            xmlXPathFreeNodeSet(nodes);
+            goto done;
+        }
+    }
+    nset = xmlSecNodeSetCreate(doc, nodes, xmlSecNodeSetNormal);
+    if(nset == NULL) {
+        xmlXPathFreeNodeSet(nodes);
+        goto done;
+    }
+
+    /* the index (if any) is built on the first lookup and it is included in the time */
+    start = clock();
+    for(cur = root->children; cur != NULL; cur = cur->next) {
+        if(linear != 0) {
+            found += xmlXPathNodeSetContains(nodes, cur);
+        } else {
+            found += xmlSecNodeSetContains(nset, cur, root);
+        }
+    }
+    ms = benchElapsedMs(start);
+    if(found != (count + 1) / 2) {
+        fprintf(stderr, "Error: found %d nodes, expected %d\n", found, (count + 1) / 2);
+        ms = -1;
+    }
+
+done:
+    if(nset != NULL) {
+        xmlSecNodeSetDestroy(nset);
+    }
+    xmlFreeDoc(doc);
+    return(ms);
+}
+
+static int
+bench_nodeset_contains(void) {
+    int count;
+    double ms, linearMs;
+
+    for(count = 1000; count <= BENCH_NODESET_MAX_NODES; count *= 10) {
+        ms = benchNodeSetContains(count, 0);
+        linearMs = benchNodeSetContains(count, 1);
+        if((ms < 0) || (linearMs < 0)) {
+            fprintf(stderr, "Error: failed to check %d nodes\n", count);
+            return(-1);
+        }
+        fprintf(stdout, "  %6d nodes: xmlSecNodeSetContains %9.2f ms, linear scan %9.2f ms\n",
+            count, ms, linearMs);
+    }
+    return(0);
+}
+
+/******************************************************************************
+ * keys stores: no crypto, the test key data has just a serial number
+  *****************************************************************************/
+typedef struct _benchKeyData {
+    xmlSecKeyData       data;
+    int                 serial;
+} benchKeyData;
+
+static int
+benchKeyDataInitialize(xmlSecKeyDataPtr data) {
+    ((benchKeyData*)data)->serial = -1;
+    return(0);
+}
+
+static int
+benchKeyDataDuplicate(xmlSecKeyDataPtr dst, xmlSecKeyDataPtr src) {
+    ((benchKeyData*)dst)->serial = ((benchKeyData*)src)->serial;
+    return(0);
+}
+
+static xmlSecKeyDataType
+benchKeyDataGetType(xmlSecKeyDataPtr data XMLSEC_ATTRIBUTE_UNUSED) {
+    UNREFERENCED_PARAMETER(data);
+    return(xmlSecKeyDataTypeSymmetric);
+}
+
+#define BENCH_KEY_DATA_KLASS(name)                                              \
+    {                                                                           \
+        sizeof(xmlSecKeyDataKlass),                                             \
+        sizeof(benchKeyData),                                                   \
+        BAD_CAST (name),                                                        \
+        xmlSecKeyDataUsageAny,                                                  \
+        NULL, NULL, NULL,                                                       \
+        benchKeyDataInitialize,                                                 \
+        benchKeyDataDuplicate,                                                  \
+        NULL, NULL,                                                             \
+        benchKeyDataGetType,                                                    \
+        NULL, NULL,                                                             \
+        NULL, NULL, NULL, NULL,                                                 \
+        NULL, NULL,                                                             \
+        NULL, NULL                                                              \
+    }
+
+static xmlSecKeyDataKlass benchKeyDataKlassA = BENCH_KEY_DATA_KLASS("bench-a");
+static xmlSecKeyDataKlass benchKeyDataKlassB = BENCH_KEY_DATA_KLASS("bench-b");
+
+static xmlSecKeyPtr
+benchCreateKey(const xmlChar* name, xmlSecKeyDataId dataId, int serial) {
+    xmlSecKeyPtr key;
+    xmlSecKeyDataPtr data;
+
+    data = xmlSecKeyDataCreate(dataId);
+    if(data == NULL) {
+        return(NULL);
+    }
+    ((benchKeyData*)data)->serial = serial;
+
+    key = xmlSecKeyCreate();
+    if(key == NULL) {
+        xmlSecKeyDataDestroy(data);
+        return(NULL);
+    }
+    if(xmlSecKeySetValue(key, data) < 0) {
+        xmlSecKeyDataDestroy(data);
+        xmlSecKeyDestroy(key);
+        return(NULL);
+    }
+    if(xmlSecKeySetName(key, name) < 0) {
+        xmlSecKeyDestroy(key);
+        return(NULL);
+    }
+    return(key);
+}
+
+static xmlSecKeyStorePtr
+benchCreateKeysStore(xmlSecKeyStoreId storeId) {
+    xmlSecKeyStorePtr store;
+    xmlSecKeyPtr key;
+    xmlChar name[64];
+    int ii;
+
+    store = xmlSecKeyStoreCreate(storeId);
+    if(store == NULL) {
+        return(NULL);
+    }
+    for(ii = 0; ii < BENCH_KEYS_STORE_KEYS_NUMBER; ++ii) {
+        /* three keys per name, two key data klasses */
+        (void)snprintf((char*)name, sizeof(name), "key-%d", ii / 3);
+        key = benchCreateKey(name, ((ii % 2) == 0) ? &benchKeyDataKlassA : &benchKeyDataKlassB, ii);
+        if(key == NULL) {
+            xmlSecKeyStoreDestroy(store);
+            return(NULL);
+        }
+        if(xmlSecSimpleKeysStoreAdoptKey(store, key) < 0) {
+            xmlSecKeyDestroy(key);
+            xmlSecKeyStoreDestroy(store);
+            return(NULL);
+        }
+    }
+    return(store);
+}
+
+/* returns the time per lookup in ms or a negative value if an error occurs */
+static double
+benchKeysStoreLookups(xmlSecKeyStoreId storeId, int lookups) {
+    xmlSecKeyStorePtr store;
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlSecKeyPtr key;
+    xmlChar name[64];
+    clock_t start;
+    double ms;
+    int ii, pos;
+
+    store = benchCreateKeysStore(storeId);
+    if(store == NULL) {
+        fprintf(stderr, "Error: failed to create keys store\n");
+        return(-1);
+    }
+
+    memset(&keyInfoCtx, 0, sizeof(keyInfoCtx));
+    keyInfoCtx.keyReq.keyId    = xmlSecKeyDataIdUnknown;
+    keyInfoCtx.keyReq.keyType  = xmlSecKeyDataTypeAny;
+    keyInfoCtx.keyReq.keyUsage = xmlSecKeyUsageAny;
+
+    start = clock();
+    for(ii = 0; ii < lookups; ++ii) {
+        /* the keys at the end of the list are the worst case for the full scan */
+        pos = BENCH_KEYS_STORE_KEYS_NUMBER - 1 - (ii % 1000) * 7;
+        (void)snprintf((char*)name, sizeof(name), "key-%d", pos / 3);
+        key = xmlSecKeyStoreFindKey(store, name, &keyInfoCtx);
+        if(key == NULL) {
+            fprintf(stderr, "Error: key '%s' is not found\n", (const char*)name);
+            xmlSecKeyStoreDestroy(store);
+            return(-1);
+        }
+        xmlSecKeyDestroy(key);
+    }
+    ms = benchElapsedMs(start) / lookups;
+
+    xmlSecKeyStoreDestroy(store);
+    return(ms);
+}
+
+static int
+bench_keys_store(void) {
+    double simpleMs, indexedMs;
+
+    /* the full scan is slow, do fewer lookups */
+    simpleMs = benchKeysStoreLookups(xmlSecSimpleKeysStoreId, BENCH_KEYS_STORE_LOOKUPS_NUMBER / 10);
+    if(simpleMs < 0) {
+        return(-1);
+    }
+    indexedMs = benchKeysStoreLookups(xmlSecIndexedKeysStoreId, BENCH_KEYS_STORE_LOOKUPS_NUMBER);
+    if(indexedMs < 0) {
+        return(-1);
+    }
+
+    fprintf(stdout, "  %d keys: simple keys store %.4f ms per lookup, indexed keys store %.4f ms per lookup\n",
+        BENCH_KEYS_STORE_KEYS_NUMBER, simpleMs, indexedMs);
+    return(0);
+}
+
+#ifdef XMLSEC_BENCHMARKS_OPENSSL
+/******************************************************************************
+ * OpenSSL X509 store: the CRL with many revoked certs, the verified cert is
+ * not revoked (the worst case for the full scan)
+  *****************************************************************************/
+static X509*
+benchCreateCert(const char* subject, long serial, X509* issuer, EVP_PKEY* pkey, EVP_PKEY* issuerPkey) {
+    X509V3_CTX v3ctx;
+    X509_EXTENSION* ext;
+    X509* cert;
+
+    cert = X509_new();
+    if(cert == NULL) {
+        return(NULL);
+    }
+    if((X509_set_version(cert, 2) != 1) ||
+       (ASN1_INTEGER_set(X509_get_serialNumber(cert), serial) != 1) ||
+       (X509_NAME_add_entry_by_txt(X509_get_subject_name(cert), "CN", MBSTRING_ASC, BAD_CAST subject, -1, -1, 0) != 1) ||
+       (X509_set_issuer_name(cert, X509_get_subject_name((issuer != NULL) ? issuer : cert)) != 1) ||
+       (X509_gmtime_adj(X509_getm_notBefore(cert), -24 * 3600) == NULL) ||
+       (X509_gmtime_adj(X509_getm_notAfter(cert), 365 * 24 * 3600) == NULL) ||
+       (X509_set_pubkey(cert, pkey) != 1))
+    {
+        X509_free(cert);
+        return(NULL);
+    }
+    if(issuer == NULL) {
+        X509V3_set_ctx(&v3ctx, cert, cert, NULL, NULL, 0);
+        ext = X509V3_EXT_conf_nid(NULL, &v3ctx, NID_basic_constraints, "critical,CA:TRUE");
+        if((ext == NULL) || (X509_add_ext(cert, ext, -1) != 1)) {
+            X509_EXTENSION_free(ext);
+            X509_free(cert);
+            return(NULL);
+        }
+        X509_EXTENSION_free(ext);
+    }
+    if(X509_sign(cert, issuerPkey, NULL) <= 0) {
+        X509_free(cert);
+        return(NULL);
+    }
+    return(cert);
+}
+
+static X509_CRL*
+benchCreateCrl(X509* issuer, EVP_PKEY* issuerPkey, int revokedNumber) {
+    X509_CRL* crl;
+    X509_REVOKED* revoked;
+    ASN1_INTEGER* serial;
+    ASN1_TIME* tm;
+    int ii;
+
+    crl = X509_CRL_new();
+    serial = ASN1_INTEGER_new();
+    tm = ASN1_TIME_new();
+    if((crl == NULL) || (serial == NULL) || (tm == NULL)) {
+        goto error;
+    }
+    if((X509_CRL_set_version(crl, 1) != 1) ||
+       (X509_CRL_set_issuer_name(crl, X509_get_subject_name(issuer)) != 1) ||
+       (X509_gmtime_adj(tm, -3600) == NULL) ||
+       (X509_CRL_set1_lastUpdate(crl, tm) != 1) ||
+       (X509_gmtime_adj(tm, 24 * 3600) == NULL) ||
+       (X509_CRL_set1_nextUpdate(crl, tm) != 1) ||
+       (X509_gmtime_adj(tm, -3600) == NULL))
+    {
+        goto error;
+    }
+    for(ii = 0; ii < revokedNumber; ++ii) {
+        revoked = X509_REVOKED_new();
+        if(revoked == NULL) {
+            goto error;
+        }
+        if((ASN1_INTEGER_set(serial, 1000 + ii) != 1) ||
+           (X509_REVOKED_set_serialNumber(revoked, serial) != 1) ||
+           (X509_REVOKED_set_revocationDate(revoked, tm) != 1) ||
+           (X509_CRL_add0_revoked(crl, revoked) != 1))
+        {
+            X509_REVOKED_free(revoked);
+            goto error;
+        }
+    }
+    if(X509_CRL_sign(crl, issuerPkey, NULL) <= 0) {
+        goto error;
+    }
+    ASN1_INTEGER_free(serial);
+    ASN1_TIME_free(tm);
+    return(crl);
+
+error:
+    ASN1_INTEGER_free(serial);
+    ASN1_TIME_free(tm);
+    X509_CRL_free(crl);
+    return(NULL);
+}
+
+/* returns the time per verification in ms or a negative value if an error occurs */
+static double
+benchX509StoreVerifications(X509* caCert, X509* cert, X509_CRL* crl, int storeCrl, int verifications) {
+    xmlSecKeyDataStorePtr store;
+    xmlSecKeyInfoCtx keyInfoCtx;
+    STACK_OF(X509)* certs = NULL;
+    STACK_OF(X509_CRL)* crls = NULL;
+    X509* caCertCopy;
+    X509_CRL* crlCopy;
+    clock_t start;
+    double ms = -1;
+    int ii;
+
+    store = xmlSecKeyDataStoreCreate(xmlSecOpenSSLX509StoreId);
+    if(store == NULL) {
+        return(-1);
+    }
+    if(xmlSecKeyInfoCtxInitialize(&keyInfoCtx, NULL) < 0) {
+        xmlSecKeyDataStoreDestroy(store);
+        return(-1);
+    }
+
+    caCertCopy = X509_dup(caCert);
+    if((caCertCopy == NULL) || (xmlSecOpenSSLX509StoreAdoptCert(store, caCertCopy, xmlSecKeyDataTypeTrusted) < 0)) {
+        X509_free(caCertCopy);
+        goto done;
+    }
+
+    /* the store CRLs are indexed, the document CRLs are scanned */
+    crlCopy = X509_CRL_dup(crl);
+    if(crlCopy == NULL) {
+        goto done;
+    }
+    if(storeCrl != 0) {
+        if(xmlSecOpenSSLX509StoreAdoptCrl(store, crlCopy) < 0) {
+            X509_CRL_free(crlCopy);
+            goto done;
+        }
+    } else {
+        crls = sk_X509_CRL_new_null();
+        if((crls == NULL) || (sk_X509_CRL_push(crls, crlCopy) <= 0)) {
+            X509_CRL_free(crlCopy);
+            goto done;
+        }
+    }
+
+    certs = sk_X509_new_null();
+    if((certs == NULL) || (sk_X509_push(certs, cert) <= 0)) {
+        goto done;
+    }
+
+    start = clock();
+    for(ii = 0; ii < verifications; ++ii) {
+        if(xmlSecOpenSSLX509StoreVerify(store, certs, crls, &keyInfoCtx) != cert) {
+            fprintf(stderr, "Error: the cert is not verified\n");
+            goto done;
+        }
+    }
+    ms = benchElapsedMs(start) / verifications;
+
+done:
+    if(certs != NULL) {
+        sk_X509_free(certs);
+    }
+    if(crls != NULL) {
+        sk_X509_CRL_pop_free(crls, X509_CRL_free);
+    }
+    xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+    xmlSecKeyDataStoreDestroy(store);
+    return(ms);
+}
+
+static int
+bench_crl_lookup(void) {
+    EVP_PKEY_CTX* pkeyCtx = NULL;
+    EVP_PKEY* caPkey = NULL;
+    EVP_PKEY* pkey = NULL;
+    X509* caCert = NULL;
+    X509* cert = NULL;
+    X509_CRL* crl = NULL;
+    double storeMs, documentMs;
+    int res = -1;
+
+    pkeyCtx = EVP_PKEY_CTX_new_id(EVP_PKEY_ED25519, NULL);
+    if((pkeyCtx == NULL) || (EVP_PKEY_keygen_init(pkeyCtx) != 1) ||
+       (EVP_PKEY_keygen(pkeyCtx, &caPkey) != 1) || (EVP_PKEY_keygen(pkeyCtx, &pkey) != 1))
+    {
+        fprintf(stderr, "Error: failed to generate keys\n");
+        goto done;
+    }
+    caCert = benchCreateCert("Bench CA", 1, NULL, caPkey, caPkey);
+    cert = benchCreateCert("Bench Cert", 2, caCert, pkey, caPkey);
+    crl = (caCert != NULL) ? benchCreateCrl(caCert, caPkey, BENCH_CRL_REVOKED_NUMBER) : NULL;
+    if((caCert == NULL) || (cert == NULL) || (crl == NULL)) {
+        fprintf(stderr, "Error: failed to create certs or CRL\n");
+        goto done;
+    }
+
+    storeMs = benchX509StoreVerifications(caCert, cert, crl, 1, BENCH_CRL_VERIFICATIONS_NUMBER);
+    if(storeMs < 0) {
+        goto done;
+    }
+    documentMs = benchX509StoreVerifications(caCert, cert, crl, 0, BENCH_CRL_VERIFICATIONS_NUMBER / 10);
+    if(documentMs < 0) {
+        goto done;
+    }
+
+    fprintf(stdout, "  %d revoked certs: store CRL %.4f ms per verification, document CRL %.4f ms per verification\n",
+        BENCH_CRL_REVOKED_NUMBER, storeMs, documentMs);
+    res = 0;
+
+done:
+    X509_CRL_free(crl);
+    X509_free(cert);
+    X509_free(caCert);
+    EVP_PKEY_free(pkey);
+    EVP_PKEY_free(caPkey);
+    EVP_PKEY_CTX_free(pkeyCtx);
+    return(res);
+}
+
+/******************************************************************************
+ * OpenSSL HMAC: the HMAC-SHA256 signatures of SignedInfo sized data with the
+ * same key, the key value is optionally reset before each signature (and
+ * the cached keyed contexts are dropped)
+  *****************************************************************************/
+/* returns the time per signature in ms or a negative value if an error occurs */
+static double
+benchHmacSignatures(xmlSecKeyPtr key, int resetKey, int signatures) {
+    xmlSecTransformCtx transformCtx;
+    xmlSecTransformPtr transform;
+    xmlSecByte data[BENCH_HMAC_DATA_SIZE];
+    xmlSecByte keyValue[32];
+    clock_t start;
+    int ii;
+
+    memset(data, 'a', sizeof(data));
+    memset(keyValue, 'k', sizeof(keyValue));
+
+    start = clock();
+    for(ii = 0; ii < signatures; ++ii) {
+        if((resetKey != 0) && (xmlSecOpenSSLKeyDataHmacSet(xmlSecKeyGetValue(key), keyValue, sizeof(keyValue)) < 0)) {
+            fprintf(stderr, "Error: failed to set the key value\n");
+            return(-1);
+        }
+        if(xmlSecTransformCtxInitialize(&transformCtx) < 0) {
+            return(-1);
+        }
+        transform = xmlSecTransformCtxCreateAndAppend(&transformCtx, xmlSecOpenSSLTransformHmacSha256Id);
+        if(transform == NULL) {
+            xmlSecTransformCtxFinalize(&transformCtx);
+            return(-1);
+        }
+        transform->operation = xmlSecTransformOperationSign;
+        if((xmlSecTransformSetKey(transform, key) < 0) ||
+           (xmlSecTransformCtxBinaryExecute(&transformCtx, data, sizeof(data)) < 0) ||
+           (xmlSecBufferGetSize(transformCtx.result) != 32))
+        {
+            fprintf(stderr, "Error: failed to sign the data\n");
+            xmlSecTransformCtxFinalize(&transformCtx);
+            return(-1);
+        }
+        xmlSecTransformCtxFinalize(&transformCtx);
+    }
+    return(benchElapsedMs(start) / signatures);
+}
+
+static int
+bench_hmac(void) {
+    xmlSecByte keyValue[32];
+    xmlSecKeyDataPtr keyData;
+    xmlSecKeyPtr key;
+    double reusedMs, resetMs;
+
+    memset(keyValue, 'k', sizeof(keyValue));
+    keyData = xmlSecKeyDataCreate(xmlSecOpenSSLKeyDataHmacId);
+    if((keyData == NULL) || (xmlSecOpenSSLKeyDataHmacSet(keyData, keyValue, sizeof(keyValue)) < 0)) {
+        fprintf(stderr, "Error: failed to create the key data\n");
+        if(keyData != NULL) {
+            xmlSecKeyDataDestroy(keyData);
+        }
+        return(-1);
+    }
+    key = xmlSecKeyCreate();
+    if((key == NULL) || (xmlSecKeySetValue(key, keyData) < 0)) {
+        fprintf(stderr, "Error: failed to create the key\n");
+        xmlSecKeyDataDestroy(keyData);
+        if(key != NULL) {
+            xmlSecKeyDestroy(key);
+        }
+        return(-1);
+    }
+
+    reusedMs = benchHmacSignatures(key, 0, BENCH_HMAC_SIGNATURES_NUMBER);
+    resetMs = benchHmacSignatures(key, 1, BENCH_HMAC_SIGNATURES_NUMBER);
+    xmlSecKeyDestroy(key);
+    if((reusedMs < 0) || (resetMs < 0)) {
+        return(-1);
+    }
+
+    fprintf(stdout, "  %d bytes: same key %.5f ms per signature, key value reset %.5f ms per signature\n",
+        BENCH_HMAC_DATA_SIZE, reusedMs, resetMs);
+    return(0);
+}
+#endif /* XMLSEC_BENCHMARKS_OPENSSL */
+
+/******************************************************************************
+ * main
+  *****************************************************************************/
+static benchInfo benchmarks[] = {
+    { "buffer-drain",   bench_buffer_drain },
+    { "nodeset",        bench_nodeset_contains },
+    { "keys-store",     bench_keys_store },
+#ifdef XMLSEC_BENCHMARKS_OPENSSL
+    { "crl-lookup",     bench_crl_lookup },
+    { "hmac",           bench_hmac },
+#endif /* XMLSEC_BENCHMARKS_OPENSSL */
+    { NULL,             NULL }
+};
+
+int
+main(int argc, const char **argv) {
+    benchInfo* bench;
+    int res = 1;
+
+    if((argc > 2) || (argv == NULL)) {
+        fprintf(stderr, "Error: usage: xmlsec_benchmarks [benchmark-name]\n");
+        return(1);
+    }
+
+    xmlInitParser();
+    LIBXML_TEST_VERSION
+
+    if(xmlSecInit() < 0) {
+        fprintf(stderr, "Error: xmlsec initialization failed.\n");
+        goto done;
+    }
+#ifdef XMLSEC_BENCHMARKS_OPENSSL
+    if((xmlSecOpenSSLAppInit(NULL) < 0) || (xmlSecOpenSSLInit() < 0)) {
+        fprintf(stderr, "Error: xmlsec-openssl initialization failed.\n");
+        xmlSecShutdown();
+        goto done;
+    }
+#endif /* XMLSEC_BENCHMARKS_OPENSSL */
+
+    res = 0;
+    for(bench = benchmarks; bench->name != NULL; ++bench) {
+        if((argc == 2) && (strcmp(argv[1], bench->name) != 0)) {
+            continue;
+        }
+        fprintf(stdout, "=== %s\n", bench->name);
+        if(bench->func() < 0) {
+            fprintf(stdout, "  FAILED\n");
+            res = 1;
+        }
+    }
+
+#ifdef XMLSEC_BENCHMARKS_OPENSSL
+    xmlSecOpenSSLShutdown();
+    xmlSecOpenSSLAppShutdown();
+#endif /* XMLSEC_BENCHMARKS_OPENSSL */
+    xmlSecShutdown();
+
+done:
+    xmlCleanupParser();
+    return(res);
+}
@@ -920,6 +920,211 @@ done:
     testFinishedFailure();
 }
 
+static int
+test_buffer_check_tail_zeroed(xmlSecBufferPtr buf) {
+    const xmlSecByte* ptr;
+    xmlSecSize ii;
+
+    ptr = xmlSecBufferGetData(buf);
+    for(ii = xmlSecBufferGetSize(buf); ii < xmlSecBufferGetMaxSize(buf); ++ii) {
+        if(ptr[ii] != 0) {
+            testLog("Error: byte at offset " XMLSEC_SIZE_FMT " is 0x%02x, expected 0x00\n",
+                ii, (unsigned)ptr[ii]);
+            return(0);
+        }
+    }
+    return(1);
+}
+
+static void
+test_buffer_remove_head_reuse(void) {
+    xmlSecBuffer buf;
+    xmlSecByte data[64];
+    xmlSecByte expected[128];
+    xmlSecSize expectedSize = 0;
+    xmlSecSize ii;
+    int ret;
+
+    memset(&buf, 0, sizeof(buf));
+    for(ii = 0; ii < sizeof(data); ++ii) {
+        data[ii] = (xmlSecByte)(ii + 1);
+    }
+
+    testStart("xmlSecBufferRemoveHead - consumed space reuse");
+
+    ret = xmlSecBufferInitialize(&buf, 0);
+    if(ret < 0) {
+        testLog("Error: xmlSecBufferInitialize failed\n");
+        testFinishedFailure();
+        return;
+    }
+
+    /* fill, consume most of it and make sure append reclaims the head space */
+    ret = xmlSecBufferSetData(&buf, data, sizeof(data));
+    if(ret < 0) {
+        testLog("Error: xmlSecBufferSetData failed\n");
+        goto done;
+    }
+    ret = xmlSecBufferRemoveHead(&buf, 60);
+    if(ret < 0) {
+        testLog("Error: xmlSecBufferRemoveHead(60) failed\n");
+        goto done;
+    }
+    memcpy(expected, data + 60, 4);
+    expectedSize = 4;
+    if(!test_buffer_check_tail_zeroed(&buf)) {
+        goto done;
+    }
+
+    /* prepend must use the consumed head space */
+    ret = xmlSecBufferPrepend(&buf, data, 8);
+    if(ret < 0) {
+        testLog("Error: xmlSecBufferPrepend(8) failed\n");
+        goto done;
+    }
+    memmove(expected + 8, expected, expectedSize);
+    memcpy(expected, data, 8);
+    expectedSize += 8;
+
+    /* append more than the current max size to force compaction */
+    ret = xmlSecBufferSetMaxSize(&buf, xmlSecBufferGetSize(&buf) + xmlSecBufferGetMaxSize(&buf) + 1);
+    if(ret < 0) {
+        testLog("Error: xmlSecBufferSetMaxSize failed\n");
+        goto done;
+    }
+    if(!test_buffer_check_tail_zeroed(&buf)) {
+        goto done;
+    }
+    ret = xmlSecBufferAppend(&buf, data, sizeof(data));
+    if(ret < 0) {
+        testLog("Error: xmlSecBufferAppend failed\n");
+        goto done;
+    }
+    memcpy(expected + expectedSize, data, sizeof(data));
+    expectedSize += sizeof(data);
+
+    if(xmlSecBufferGetSize(&buf) != expectedSize) {
+        testLog("Error: size=" XMLSEC_SIZE_FMT " expected=" XMLSEC_SIZE_FMT "\n",
+            xmlSecBufferGetSize(&buf), expectedSize);
+        goto done;
+    }
+    if(memcmp(xmlSecBufferGetData(&buf), expected, expectedSize) != 0) {
+        testLog("Error: data mismatch after RemoveHead/Prepend/Append\n");
+        goto done;
+    }
+
+    /* swap must keep the consumed head space with the data */
+    ret = xmlSecBufferRemoveHead(&buf, 3);
+    if(ret < 0) {
+        testLog("Error: xmlSecBufferRemoveHead(3) failed\n");
+        goto done;
+    }
+    {
+        xmlSecBuffer buf2;
+
+        ret = xmlSecBufferInitialize(&buf2, 0);
+        if(ret < 0) {
+            testLog("Error: xmlSecBufferInitialize(buf2) failed\n");
+            goto done;
+        }
+        xmlSecBufferSwap(&buf, &buf2);
+        xmlSecBufferFinalize(&buf);
+        xmlSecBufferSwap(&buf, &buf2);
+        xmlSecBufferFinalize(&buf2);
+    }
+    if(memcmp(xmlSecBufferGetData(&buf), expected + 3, expectedSize - 3) != 0) {
+        testLog("Error: data mismatch after Swap\n");
+        goto done;
+    }
+
+    /* removing everything returns the whole allocation */
+    ret = xmlSecBufferRemoveHead(&buf, expectedSize);
+    if(ret < 0) {
+        testLog("Error: xmlSecBufferRemoveHead(all) failed\n");
+        goto done;
+    }
+    if(!test_buffer_check_tail_zeroed(&buf)) {
+        goto done;
+    }
+
+    xmlSecBufferFinalize(&buf);
+    testFinishedSuccess();
+    return;
+
+done:
+    xmlSecBufferFinalize(&buf);
+    testFinishedFailure();
+}
+
+static void
+test_buffer_remove_head_drain(void) {
+    xmlSecBuffer buf;
+    const xmlSecSize totalSize = 64 * 1024;
+    const xmlSecSize chunkSize = 64;
+    xmlSecByte chunk[64];
+    xmlSecSize ii, jj;
+    const xmlSecByte* ptr;
+    int ret;
+
+    memset(&buf, 0, sizeof(buf));
+
+    /* see "make bench" for the large buffers */
+    testStart("xmlSecBufferRemoveHead - drain buffer in small chunks");
+
+    ret = xmlSecBufferInitialize(&buf, totalSize);
+    if(ret < 0) {
+        testLog("Error: xmlSecBufferInitialize failed\n");
+        testFinishedFailure();
+        return;
+    }
+    for(ii = 0; ii < totalSize; ii += chunkSize) {
+        for(jj = 0; jj < chunkSize; ++jj) {
+            chunk[jj] = (xmlSecByte)(ii / chunkSize + jj);
+        }
+        ret = xmlSecBufferAppend(&buf, chunk, chunkSize);
+        if(ret < 0) {
+            testLog("Error: xmlSecBufferAppend failed\n");
+            goto done;
+        }
+    }
+
+    /* consume the data and keep appending to the tail like the transforms do */
+    for(ii = 0; ii < totalSize; ii += chunkSize) {
+        ptr = xmlSecBufferGetData(&buf);
+        for(jj = 0; jj < chunkSize; ++jj) {
+            if(ptr[jj] != (xmlSecByte)(ii / chunkSize + jj)) {
+                testLog("Error: data mismatch at offset " XMLSEC_SIZE_FMT "\n", ii + jj);
+                goto done;
+            }
+        }
+        ret = xmlSecBufferRemoveHead(&buf, chunkSize);
+        if(ret < 0) {
+            testLog("Error: xmlSecBufferRemoveHead failed\n");
+            goto done;
+        }
+        if((ii % (2 * chunkSize)) == 0) {
+            ret = xmlSecBufferAppend(&buf, chunk, chunkSize);
+            if(ret < 0) {
+                testLog("Error: xmlSecBufferAppend failed\n");
+                goto done;
+            }
+        }
+    }
+    if(xmlSecBufferGetSize(&buf) != totalSize / 2) {
+        testLog("Error: size=" XMLSEC_SIZE_FMT " expected=" XMLSEC_SIZE_FMT "\n",
+            xmlSecBufferGetSize(&buf), totalSize / 2);
+        goto done;
+    }
+
+    xmlSecBufferFinalize(&buf);
+    testFinishedSuccess();
+    return;
+
+done:
+    xmlSecBufferFinalize(&buf);
+    testFinishedFailure();
+}
+
 static void
 test_buffer_reverse(void) {
     xmlSecBuffer buf;
@@ -1183,6 +1388,8 @@ test_buffer(void) {
     test_buffer_prepend();
     test_buffer_remove_head();
     test_buffer_remove_tail();
+    test_buffer_remove_head_reuse();
+    test_buffer_remove_head_drain();
     test_buffer_reverse();
     test_buffer_hex_read();
 
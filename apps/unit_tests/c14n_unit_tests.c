@@ -0,0 +1,569 @@
+/**
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * This is free software; see the Copyright file in the source distribution for precise wording.
+ *
+ * Copyright (C) 2002-2026 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+/**
+ * @brief XML Security Library C14N transforms unit tests.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libxml/c14n.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+/* must be included before any other xmlsec header */
+#include "xmlsec_unit_tests.h"
+#include <xmlsec/base64.h>
+#include <xmlsec/buffer.h>
+#include <xmlsec/membuf.h>
+#include <xmlsec/nodeset.h>
+#include <xmlsec/parser.h>
+#include <xmlsec/strings.h>
+#include <xmlsec/transforms.h>
+#include <xmlsec/xmltree.h>
+
+/* creates "<Root><Item id="1">...</Item>...</Root>" document with @count items */
+static int
+c14nTestCreateXml(xmlSecBufferPtr xml, int count) {
+    char item[128];
+    int ii;
+    int ret;
+
+    xmlSecAssert2(xml != NULL, -1);
+
+    ret = xmlSecBufferAppend(xml, BAD_CAST "<Root xmlns=\"urn:test\">", 23);
+    if(ret < 0) {
+        return(-1);
+    }
+    for(ii = 0; ii < count; ++ii) {
+        int len = snprintf(item, sizeof(item), "<Item  id=\"%d\" b=\"2\" a=\"1\">text %d &amp; more</Item>\n", ii, ii);
+        if((len <= 0) || ((size_t)len >= sizeof(item))) {
+            return(-1);
+        }
+        ret = xmlSecBufferAppend(xml, BAD_CAST item, (xmlSecSize)len);
+        if(ret < 0) {
+            return(-1);
+        }
+    }
+    ret = xmlSecBufferAppend(xml, BAD_CAST "</Root>", 7);
+    if(ret < 0) {
+        return(-1);
+    }
+    return(0);
+}
+
+/* test transform that, like a digest, collects all its input and outputs it at the end;
+ * it also records the largest chunk added to its input buffer between two executes */
+static xmlSecSize c14nTestCollectSeen = 0;
+static xmlSecSize c14nTestCollectMaxChunk = 0;
+
+static int
+c14nTestCollectExecute(xmlSecTransformPtr transform, int last, xmlSecTransformCtxPtr transformCtx) {
+    xmlSecSize inSize;
+    int ret;
+
+    xmlSecAssert2(transform != NULL, -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    if(transform->status == xmlSecTransformStatusNone) {
+        transform->status = xmlSecTransformStatusWorking;
+    }
+    if(transform->status == xmlSecTransformStatusWorking) {
+        inSize = xmlSecBufferGetSize(&(transform->inBuf));
+        if(inSize - c14nTestCollectSeen > c14nTestCollectMaxChunk) {
+            c14nTestCollectMaxChunk = inSize - c14nTestCollectSeen;
+        }
+        c14nTestCollectSeen = inSize;
+
+        if(last != 0) {
+            ret = xmlSecBufferSetData(&(transform->outBuf), xmlSecBufferGetData(&(transform->inBuf)), inSize);
+            if(ret < 0) {
+                return(-1);
+            }
+            ret = xmlSecBufferRemoveHead(&(transform->inBuf), inSize);
+            if(ret < 0) {
+                return(-1);
+            }
+            transform->status = xmlSecTransformStatusFinished;
+        }
+    } else if(transform->status == xmlSecTransformStatusFinished) {
+        xmlSecAssert2(xmlSecBufferGetSize(&(transform->inBuf)) == 0, -1);
+    } else {
+        return(-1);
+    }
+    return(0);
+}
+
+#define C14N_TEST_COLLECT_KLASS(usage)                                                              \
+    {                                                                                               \
+        sizeof(xmlSecTransformKlass),               /* xmlSecSize klassSize */                      \
+        sizeof(xmlSecTransform),                    /* xmlSecSize objSize */                        \
+        BAD_CAST "test-collect",                    /* const xmlChar* name; */                      \
+        NULL,                                       /* const xmlChar* href; */                      \
+        (usage),                                    /* xmlSecAlgorithmUsage usage; */               \
+        NULL,                                       /* xmlSecTransformInitializeMethod initialize; */ \
+        NULL,                                       /* xmlSecTransformFinalizeMethod finalize; */   \
+        NULL,                                       /* xmlSecTransformNodeReadMethod readNode; */   \
+        NULL,                                       /* xmlSecTransformNodeWriteMethod writeNode; */ \
+        NULL,                                       /* xmlSecTransformSetKeyReqMethod setKeyReq; */ \
+        NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */       \
+        NULL,                                       /* xmlSecTransformValidateMethod validate; */   \
+        xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */ \
+        xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */     \
+        xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */       \
+        NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */     \
+        NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */       \
+        c14nTestCollectExecute,                     /* xmlSecTransformExecuteMethod execute; */     \
+        NULL,                                       /* void* reserved0; */                          \
+        NULL,                                       /* void* reserved1; */                          \
+    }
+
+/* "digest": C14N feeds it directly */
+static xmlSecTransformKlass c14nTestCollectDigestKlass = C14N_TEST_COLLECT_KLASS(xmlSecTransformUsageDigestMethod);
+/* any other transform: C14N output is staged and pulled in chunks */
+static xmlSecTransformKlass c14nTestCollectOtherKlass = C14N_TEST_COLLECT_KLASS(xmlSecTransformUsageDSigTransform);
+
+/* pulls all the data from the last transform in the chain */
+static int
+c14nTestPullAll(xmlSecTransformCtxPtr transformCtx, xmlSecBufferPtr out) {
+    xmlSecByte chunk[48];
+    xmlSecSize chunkSize;
+    int ret;
+
+    xmlSecAssert2(transformCtx != NULL, -1);
+    xmlSecAssert2(transformCtx->last != NULL, -1);
+    xmlSecAssert2(out != NULL, -1);
+
+    do {
+        chunkSize = 0;
+        ret = xmlSecTransformPopBin(transformCtx->last, chunk, sizeof(chunk), &chunkSize, transformCtx);
+        if(ret < 0) {
+            testLog("Error: xmlSecTransformPopBin failed\n");
+            return(-1);
+        }
+        if(chunkSize > 0) {
+            ret = xmlSecBufferAppend(out, chunk, chunkSize);
+            if(ret < 0) {
+                testLog("Error: xmlSecBufferAppend failed\n");
+                return(-1);
+            }
+        }
+    } while(chunkSize > 0);
+    return(0);
+}
+
+/* MemBuf -> XmlParser -> C14N [-> next]: pulls the result from the last transform */
+static int
+c14nTestPullChain(xmlSecBufferPtr xml, xmlSecTransformId nextId, xmlSecBufferPtr out) {
+    xmlSecTransformCtxPtr transformCtx;
+    xmlSecTransformPtr transform;
+    int res = -1;
+    int ret;
+
+    xmlSecAssert2(xml != NULL, -1);
+    xmlSecAssert2(out != NULL, -1);
+
+    transformCtx = xmlSecTransformCtxCreate();
+    if(transformCtx == NULL) {
+        testLog("Error: failed to create transform ctx\n");
+        return(-1);
+    }
+    /* small chunks: the C14N output is fed in many pieces */
+    transformCtx->binaryChunkSize = 16;
+
+    transform = xmlSecTransformCtxCreateAndAppend(transformCtx, xmlSecTransformMemBufId);
+    if(transform == NULL) {
+        testLog("Error: failed to create MemBuf transform\n");
+        goto done;
+    }
+    ret = xmlSecBufferSetData(&(transform->inBuf), xmlSecBufferGetData(xml), xmlSecBufferGetSize(xml));
+    if(ret < 0) {
+        testLog("Error: failed to set MemBuf transform data\n");
+        goto done;
+    }
+    transform = xmlSecTransformCtxCreateAndAppend(transformCtx, xmlSecTransformXmlParserId);
+    if(transform == NULL) {
+        testLog("Error: failed to create XmlParser transform\n");
+        goto done;
+    }
+    transform = xmlSecTransformCtxCreateAndAppend(transformCtx, xmlSecTransformInclC14NId);
+    if(transform == NULL) {
+        testLog("Error: failed to create C14N transform\n");
+        goto done;
+    }
+    if(nextId != xmlSecTransformIdUnknown) {
+        transform = xmlSecTransformCtxCreateAndAppend(transformCtx, nextId);
+        if(transform == NULL) {
+            testLog("Error: failed to create next transform\n");
+            goto done;
+        }
+        transform->operation = xmlSecTransformOperationEncode;
+    }
+    c14nTestCollectSeen = 0;
+    c14nTestCollectMaxChunk = 0;
+
+    ret = c14nTestPullAll(transformCtx, out);
+    if(ret < 0) {
+        goto done;
+    }
+
+    /* success */
+    res = 0;
+
+done:
+    xmlSecTransformCtxDestroy(transformCtx);
+    return(res);
+}
+
+static void
+test_xmlSecTransformC14N_pull_feed_next(void) {
+    xmlSecBuffer xml, staged, fed;
+    xmlChar* expected = NULL;
+    int ret;
+
+    testStart("C14N pull mode feeds the next digest transform");
+
+    if(xmlSecBufferInitialize(&xml, 0) < 0) {
+        testLog("Error: failed to initialize buffer\n");
+        testFinishedFailure();
+        return;
+    }
+    if(xmlSecBufferInitialize(&staged, 0) < 0) {
+        testLog("Error: failed to initialize buffer\n");
+        xmlSecBufferFinalize(&xml);
+        testFinishedFailure();
+        return;
+    }
+    if(xmlSecBufferInitialize(&fed, 0) < 0) {
+        testLog("Error: failed to initialize buffer\n");
+        xmlSecBufferFinalize(&staged);
+        xmlSecBufferFinalize(&xml);
+        testFinishedFailure();
+        return;
+    }
+
+    /* large enough for libxml2 to flush the C14N output several times */
+    ret = c14nTestCreateXml(&xml, 1000);
+    if(ret < 0) {
+        testLog("Error: failed to create test xml\n");
+        goto failed;
+    }
+
+    /* C14N is the last transform: the output is staged in its buffer */
+    ret = c14nTestPullChain(&xml, xmlSecTransformIdUnknown, &staged);
+    if((ret < 0) || (xmlSecBufferGetSize(&staged) <= 0)) {
+        testLog("Error: failed to pull C14N output\n");
+        goto failed;
+    }
+
+    /* "digest" pulls from C14N: the output is fed into its input buffer in large chunks */
+    ret = c14nTestPullChain(&xml, &c14nTestCollectDigestKlass, &fed);
+    if(ret < 0) {
+        testLog("Error: failed to pull C14N + digest output\n");
+        goto failed;
+    }
+    if((xmlSecBufferGetSize(&fed) != xmlSecBufferGetSize(&staged)) ||
+       (memcmp(xmlSecBufferGetData(&fed), xmlSecBufferGetData(&staged), xmlSecBufferGetSize(&fed)) != 0)
+    ) {
+        testLog("Error: C14N output fed to the digest transform doesn't match the staged output\n");
+        goto failed;
+    }
+    if(c14nTestCollectMaxChunk <= 16) {
+        testLog("Error: C14N output was not fed to the digest transform\n");
+        goto failed;
+    }
+
+    /* any other transform pulls from C14N in chunks */
+    xmlSecBufferEmpty(&fed);
+    ret = c14nTestPullChain(&xml, &c14nTestCollectOtherKlass, &fed);
+    if(ret < 0) {
+        testLog("Error: failed to pull C14N + transform output\n");
+        goto failed;
+    }
+    if((xmlSecBufferGetSize(&fed) != xmlSecBufferGetSize(&staged)) ||
+       (memcmp(xmlSecBufferGetData(&fed), xmlSecBufferGetData(&staged), xmlSecBufferGetSize(&fed)) != 0)
+    ) {
+        testLog("Error: C14N output pulled by the transform doesn't match the staged output\n");
+        goto failed;
+    }
+    if(c14nTestCollectMaxChunk > 16) {
+        testLog("Error: C14N output was fed to the transform with streamed output\n");
+        goto failed;
+    }
+
+    /* Base64 pulls from C14N in chunks */
+    xmlSecBufferEmpty(&fed);
+    ret = c14nTestPullChain(&xml, xmlSecTransformBase64Id, &fed);
+    if(ret < 0) {
+        testLog("Error: failed to pull C14N + Base64 output\n");
+        goto failed;
+    }
+
+    expected = xmlSecBase64Encode(xmlSecBufferGetData(&staged), xmlSecBufferGetSize(&staged),
+        xmlSecBase64GetDefaultLineSize());
+    if(expected == NULL) {
+        testLog("Error: failed to base64 encode C14N output\n");
+        goto failed;
+    }
+    if((xmlSecBufferGetSize(&fed) != (xmlSecSize)xmlStrlen(expected)) ||
+       (memcmp(xmlSecBufferGetData(&fed), expected, xmlSecBufferGetSize(&fed)) != 0)
+    ) {
+        testLog("Error: C14N + Base64 output doesn't match the staged output\n");
+        goto failed;
+    }
+
+    xmlFree(expected);
+    xmlSecBufferFinalize(&fed);
+    xmlSecBufferFinalize(&staged);
+    xmlSecBufferFinalize(&xml);
+    testFinishedSuccess();
+    return;
+
+failed:
+    if(expected != NULL) {
+        xmlFree(expected);
+    }
+    xmlSecBufferFinalize(&fed);
+    xmlSecBufferFinalize(&staged);
+    xmlSecBufferFinalize(&xml);
+    testFinishedFailure();
+}
+
+static const char c14nTestEnvelopedXml[] =
+    "<!-- before -->\n"
+    "<Root xmlns=\"urn:test\" xmlns:x=\"urn:x\">"
+    "<!-- c1 -->"
+    "<A id=\"a\" x:attr=\"1\">text<B>b<!-- c2 --></B>"
+    "<Signature xmlns=\"http://www.w3.org/2000/09/xmldsig#\">"
+    "<SignedInfo><Reference URI=\"\"><Transforms>"
+    "<Transform Algorithm=\"http://www.w3.org/2000/09/xmldsig#enveloped-signature\"/>"
+    "</Transforms></Reference></SignedInfo>"
+    "<!-- signature comment -->signature text"
+    "</Signature>"
+    "tail<C x:attr=\"2\"/></A>"
+    "<D>after<!-- c3 --></D>"
+    "</Root>\n"
+    "<!-- after -->";
+
+/* canonicalizes @nodes minus the signature subtree checking every node against the nodes sets */
+static int
+c14nTestExpected(xmlNodePtr signatureNode, xmlSecNodeSetPtr nodes, int mode, int withComments, xmlSecBufferPtr out) {
+    xmlSecNodeSetPtr children;
+    xmlOutputBufferPtr buf;
+    int ret;
+
+    xmlSecAssert2(signatureNode != NULL, -1);
+    xmlSecAssert2(nodes != NULL, -1);
+    xmlSecAssert2(out != NULL, -1);
+
+    /* the same nodes set as the enveloped signature transform creates */
+    children = xmlSecNodeSetGetChildren(signatureNode->doc, signatureNode, 1, 1);
+    if(children == NULL) {
+        testLog("Error: failed to get signature children\n");
+        return(-1);
+    }
+    if(xmlSecNodeSetAdd(nodes, children, xmlSecNodeSetIntersection) == NULL) {
+        testLog("Error: failed to add nodes set\n");
+        xmlSecNodeSetDestroy(children);
+        return(-1);
+    }
+
+    buf = xmlSecBufferCreateOutputBuffer(out);
+    if(buf == NULL) {
+        testLog("Error: failed to create output buffer\n");
+        return(-1);
+    }
+    ret = xmlC14NExecute(nodes->doc, (xmlC14NIsVisibleCallback)xmlSecNodeSetContains, nodes,
+        mode, NULL, withComments, buf);
+    if(ret < 0) {
+        testLog("Error: xmlC14NExecute failed\n");
+        (void)xmlOutputBufferClose(buf);
+        return(-1);
+    }
+    ret = xmlOutputBufferClose(buf);
+    if(ret < 0) {
+        testLog("Error: xmlOutputBufferClose failed\n");
+        return(-1);
+    }
+    return(0);
+}
+
+/* Enveloped -> C14N chain */
+static int
+c14nTestEnveloped(xmlNodePtr hereNode, xmlSecNodeSetPtr nodes, xmlSecTransformId c14nId, xmlSecBufferPtr out) {
+    xmlSecTransformCtxPtr transformCtx;
+    xmlSecTransformPtr transform;
+    xmlSecBufferPtr result;
+    int res = -1;
+    int ret;
+
+    xmlSecAssert2(hereNode != NULL, -1);
+    xmlSecAssert2(nodes != NULL, -1);
+    xmlSecAssert2(out != NULL, -1);
+
+    transformCtx = xmlSecTransformCtxCreate();
+    if(transformCtx == NULL) {
+        testLog("Error: failed to create transform ctx\n");
+        return(-1);
+    }
+    transform = xmlSecTransformCtxCreateAndAppend(transformCtx, xmlSecTransformEnvelopedId);
+    if(transform == NULL) {
+        testLog("Error: failed to create Enveloped transform\n");
+        goto done;
+    }
+    transform->hereNode = hereNode;
+    transform = xmlSecTransformCtxCreateAndAppend(transformCtx, c14nId);
+    if(transform == NULL) {
+        testLog("Error: failed to create C14N transform\n");
+        goto done;
+    }
+
+    ret = xmlSecTransformCtxXmlExecute(transformCtx, nodes);
+    if(ret < 0) {
+        testLog("Error: failed to execute transforms\n");
+        goto done;
+    }
+    result = transformCtx->result;
+    if(result == NULL) {
+        testLog("Error: no transforms result\n");
+        goto done;
+    }
+    ret = xmlSecBufferSetData(out, xmlSecBufferGetData(result), xmlSecBufferGetSize(result));
+    if(ret < 0) {
+        testLog("Error: failed to copy transforms result\n");
+        goto done;
+    }
+
+    /* success */
+    res = 0;
+
+done:
+    xmlSecTransformCtxDestroy(transformCtx);
+    return(res);
+}
+
+static void
+test_xmlSecTransformC14N_enveloped(const char* name, const xmlChar* nodeName, int withComments,
+    xmlSecTransformId c14nId, int mode
+) {
+    xmlDocPtr doc = NULL;
+    xmlNodePtr node = NULL;
+    xmlNodePtr signatureNode, hereNode;
+    xmlSecNodeSetPtr nodes = NULL;
+    xmlSecBuffer expected, actual;
+    int ret;
+
+    testStart(name);
+
+    if(xmlSecBufferInitialize(&expected, 0) < 0) {
+        testLog("Error: failed to initialize buffer\n");
+        testFinishedFailure();
+        return;
+    }
+    if(xmlSecBufferInitialize(&actual, 0) < 0) {
+        testLog("Error: failed to initialize buffer\n");
+        xmlSecBufferFinalize(&expected);
+        testFinishedFailure();
+        return;
+    }
+
+    doc = xmlReadMemory(c14nTestEnvelopedXml, (int)strlen(c14nTestEnvelopedXml), "c14n.xml", NULL, XML_PARSE_NONET);
+    if(doc == NULL) {
+        testLog("Error: failed to parse XML\n");
+        goto failed;
+    }
+    signatureNode = xmlSecFindNode(xmlDocGetRootElement(doc), xmlSecNodeSignature, xmlSecDSigNs);
+    hereNode = xmlSecFindNode(xmlDocGetRootElement(doc), xmlSecNodeTransform, xmlSecDSigNs);
+    if((signatureNode == NULL) || (hereNode == NULL)) {
+        testLog("Error: failed to find Signature or Transform node\n");
+        goto failed;
+    }
+    /* the whole document or the @nodeName subtree */
+    if(nodeName != NULL) {
+        node = xmlSecFindNode(xmlDocGetRootElement(doc), nodeName, BAD_CAST "urn:test");
+        if(node == NULL) {
+            testLog("Error: failed to find the reference node\n");
+            goto failed;
+        }
+    }
+
+    /* expected */
+    nodes = xmlSecNodeSetGetChildren(doc, node, withComments, 0);
+    if(nodes == NULL) {
+        testLog("Error: failed to create nodes set\n");
+        goto failed;
+    }
+    ret = c14nTestExpected(signatureNode, nodes, mode, withComments, &expected);
+    xmlSecNodeSetDestroy(nodes);
+    nodes = NULL;
+    if(ret < 0) {
+        goto failed;
+    }
+
+    /* actual */
+    nodes = xmlSecNodeSetGetChildren(doc, node, withComments, 0);
+    if(nodes == NULL) {
+        testLog("Error: failed to create nodes set\n");
+        goto failed;
+    }
+    ret = c14nTestEnveloped(hereNode, nodes, c14nId, &actual);
+    xmlSecNodeSetDestroy(nodes);
+    nodes = NULL;
+    if(ret < 0) {
+        goto failed;
+    }
+
+    /* compare */
+    if((xmlSecBufferGetSize(&expected) <= 0) ||
+       (xmlSecBufferGetSize(&actual) != xmlSecBufferGetSize(&expected)) ||
+       (memcmp(xmlSecBufferGetData(&actual), xmlSecBufferGetData(&expected), xmlSecBufferGetSize(&expected)) != 0)
+    ) {
+        testLog("Error: enveloped signature C14N output doesn't match the expected output\n");
+        goto failed;
+    }
+    if(xmlStrstr(BAD_CAST xmlSecBufferGetData(&actual), BAD_CAST "signature") != NULL) {
+        testLog("Error: enveloped signature C14N output contains the signature\n");
+        goto failed;
+    }
+
+    xmlSecBufferFinalize(&actual);
+    xmlSecBufferFinalize(&expected);
+    xmlFreeDoc(doc);
+    testFinishedSuccess();
+    return;
+
+failed:
+    xmlSecBufferFinalize(&actual);
+    xmlSecBufferFinalize(&expected);
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    testFinishedFailure();
+}
+
+int
+test_c14n(void) {
+    testGroupStart("c14n");
+
+    test_xmlSecTransformC14N_pull_feed_next();
+
+    test_xmlSecTransformC14N_enveloped("C14N enveloped signature: whole document",
+        NULL, 0, xmlSecTransformInclC14NId, XML_C14N_1_0);
+    test_xmlSecTransformC14N_enveloped("C14N enveloped signature: whole document with comments",
+        NULL, 1, xmlSecTransformInclC14NWithCommentsId, XML_C14N_1_0);
+    test_xmlSecTransformC14N_enveloped("C14N enveloped signature: whole document, C14N 1.1",
+        NULL, 0, xmlSecTransformInclC14N11Id, XML_C14N_1_1);
+    test_xmlSecTransformC14N_enveloped("C14N enveloped signature: whole document, exclusive C14N",
+        NULL, 0, xmlSecTransformExclC14NId, XML_C14N_EXCLUSIVE_1_0);
+    test_xmlSecTransformC14N_enveloped("C14N enveloped signature: subtree",
+        BAD_CAST "A", 0, xmlSecTransformInclC14NId, XML_C14N_1_0);
+    test_xmlSecTransformC14N_enveloped("C14N enveloped signature: subtree with comments, exclusive C14N",
+        BAD_CAST "A", 1, xmlSecTransformExclC14NWithCommentsId, XML_C14N_EXCLUSIVE_1_0);
+
+    return(testGroupFinished());
+}
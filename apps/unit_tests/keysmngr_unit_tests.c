@@ -0,0 +1,1019 @@
+/**
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * This is free software; see the Copyright file in the source distribution for precise wording.
+ *
+ * Copyright (C) 2002-2026 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+/**
+ * @brief XML Security Library keys stores unit tests.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+/* must be included before any other xmlsec header */
+#include "xmlsec_unit_tests.h"
+#include <xmlsec/buffer.h>
+#include <xmlsec/keys.h>
+#include <xmlsec/keyinfo.h>
+#include <xmlsec/keysdata.h>
+#include <xmlsec/keysmngr.h>
+#include <xmlsec/errors.h>
+#include <xmlsec/list.h>
+#include <xmlsec/private.h>
+
+/******************************************************************************
+ * test key data: no crypto, just a serial number to identify the key
+  *****************************************************************************/
+typedef struct _keysmngrTestKeyData {
+    xmlSecKeyData       data;
+    int                 serial;
+} keysmngrTestKeyData;
+
+static int
+keysmngrTestKeyDataInitialize(xmlSecKeyDataPtr data) {
+    ((keysmngrTestKeyData*)data)->serial = -1;
+    return(0);
+}
+
+static int
+keysmngrTestKeyDataDuplicate(xmlSecKeyDataPtr dst, xmlSecKeyDataPtr src) {
+    ((keysmngrTestKeyData*)dst)->serial = ((keysmngrTestKeyData*)src)->serial;
+    return(0);
+}
+
+static xmlSecKeyDataType
+keysmngrTestKeyDataGetType(xmlSecKeyDataPtr data XMLSEC_ATTRIBUTE_UNUSED) {
+    UNREFERENCED_PARAMETER(data);
+    return(xmlSecKeyDataTypeSymmetric);
+}
+
+#define KEYSMNGR_TEST_KEY_DATA_KLASS(name)                                      \
+    {                                                                           \
+        sizeof(xmlSecKeyDataKlass),                                             \
+        sizeof(keysmngrTestKeyData),                                            \
+        BAD_CAST (name),                                                        \
+        xmlSecKeyDataUsageAny,                                                  \
+        NULL, NULL, NULL,                                                       \
+        keysmngrTestKeyDataInitialize,                                          \
+        keysmngrTestKeyDataDuplicate,                                           \
+        NULL, NULL,                                                             \
+        keysmngrTestKeyDataGetType,                                             \
+        NULL, NULL,                                                             \
+        NULL, NULL, NULL, NULL,                                                 \
+        NULL, NULL,                                                             \
+        NULL, NULL                                                              \
+    }
+
+static xmlSecKeyDataKlass keysmngrTestKeyDataKlassA = KEYSMNGR_TEST_KEY_DATA_KLASS("test-a");
+static xmlSecKeyDataKlass keysmngrTestKeyDataKlassB = KEYSMNGR_TEST_KEY_DATA_KLASS("test-b");
+
+/* the same test key data but saved in the <TestKeyValue/> node */
+static int keysmngrTestKeysRead = 0;
+
+static int
+keysmngrTestKeyDataXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key, xmlNodePtr node,
+    xmlSecKeyInfoCtxPtr keyInfoCtx XMLSEC_ATTRIBUTE_UNUSED
+) {
+    xmlSecKeyDataPtr data;
+    xmlChar* content;
+
+    UNREFERENCED_PARAMETER(keyInfoCtx);
+
+    content = xmlNodeGetContent(node);
+    if(content == NULL) {
+        return(-1);
+    }
+    data = xmlSecKeyDataCreate(id);
+    if(data == NULL) {
+        xmlFree(content);
+        return(-1);
+    }
+    ((keysmngrTestKeyData*)data)->serial = atoi((const char*)content);
+    xmlFree(content);
+
+    if(xmlSecKeySetValue(key, data) < 0) {
+        xmlSecKeyDataDestroy(data);
+        return(-1);
+    }
+    ++keysmngrTestKeysRead;
+    return(0);
+}
+
+static int
+keysmngrTestKeyDataXmlWrite(xmlSecKeyDataId id XMLSEC_ATTRIBUTE_UNUSED, xmlSecKeyPtr key, xmlNodePtr node,
+    xmlSecKeyInfoCtxPtr keyInfoCtx XMLSEC_ATTRIBUTE_UNUSED
+) {
+    xmlChar buf[64];
+
+    UNREFERENCED_PARAMETER(id);
+    UNREFERENCED_PARAMETER(keyInfoCtx);
+
+    if(xmlSecKeyGetValue(key) == NULL) {
+        return(-1);
+    }
+    (void)snprintf((char*)buf, sizeof(buf), "%d", ((keysmngrTestKeyData*)xmlSecKeyGetValue(key))->serial);
+    xmlNodeSetContent(node, buf);
+    return(0);
+}
+
+#define KEYSMNGR_TEST_XML_KEY_DATA_KLASS(name, nodeName)                        \
+    {                                                                           \
+        sizeof(xmlSecKeyDataKlass),                                             \
+        sizeof(keysmngrTestKeyData),                                            \
+        BAD_CAST (name),                                                        \
+        xmlSecKeyDataUsageAny,                                                  \
+        NULL, BAD_CAST (nodeName), BAD_CAST "urn:xmlsec:unit-tests",            \
+        keysmngrTestKeyDataInitialize,                                          \
+        keysmngrTestKeyDataDuplicate,                                           \
+        NULL, NULL,                                                             \
+        keysmngrTestKeyDataGetType,                                             \
+        NULL, NULL,                                                             \
+        keysmngrTestKeyDataXmlRead, keysmngrTestKeyDataXmlWrite, NULL, NULL,    \
+        NULL, NULL,                                                             \
+        NULL, NULL                                                              \
+    }
+
+static xmlSecKeyDataKlass keysmngrTestKeyDataKlassXmlA = KEYSMNGR_TEST_XML_KEY_DATA_KLASS("test-xml-a", "TestKeyValueA");
+static xmlSecKeyDataKlass keysmngrTestKeyDataKlassXmlB = KEYSMNGR_TEST_XML_KEY_DATA_KLASS("test-xml-b", "TestKeyValueB");
+
+static xmlSecKeyPtr
+keysmngrTestCreateKey(const xmlChar* name, xmlSecKeyDataId dataId, xmlSecKeyUsage usage, int serial) {
+    xmlSecKeyPtr key;
+    xmlSecKeyDataPtr data;
+
+    data = xmlSecKeyDataCreate(dataId);
+    if(data == NULL) {
+        return(NULL);
+    }
+    ((keysmngrTestKeyData*)data)->serial = serial;
+
+    key = xmlSecKeyCreate();
+    if(key == NULL) {
+        xmlSecKeyDataDestroy(data);
+        return(NULL);
+    }
+    if(xmlSecKeySetValue(key, data) < 0) {
+        xmlSecKeyDataDestroy(data);
+        xmlSecKeyDestroy(key);
+        return(NULL);
+    }
+    if((name != NULL) && (xmlSecKeySetName(key, name) < 0)) {
+        xmlSecKeyDestroy(key);
+        return(NULL);
+    }
+    key->usage = usage;
+    return(key);
+}
+
+/* returns the found key serial, -1 if the key is not found or -2 if an error occurs */
+static int
+keysmngrTestFindKey(xmlSecKeyStorePtr store, const xmlChar* name, xmlSecKeyDataId keyId, xmlSecKeyUsage keyUsage) {
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlSecKeyPtr key;
+    int serial;
+
+    memset(&keyInfoCtx, 0, sizeof(keyInfoCtx));
+    keyInfoCtx.keyReq.keyId    = keyId;
+    keyInfoCtx.keyReq.keyType  = xmlSecKeyDataTypeAny;
+    keyInfoCtx.keyReq.keyUsage = keyUsage;
+
+    key = xmlSecKeyStoreFindKey(store, name, &keyInfoCtx);
+    if(key == NULL) {
+        return(-1);
+    }
+    if(xmlSecKeyGetValue(key) == NULL) {
+        xmlSecKeyDestroy(key);
+        return(-2);
+    }
+    serial = ((keysmngrTestKeyData*)xmlSecKeyGetValue(key))->serial;
+    xmlSecKeyDestroy(key);
+    return(serial);
+}
+
+/* adds the same keys to the stores */
+static int
+keysmngrTestAddKeys(xmlSecKeyStorePtr store1, xmlSecKeyStorePtr store2, xmlSecSize count) {
+    xmlChar name[64];
+    xmlSecKeyPtr key;
+    xmlSecKeyDataId dataId;
+    xmlSecKeyUsage usage;
+    xmlSecSize ii;
+    int serial;
+
+    for(ii = 0; ii < count; ++ii) {
+        /* duplicate names, two key data klasses, various usages and some keys without names */
+        (void)snprintf((char*)name, sizeof(name), "key-%u", (unsigned int)(ii / 3));
+        dataId = ((ii % 2) == 0) ? &keysmngrTestKeyDataKlassA : &keysmngrTestKeyDataKlassB;
+        usage = ((ii % 5) == 0) ? xmlSecKeyUsageSign : xmlSecKeyUsageAny;
+        serial = (int)ii;
+
+        key = keysmngrTestCreateKey(((ii % 7) != 0) ? name : NULL, dataId, usage, serial);
+        if(key == NULL) {
+            return(-1);
+        }
+        if(xmlSecSimpleKeysStoreAdoptKey(store1, key) < 0) {
+            xmlSecKeyDestroy(key);
+            return(-1);
+        }
+        if(store2 == NULL) {
+            continue;
+        }
+
+        key = keysmngrTestCreateKey(((ii % 7) != 0) ? name : NULL, dataId, usage, serial);
+        if(key == NULL) {
+            return(-1);
+        }
+        if(xmlSecSimpleKeysStoreAdoptKey(store2, key) < 0) {
+            xmlSecKeyDestroy(key);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/******************************************************************************
+ * xmlSecIndexedKeysStore
+  *****************************************************************************/
+static void
+test_xmlSecIndexedKeysStore_same_as_simple(void) {
+    static const xmlSecKeyUsage usages[] = { xmlSecKeyUsageAny, xmlSecKeyUsageSign, xmlSecKeyUsageEncrypt };
+    xmlSecKeyDataId dataIds[] = { xmlSecKeyDataIdUnknown, &keysmngrTestKeyDataKlassA, &keysmngrTestKeyDataKlassB };
+    xmlSecKeyStorePtr simpleStore = NULL;
+    xmlSecKeyStorePtr indexedStore = NULL;
+    xmlChar name[64];
+    xmlSecSize ii, jj, kk;
+    int res1, res2;
+
+    testStart("xmlSecIndexedKeysStore: finds the same keys as simple keys store");
+
+    simpleStore = xmlSecKeyStoreCreate(xmlSecSimpleKeysStoreId);
+    indexedStore = xmlSecKeyStoreCreate(xmlSecIndexedKeysStoreId);
+    if((simpleStore == NULL) || (indexedStore == NULL)) {
+        testLog("Error: failed to create keys stores\n");
+        goto error;
+    }
+    if(keysmngrTestAddKeys(simpleStore, indexedStore, 100) < 0) {
+        testLog("Error: failed to add keys\n");
+        goto error;
+    }
+
+    /* the last name is not in the stores; the last iteration is for NULL name */
+    for(ii = 0; ii <= 36; ++ii) {
+        (void)snprintf((char*)name, sizeof(name), "key-%u", (unsigned int)ii);
+        for(jj = 0; jj < sizeof(dataIds) / sizeof(dataIds[0]); ++jj) {
+            for(kk = 0; kk < sizeof(usages) / sizeof(usages[0]); ++kk) {
+                res1 = keysmngrTestFindKey(simpleStore, (ii < 36) ? name : NULL, dataIds[jj], usages[kk]);
+                res2 = keysmngrTestFindKey(indexedStore, (ii < 36) ? name : NULL, dataIds[jj], usages[kk]);
+                if((res1 != res2) || (res1 < -1)) {
+                    testLog("Error: name=%s, keyId=%u, usage=%u: simple store found %d, indexed store found %d\n",
+                        (ii < 36) ? (char*)name : "NULL", (unsigned int)jj, (unsigned int)usages[kk], res1, res2);
+                    goto error;
+                }
+            }
+        }
+    }
+
+    xmlSecKeyStoreDestroy(simpleStore);
+    xmlSecKeyStoreDestroy(indexedStore);
+    testFinishedSuccess();
+    return;
+
+error:
+    if(simpleStore != NULL) {
+        xmlSecKeyStoreDestroy(simpleStore);
+    }
+    if(indexedStore != NULL) {
+        xmlSecKeyStoreDestroy(indexedStore);
+    }
+    testFinishedFailure();
+}
+
+static void
+test_xmlSecIndexedKeysStore_list_changed(void) {
+    xmlSecKeyStorePtr store = NULL;
+    xmlSecPtrListPtr list;
+    xmlSecKeyPtr key;
+    int res;
+
+    testStart("xmlSecIndexedKeysStore: keys added directly to the keys list are found");
+
+    store = xmlSecKeyStoreCreate(xmlSecIndexedKeysStoreId);
+    if(store == NULL) {
+        testLog("Error: failed to create keys store\n");
+        goto error;
+    }
+    if(keysmngrTestAddKeys(store, NULL, 10) < 0) {
+        testLog("Error: failed to add keys\n");
+        goto error;
+    }
+
+    list = xmlSecSimpleKeysStoreGetKeys(store);
+    key = keysmngrTestCreateKey(BAD_CAST "direct", &keysmngrTestKeyDataKlassA, xmlSecKeyUsageAny, 1000);
+    if((list == NULL) || (key == NULL)) {
+        testLog("Error: failed to create key\n");
+        goto error;
+    }
+    if(xmlSecPtrListAdd(list, key) < 0) {
+        testLog("Error: failed to add key to the list\n");
+        xmlSecKeyDestroy(key);
+        goto error;
+    }
+
+    res = keysmngrTestFindKey(store, BAD_CAST "direct", &keysmngrTestKeyDataKlassA, xmlSecKeyUsageAny);
+    if(res != 1000) {
+        testLog("Error: expected key 1000, found %d\n", res);
+        goto error;
+    }
+
+    /* the keys added after that are still found */
+    key = keysmngrTestCreateKey(BAD_CAST "adopted", &keysmngrTestKeyDataKlassB, xmlSecKeyUsageAny, 1001);
+    if((key == NULL) || (xmlSecSimpleKeysStoreAdoptKey(store, key) < 0)) {
+        testLog("Error: failed to adopt key\n");
+        if(key != NULL) {
+            xmlSecKeyDestroy(key);
+        }
+        goto error;
+    }
+    res = keysmngrTestFindKey(store, BAD_CAST "adopted", xmlSecKeyDataIdUnknown, xmlSecKeyUsageAny);
+    if(res != 1001) {
+        testLog("Error: expected key 1001, found %d\n", res);
+        goto error;
+    }
+
+    xmlSecKeyStoreDestroy(store);
+    testFinishedSuccess();
+    return;
+
+error:
+    if(store != NULL) {
+        xmlSecKeyStoreDestroy(store);
+    }
+    testFinishedFailure();
+}
+
+static void
+test_xmlSecKeyRef_copied_lookups(void) {
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlSecKeyStorePtr store = NULL;
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlSecKeyPtr storeKey = NULL;
+    xmlSecKeyPtr key = NULL;
+
+    testStart("xmlSecKeyRef: lookups return copies of the keys by default");
+
+    mngr = xmlSecKeysMngrCreate();
+    store = xmlSecKeyStoreCreate(xmlSecIndexedKeysStoreId);
+    storeKey = keysmngrTestCreateKey(BAD_CAST "copied", &keysmngrTestKeyDataKlassA, xmlSecKeyUsageAny, 1);
+    if((mngr == NULL) || (store == NULL) || (storeKey == NULL)) {
+        testLog("Error: failed to create keys manager, keys store or key\n");
+        goto error;
+    }
+    if(xmlSecSimpleKeysStoreAdoptKey(store, storeKey) < 0) {
+        testLog("Error: failed to add key\n");
+        goto error;
+    }
+
+    memset(&keyInfoCtx, 0, sizeof(keyInfoCtx));
+    keyInfoCtx.keysMngr        = mngr;
+    keyInfoCtx.keyReq.keyType  = xmlSecKeyDataTypeAny;
+    keyInfoCtx.keyReq.keyUsage = xmlSecKeyUsageAny;
+
+    key = xmlSecKeyStoreFindKey(store, BAD_CAST "copied", &keyInfoCtx);
+    if((key == NULL) || (key == storeKey) || (xmlSecKeyIsShared(storeKey) != 0)) {
+        testLog("Error: expected a copy of the store key\n");
+        goto error;
+    }
+
+    /* the copy can be changed */
+    if(xmlSecKeySetName(key, BAD_CAST "changed") < 0) {
+        testLog("Error: failed to change the key copy name\n");
+        goto error;
+    }
+    if(!xmlStrEqual(xmlSecKeyGetName(storeKey), BAD_CAST "copied")) {
+        testLog("Error: the store key was changed\n");
+        goto error;
+    }
+
+    xmlSecKeyDestroy(key);
+    xmlSecKeyStoreDestroy(store);
+    xmlSecKeysMngrDestroy(mngr);
+    testFinishedSuccess();
+    return;
+
+error:
+    if(key != NULL) {
+        xmlSecKeyDestroy(key);
+    }
+    if(store != NULL) {
+        xmlSecKeyStoreDestroy(store);
+    } else if(storeKey != NULL) {
+        xmlSecKeyDestroy(storeKey);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    testFinishedFailure();
+}
+
+static void
+test_xmlSecKeyRef_shared_lookups(void) {
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlSecKeyStorePtr store = NULL;
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlSecKeyPtr storeKey = NULL;
+    xmlSecKeyPtr key1 = NULL;
+    xmlSecKeyPtr key2 = NULL;
+
+    testStart("xmlSecKeyRef: lookups return the shared keys if requested");
+
+    mngr = xmlSecKeysMngrCreate();
+    store = xmlSecKeyStoreCreate(xmlSecIndexedKeysStoreId);
+    storeKey = keysmngrTestCreateKey(BAD_CAST "shared", &keysmngrTestKeyDataKlassA, xmlSecKeyUsageAny, 1);
+    if((mngr == NULL) || (store == NULL) || (storeKey == NULL)) {
+        testLog("Error: failed to create keys manager, keys store or key\n");
+        goto error;
+    }
+    if(xmlSecSimpleKeysStoreAdoptKey(store, storeKey) < 0) {
+        testLog("Error: failed to add key\n");
+        goto error;
+    }
+    mngr->flags |= XMLSEC_KEYSMNGR_FLAGS_SHARE_KEYS;
+
+    memset(&keyInfoCtx, 0, sizeof(keyInfoCtx));
+    keyInfoCtx.keysMngr        = mngr;
+    keyInfoCtx.keyReq.keyType  = xmlSecKeyDataTypeAny;
+    keyInfoCtx.keyReq.keyUsage = xmlSecKeyUsageAny;
+
+    key1 = xmlSecKeyStoreFindKey(store, BAD_CAST "shared", &keyInfoCtx);
+    key2 = xmlSecKeyStoreFindKey(store, BAD_CAST "shared", &keyInfoCtx);
+    if((key1 != storeKey) || (key2 != storeKey)) {
+        testLog("Error: expected the store key to be returned\n");
+        goto error;
+    }
+    if(xmlSecKeyIsShared(key1) != 1) {
+        testLog("Error: expected the key to be shared\n");
+        goto error;
+    }
+
+    /* releasing the reference keeps the store key */
+    xmlSecKeyDestroy(key2);
+    key2 = NULL;
+    if(keysmngrTestFindKey(store, BAD_CAST "shared", &keysmngrTestKeyDataKlassA, xmlSecKeyUsageAny) != 1) {
+        testLog("Error: the store key is not found after releasing the reference\n");
+        goto error;
+    }
+
+    /* copy on write */
+    key1 = xmlSecKeyEnsureWritable(key1);
+    if((key1 == NULL) || (key1 == storeKey) || (xmlSecKeyIsShared(key1) != 0)) {
+        testLog("Error: expected a writable copy of the key\n");
+        goto error;
+    }
+    if(xmlSecKeySetName(key1, BAD_CAST "changed") < 0) {
+        testLog("Error: failed to change the key copy name\n");
+        goto error;
+    }
+    if((xmlSecKeyIsShared(storeKey) != 0) || (!xmlStrEqual(xmlSecKeyGetName(storeKey), BAD_CAST "shared"))) {
+        testLog("Error: the store key was changed\n");
+        goto error;
+    }
+    if(xmlSecKeyEnsureWritable(key1) != key1) {
+        testLog("Error: expected the not shared key to be returned as-is\n");
+        goto error;
+    }
+
+    xmlSecKeyDestroy(key1);
+    xmlSecKeyStoreDestroy(store);
+    xmlSecKeysMngrDestroy(mngr);
+    testFinishedSuccess();
+    return;
+
+error:
+    if(key1 != NULL) {
+        xmlSecKeyDestroy(key1);
+    }
+    if(key2 != NULL) {
+        xmlSecKeyDestroy(key2);
+    }
+    if(store != NULL) {
+        xmlSecKeyStoreDestroy(store);
+    } else if(storeKey != NULL) {
+        xmlSecKeyDestroy(storeKey);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    testFinishedFailure();
+}
+
+static const char keysmngrTestKeyNameXml[] =
+    "<KeyInfo xmlns=\"http://www.w3.org/2000/09/xmldsig#\"><KeyName>shared</KeyName></KeyInfo>";
+
+static void
+test_xmlSecKeyRef_key_name_lookup(void) {
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlSecKeyStorePtr store;
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlSecKeyPtr storeKey = NULL;
+    xmlSecKeyPtr key = NULL;
+    xmlDocPtr doc = NULL;
+    int keyInfoCtxInitialized = 0;
+    int ret;
+
+    testStart("xmlSecKeyRef: the key found by KeyName is copied or shared");
+
+    if(xmlSecKeyDataIdsInit() < 0) {
+        testLog("Error: failed to initialize key data klasses\n");
+        testFinishedFailure();
+        return;
+    }
+
+    mngr = xmlSecKeysMngrCreate();
+    store = xmlSecKeyStoreCreate(xmlSecIndexedKeysStoreId);
+    if((mngr == NULL) || (store == NULL)) {
+        testLog("Error: failed to create keys manager or keys store\n");
+        if(store != NULL) {
+            xmlSecKeyStoreDestroy(store);
+        }
+        goto error;
+    }
+    if(xmlSecKeysMngrAdoptKeysStore(mngr, store) < 0) {
+        testLog("Error: failed to add keys store\n");
+        xmlSecKeyStoreDestroy(store);
+        goto error;
+    }
+    storeKey = keysmngrTestCreateKey(BAD_CAST "shared", &keysmngrTestKeyDataKlassA, xmlSecKeyUsageAny, 1);
+    if((storeKey == NULL) || (xmlSecSimpleKeysStoreAdoptKey(store, storeKey) < 0)) {
+        testLog("Error: failed to add key\n");
+        if(storeKey != NULL) {
+            xmlSecKeyDestroy(storeKey);
+        }
+        goto error;
+    }
+    mngr->getKey = xmlSecKeysMngrGetKey;
+
+    doc = xmlReadMemory(keysmngrTestKeyNameXml, (int)strlen(keysmngrTestKeyNameXml), "keyname.xml", NULL, XML_PARSE_NONET);
+    if(doc == NULL) {
+        testLog("Error: failed to parse the KeyInfo\n");
+        goto error;
+    }
+
+    ret = xmlSecKeyInfoCtxInitialize(&keyInfoCtx, mngr);
+    if(ret < 0) {
+        testLog("Error: failed to initialize KeyInfo context\n");
+        goto error;
+    }
+    keyInfoCtxInitialized = 1;
+    keyInfoCtx.mode = xmlSecKeyInfoModeRead;
+    keyInfoCtx.keyReq.keyType  = xmlSecKeyDataTypeAny;
+    keyInfoCtx.keyReq.keyUsage = xmlSecKeyUsageAny;
+
+    /* by default, the keys manager returns the copy of the store key found by name */
+    key = (mngr->getKey)(xmlDocGetRootElement(doc), &keyInfoCtx);
+    if((key == NULL) || (key == storeKey) || (xmlSecKeyIsShared(storeKey) != 0) ||
+       (xmlSecKeyGetValue(key) == NULL) || (((keysmngrTestKeyData*)xmlSecKeyGetValue(key))->serial != 1)
+    ) {
+        testLog("Error: expected a copy of the store key to be returned\n");
+        goto error;
+    }
+    xmlSecKeyDestroy(key);
+    key = NULL;
+
+    /* the keys manager returns the store key without copying it if requested */
+    mngr->flags |= XMLSEC_KEYSMNGR_FLAGS_SHARE_KEYS;
+    key = (mngr->getKey)(xmlDocGetRootElement(doc), &keyInfoCtx);
+    if((key != storeKey) || (xmlSecKeyIsShared(key) != 1)) {
+        testLog("Error: expected the store key to be returned\n");
+        goto error;
+    }
+    xmlSecKeyDestroy(key);
+    key = NULL;
+
+    /* the caller's key is filled with a copy */
+    key = xmlSecKeyCreate();
+    if(key == NULL) {
+        testLog("Error: failed to create key\n");
+        goto error;
+    }
+    ret = xmlSecKeyInfoNodeRead(xmlDocGetRootElement(doc), key, &keyInfoCtx);
+    if((ret < 0) || (xmlSecKeyGetValue(key) == NULL) ||
+       (((keysmngrTestKeyData*)xmlSecKeyGetValue(key))->serial != 1) ||
+       (!xmlStrEqual(xmlSecKeyGetName(key), BAD_CAST "shared")) ||
+       (xmlSecKeyIsShared(storeKey) != 0)
+    ) {
+        testLog("Error: expected a copy of the store key\n");
+        goto error;
+    }
+
+    xmlSecKeyDestroy(key);
+    xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+    xmlFreeDoc(doc);
+    xmlSecKeysMngrDestroy(mngr);
+    xmlSecKeyDataIdsShutdown();
+    testFinishedSuccess();
+    return;
+
+error:
+    if(key != NULL) {
+        xmlSecKeyDestroy(key);
+    }
+    if(keyInfoCtxInitialized != 0) {
+        xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    xmlSecKeyDataIdsShutdown();
+    testFinishedFailure();
+}
+
+/******************************************************************************
+ * Keys snapshot
+  *****************************************************************************/
+#define KEYSMNGR_TEST_SNAPSHOT_KEYS_NUMBER      300
+#define KEYSMNGR_TEST_SNAPSHOT_FILENAME         "keysmngr_unit_tests.snapshot"
+#define KEYSMNGR_TEST_SNAPSHOT_XML_FILENAME     "keysmngr_unit_tests.xml"
+
+/* the <KeyInfo/> nodes are processed using the global key data klasses list */
+static int
+keysmngrTestSnapshotInit(void) {
+    if(xmlSecKeyDataIdsInit() < 0) {
+        return(-1);
+    }
+    if((xmlSecKeyDataIdsRegister(&keysmngrTestKeyDataKlassXmlA) < 0) ||
+       (xmlSecKeyDataIdsRegister(&keysmngrTestKeyDataKlassXmlB) < 0)) {
+        xmlSecKeyDataIdsShutdown();
+        return(-1);
+    }
+    return(0);
+}
+
+static void
+keysmngrTestSnapshotShutdown(void) {
+    (void)remove(KEYSMNGR_TEST_SNAPSHOT_FILENAME);
+    (void)remove(KEYSMNGR_TEST_SNAPSHOT_XML_FILENAME);
+    xmlSecKeyDataIdsShutdown();
+}
+
+/* saves the same keys as the keys snapshot and as the XML file */
+static int
+keysmngrTestSnapshotSave(void) {
+    xmlChar name[64];
+    xmlSecKeyStorePtr store;
+    xmlSecKeyPtr key;
+    xmlSecKeyDataId dataId;
+    xmlSecSize ii;
+
+    store = xmlSecKeyStoreCreate(xmlSecSimpleKeysStoreId);
+    if(store == NULL) {
+        return(-1);
+    }
+    for(ii = 0; ii < KEYSMNGR_TEST_SNAPSHOT_KEYS_NUMBER; ++ii) {
+        /* duplicate names, two key data klasses and some keys without names */
+        (void)snprintf((char*)name, sizeof(name), "key-%u", (unsigned int)(ii / 3));
+        dataId = ((ii % 2) == 0) ? &keysmngrTestKeyDataKlassXmlA : &keysmngrTestKeyDataKlassXmlB;
+
+        key = keysmngrTestCreateKey(((ii % 7) != 0) ? name : NULL, dataId, xmlSecKeyUsageAny, (int)ii);
+        if((key == NULL) || (xmlSecSimpleKeysStoreAdoptKey(store, key) < 0)) {
+            if(key != NULL) {
+                xmlSecKeyDestroy(key);
+            }
+            xmlSecKeyStoreDestroy(store);
+            return(-1);
+        }
+    }
+    if((xmlSecSimpleKeysStoreSaveSnapshot(store, KEYSMNGR_TEST_SNAPSHOT_FILENAME, xmlSecKeyDataTypeAny) < 0) ||
+       (xmlSecSimpleKeysStoreSave(store, KEYSMNGR_TEST_SNAPSHOT_XML_FILENAME, xmlSecKeyDataTypeAny) < 0)) {
+        xmlSecKeyStoreDestroy(store);
+        return(-1);
+    }
+    xmlSecKeyStoreDestroy(store);
+    return(0);
+}
+
+static void
+test_xmlSecKeysSnapshot_same_as_xml(void) {
+    static const xmlSecKeyDataId keyIds[] = { NULL, &keysmngrTestKeyDataKlassXmlA, &keysmngrTestKeyDataKlassXmlB };
+    xmlSecKeyStorePtr xmlStore = NULL;
+    xmlSecKeyStorePtr indexedStore = NULL;
+    xmlSecKeyStorePtr simpleStore = NULL;
+    xmlChar name[64];
+    xmlSecSize ii, jj;
+    int res1, res2, res3;
+
+    testStart("xmlSecKeysSnapshot: the keys are the same as in the keys XML file");
+
+    if(keysmngrTestSnapshotInit() < 0) {
+        testLog("Error: failed to initialize key data klasses\n");
+        testFinishedFailure();
+        return;
+    }
+    if(keysmngrTestSnapshotSave() < 0) {
+        testLog("Error: failed to save keys\n");
+        goto error;
+    }
+    xmlStore = xmlSecKeyStoreCreate(xmlSecSimpleKeysStoreId);
+    indexedStore = xmlSecKeyStoreCreate(xmlSecIndexedKeysStoreId);
+    simpleStore = xmlSecKeyStoreCreate(xmlSecSimpleKeysStoreId);
+    if((xmlStore == NULL) || (indexedStore == NULL) || (simpleStore == NULL)) {
+        testLog("Error: failed to create keys stores\n");
+        goto error;
+    }
+    if(xmlSecSimpleKeysStoreLoad(xmlStore, KEYSMNGR_TEST_SNAPSHOT_XML_FILENAME, NULL) < 0) {
+        testLog("Error: failed to load keys XML file\n");
+        goto error;
+    }
+
+    /* the indexed keys store only reads the index */
+    keysmngrTestKeysRead = 0;
+    if(xmlSecSimpleKeysStoreLoadSnapshot(indexedStore, KEYSMNGR_TEST_SNAPSHOT_FILENAME) < 0) {
+        testLog("Error: failed to load keys snapshot in the indexed keys store\n");
+        goto error;
+    }
+    if(keysmngrTestKeysRead != 0) {
+        testLog("Error: expected no keys read, got %d\n", keysmngrTestKeysRead);
+        goto error;
+    }
+
+    /* the name lookup reads only the keys with this name: "key-4" is used by the keys 12 and 13 (but not 14) */
+    res1 = keysmngrTestFindKey(xmlStore, BAD_CAST "key-4", &keysmngrTestKeyDataKlassXmlB, xmlSecKeyUsageAny);
+    res2 = keysmngrTestFindKey(indexedStore, BAD_CAST "key-4", &keysmngrTestKeyDataKlassXmlB, xmlSecKeyUsageAny);
+    if((res1 != 13) || (res1 != res2)) {
+        testLog("Error: name lookup, expected key %d, found %d\n", res1, res2);
+        goto error;
+    }
+    if(keysmngrTestKeysRead != 2) {
+        testLog("Error: expected 2 keys read, got %d\n", keysmngrTestKeysRead);
+        goto error;
+    }
+
+    /* the klass lookup reads all the keys */
+    res1 = keysmngrTestFindKey(xmlStore, NULL, &keysmngrTestKeyDataKlassXmlB, xmlSecKeyUsageAny);
+    res2 = keysmngrTestFindKey(indexedStore, NULL, &keysmngrTestKeyDataKlassXmlB, xmlSecKeyUsageAny);
+    if((res1 < 0) || (res1 != res2)) {
+        testLog("Error: klass lookup, expected key %d, found %d\n", res1, res2);
+        goto error;
+    }
+    if(keysmngrTestKeysRead != KEYSMNGR_TEST_SNAPSHOT_KEYS_NUMBER) {
+        testLog("Error: expected %d keys read, got %d\n", KEYSMNGR_TEST_SNAPSHOT_KEYS_NUMBER, keysmngrTestKeysRead);
+        goto error;
+    }
+
+    /* the simple keys store reads everything right away */
+    if(xmlSecSimpleKeysStoreLoadSnapshot(simpleStore, KEYSMNGR_TEST_SNAPSHOT_FILENAME) < 0) {
+        testLog("Error: failed to load keys snapshot in the simple keys store\n");
+        goto error;
+    }
+    if(xmlSecPtrListGetSize(xmlSecSimpleKeysStoreGetKeys(simpleStore)) != KEYSMNGR_TEST_SNAPSHOT_KEYS_NUMBER) {
+        testLog("Error: not all keys were read\n");
+        goto error;
+    }
+
+    for(ii = 0; ii < KEYSMNGR_TEST_SNAPSHOT_KEYS_NUMBER / 3 + 2; ++ii) {
+        (void)snprintf((char*)name, sizeof(name), "key-%u", (unsigned int)ii);
+        for(jj = 0; jj < sizeof(keyIds) / sizeof(keyIds[0]); ++jj) {
+            res1 = keysmngrTestFindKey(xmlStore, name, keyIds[jj], xmlSecKeyUsageAny);
+            res2 = keysmngrTestFindKey(indexedStore, name, keyIds[jj], xmlSecKeyUsageAny);
+            res3 = keysmngrTestFindKey(simpleStore, name, keyIds[jj], xmlSecKeyUsageAny);
+            if((res1 < -1) || (res1 != res2) || (res1 != res3)) {
+                testLog("Error: name=%s, keyId=%u: expected key %d, found %d and %d\n",
+                    (const char*)name, (unsigned int)jj, res1, res2, res3);
+                goto error;
+            }
+        }
+    }
+
+    /* the keys are in the same order as in the keys XML file */
+    if(xmlSecPtrListGetSize(xmlSecSimpleKeysStoreGetKeys(indexedStore)) != KEYSMNGR_TEST_SNAPSHOT_KEYS_NUMBER) {
+        testLog("Error: not all keys were read\n");
+        goto error;
+    }
+    for(ii = 0; ii < KEYSMNGR_TEST_SNAPSHOT_KEYS_NUMBER; ++ii) {
+        xmlSecKeyPtr key1 = (xmlSecKeyPtr)xmlSecPtrListGetItem(xmlSecSimpleKeysStoreGetKeys(xmlStore), ii);
+        xmlSecKeyPtr key2 = (xmlSecKeyPtr)xmlSecPtrListGetItem(xmlSecSimpleKeysStoreGetKeys(indexedStore), ii);
+        if((key1 == NULL) || (key2 == NULL) ||
+           (((keysmngrTestKeyData*)xmlSecKeyGetValue(key1))->serial != ((keysmngrTestKeyData*)xmlSecKeyGetValue(key2))->serial)
+        ) {
+            testLog("Error: the key %u is different\n", (unsigned int)ii);
+            goto error;
+        }
+    }
+
+    xmlSecKeyStoreDestroy(xmlStore);
+    xmlSecKeyStoreDestroy(indexedStore);
+    xmlSecKeyStoreDestroy(simpleStore);
+    keysmngrTestSnapshotShutdown();
+    testFinishedSuccess();
+    return;
+
+error:
+    if(xmlStore != NULL) {
+        xmlSecKeyStoreDestroy(xmlStore);
+    }
+    if(indexedStore != NULL) {
+        xmlSecKeyStoreDestroy(indexedStore);
+    }
+    if(simpleStore != NULL) {
+        xmlSecKeyStoreDestroy(simpleStore);
+    }
+    keysmngrTestSnapshotShutdown();
+    testFinishedFailure();
+}
+
+static void
+test_xmlSecKeysSnapshot_keys_added_later(void) {
+    xmlSecKeyStorePtr store = NULL;
+    xmlSecKeyPtr key = NULL;
+    xmlSecPtrListPtr keys;
+    int res;
+
+    testStart("xmlSecKeysSnapshot: the keys added after the snapshot go after the snapshot keys");
+
+    if(keysmngrTestSnapshotInit() < 0) {
+        testLog("Error: failed to initialize key data klasses\n");
+        testFinishedFailure();
+        return;
+    }
+    if(keysmngrTestSnapshotSave() < 0) {
+        testLog("Error: failed to save keys\n");
+        goto error;
+    }
+    store = xmlSecKeyStoreCreate(xmlSecIndexedKeysStoreId);
+    if(store == NULL) {
+        testLog("Error: failed to create keys store\n");
+        goto error;
+    }
+    if(xmlSecSimpleKeysStoreLoadSnapshot(store, KEYSMNGR_TEST_SNAPSHOT_FILENAME) < 0) {
+        testLog("Error: failed to load keys snapshot\n");
+        goto error;
+    }
+
+    /* the same name and klass as the snapshot key 13 */
+    key = keysmngrTestCreateKey(BAD_CAST "key-4", &keysmngrTestKeyDataKlassXmlB, xmlSecKeyUsageAny,
+        KEYSMNGR_TEST_SNAPSHOT_KEYS_NUMBER);
+    if((key == NULL) || (xmlSecSimpleKeysStoreAdoptKey(store, key) < 0)) {
+        testLog("Error: failed to add key\n");
+        goto error;
+    }
+    key = NULL;
+
+    res = keysmngrTestFindKey(store, BAD_CAST "key-4", &keysmngrTestKeyDataKlassXmlB, xmlSecKeyUsageAny);
+    if(res != 13) {
+        testLog("Error: expected the snapshot key 13, found %d\n", res);
+        goto error;
+    }
+
+    keys = xmlSecSimpleKeysStoreGetKeys(store);
+    if((keys == NULL) || (xmlSecPtrListGetSize(keys) != KEYSMNGR_TEST_SNAPSHOT_KEYS_NUMBER + 1)) {
+        testLog("Error: unexpected keys number\n");
+        goto error;
+    }
+    key = (xmlSecKeyPtr)xmlSecPtrListGetItem(keys, KEYSMNGR_TEST_SNAPSHOT_KEYS_NUMBER);
+    if((key == NULL) || (((keysmngrTestKeyData*)xmlSecKeyGetValue(key))->serial != KEYSMNGR_TEST_SNAPSHOT_KEYS_NUMBER)) {
+        testLog("Error: expected the added key to be the last one\n");
+        key = NULL;
+        goto error;
+    }
+    key = NULL;
+
+    xmlSecKeyStoreDestroy(store);
+    keysmngrTestSnapshotShutdown();
+    testFinishedSuccess();
+    return;
+
+error:
+    if(key != NULL) {
+        xmlSecKeyDestroy(key);
+    }
+    if(store != NULL) {
+        xmlSecKeyStoreDestroy(store);
+    }
+    keysmngrTestSnapshotShutdown();
+    testFinishedFailure();
+}
+
+/* flips one byte in the snapshot file and tries to load it */
+static int
+keysmngrTestSnapshotCorrupt(xmlSecBufferPtr snapshot, xmlSecSize pos) {
+    xmlSecKeyStorePtr store;
+    FILE* f;
+    int res;
+
+    xmlSecBufferGetData(snapshot)[pos] ^= 0x01;
+    f = fopen(KEYSMNGR_TEST_SNAPSHOT_FILENAME, "wb");
+    if(f != NULL) {
+        (void)fwrite(xmlSecBufferGetData(snapshot), 1, xmlSecBufferGetSize(snapshot), f);
+        fclose(f);
+    }
+    xmlSecBufferGetData(snapshot)[pos] ^= 0x01;
+    if(f == NULL) {
+        return(-2);
+    }
+
+    store = xmlSecKeyStoreCreate(xmlSecIndexedKeysStoreId);
+    if(store == NULL) {
+        return(-2);
+    }
+    res = xmlSecSimpleKeysStoreLoadSnapshot(store, KEYSMNGR_TEST_SNAPSHOT_FILENAME);
+    if(res >= 0) {
+        /* the last key is corrupted */
+        res = keysmngrTestFindKey(store, BAD_CAST "key-99", NULL, xmlSecKeyUsageAny);
+    }
+    xmlSecKeyStoreDestroy(store);
+    return(res);
+}
+
+static void
+test_xmlSecKeysSnapshot_corrupted(void) {
+    xmlSecBuffer snapshot;
+    xmlSecSize size;
+    int res;
+
+    testStart("xmlSecKeysSnapshot: the corrupted snapshots are rejected");
+
+    if(keysmngrTestSnapshotInit() < 0) {
+        testLog("Error: failed to initialize key data klasses\n");
+        testFinishedFailure();
+        return;
+    }
+    if(xmlSecBufferInitialize(&snapshot, 0) < 0) {
+        testLog("Error: failed to initialize buffer\n");
+        keysmngrTestSnapshotShutdown();
+        testFinishedFailure();
+        return;
+    }
+    if((keysmngrTestSnapshotSave() < 0) || (xmlSecBufferReadFile(&snapshot, KEYSMNGR_TEST_SNAPSHOT_FILENAME) < 0)) {
+        testLog("Error: failed to save keys snapshot\n");
+        goto error;
+    }
+    size = xmlSecBufferGetSize(&snapshot);
+
+    /* magic, header, index */
+    res = keysmngrTestSnapshotCorrupt(&snapshot, 0);
+    if(res != -1) {
+        testLog("Error: corrupted magic, expected failure, got %d\n", res);
+        goto error;
+    }
+    res = keysmngrTestSnapshotCorrupt(&snapshot, 13);
+    if(res != -1) {
+        testLog("Error: corrupted header, expected failure, got %d\n", res);
+        goto error;
+    }
+    res = keysmngrTestSnapshotCorrupt(&snapshot, 40);
+    if(res != -1) {
+        testLog("Error: corrupted index, expected failure, got %d\n", res);
+        goto error;
+    }
+
+    /* the last key: the snapshot is loaded but the key is not */
+    res = keysmngrTestSnapshotCorrupt(&snapshot, size - 20);
+    if(res != -1) {
+        testLog("Error: corrupted key, expected key not found, got %d\n", res);
+        goto error;
+    }
+
+    xmlSecBufferFinalize(&snapshot);
+    keysmngrTestSnapshotShutdown();
+    testFinishedSuccess();
+    return;
+
+error:
+    xmlSecBufferFinalize(&snapshot);
+    keysmngrTestSnapshotShutdown();
+    testFinishedFailure();
+}
+
+/******************************************************************************
+ * exported entry point
+  *****************************************************************************/
+int
+test_keysmngr(void) {
+    int success = 1;
+
+    testGroupStart("xmlSecIndexedKeysStore");
+    test_xmlSecIndexedKeysStore_same_as_simple();
+    test_xmlSecIndexedKeysStore_list_changed();
+    if(testGroupFinished() != 1) { success = 0; }
+
+    testGroupStart("xmlSecKeyRef");
+    test_xmlSecKeyRef_copied_lookups();
+    test_xmlSecKeyRef_shared_lookups();
+    test_xmlSecKeyRef_key_name_lookup();
+    if(testGroupFinished() != 1) { success = 0; }
+
+    testGroupStart("xmlSecKeysSnapshot");
+    test_xmlSecKeysSnapshot_same_as_xml();
+    test_xmlSecKeysSnapshot_keys_added_later();
+    test_xmlSecKeysSnapshot_corrupted();
+    if(testGroupFinished() != 1) { success = 0; }
+
+    return(success);
+}
@@ -194,6 +194,429 @@ test_xmlSecNodeSetContains_null_nodeset_allows_node(void) {
     testFinishedSuccess();
 }
 
+static xmlNodeSetPtr
+nodesetTestEvalXPath(xmlDocPtr doc, const char* expr) {
+    xmlXPathContextPtr ctx;
+    xmlXPathObjectPtr obj;
+    xmlNodeSetPtr nodes;
+
+    xmlSecAssert2(doc != NULL, NULL);
+    xmlSecAssert2(expr != NULL, NULL);
+
+    ctx = xmlXPathNewContext(doc);
+    if(ctx == NULL) {
+        testLog("Error: failed to create XPath context\n");
+        return(NULL);
+    }
+    obj = xmlXPathEvalExpression(BAD_CAST expr, ctx);
+    xmlXPathFreeContext(ctx);
+    if((obj == NULL) || (obj->type != XPATH_NODESET) || (obj->nodesetval == NULL)) {
+        testLog("Error: failed to evaluate XPath expression '%s'\n", expr);
+        xmlXPathFreeObject(obj);
+        return(NULL);
+    }
+
+    /* take the ownership of the nodes list */
+    nodes = obj->nodesetval;
+    obj->nodesetval = NULL;
+    xmlXPathFreeObject(obj);
+    return(nodes);
+}
+
+static void
+test_xmlSecNodeSetContains_indexed_normal_and_invert(void) {
+    xmlDocPtr doc;
+    xmlNodePtr root;
+    xmlNodePtr cur;
+    xmlNodeSetPtr nodes;
+    xmlNodeSetPtr invertNodes;
+    xmlSecNodeSetPtr nset = NULL;
+    xmlSecNodeSetPtr invertNset = NULL;
+    xmlBufferPtr xml;
+    int ii, expected;
+
+    testStart("xmlSecNodeSetContains with indexed Normal and Invert sets");
+
+    /* more items than XMLSEC_NODESET_INDEX_MIN_SIZE to use the index */
+    xml = xmlBufferCreate();
+    if(xml == NULL) {
+        testLog("Error: failed to create buffer\n");
+        testFinishedFailure();
+        return;
+    }
+    xmlBufferCCat(xml, "<Root xmlns:a=\"urn:a\" xmlns:b=\"urn:b\">");
+    for(ii = 0; ii < 64; ++ii) {
+        char item[64];
+        snprintf(item, sizeof(item), "<a:Item n=\"%d\">text</a:Item>", ii);
+        xmlBufferCCat(xml, item);
+    }
+    xmlBufferCCat(xml, "</Root>");
+    doc = nodesetTestParseDoc((const char*)xmlBufferContent(xml));
+    xmlBufferFree(xml);
+    if(doc == NULL) {
+        testFinishedFailure();
+        return;
+    }
+    root = xmlDocGetRootElement(doc);
+
+    /* even items with their attributes and "a" namespace node */
+    nodes = nodesetTestEvalXPath(doc,
+        "//*[@n mod 2 = 0] | //*[@n mod 2 = 0]/@* | //*[@n mod 2 = 0]/namespace::a");
+    invertNodes = nodesetTestEvalXPath(doc,
+        "//*[@n mod 2 = 0] | //*[@n mod 2 = 0]/@* | //*[@n mod 2 = 0]/namespace::a");
+    if((root == NULL) || (root->nsDef == NULL) || (root->nsDef->next == NULL) ||
+       (nodes == NULL) || (invertNodes == NULL) || (nodes->nodeNr != 96)
+    ) {
+        testLog("Error: failed to prepare indexed nodes set test data\n");
+        if(nodes != NULL) { xmlXPathFreeNodeSet(nodes); }
+        if(invertNodes != NULL) { xmlXPathFreeNodeSet(invertNodes); }
+        xmlFreeDoc(doc);
+        testFinishedFailure();
+        return;
+    }
+    nset = xmlSecNodeSetCreate(doc, nodes, xmlSecNodeSetNormal);
+    if(nset == NULL) {
+        xmlXPathFreeNodeSet(nodes);
+        xmlXPathFreeNodeSet(invertNodes);
+        xmlFreeDoc(doc);
+        testFinishedFailure();
+        return;
+    }
+    invertNset = xmlSecNodeSetCreate(doc, invertNodes, xmlSecNodeSetInvert);
+    if(invertNset == NULL) {
+        xmlXPathFreeNodeSet(invertNodes);
+        xmlSecNodeSetDestroy(nset);
+        xmlFreeDoc(doc);
+        testFinishedFailure();
+        return;
+    }
+
+    for(cur = root->children, ii = 0; cur != NULL; cur = cur->next, ++ii) {
+        expected = ((ii % 2) == 0) ? 1 : 0;
+        if((xmlSecNodeSetContains(nset, cur, root) != expected) ||
+           (xmlSecNodeSetContains(nset, (xmlNodePtr)cur->properties, cur) != expected) ||
+           (xmlSecNodeSetContains(nset, (xmlNodePtr)root->nsDef, cur) != expected) ||
+           (xmlSecNodeSetContains(nset, (xmlNodePtr)root->nsDef->next, cur) != 0) ||
+           (xmlSecNodeSetContains(nset, cur->children, cur) != 0) ||
+           (xmlSecNodeSetContains(invertNset, cur, root) != !expected) ||
+           (xmlSecNodeSetContains(invertNset, (xmlNodePtr)cur->properties, cur) != !expected) ||
+           (xmlSecNodeSetContains(invertNset, (xmlNodePtr)root->nsDef, cur) != !expected) ||
+           (xmlSecNodeSetContains(invertNset, cur->children, cur) != 1)
+        ) {
+            testLog("Error: unexpected membership for item %d\n", ii);
+            xmlSecNodeSetDestroy(nset);
+            xmlSecNodeSetDestroy(invertNset);
+            xmlFreeDoc(doc);
+            testFinishedFailure();
+            return;
+        }
+    }
+    if((xmlSecNodeSetContains(nset, root, root->parent) != 0) ||
+       (xmlSecNodeSetContains(nset, (xmlNodePtr)root->nsDef, root) != 0) ||
+       (xmlSecNodeSetContains(invertNset, root, root->parent) != 1)) {
+        testLog("Error: unexpected membership for the root node\n");
+        xmlSecNodeSetDestroy(nset);
+        xmlSecNodeSetDestroy(invertNset);
+        xmlFreeDoc(doc);
+        testFinishedFailure();
+        return;
+    }
+
+    xmlSecNodeSetDestroy(nset);
+    xmlSecNodeSetDestroy(invertNset);
+    xmlFreeDoc(doc);
+    testFinishedSuccess();
+}
+
+/* see "make bench" for the large sets */
+#define NODESET_TEST_LARGE_SET_SIZE     1000
+
+static void
+test_xmlSecNodeSetContains_large_set_and_rebuild(void) {
+    xmlDocPtr doc;
+    xmlNodePtr root;
+    xmlNodePtr cur;
+    xmlNodePtr last = NULL;
+    xmlNodeSetPtr nodes;
+    xmlSecNodeSetPtr nset;
+    int ii, expected;
+
+    testStart("xmlSecNodeSetContains on a large nodes set and after the set is changed");
+
+    doc = xmlNewDoc(BAD_CAST "1.0");
+    root = (doc != NULL) ? xmlNewDocNode(doc, NULL, BAD_CAST "Root", NULL) : NULL;
+    nodes = xmlXPathNodeSetCreate(NULL);
+    if((doc == NULL) || (root == NULL) || (nodes == NULL)) {
+        testLog("Error: failed to create document\n");
+        if(nodes != NULL) { xmlXPathFreeNodeSet(nodes); }
+        if(root != NULL) { xmlFreeNode(root); }
+        if(doc != NULL) { xmlFreeDoc(doc); }
+        testFinishedFailure();
+        return;
+    }
+    xmlDocSetRootElement(doc, root);
+
+    /* every other node is in the set (except the last one) */
+    for(ii = 0; ii < NODESET_TEST_LARGE_SET_SIZE; ++ii) {
+        cur = xmlNewChild(root, NULL, BAD_CAST "Item", NULL);
+        if(cur == NULL) {
+            testLog("Error: failed to create node %d\n", ii);
+            xmlXPathFreeNodeSet(nodes);
+            xmlFreeDoc(doc);
+            testFinishedFailure();
+            return;
+        }
+        if(((ii % 2) == 0) && (ii < NODESET_TEST_LARGE_SET_SIZE - 2)) {
+            if(xmlXPathNodeSetAddUnique(nodes, cur) < 0) {
+                testLog("Error: failed to add node %d\n", ii);
+                xmlXPathFreeNodeSet(nodes);
+                xmlFreeDoc(doc);
+                testFinishedFailure();
+                return;
+            }
+        }
+        last = cur;
+    }
+    nset = xmlSecNodeSetCreate(doc, nodes, xmlSecNodeSetNormal);
+    if(nset == NULL) {
+        xmlXPathFreeNodeSet(nodes);
+        xmlFreeDoc(doc);
+        testFinishedFailure();
+        return;
+    }
+
+    for(cur = root->children, ii = 0; cur != NULL; cur = cur->next, ++ii) {
+        expected = (((ii % 2) == 0) && (ii < NODESET_TEST_LARGE_SET_SIZE - 2)) ? 1 : 0;
+        if(xmlSecNodeSetContains(nset, cur, root) != expected) {
+            testLog("Error: unexpected membership for item %d\n", ii);
+            xmlSecNodeSetDestroy(nset);
+            xmlFreeDoc(doc);
+            testFinishedFailure();
+            return;
+        }
+    }
+
+    /* the index must be rebuilt when the nodes list changes */
+    if((xmlXPathNodeSetAddUnique(nodes, last) < 0) || (xmlSecNodeSetContains(nset, last, root) != 1)) {
+        testLog("Error: node added after the first lookup is not found\n");
+        xmlSecNodeSetDestroy(nset);
+        xmlFreeDoc(doc);
+        testFinishedFailure();
+        return;
+    }
+
+    xmlSecNodeSetDestroy(nset);
+    xmlFreeDoc(doc);
+    testFinishedSuccess();
+}
+
+static void
+test_xmlSecNodeSetContains_tree_deep_subtrees(void) {
+    xmlDocPtr doc;
+    xmlNodePtr root;
+    xmlNodePtr a, b, c, cur;
+    xmlNodePtr chain[100];
+    xmlNodeSetPtr nodes;
+    xmlSecNodeSetPtr nset;
+    xmlSecNodeSetPtr invertNset;
+    int ii, expected;
+
+    testStart("xmlSecNodeSetContains with Tree and TreeInvert sets on a deep document");
+
+    doc = nodesetTestParseDoc("<Root><A/><B attr=\"1\"><BChild/></B><C><CChild>text</CChild></C></Root>");
+    if(doc == NULL) {
+        testFinishedFailure();
+        return;
+    }
+    root = xmlDocGetRootElement(doc);
+    a = nodesetTestFindChild(root, BAD_CAST "A");
+    b = nodesetTestFindChild(root, BAD_CAST "B");
+    c = nodesetTestFindChild(root, BAD_CAST "C");
+    if((a == NULL) || (b == NULL) || (c == NULL) || (b->properties == NULL)) {
+        testLog("Error: failed to prepare tree test data\n");
+        xmlFreeDoc(doc);
+        testFinishedFailure();
+        return;
+    }
+
+    /* a deep chain of elements with attributes under A */
+    for(ii = 0, cur = a; ii < 100; ++ii) {
+        cur = xmlNewChild(cur, NULL, BAD_CAST "D", BAD_CAST "text");
+        if((cur == NULL) || (xmlNewProp(cur, BAD_CAST "n", BAD_CAST "v") == NULL)) {
+            testLog("Error: failed to create node %d\n", ii);
+            xmlFreeDoc(doc);
+            testFinishedFailure();
+            return;
+        }
+        chain[ii] = cur;
+    }
+
+    /* nested subtrees (chain[50] and chain[60]), a sibling subtree (C) and
+     * a non-element node (B attribute) which only contains itself */
+    nodes = xmlXPathNodeSetCreate(chain[60]);
+    if((nodes == NULL) ||
+       (xmlXPathNodeSetAdd(nodes, c) < 0) ||
+       (xmlXPathNodeSetAdd(nodes, (xmlNodePtr)b->properties) < 0) ||
+       (xmlXPathNodeSetAdd(nodes, chain[50]) < 0)
+    ) {
+        testLog("Error: failed to create XPath node set\n");
+        if(nodes != NULL) { xmlXPathFreeNodeSet(nodes); }
+        xmlFreeDoc(doc);
+        testFinishedFailure();
+        return;
+    }
+    /* more nodes inside chain[50] subtree to build the document order index */
+    for(ii = 70; ii < 90; ++ii) {
+        if(xmlXPathNodeSetAdd(nodes, chain[ii]) < 0) {
+            testLog("Error: failed to add node %d\n", ii);
+            xmlXPathFreeNodeSet(nodes);
+            xmlFreeDoc(doc);
+            testFinishedFailure();
+            return;
+        }
+    }
+    nset = xmlSecNodeSetCreate(doc, nodes, xmlSecNodeSetTree);
+    if(nset == NULL) {
+        xmlXPathFreeNodeSet(nodes);
+        xmlFreeDoc(doc);
+        testFinishedFailure();
+        return;
+    }
+    nodes = xmlXPathNodeSetMerge(NULL, nset->nodes);
+    invertNset = (nodes != NULL) ? xmlSecNodeSetCreate(doc, nodes, xmlSecNodeSetTreeInvert) : NULL;
+    if(invertNset == NULL) {
+        testLog("Error: failed to create inverted node set\n");
+        if(nodes != NULL) { xmlXPathFreeNodeSet(nodes); }
+        xmlSecNodeSetDestroy(nset);
+        xmlFreeDoc(doc);
+        testFinishedFailure();
+        return;
+    }
+
+    for(ii = 0; ii < 100; ++ii) {
+        expected = (ii >= 50) ? 1 : 0;
+        cur = chain[ii];
+        if((xmlSecNodeSetContains(nset, cur, cur->parent) != expected) ||
+           (xmlSecNodeSetContains(nset, (xmlNodePtr)cur->properties, cur) != expected) ||
+           (xmlSecNodeSetContains(nset, cur->children, cur) != expected) ||
+           (xmlSecNodeSetContains(invertNset, cur, cur->parent) != !expected) ||
+           (xmlSecNodeSetContains(invertNset, cur->children, cur) != !expected)
+        ) {
+            testLog("Error: unexpected membership for the chain node %d\n", ii);
+            xmlSecNodeSetDestroy(nset);
+            xmlSecNodeSetDestroy(invertNset);
+            xmlFreeDoc(doc);
+            testFinishedFailure();
+            return;
+        }
+    }
+    if((xmlSecNodeSetContains(nset, root, root->parent) != 0) ||
+       (xmlSecNodeSetContains(nset, a, root) != 0) ||
+       (xmlSecNodeSetContains(nset, b, root) != 0) ||
+       (xmlSecNodeSetContains(nset, (xmlNodePtr)b->properties, b) != 1) ||
+       (xmlSecNodeSetContains(nset, b->children, b) != 0) ||
+       (xmlSecNodeSetContains(nset, c, root) != 1) ||
+       (xmlSecNodeSetContains(nset, c->children, c) != 1) ||
+       (xmlSecNodeSetContains(nset, c->children->children, c->children) != 1) ||
+       (xmlSecNodeSetContains(invertNset, root, root->parent) != 1) ||
+       (xmlSecNodeSetContains(invertNset, b->children, b) != 1) ||
+       (xmlSecNodeSetContains(invertNset, c->children, c) != 0)
+    ) {
+        testLog("Error: unexpected membership for the top level nodes\n");
+        xmlSecNodeSetDestroy(nset);
+        xmlSecNodeSetDestroy(invertNset);
+        xmlFreeDoc(doc);
+        testFinishedFailure();
+        return;
+    }
+
+    xmlSecNodeSetDestroy(nset);
+    xmlSecNodeSetDestroy(invertNset);
+    xmlFreeDoc(doc);
+    testFinishedSuccess();
+}
+
+static void
+test_xmlSecNodeSetContains_tree_detached_and_modified(void) {
+    xmlDocPtr doc;
+    xmlNodePtr root;
+    xmlNodePtr detached = NULL;
+    xmlNodePtr detachedChild;
+    xmlNodePtr added;
+    xmlSecNodeSetPtr nset;
+    xmlSecNodeSetPtr tmp;
+
+    testStart("xmlSecNodeSetContains with Tree sets for nodes outside of the document tree");
+
+    doc = nodesetTestParseDoc("<Root><Signature><SignedInfo/></Signature><Data/></Root>");
+    if(doc == NULL) {
+        testFinishedFailure();
+        return;
+    }
+    root = xmlDocGetRootElement(doc);
+
+    /* the enveloped signature: whole document minus the signature subtree */
+    nset = xmlSecNodeSetGetChildren(doc, NULL, 1, 0);
+    tmp = xmlSecNodeSetGetChildren(doc, nodesetTestFindChild(root, BAD_CAST "Signature"), 1, 1);
+    if((nset == NULL) || (tmp == NULL)) {
+        testLog("Error: failed to create node sets\n");
+        if(nset != NULL) { xmlSecNodeSetDestroy(nset); }
+        if(tmp != NULL) { xmlSecNodeSetDestroy(tmp); }
+        xmlFreeDoc(doc);
+        testFinishedFailure();
+        return;
+    }
+    nset = xmlSecNodeSetAdd(nset, tmp, xmlSecNodeSetIntersection);
+    if(nset == NULL) {
+        testLog("Error: xmlSecNodeSetAdd failed\n");
+        xmlSecNodeSetDestroy(tmp);
+        xmlFreeDoc(doc);
+        testFinishedFailure();
+        return;
+    }
+    if((xmlSecNodeSetContains(nset, root, root->parent) != 1) ||
+       (xmlSecNodeSetContains(nset, root->children, root) != 0) ||
+       (xmlSecNodeSetContains(nset, root->children->children, root->children) != 0) ||
+       (xmlSecNodeSetContains(nset, root->children->next, root) != 1)) {
+        testLog("Error: unexpected membership for the enveloped signature\n");
+        xmlSecNodeSetDestroy(nset);
+        xmlFreeDoc(doc);
+        testFinishedFailure();
+        return;
+    }
+
+    /* the node added after the index was built */
+    added = xmlNewChild(root->children->next, NULL, BAD_CAST "Added", NULL);
+    if((added == NULL) || (xmlSecNodeSetContains(nset, added, added->parent) != 1)) {
+        testLog("Error: unexpected membership for the added node\n");
+        xmlSecNodeSetDestroy(nset);
+        xmlFreeDoc(doc);
+        testFinishedFailure();
+        return;
+    }
+    xmlSecNodeSetDestroy(nset);
+
+    /* the subtree that is not in the document tree */
+    detached = xmlNewDocNode(doc, NULL, BAD_CAST "Detached", NULL);
+    detachedChild = (detached != NULL) ? xmlNewChild(detached, NULL, BAD_CAST "Child", NULL) : NULL;
+    nset = (detachedChild != NULL) ? xmlSecNodeSetGetChildren(doc, detached, 1, 0) : NULL;
+    if((nset == NULL) ||
+       (xmlSecNodeSetContains(nset, detachedChild, detached) != 1) ||
+       (xmlSecNodeSetContains(nset, root, root->parent) != 0)) {
+        testLog("Error: unexpected membership for the detached subtree\n");
+        if(nset != NULL) { xmlSecNodeSetDestroy(nset); }
+        if(detached != NULL) { xmlFreeNode(detached); }
+        xmlFreeDoc(doc);
+        testFinishedFailure();
+        return;
+    }
+
+    xmlSecNodeSetDestroy(nset);
+    xmlFreeNode(detached);
+    xmlFreeDoc(doc);
+    testFinishedSuccess();
+}
+
 static void
 test_xmlSecNodeSetGetChildren_without_comments_contains_subtree(void) {
     xmlDocPtr doc;
@@ -938,6 +1361,10 @@ test_nodeset(void) {
     testGroupStart("xmlSecNodeSetCreate");
     test_xmlSecNodeSetCreate_destroy_doc_destroy();
     test_xmlSecNodeSetContains_null_nodeset_allows_node();
+    test_xmlSecNodeSetContains_indexed_normal_and_invert();
+    test_xmlSecNodeSetContains_large_set_and_rebuild();
+    test_xmlSecNodeSetContains_tree_deep_subtrees();
+    test_xmlSecNodeSetContains_tree_detached_and_modified();
     if(testGroupFinished() != 1) { success = 0; }
 
     testGroupStart("xmlSecNodeSetGetChildren");
@@ -132,6 +132,12 @@ int main(int argc, const char **argv) {
     if (test_buffer() != 1) {
         success = 0;
     }
+    if (test_c14n() != 1) {
+        success = 0;
+    }
+    if (test_keysmngr() != 1) {
+        success = 0;
+    }
     if (test_list() != 1) {
         success = 0;
     }
@@ -159,6 +165,9 @@ int main(int argc, const char **argv) {
     if (test_xmltree() != 1) {
         success = 0;
     }
+    if (test_xpath() != 1) {
+        success = 0;
+    }
     if (test_templates() != 1) {
         success = 0;
     }
@@ -41,6 +41,8 @@ int test_xmlsec(void);
 int test_base64(void);
 int test_bn(void);
 int test_buffer(void);
+int test_c14n(void);
+int test_keysmngr(void);
 int test_list(void);
 int test_transform_helpers(void);
 int test_xmlSecX509EscapedStringRead(void);
@@ -50,6 +52,7 @@ int test_xmlSecX509SerialNumberRead(void);
 int test_xmlSecKeyDataX509XmlRead(void);
 int test_nodeset(void);
 int test_xmltree(void);
+int test_xpath(void);
 int test_templates(void);
 
 #ifdef __cplusplus
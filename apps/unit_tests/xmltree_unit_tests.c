@@ -19,6 +19,8 @@
 #include <xmlsec/buffer.h>
 #include <xmlsec/strings.h>
 
+#include "../src/xmltree_helpers.h"
+
 #define TEST_NS BAD_CAST "http://test.ns"
 
 /******************************************************************************
@@ -1826,6 +1828,287 @@ test_xmlSecDepthFirstTreeWalk_skips_siblings(void) {
 }
 
 
+/******************************************************************************
+ * xmlSecAddIDs
+  *****************************************************************************/
+static const xmlChar* xmltreeTestIds[] = { BAD_CAST "Id", NULL };
+
+static xmlNodePtr
+xmltreeTestAddIdNode(xmlNodePtr parent, const xmlChar* name, const xmlChar* id) {
+    xmlNodePtr node;
+
+    node = xmlSecAddChild(parent, name, NULL);
+    if(node == NULL) {
+        return(NULL);
+    }
+    if(xmlNewProp(node, BAD_CAST "Id", id) == NULL) {
+        return(NULL);
+    }
+    return(node);
+}
+
+static void
+test_xmlSecAddIDs_registry_skips_scanned(void) {
+    xmlSecIdsRegistryPtr registry = NULL;
+    xmlDocPtr doc;
+    xmlNodePtr root, node;
+
+    testStart("xmlSecIdsRegistryAddIDs: nested calls are skipped during an operation");
+
+    doc = xmltreeTestCreateDoc(BAD_CAST "Root", NULL);
+    root = (doc != NULL) ? xmlDocGetRootElement(doc) : NULL;
+    node = (root != NULL) ? xmltreeTestAddIdNode(root, BAD_CAST "Node", BAD_CAST "id1") : NULL;
+    if(node == NULL) {
+        testLog("Error: failed to create doc\n");
+        goto error;
+    }
+
+    registry = xmlSecIdsRegistryCreate(doc);
+    if(registry == NULL) {
+        testLog("Error: xmlSecIdsRegistryCreate failed\n");
+        goto error;
+    }
+    xmlSecIdsRegistryAddIDs(registry, doc, NULL, xmltreeTestIds);
+    if(xmlGetID(doc, BAD_CAST "id1") == NULL) {
+        testLog("Error: id1 is not registered\n");
+        goto error;
+    }
+
+    /* the document is changed behind xmlsec back: the scanned subtree is not walked again */
+    if(xmltreeTestAddIdNode(node, BAD_CAST "Child", BAD_CAST "id2") == NULL) {
+        testLog("Error: failed to add child\n");
+        goto error;
+    }
+    xmlSecIdsRegistryAddIDs(registry, doc, node, xmltreeTestIds);
+    if(xmlGetID(doc, BAD_CAST "id2") != NULL) {
+        testLog("Error: id2 is registered, the subtree was walked again\n");
+        goto error;
+    }
+    xmlSecIdsRegistryDestroy(registry);
+    registry = NULL;
+
+    /* the operation is finished: the subtree is walked again */
+    xmlSecAddIDs(doc, node, xmltreeTestIds);
+    if(xmlGetID(doc, BAD_CAST "id2") == NULL) {
+        testLog("Error: id2 is not registered after the operation\n");
+        goto error;
+    }
+
+    xmlFreeDoc(doc);
+    testFinishedSuccess();
+    return;
+
+error:
+    if(registry != NULL) {
+        xmlSecIdsRegistryDestroy(registry);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    testFinishedFailure();
+}
+
+static void
+test_xmlSecAddIDs_registry_other_doc(void) {
+    xmlSecIdsRegistryPtr registry = NULL;
+    xmlDocPtr doc, otherDoc = NULL;
+    xmlNodePtr root, node;
+
+    testStart("xmlSecIdsRegistryAddIDs: the registry of another document is ignored");
+
+    doc = xmltreeTestCreateDoc(BAD_CAST "Root", NULL);
+    root = (doc != NULL) ? xmlDocGetRootElement(doc) : NULL;
+    node = (root != NULL) ? xmltreeTestAddIdNode(root, BAD_CAST "Node", BAD_CAST "id1") : NULL;
+    otherDoc = (node != NULL) ? xmltreeTestCreateDoc(BAD_CAST "Other", NULL) : NULL;
+    if(otherDoc == NULL) {
+        testLog("Error: failed to create docs\n");
+        goto error;
+    }
+
+    registry = xmlSecIdsRegistryCreate(otherDoc);
+    if(registry == NULL) {
+        testLog("Error: xmlSecIdsRegistryCreate failed\n");
+        goto error;
+    }
+    xmlSecIdsRegistryAddIDs(registry, doc, NULL, xmltreeTestIds);
+    if(xmltreeTestAddIdNode(node, BAD_CAST "Child", BAD_CAST "id2") == NULL) {
+        testLog("Error: failed to add child\n");
+        goto error;
+    }
+    xmlSecIdsRegistryAddIDs(registry, doc, NULL, xmltreeTestIds);
+    if((xmlGetID(doc, BAD_CAST "id1") == NULL) || (xmlGetID(doc, BAD_CAST "id2") == NULL)) {
+        testLog("Error: IDs are not registered\n");
+        goto error;
+    }
+
+    xmlSecIdsRegistryDestroy(registry);
+    xmlFreeDoc(otherDoc);
+    xmlFreeDoc(doc);
+    testFinishedSuccess();
+    return;
+
+error:
+    if(registry != NULL) {
+        xmlSecIdsRegistryDestroy(registry);
+    }
+    if(otherDoc != NULL) {
+        xmlFreeDoc(otherDoc);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    testFinishedFailure();
+}
+
+static void
+test_xmlSecAddIDs_registry_replace_node_buffer(void) {
+    static const char data[] = "<New Id=\"new1\"><Sub Id=\"new2\"/></New>";
+    xmlSecIdsRegistryPtr registry = NULL;
+    xmlDocPtr doc;
+    xmlNodePtr root, node;
+    int ret;
+
+    testStart("xmlSecIdsRegistryReplaceNodeBuffer: IDs in the replaced nodes are registered");
+
+    doc = xmltreeTestCreateDoc(BAD_CAST "Root", NULL);
+    root = (doc != NULL) ? xmlDocGetRootElement(doc) : NULL;
+    node = (root != NULL) ? xmltreeTestAddIdNode(root, BAD_CAST "Old", BAD_CAST "old1") : NULL;
+    if(node == NULL) {
+        testLog("Error: failed to create doc\n");
+        goto error;
+    }
+
+    registry = xmlSecIdsRegistryCreate(doc);
+    if(registry == NULL) {
+        testLog("Error: xmlSecIdsRegistryCreate failed\n");
+        goto error;
+    }
+    xmlSecIdsRegistryAddIDs(registry, doc, root, xmltreeTestIds);
+
+    ret = xmlSecIdsRegistryReplaceNodeBuffer(registry, node, (const xmlSecByte*)data, sizeof(data) - 1, NULL);
+    if(ret < 0) {
+        testLog("Error: xmlSecIdsRegistryReplaceNodeBuffer failed\n");
+        goto error;
+    }
+    if((xmlGetID(doc, BAD_CAST "new1") == NULL) || (xmlGetID(doc, BAD_CAST "new2") == NULL)) {
+        testLog("Error: new IDs are not registered\n");
+        goto error;
+    }
+    if(xmlGetID(doc, BAD_CAST "old1") != NULL) {
+        testLog("Error: old ID is still registered\n");
+        goto error;
+    }
+
+    xmlSecIdsRegistryDestroy(registry);
+    xmlFreeDoc(doc);
+    testFinishedSuccess();
+    return;
+
+error:
+    if(registry != NULL) {
+        xmlSecIdsRegistryDestroy(registry);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    testFinishedFailure();
+}
+
+static void
+test_xmlSecAddIDs_registry_replace_node(void) {
+    xmlSecIdsRegistryPtr registry = NULL;
+    xmlDocPtr doc;
+    xmlNodePtr root, node, newNode;
+    int ret;
+
+    testStart("xmlSecIdsRegistryReplaceNode: the replaced subtree is scanned again");
+
+    doc = xmltreeTestCreateDoc(BAD_CAST "Root", NULL);
+    root = (doc != NULL) ? xmlDocGetRootElement(doc) : NULL;
+    node = (root != NULL) ? xmltreeTestAddIdNode(root, BAD_CAST "Old", BAD_CAST "old1") : NULL;
+    newNode = (node != NULL) ? xmlNewDocNode(doc, NULL, BAD_CAST "New", NULL) : NULL;
+    if((newNode == NULL) || (xmlNewProp(newNode, BAD_CAST "Id", BAD_CAST "new1") == NULL)) {
+        testLog("Error: failed to create doc\n");
+        if(newNode != NULL) {
+            xmlFreeNode(newNode);
+        }
+        goto error;
+    }
+
+    registry = xmlSecIdsRegistryCreate(doc);
+    if(registry == NULL) {
+        testLog("Error: xmlSecIdsRegistryCreate failed\n");
+        xmlFreeNode(newNode);
+        goto error;
+    }
+    xmlSecIdsRegistryAddIDs(registry, doc, node, xmltreeTestIds);
+
+    /* only the old node was scanned, the new one is not in the scanned subtree */
+    ret = xmlSecIdsRegistryReplaceNode(registry, node, newNode, NULL);
+    if(ret < 0) {
+        testLog("Error: xmlSecIdsRegistryReplaceNode failed\n");
+        xmlFreeNode(newNode);
+        goto error;
+    }
+    xmlSecIdsRegistryAddIDs(registry, doc, newNode, xmltreeTestIds);
+    if(xmlGetID(doc, BAD_CAST "new1") == NULL) {
+        testLog("Error: new ID is not registered\n");
+        goto error;
+    }
+
+    xmlSecIdsRegistryDestroy(registry);
+    xmlFreeDoc(doc);
+    testFinishedSuccess();
+    return;
+
+error:
+    if(registry != NULL) {
+        xmlSecIdsRegistryDestroy(registry);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    testFinishedFailure();
+}
+
+static void
+test_xmlSecAddIDs_no_registry(void) {
+    xmlDocPtr doc;
+    xmlNodePtr root, node;
+
+    testStart("xmlSecAddIDs: every call walks the subtree without an operation");
+
+    doc = xmltreeTestCreateDoc(BAD_CAST "Root", NULL);
+    root = (doc != NULL) ? xmlDocGetRootElement(doc) : NULL;
+    node = (root != NULL) ? xmltreeTestAddIdNode(root, BAD_CAST "Node", BAD_CAST "id1") : NULL;
+    if(node == NULL) {
+        testLog("Error: failed to create doc\n");
+        goto error;
+    }
+
+    xmlSecAddIDs(doc, NULL, xmltreeTestIds);
+    if(xmltreeTestAddIdNode(node, BAD_CAST "Child", BAD_CAST "id2") == NULL) {
+        testLog("Error: failed to add child\n");
+        goto error;
+    }
+    xmlSecAddIDs(doc, NULL, xmltreeTestIds);
+    if((xmlGetID(doc, BAD_CAST "id1") == NULL) || (xmlGetID(doc, BAD_CAST "id2") == NULL)) {
+        testLog("Error: IDs are not registered\n");
+        goto error;
+    }
+
+    xmlFreeDoc(doc);
+    testFinishedSuccess();
+    return;
+
+error:
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    testFinishedFailure();
+}
+
+
 /******************************************************************************
  * exported entry point
   *****************************************************************************/
@@ -1925,5 +2208,13 @@ test_xmltree(void) {
     test_xmlSecDepthFirstTreeWalk_skips_siblings();
     if(testGroupFinished() != 1) { success = 0; }
 
+    testGroupStart("xmlSecAddIDs");
+    test_xmlSecAddIDs_no_registry();
+    test_xmlSecAddIDs_registry_skips_scanned();
+    test_xmlSecAddIDs_registry_other_doc();
+    test_xmlSecAddIDs_registry_replace_node_buffer();
+    test_xmlSecAddIDs_registry_replace_node();
+    if(testGroupFinished() != 1) { success = 0; }
+
     return(success);
 }
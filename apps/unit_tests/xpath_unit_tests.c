@@ -0,0 +1,764 @@
+/**
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * This is free software; see the Copyright file in the source distribution for precise wording.
+ *
+ * Copyright (C) 2002-2026 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+/**
+ * @brief XML Security Library XPath/XPointer transforms unit tests.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+#include <libxml/xpath.h>
+#include <libxml/xpathInternals.h>
+#include <libxml/xpointer.h>
+
+/* must be included before any other xmlsec header */
+#include "xmlsec_unit_tests.h"
+#include <xmlsec/nodeset.h>
+#include <xmlsec/strings.h>
+#include <xmlsec/transforms.h>
+#include <xmlsec/xmltree.h>
+#include "../src/transform_helpers.h"
+
+static const char xpathTestXml[] =
+    "<Root xmlns:a=\"urn:a\" xmlns:b=\"urn:b\">"
+    "<a:Item id=\"i1\"/><b:Item id=\"i2\"/><a:Item id=\"i3\"/>"
+    "<Transform xmlns=\"http://www.w3.org/2000/09/xmldsig#\" Algorithm=\"http://www.w3.org/TR/1999/REC-xpath-19991116\">"
+    "<XPath>self::p:Item</XPath>"
+    "</Transform>"
+    "<Other xmlns:p=\"urn:a\">"
+    "<Transform xmlns=\"http://www.w3.org/2000/09/xmldsig#\" Algorithm=\"http://www.w3.org/TR/1999/REC-xpath-19991116\">"
+    "<XPath>self::p:Item</XPath>"
+    "</Transform>"
+    "<Transform xmlns=\"http://www.w3.org/2000/09/xmldsig#\" Algorithm=\"http://www.w3.org/TR/1999/REC-xpath-19991116\">"
+    "<XPath>self::p:Item</XPath>"
+    "</Transform>"
+    "</Other>"
+    "<Other xmlns:p=\"urn:b\">"
+    "<Transform xmlns=\"http://www.w3.org/2000/09/xmldsig#\" Algorithm=\"http://www.w3.org/TR/1999/REC-xpath-19991116\">"
+    "<XPath>self::p:Item</XPath>"
+    "</Transform>"
+    "</Other>"
+    "</Root>";
+
+/* returns the number of the root children elements in the nodes set or -1 if id doesn't match */
+static int
+xpathTestCountElements(xmlSecNodeSetPtr nset, xmlNodePtr root, const xmlChar* id) {
+    xmlNodePtr cur;
+    int count = 0;
+
+    xmlSecAssert2(root != NULL, -1);
+
+    for(cur = xmlSecGetNextElementNode(root->children); cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        if(xmlSecNodeSetContains(nset, cur, root) != 1) {
+            continue;
+        }
+        if(id != NULL) {
+            xmlChar* value = xmlGetProp(cur, BAD_CAST "id");
+            int match = xmlStrEqual(value, id);
+
+            if(value != NULL) { xmlFree(value); }
+            if(!match) {
+                return(-1);
+            }
+        }
+        ++count;
+    }
+    return(count);
+}
+
+/* reads the XPath transform from the Transform node and executes it */
+static xmlSecNodeSetPtr
+xpathTestExecuteXPath(xmlNodePtr transformNode) {
+    xmlSecTransformCtxPtr transformCtx;
+    xmlSecTransformPtr transform;
+    xmlSecNodeSetPtr res;
+    int ret;
+
+    xmlSecAssert2(transformNode != NULL, NULL);
+
+    transformCtx = xmlSecTransformCtxCreate();
+    if(transformCtx == NULL) {
+        testLog("Error: failed to create transform ctx\n");
+        return(NULL);
+    }
+    transform = xmlSecTransformCreate(xmlSecTransformXPathId);
+    if(transform == NULL) {
+        testLog("Error: failed to create XPath transform\n");
+        xmlSecTransformCtxDestroy(transformCtx);
+        return(NULL);
+    }
+    transform->hereNode = transformNode;
+
+    ret = transform->id->readNode(transform, transformNode, transformCtx);
+    if(ret < 0) {
+        testLog("Error: failed to read XPath transform\n");
+        xmlSecTransformDestroy(transform);
+        xmlSecTransformCtxDestroy(transformCtx);
+        return(NULL);
+    }
+    ret = xmlSecTransformExecute(transform, 1, transformCtx);
+    if((ret < 0) || (transform->outNodes == NULL)) {
+        testLog("Error: failed to execute XPath transform\n");
+        xmlSecTransformDestroy(transform);
+        xmlSecTransformCtxDestroy(transformCtx);
+        return(NULL);
+    }
+
+    res = transform->outNodes;
+    transform->outNodes = NULL;
+    xmlSecTransformDestroy(transform);
+    xmlSecTransformCtxDestroy(transformCtx);
+    return(res);
+}
+
+/* creates the XPointer transform and executes it */
+static xmlSecNodeSetPtr
+xpathTestExecuteXPointer(xmlNodePtr hereNode, const char* expr) {
+    xmlSecTransformCtxPtr transformCtx;
+    xmlSecTransformPtr transform;
+    xmlSecNodeSetPtr res;
+    int ret;
+
+    xmlSecAssert2(hereNode != NULL, NULL);
+    xmlSecAssert2(expr != NULL, NULL);
+
+    transformCtx = xmlSecTransformCtxCreate();
+    if(transformCtx == NULL) {
+        testLog("Error: failed to create transform ctx\n");
+        return(NULL);
+    }
+    transform = xmlSecTransformCreate(xmlSecTransformXPointerId);
+    if(transform == NULL) {
+        testLog("Error: failed to create XPointer transform\n");
+        xmlSecTransformCtxDestroy(transformCtx);
+        return(NULL);
+    }
+    ret = xmlSecTransformXPointerSetExpr(transform, BAD_CAST expr, xmlSecNodeSetTree, hereNode);
+    if(ret < 0) {
+        testLog("Error: failed to set XPointer expression\n");
+        xmlSecTransformDestroy(transform);
+        xmlSecTransformCtxDestroy(transformCtx);
+        return(NULL);
+    }
+    ret = xmlSecTransformExecute(transform, 1, transformCtx);
+    if((ret < 0) || (transform->outNodes == NULL)) {
+        xmlSecTransformDestroy(transform);
+        xmlSecTransformCtxDestroy(transformCtx);
+        return(NULL);
+    }
+
+    res = transform->outNodes;
+    transform->outNodes = NULL;
+    xmlSecTransformDestroy(transform);
+    xmlSecTransformCtxDestroy(transformCtx);
+    return(res);
+}
+
+static const char xpathPatternsTestXml[] =
+    "<Root xmlns:dsig=\"http://www.w3.org/2000/09/xmldsig#\" xmlns:a=\"urn:a\" Id=\"root\">"
+    "<!-- comment -->"
+    "<a:Item Id=\"i1\" a:attr=\"x\">text<a:Item Id=\"i2\"><Leaf Id=\"i1\" xmlns:c=\"urn:c\"/></a:Item></a:Item>"
+    "<dsig:Signature Id=\"sig\"><dsig:SignedInfo><Leaf Id=\"i1\"/><?pi data?></dsig:SignedInfo>"
+    "<dsig:Signature Id=\"nested\"/></dsig:Signature>"
+    "<Item Id=\"i&amp;1\"><a:Item Id=\"i3\">text</a:Item></Item>"
+    "<Tests>"
+    "<dsig:Transform><dsig:XPath>not(ancestor-or-self::dsig:Signature)</dsig:XPath></dsig:Transform>"
+    "<dsig:Transform><dsig:XPath>not(ancestor-or-self::dsig:Signature) and true()</dsig:XPath></dsig:Transform>"
+    "<dsig:Transform><dsig:XPath> ancestor-or-self :: a:Item </dsig:XPath></dsig:Transform>"
+    "<dsig:Transform><dsig:XPath>ancestor-or-self::a:Item and true()</dsig:XPath></dsig:Transform>"
+    "<dsig:Transform><dsig:XPath>not ( ancestor-or-self::Item )</dsig:XPath></dsig:Transform>"
+    "<dsig:Transform><dsig:XPath>not(ancestor-or-self::Item) and true()</dsig:XPath></dsig:Transform>"
+    "<dsig:Transform><dsig:XPath>@Id='i1'</dsig:XPath></dsig:Transform>"
+    "<dsig:Transform><dsig:XPath>@Id='i1' and true()</dsig:XPath></dsig:Transform>"
+    "<dsig:Transform><dsig:XPath>@Id = \"i&amp;1\"</dsig:XPath></dsig:Transform>"
+    "<dsig:Transform><dsig:XPath>@Id = \"i&amp;1\" and true()</dsig:XPath></dsig:Transform>"
+    "</Tests>"
+    "</Root>";
+
+static int
+xpathTestCompareNodeSetsNode(xmlSecNodeSetPtr nset1, xmlSecNodeSetPtr nset2,
+                             xmlNodePtr node, xmlNodePtr parent, int* count) {
+    int ret1, ret2;
+
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(count != NULL, -1);
+
+    ret1 = xmlSecNodeSetContains(nset1, node, parent);
+    ret2 = xmlSecNodeSetContains(nset2, node, parent);
+    if(ret1 != ret2) {
+        testLog("Error: nodes sets mismatch for node type=%d name=%s parent=%s: %d vs %d\n",
+            (int)node->type, (node->name != NULL) ? (const char*)node->name : "",
+            ((parent != NULL) && (parent->name != NULL)) ? (const char*)parent->name : "",
+            ret1, ret2);
+        return(-1);
+    }
+    if(ret1 == 1) {
+        ++(*count);
+    }
+    return(0);
+}
+
+/* compares two nodes sets for all the nodes in the parent's subtree */
+static int
+xpathTestCompareNodeSets(xmlSecNodeSetPtr nset1, xmlSecNodeSetPtr nset2, xmlNodePtr parent, int* count) {
+    xmlNodePtr cur, tmp;
+    xmlAttrPtr attr;
+    xmlNsPtr ns;
+
+    xmlSecAssert2(parent != NULL, -1);
+    xmlSecAssert2(count != NULL, -1);
+
+    for(cur = parent->children; cur != NULL; cur = cur->next) {
+        if(xpathTestCompareNodeSetsNode(nset1, nset2, cur, parent, count) < 0) {
+            return(-1);
+        }
+        if(cur->type != XML_ELEMENT_NODE) {
+            continue;
+        }
+        for(attr = cur->properties; attr != NULL; attr = attr->next) {
+            if(xpathTestCompareNodeSetsNode(nset1, nset2, (xmlNodePtr)attr, cur, count) < 0) {
+                return(-1);
+            }
+        }
+        /* all the in-scope namespaces */
+        for(tmp = cur; (tmp != NULL) && (tmp->type == XML_ELEMENT_NODE); tmp = tmp->parent) {
+            for(ns = tmp->nsDef; ns != NULL; ns = ns->next) {
+                if(xpathTestCompareNodeSetsNode(nset1, nset2, (xmlNodePtr)ns, cur, count) < 0) {
+                    return(-1);
+                }
+            }
+        }
+        if(xpathTestCompareNodeSets(nset1, nset2, cur, count) < 0) {
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static void
+test_xmlSecTransformXPath_compiled_cache(void) {
+    xmlDocPtr doc;
+    xmlNodePtr root;
+    xmlNodePtr transformNodes[4];
+    xmlNodePtr cur;
+    xmlSecNodeSetPtr nsets[4] = { NULL, NULL, NULL, NULL };
+    xmlSecSize hits0 = 0, misses0 = 0, hits = 0, misses = 0;
+    int ii, count;
+
+    testStart("XPath transform compiled expressions cache");
+
+    if(xmlSecTransformXPathCacheInit() < 0) {
+        testLog("Error: failed to initialize XPath cache\n");
+        testFinishedFailure();
+        return;
+    }
+    xmlSecTransformXPathCacheGetStats(&hits0, &misses0);
+
+    doc = xmlReadMemory(xpathTestXml, (int)strlen(xpathTestXml), "xpath-test.xml", NULL, XML_PARSE_NONET);
+    root = (doc != NULL) ? xmlDocGetRootElement(doc) : NULL;
+    if(root == NULL) {
+        testLog("Error: failed to parse XML\n");
+        if(doc != NULL) { xmlFreeDoc(doc); }
+        xmlSecTransformXPathCacheShutdown();
+        testFinishedFailure();
+        return;
+    }
+
+    /* all the Transform nodes in the document order */
+    ii = 0;
+    for(cur = xmlSecGetNextElementNode(root->children); cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        if(xmlStrEqual(cur->name, xmlSecNodeTransform)) {
+            transformNodes[ii++] = cur;
+        } else if(xmlStrEqual(cur->name, BAD_CAST "Other")) {
+            xmlNodePtr tmp;
+            for(tmp = xmlSecGetNextElementNode(cur->children); tmp != NULL; tmp = xmlSecGetNextElementNode(tmp->next)) {
+                transformNodes[ii++] = tmp;
+            }
+        }
+    }
+    if(ii != 4) {
+        testLog("Error: unexpected number of transform nodes %d\n", ii);
+        xmlFreeDoc(doc);
+        xmlSecTransformXPathCacheShutdown();
+        testFinishedFailure();
+        return;
+    }
+
+    /* the 2nd and 3rd transforms have the same expression and namespaces */
+    for(ii = 1; ii < 4; ++ii) {
+        nsets[ii] = xpathTestExecuteXPath(transformNodes[ii]);
+        if(nsets[ii] == NULL) {
+            testLog("Error: failed to execute transform %d\n", ii);
+            goto fail;
+        }
+    }
+    xmlSecTransformXPathCacheGetStats(&hits, &misses);
+    if((hits - hits0 != 1) || (misses - misses0 != 2)) {
+        testLog("Error: unexpected cache stats: hits=" XMLSEC_SIZE_FMT " misses=" XMLSEC_SIZE_FMT "\n",
+            hits - hits0, misses - misses0);
+        goto fail;
+    }
+
+    /* the p prefix is bound to different namespaces */
+    count = xpathTestCountElements(nsets[1], root, NULL);
+    if((count != 2) || (xpathTestCountElements(nsets[2], root, NULL) != 2)) {
+        testLog("Error: unexpected number of urn:a items %d\n", count);
+        goto fail;
+    }
+    count = xpathTestCountElements(nsets[3], root, BAD_CAST "i2");
+    if(count != 1) {
+        testLog("Error: unexpected number of urn:b items %d\n", count);
+        goto fail;
+    }
+
+    /* the prefix is not bound at all */
+    nsets[0] = xpathTestExecuteXPath(transformNodes[0]);
+    if(nsets[0] != NULL) {
+        testLog("Error: expression with unbound prefix should fail\n");
+        goto fail;
+    }
+
+    for(ii = 0; ii < 4; ++ii) {
+        if(nsets[ii] != NULL) { xmlSecNodeSetDestroy(nsets[ii]); }
+    }
+    xmlFreeDoc(doc);
+    xmlSecTransformXPathCacheShutdown();
+    testFinishedSuccess();
+    return;
+
+fail:
+    for(ii = 0; ii < 4; ++ii) {
+        if(nsets[ii] != NULL) { xmlSecNodeSetDestroy(nsets[ii]); }
+    }
+    xmlFreeDoc(doc);
+    xmlSecTransformXPathCacheShutdown();
+    testFinishedFailure();
+}
+
+static void
+test_xmlSecTransformXPath_filter_patterns(void) {
+    xmlDocPtr doc;
+    xmlNodePtr root, tests, cur, generic;
+    xmlSecNodeSetPtr nset1 = NULL, nset2 = NULL;
+    xmlSecSize hits0 = 0, misses0 = 0, hits = 0, misses = 0;
+    int count;
+
+    testStart("XPath transform filter patterns match LibXML2 results");
+
+    if(xmlSecTransformXPathCacheInit() < 0) {
+        testLog("Error: failed to initialize XPath cache\n");
+        testFinishedFailure();
+        return;
+    }
+
+    doc = xmlReadMemory(xpathPatternsTestXml, (int)strlen(xpathPatternsTestXml), "xpath-test.xml", NULL, XML_PARSE_NONET);
+    root = (doc != NULL) ? xmlDocGetRootElement(doc) : NULL;
+    tests = (root != NULL) ? xmlSecFindChild(root, BAD_CAST "Tests", NULL) : NULL;
+    if(tests == NULL) {
+        testLog("Error: failed to parse XML\n");
+        if(doc != NULL) { xmlFreeDoc(doc); }
+        xmlSecTransformXPathCacheShutdown();
+        testFinishedFailure();
+        return;
+    }
+
+    /* pairs of the recognized and generic expressions */
+    for(cur = xmlSecGetNextElementNode(tests->children); cur != NULL; cur = xmlSecGetNextElementNode(generic->next)) {
+        generic = xmlSecGetNextElementNode(cur->next);
+        if(generic == NULL) {
+            testLog("Error: missing generic expression\n");
+            goto fail;
+        }
+
+        /* the recognized expression doesn't use the compiled expressions cache */
+        xmlSecTransformXPathCacheGetStats(&hits0, &misses0);
+        nset1 = xpathTestExecuteXPath(cur);
+        xmlSecTransformXPathCacheGetStats(&hits, &misses);
+        if((nset1 == NULL) || (hits != hits0) || (misses != misses0)) {
+            testLog("Error: expression was not recognized: %s\n", (const char*)cur->children->children->content);
+            goto fail;
+        }
+        nset2 = xpathTestExecuteXPath(generic);
+        if(nset2 == NULL) {
+            testLog("Error: failed to execute generic expression\n");
+            goto fail;
+        }
+
+        count = 0;
+        if(xpathTestCompareNodeSets(nset1, nset2, (xmlNodePtr)doc, &count) < 0) {
+            testLog("Error: results mismatch for expression: %s\n", (const char*)cur->children->children->content);
+            goto fail;
+        }
+        if(count <= 0) {
+            testLog("Error: empty result for expression: %s\n", (const char*)cur->children->children->content);
+            goto fail;
+        }
+
+        xmlSecNodeSetDestroy(nset1);
+        nset1 = NULL;
+        xmlSecNodeSetDestroy(nset2);
+        nset2 = NULL;
+    }
+
+    xmlFreeDoc(doc);
+    xmlSecTransformXPathCacheShutdown();
+    testFinishedSuccess();
+    return;
+
+fail:
+    if(nset1 != NULL) { xmlSecNodeSetDestroy(nset1); }
+    if(nset2 != NULL) { xmlSecNodeSetDestroy(nset2); }
+    xmlFreeDoc(doc);
+    xmlSecTransformXPathCacheShutdown();
+    testFinishedFailure();
+}
+
+static void
+test_xmlSecTransformXPointer_compiled_expression(void) {
+    xmlDocPtr doc;
+    xmlNodePtr root;
+    xmlSecNodeSetPtr nset;
+    int count;
+
+    testStart("XPointer transform with simple xpointer() expressions");
+
+    if(xmlSecTransformXPathCacheInit() < 0) {
+        testLog("Error: failed to initialize XPath cache\n");
+        testFinishedFailure();
+        return;
+    }
+
+    doc = xmlReadMemory(xpathTestXml, (int)strlen(xpathTestXml), "xpath-test.xml", NULL, XML_PARSE_NONET);
+    root = (doc != NULL) ? xmlDocGetRootElement(doc) : NULL;
+    if(root == NULL) {
+        testLog("Error: failed to parse XML\n");
+        if(doc != NULL) { xmlFreeDoc(doc); }
+        xmlSecTransformXPathCacheShutdown();
+        testFinishedFailure();
+        return;
+    }
+
+    /* the same expression twice, with the namespace from the "here" node */
+    for(count = 0; count < 2; ++count) {
+        nset = xpathTestExecuteXPointer(root, "xpointer(//b:Item)");
+        if((nset == NULL) || (xpathTestCountElements(nset, root, BAD_CAST "i2") != 1)) {
+            testLog("Error: unexpected result for xpointer(//b:Item)\n");
+            if(nset != NULL) { xmlSecNodeSetDestroy(nset); }
+            xmlFreeDoc(doc);
+            xmlSecTransformXPathCacheShutdown();
+            testFinishedFailure();
+            return;
+        }
+        xmlSecNodeSetDestroy(nset);
+    }
+
+    /* parenthesis in the expression */
+    nset = xpathTestExecuteXPointer(root, " xpointer(//*[(@id = 'i3')]) ");
+    if((nset == NULL) || (xpathTestCountElements(nset, root, BAD_CAST "i3") != 1)) {
+        testLog("Error: unexpected result for xpointer(//*[(@id = 'i3')])\n");
+        if(nset != NULL) { xmlSecNodeSetDestroy(nset); }
+        xmlFreeDoc(doc);
+        xmlSecTransformXPathCacheShutdown();
+        testFinishedFailure();
+        return;
+    }
+    xmlSecNodeSetDestroy(nset);
+
+    /* empty result is an error for XPointer */
+    nset = xpathTestExecuteXPointer(root, "xpointer(//*[@id = 'missing'])");
+    if(nset != NULL) {
+        testLog("Error: expected failure for the empty XPointer result\n");
+        xmlSecNodeSetDestroy(nset);
+        xmlFreeDoc(doc);
+        xmlSecTransformXPathCacheShutdown();
+        testFinishedFailure();
+        return;
+    }
+
+    xmlFreeDoc(doc);
+    xmlSecTransformXPathCacheShutdown();
+    testFinishedSuccess();
+}
+
+/* evaluates the expression with xmlXPtrEval(), i.e. without the compiled expressions */
+static xmlSecNodeSetPtr
+xpathTestEvalXPointer(xmlDocPtr doc, const char* expr) {
+    xmlXPathContextPtr ctx;
+    xmlXPathObjectPtr obj;
+    xmlSecNodeSetPtr res;
+
+    xmlSecAssert2(doc != NULL, NULL);
+    xmlSecAssert2(expr != NULL, NULL);
+
+    ctx = xmlXPathNewContext(doc);
+    if(ctx == NULL) {
+        testLog("Error: failed to create XPath context\n");
+        return(NULL);
+    }
+    /* the same namespaces as declared on the "here" node */
+    if((xmlXPathRegisterNs(ctx, BAD_CAST "a", BAD_CAST "urn:a") != 0) ||
+       (xmlXPathRegisterNs(ctx, BAD_CAST "b", BAD_CAST "urn:b") != 0)
+    ) {
+        testLog("Error: failed to register namespaces\n");
+        xmlXPathFreeContext(ctx);
+        return(NULL);
+    }
+
+    obj = xmlXPtrEval(BAD_CAST expr, ctx);
+    xmlXPathFreeContext(ctx);
+    if(obj == NULL) {
+        return(NULL);
+    }
+    if((obj->type != XPATH_NODESET) || (obj->nodesetval == NULL) || (obj->nodesetval->nodeNr <= 0)) {
+        xmlXPathFreeObject(obj);
+        return(NULL);
+    }
+
+    res = xmlSecNodeSetCreate(doc, obj->nodesetval, xmlSecNodeSetTree);
+    if(res == NULL) {
+        testLog("Error: failed to create nodes set\n");
+        xmlXPathFreeObject(obj);
+        return(NULL);
+    }
+    obj->nodesetval = NULL;
+    xmlXPathFreeObject(obj);
+    return(res);
+}
+
+static void
+test_xmlSecTransformXPointer_compiled_same_as_xptr_eval(void) {
+    /* relative expressions are evaluated with the document as the context node */
+    static const char* exprs[] = {
+        "xpointer(/)",
+        "xpointer(.)",
+        "xpointer(self::node())",
+        "xpointer(*)",
+        "xpointer(Root)",
+        "xpointer(*/b:Item)",
+        "xpointer(node()/a:Item[2])",
+        "xpointer(//a:Item[position() = last()])",
+        "xpointer(descendant::*[@id = 'i2'])",
+        "xpointer(//*[(@id = 'i3')])",
+        /* errors: not a nodes set or empty nodes set */
+        "xpointer(count(//*))",
+        "xpointer(..)",
+        "xpointer(//*[@id = 'missing'])",
+        NULL
+    };
+    xmlDocPtr doc;
+    xmlNodePtr root;
+    xmlSecNodeSetPtr nset1, nset2;
+    int count;
+    int ii, round;
+
+    testStart("XPointer transform: compiled expressions match xmlXPtrEval()");
+
+    if(xmlSecTransformXPathCacheInit() < 0) {
+        testLog("Error: failed to initialize XPath cache\n");
+        testFinishedFailure();
+        return;
+    }
+
+    doc = xmlReadMemory(xpathTestXml, (int)strlen(xpathTestXml), "xpath-test.xml", NULL, XML_PARSE_NONET);
+    root = (doc != NULL) ? xmlDocGetRootElement(doc) : NULL;
+    if(root == NULL) {
+        testLog("Error: failed to parse XML\n");
+        if(doc != NULL) { xmlFreeDoc(doc); }
+        xmlSecTransformXPathCacheShutdown();
+        testFinishedFailure();
+        return;
+    }
+
+    /* the second round uses the compiled expressions from the cache */
+    for(round = 0; round < 2; ++round) {
+        for(ii = 0; exprs[ii] != NULL; ++ii) {
+            nset1 = xpathTestExecuteXPointer(root, exprs[ii]);
+            nset2 = xpathTestEvalXPointer(doc, exprs[ii]);
+            if((nset1 == NULL) || (nset2 == NULL)) {
+                if((nset1 != NULL) || (nset2 != NULL)) {
+                    testLog("Error: %s: the XPointer transform %s but xmlXPtrEval() %s\n", exprs[ii],
+                        (nset1 != NULL) ? "succeeded" : "failed",
+                        (nset2 != NULL) ? "succeeded" : "failed");
+                    if(nset1 != NULL) { xmlSecNodeSetDestroy(nset1); }
+                    if(nset2 != NULL) { xmlSecNodeSetDestroy(nset2); }
+                    goto failed;
+                }
+                continue;
+            }
+
+            count = 0;
+            if(xpathTestCompareNodeSets(nset1, nset2, (xmlNodePtr)doc, &count) < 0) {
+                testLog("Error: %s: the XPointer transform result doesn't match xmlXPtrEval()\n", exprs[ii]);
+                xmlSecNodeSetDestroy(nset1);
+                xmlSecNodeSetDestroy(nset2);
+                goto failed;
+            }
+            xmlSecNodeSetDestroy(nset1);
+            xmlSecNodeSetDestroy(nset2);
+        }
+    }
+
+    xmlFreeDoc(doc);
+    xmlSecTransformXPathCacheShutdown();
+    testFinishedSuccess();
+    return;
+
+failed:
+    xmlFreeDoc(doc);
+    xmlSecTransformXPathCacheShutdown();
+    testFinishedFailure();
+}
+
+/* sets the URI for the transforms ctx and executes the first transform */
+static xmlSecNodeSetPtr
+xpathTestExecuteUri(xmlNodePtr hereNode, const char* uri, xmlSecTransformId expectedId) {
+    xmlSecTransformCtxPtr transformCtx;
+    xmlSecNodeSetPtr res;
+    int ret;
+
+    xmlSecAssert2(hereNode != NULL, NULL);
+    xmlSecAssert2(uri != NULL, NULL);
+
+    transformCtx = xmlSecTransformCtxCreate();
+    if(transformCtx == NULL) {
+        testLog("Error: failed to create transform ctx\n");
+        return(NULL);
+    }
+    ret = xmlSecTransformCtxSetUri(transformCtx, BAD_CAST uri, hereNode);
+    if((ret < 0) || (transformCtx->first == NULL)) {
+        testLog("Error: failed to set uri %s\n", uri);
+        xmlSecTransformCtxDestroy(transformCtx);
+        return(NULL);
+    }
+    if(transformCtx->first->id != expectedId) {
+        testLog("Error: unexpected transform %s for uri %s\n",
+            (const char*)xmlSecTransformGetName(transformCtx->first), uri);
+        xmlSecTransformCtxDestroy(transformCtx);
+        return(NULL);
+    }
+    ret = xmlSecTransformExecute(transformCtx->first, 1, transformCtx);
+    if((ret < 0) || (transformCtx->first->outNodes == NULL)) {
+        xmlSecTransformCtxDestroy(transformCtx);
+        return(NULL);
+    }
+
+    res = transformCtx->first->outNodes;
+    transformCtx->first->outNodes = NULL;
+    xmlSecTransformCtxDestroy(transformCtx);
+    return(res);
+}
+
+static void
+test_xmlSecTransformBareName_same_as_xpointer(void) {
+    static const xmlChar* ids[] = { BAD_CAST "Id", NULL };
+    static const char* testIds[] = { "i1", "i2", "sig", "nested" };
+    char uri[64];
+    xmlDocPtr doc;
+    xmlNodePtr root;
+    xmlSecNodeSetPtr nset1 = NULL, nset2 = NULL;
+    xmlSecSize ii;
+    int count;
+
+    testStart("Bare name XPointer transform matches xpointer(id(...))");
+
+    if(xmlSecTransformXPathCacheInit() < 0) {
+        testLog("Error: failed to initialize XPath cache\n");
+        testFinishedFailure();
+        return;
+    }
+
+    doc = xmlReadMemory(xpathPatternsTestXml, (int)strlen(xpathPatternsTestXml), "xpath-test.xml", NULL, XML_PARSE_NONET);
+    root = (doc != NULL) ? xmlDocGetRootElement(doc) : NULL;
+    if(root == NULL) {
+        testLog("Error: failed to parse XML\n");
+        if(doc != NULL) { xmlFreeDoc(doc); }
+        xmlSecTransformXPathCacheShutdown();
+        testFinishedFailure();
+        return;
+    }
+    /* "i1" is duplicated, the first one is used */
+    xmlSecAddIDs(doc, root, ids);
+
+    for(ii = 0; ii < sizeof(testIds) / sizeof(testIds[0]); ++ii) {
+        (void)snprintf(uri, sizeof(uri), "#%s", testIds[ii]);
+        nset1 = xpathTestExecuteUri(root, uri, xmlSecTransformBareNameId);
+        if(nset1 == NULL) {
+            testLog("Error: failed to execute bare name transform for %s\n", uri);
+            goto fail;
+        }
+        (void)snprintf(uri, sizeof(uri), "#xpointer(id('%s'))", testIds[ii]);
+        nset2 = xpathTestExecuteUri(root, uri, xmlSecTransformXPointerId);
+        if(nset2 == NULL) {
+            testLog("Error: failed to execute xpointer transform for %s\n", uri);
+            goto fail;
+        }
+        if(nset1->type != xmlSecNodeSetTreeWithoutComments) {
+            testLog("Error: unexpected nodes set type for %s\n", testIds[ii]);
+            goto fail;
+        }
+
+        count = 0;
+        if((xpathTestCompareNodeSets(nset1, nset2, (xmlNodePtr)doc, &count) < 0) || (count <= 0)) {
+            testLog("Error: results mismatch for id: %s\n", testIds[ii]);
+            goto fail;
+        }
+
+        xmlSecNodeSetDestroy(nset1);
+        nset1 = NULL;
+        xmlSecNodeSetDestroy(nset2);
+        nset2 = NULL;
+    }
+
+    /* unknown id fails */
+    nset1 = xpathTestExecuteUri(root, "#missing", xmlSecTransformBareNameId);
+    if(nset1 != NULL) {
+        testLog("Error: expected failure for unknown id\n");
+        goto fail;
+    }
+
+    /* "strange" ids still go thru the XPointer engine */
+    nset1 = xpathTestExecuteUri(root, "#i1 i2", xmlSecTransformXPointerId);
+    if(nset1 == NULL) {
+        testLog("Error: failed to execute xpointer transform for multiple ids\n");
+        goto fail;
+    }
+    xmlSecNodeSetDestroy(nset1);
+    nset1 = NULL;
+
+    xmlFreeDoc(doc);
+    xmlSecTransformXPathCacheShutdown();
+    testFinishedSuccess();
+    return;
+
+fail:
+    if(nset1 != NULL) { xmlSecNodeSetDestroy(nset1); }
+    if(nset2 != NULL) { xmlSecNodeSetDestroy(nset2); }
+    xmlFreeDoc(doc);
+    xmlSecTransformXPathCacheShutdown();
+    testFinishedFailure();
+}
+
+int
+test_xpath(void) {
+    int success = 1;
+
+    testGroupStart("xmlSecTransformXPath");
+    test_xmlSecTransformXPath_compiled_cache();
+    test_xmlSecTransformXPath_filter_patterns();
+    test_xmlSecTransformXPointer_compiled_expression();
+    test_xmlSecTransformXPointer_compiled_same_as_xptr_eval();
+    if(testGroupFinished() != 1) { success = 0; }
+
+    testGroupStart("xmlSecTransformBareName");
+    test_xmlSecTransformBareName_same_as_xpointer();
+    if(testGroupFinished() != 1) { success = 0; }
+
+    return(success);
+}
@@ -61,6 +61,7 @@ struct _xmlSecBuffer {
     xmlSecSize          size;  /**< the current data size. */
     xmlSecSize          maxSize;  /**< the max data size (allocated buffer size). */
     int                 flags;  /**< the buffer behavior flags. */
+    xmlSecSize          headSize;  /**< the number of already consumed bytes allocated in front of @p data (see #xmlSecBufferRemoveHead). */
 };
 
 XMLSEC_EXPORT void              xmlSecBufferSetDefaultAllocMode (xmlSecAllocMode defAllocMode,
@@ -207,9 +207,9 @@ struct _xmlSecKeyInfoCtx {
     xmlSecTransformOperation            operation;  /**< the transform operation for this key info. */
     xmlSecKeyReq                        keyReq;  /**< the current key requirements. */
 
-    /* for the future */
-    void*                               reserved0;  /**< reserved for the future. */
-    void*                               reserved1;  /**< reserved for the future. */
+    /* reserved (used internally) */
+    void*                               reserved0;  /**< used internally: the IDs registry of the current operation. */
+    void*                               reserved1;  /**< used internally: the key found in the keys manager (see xmlSecKeysMngrGetKey()). */
 };
 
 XMLSEC_EXPORT xmlSecKeyInfoCtxPtr       xmlSecKeyInfoCtxCreate          (xmlSecKeysMngrPtr keysMngr);
@@ -168,6 +168,9 @@ XMLSEC_EXPORT xmlSecKeyPtr      xmlSecKeyCreate         (void);
 XMLSEC_EXPORT void              xmlSecKeyDestroy        (xmlSecKeyPtr key);
 XMLSEC_EXPORT void              xmlSecKeyEmpty          (xmlSecKeyPtr key);
 XMLSEC_EXPORT xmlSecKeyPtr      xmlSecKeyDuplicate      (xmlSecKeyPtr key);
+XMLSEC_EXPORT xmlSecKeyPtr      xmlSecKeyRef            (xmlSecKeyPtr key);
+XMLSEC_EXPORT int               xmlSecKeyIsShared       (xmlSecKeyPtr key);
+XMLSEC_EXPORT xmlSecKeyPtr      xmlSecKeyEnsureWritable (xmlSecKeyPtr key);
 XMLSEC_EXPORT int               xmlSecKeyCopy           (xmlSecKeyPtr keyDst,
                                                          xmlSecKeyPtr keySrc);
 XMLSEC_EXPORT int               xmlSecKeySwap           (xmlSecKeyPtr key1,
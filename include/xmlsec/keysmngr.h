@@ -71,6 +71,17 @@ XMLSEC_EXPORT xmlSecKeyDataStorePtr     xmlSecKeysMngrGetDataStore      (xmlSecK
 typedef xmlSecKeyPtr    (*xmlSecGetKeyCallback)         (xmlNodePtr keyInfoNode,
                                                          xmlSecKeyInfoCtxPtr keyInfoCtx);
 
+/**
+ * @brief Share the keys found in the keys store.
+ * @details If flag is set then the simple and indexed keys stores return
+ * a new reference to the stored key (see #xmlSecKeyRef) instead of a copy.
+ * The returned keys must not be modified (use #xmlSecKeyEnsureWritable to get
+ * a key that can be modified) and the keys data must be safe to use from
+ * several threads at once with the crypto library in use. By default,
+ * the keys stores return a copy of the stored key.
+ */
+#define XMLSEC_KEYSMNGR_FLAGS_SHARE_KEYS                        0x00000001
+
 /**
  * @brief The keys manager structure.
  */
@@ -78,6 +89,7 @@ struct _xmlSecKeysMngr {
     xmlSecKeyStorePtr           keysStore;  /**< the key store (list of keys known to keys manager). */
     xmlSecPtrList               storesList;  /**< the list of key data stores known to keys manager. */
     xmlSecGetKeyCallback        getKey;  /**< the callback used to read &lt;dsig:KeyInfo/&gt; node. */
+    unsigned int                flags;  /**< the bit mask for flags that control the keys manager (XMLSEC_KEYSMNGR_FLAGS_*). */
 };
 
 
@@ -171,7 +183,9 @@ typedef void                    (*xmlSecKeyStoreFinalizeMethod)         (xmlSecK
 /**
  * @brief Keys store specific find method by key name.
  * @details Keys store specific find method. The caller is responsible for destroying
- * the returned key using #xmlSecKeyDestroy method.
+ * the returned key using #xmlSecKeyDestroy method. The store might return a key
+ * shared with the store (see #XMLSEC_KEYSMNGR_FLAGS_SHARE_KEYS), such key must
+ * not be modified.
  * @param store the store.
  * @param name the desired key name.
  * @param keyInfoCtx the pointer to key info context.
@@ -261,6 +275,26 @@ XMLSEC_EXPORT int                       xmlSecSimpleKeysStoreSave       (xmlSecK
                                                                          const char *filename,
                                                                          xmlSecKeyDataType type);
 XMLSEC_EXPORT xmlSecPtrListPtr          xmlSecSimpleKeysStoreGetKeys    (xmlSecKeyStorePtr store);
+XMLSEC_EXPORT int                       xmlSecSimpleKeysStoreSaveSnapshot(xmlSecKeyStorePtr store,
+                                                                         const char *filename,
+                                                                         xmlSecKeyDataType type);
+XMLSEC_EXPORT int                       xmlSecSimpleKeysStoreLoadSnapshot(xmlSecKeyStorePtr store,
+                                                                         const char *filename);
+
+/******************************************************************************
+ *
+ * Indexed Keys Store
+ *
+  *****************************************************************************/
+/**
+ * @brief An indexed keys store klass id.
+ * @details The simple keys store with the keys indexed by name and key data klass;
+ * use xmlSecSimpleKeysStore* functions to add, load and save keys. The keys are
+ * indexed when added to the store, the keys owned by the store must not be changed
+ * (e.g. with xmlSecKeySetName() or xmlSecKeySetValue()) after that.
+ */
+#define xmlSecIndexedKeysStoreId        xmlSecIndexedKeysStoreGetKlass()
+XMLSEC_EXPORT xmlSecKeyStoreId          xmlSecIndexedKeysStoreGetKlass  (void);
 
 
 #ifdef __cplusplus
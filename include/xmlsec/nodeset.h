@@ -53,14 +53,14 @@ typedef enum {
  * @brief The enhanced nodes set.
  */
 struct _xmlSecNodeSet {
-    xmlNodeSetPtr       nodes;  /**< the nodes list. */
+    xmlNodeSetPtr       nodes;  /**< the nodes list (nodes can be appended to the list, but must not be replaced or removed in place: the membership index is rebuilt only when the list size changes). */
     xmlDocPtr           doc;  /**< the parent XML document. */
     int                 destroyDoc;  /**< the flag: if set to 1 then @p doc will be destroyed when node set is destroyed. */
     xmlSecNodeSetType   type;  /**< the nodes set type. */
     xmlSecNodeSetOp     op;  /**< the operation type. */
     xmlSecNodeSetPtr    next;  /**< the next nodes set. */
     xmlSecNodeSetPtr    prev;  /**< the previous nodes set. */
-    void*               reserved;  /**< the reserved pointer. DEPRECATED: the children list (valid only if type equal to #xmlSecNodeSetList). */
+    void*               reserved;  /**< the reserved pointer, used internally for the nodes membership index (built on the first #xmlSecNodeSetContains call for large @p nodes lists). */
 };
 
 /**
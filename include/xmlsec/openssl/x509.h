@@ -97,6 +97,11 @@ XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLX509StoreAddCertsPath(xmlSe
                                                                          const char* path);
 XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLX509StoreAddCertsFile(xmlSecKeyDataStorePtr store,
                                                                          const char* filename);
+XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLX509StoreSetVerifyCacheSize(xmlSecKeyDataStorePtr store,
+                                                                         xmlSecSize size);
+XMLSEC_CRYPTO_EXPORT void               xmlSecOpenSSLX509StoreGetVerifyCacheStats(xmlSecKeyDataStorePtr store,
+                                                                         xmlSecSize* hits,
+                                                                         xmlSecSize* misses);
 
 /******************************************************************************
  *
@@ -862,6 +862,24 @@ XMLSEC_EXPORT int               xmlSecTransformXPointerSetExpr          (xmlSecT
                                                                          const xmlChar* expr,
                                                                          xmlSecNodeSetType nodeSetType,
                                                                          xmlNodePtr hereNode);
+
+/**
+ * @brief The bare name XPointer transform klass.
+ * @details Selects the element with given ID (the "#id" URI), same as
+ * the "xpointer(id('id'))" XPointer expression but using a direct
+ * lookup in the document IDs table.
+ */
+#define xmlSecTransformBareNameId \
+        xmlSecTransformBareNameGetKlass()
+XMLSEC_EXPORT xmlSecTransformId xmlSecTransformBareNameGetKlass         (void);
+XMLSEC_EXPORT int               xmlSecTransformBareNameSetId            (xmlSecTransformPtr transform,
+                                                                         const xmlChar* id,
+                                                                         xmlSecNodeSetType nodeSetType,
+                                                                         xmlNodePtr hereNode);
+
+XMLSEC_EXPORT void              xmlSecTransformXPathCacheGetStats       (xmlSecSize* hits,
+                                                                         xmlSecSize* misses);
+
 /**
  * @brief The Relationship transform klass.
  */
@@ -150,7 +150,7 @@ struct _xmlSecDSigCtx {
     xmlSecPtrList               manifestReferences;  /**< the list of references in &lt;dsig:Manifest/&gt; nodes. */
 
     /* reserved for future */
-    void*                       reserved0;  /**< reserved for the future. */
+    void*                       reserved0;  /**< used internally: the IDs registry of the current operation. */
     void*                       reserved1;  /**< reserved for the future. */
 };
 
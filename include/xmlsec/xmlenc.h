@@ -97,7 +97,7 @@ struct _xmlSecEncCtx {
     xmlNodePtr                  cipherValueNode;  /**< the pointer to &lt;enc:CipherValue/&gt; node. */
 
     xmlNodePtr                  replacedNodeList;  /**< the first node of the list of replaced nodes (populated when the #XMLSEC_ENC_RETURN_REPLACED_NODE flag is set) */
-    void*                       reserved1;  /**< reserved for the future. */
+    void*                       reserved1;  /**< used internally: the IDs registry of the current operation. */
 };
 
 XMLSEC_EXPORT xmlSecEncCtxPtr   xmlSecEncCtxCreate              (xmlSecKeysMngrPtr keysMngr);
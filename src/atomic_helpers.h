@@ -0,0 +1,103 @@
+/**
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * This is free software; see the Copyright file in the source distribution for precise wording.
+ *
+ * Copyright (C) 2002-2026 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+/**
+ * @brief Internal atomic operations helper macros.
+ */
+#ifndef __XMLSEC_ATOMIC_HELPERS_H__
+#define __XMLSEC_ATOMIC_HELPERS_H__
+
+
+#ifndef XMLSEC_PRIVATE
+#error "atomic_helpers.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+/******************************************************************************
+ *
+ * Atomic counters (e.g. reference counts):
+ *   - xmlSecAtomicIntIncrement(ptr): increments the counter and returns the new value;
+ *   - xmlSecAtomicIntDecrement(ptr): decrements the counter and returns the new value;
+ *   - xmlSecAtomicIntLoad(ptr): returns the counter value.
+ *
+ * Atomic pointers (e.g. the data published once it is fully built):
+ *   - xmlSecAtomicPtrLoad(ptr): returns the pointer value (acquire);
+ *   - xmlSecAtomicPtrStore(ptr, val): sets the pointer value (release);
+ *   - xmlSecAtomicPtrCompareExchange(ptr, oldval, newval): sets the pointer value
+ *     to newval if it is equal to oldval and returns the previous value (full barrier).
+ *
+  *****************************************************************************/
+#if defined(__GNUC__) || defined(__clang__)
+
+typedef int xmlSecAtomicInt;
+
+#define xmlSecAtomicIntIncrement(ptr)   __atomic_add_fetch((ptr), 1, __ATOMIC_ACQ_REL)
+#define xmlSecAtomicIntDecrement(ptr)   __atomic_sub_fetch((ptr), 1, __ATOMIC_ACQ_REL)
+#define xmlSecAtomicIntLoad(ptr)        __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+
+#define xmlSecAtomicPtrLoad(ptr)        __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define xmlSecAtomicPtrStore(ptr, val)  __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define xmlSecAtomicPtrCompareExchange(ptr, oldval, newval) \
+    __sync_val_compare_and_swap((ptr), (oldval), (newval))
+
+#elif defined(_MSC_VER)
+
+#include <intrin.h>
+
+typedef long xmlSecAtomicInt;
+
+#define xmlSecAtomicIntIncrement(ptr)   _InterlockedIncrement((volatile long*)(ptr))
+#define xmlSecAtomicIntDecrement(ptr)   _InterlockedDecrement((volatile long*)(ptr))
+#define xmlSecAtomicIntLoad(ptr)        _InterlockedOr((volatile long*)(ptr), 0)
+
+#define xmlSecAtomicPtrLoad(ptr)        _InterlockedCompareExchangePointer((void* volatile*)(ptr), NULL, NULL)
+#define xmlSecAtomicPtrStore(ptr, val)  ((void)_InterlockedExchangePointer((void* volatile*)(ptr), (void*)(val)))
+#define xmlSecAtomicPtrCompareExchange(ptr, oldval, newval) \
+    _InterlockedCompareExchangePointer((void* volatile*)(ptr), (void*)(newval), (void*)(oldval))
+
+#else /* defined(_MSC_VER) */
+
+/* no compiler atomics: serialize the operations with the libxml2 library lock */
+#include <libxml/threads.h>
+
+typedef int xmlSecAtomicInt;
+
+static inline xmlSecAtomicInt
+xmlSecAtomicIntAddLocked(xmlSecAtomicInt* ptr, xmlSecAtomicInt delta) {
+    xmlSecAtomicInt res;
+
+    xmlLockLibrary();
+    (*ptr) += delta;
+    res = (*ptr);
+    xmlUnlockLibrary();
+    return(res);
+}
+
+static inline void*
+xmlSecAtomicPtrExchangeLocked(void** ptr, void* oldval, void* newval, int force) {
+    void* res;
+
+    xmlLockLibrary();
+    res = (*ptr);
+    if((force != 0) || (res == oldval)) {
+        (*ptr) = newval;
+    }
+    xmlUnlockLibrary();
+    return(res);
+}
+
+#define xmlSecAtomicIntIncrement(ptr)   xmlSecAtomicIntAddLocked((ptr), 1)
+#define xmlSecAtomicIntDecrement(ptr)   xmlSecAtomicIntAddLocked((ptr), -1)
+#define xmlSecAtomicIntLoad(ptr)        xmlSecAtomicIntAddLocked((ptr), 0)
+
+#define xmlSecAtomicPtrLoad(ptr)        xmlSecAtomicPtrExchangeLocked((void**)(ptr), NULL, NULL, 0)
+#define xmlSecAtomicPtrStore(ptr, val)  ((void)xmlSecAtomicPtrExchangeLocked((void**)(ptr), NULL, (void*)(val), 1))
+#define xmlSecAtomicPtrCompareExchange(ptr, oldval, newval) \
+    xmlSecAtomicPtrExchangeLocked((void**)(ptr), (void*)(oldval), (void*)(newval), 0)
+
+#endif /* defined(__GNUC__) || defined(__clang__) */
+
+#endif /* __XMLSEC_ATOMIC_HELPERS_H__ */
@@ -62,6 +62,34 @@ xmlSecBufferWipe(xmlSecBufferPtr buf, xmlSecByte* data, xmlSecSize size) {
     }
 }
 
+/*
+ * Moves the data back to the beginning of the allocated memory and returns
+ * the consumed head space (see xmlSecBufferRemoveHead) to the buffer. The
+ * bytes after the data are always zeroed, thus we need to wipe everything
+ * that ends up after the data after the move.
+ */
+static void
+xmlSecBufferCompact(xmlSecBufferPtr buf) {
+    xmlSecByte* base;
+
+    xmlSecAssert(buf != NULL);
+
+    if(buf->headSize <= 0) {
+        return;
+    }
+    xmlSecAssert(buf->data != NULL);
+
+    base = buf->data - buf->headSize;
+    if(buf->size > 0) {
+        memmove(base, buf->data, buf->size);
+    }
+    xmlSecBufferWipe(buf, base + buf->size, buf->headSize);
+
+    buf->data = base;
+    buf->maxSize += buf->headSize;
+    buf->headSize = 0;
+}
+
 /**
  * @brief Sets the default buffer allocation mode.
  * @details Sets new global default allocation mode and minimal initial size.
@@ -132,6 +160,7 @@ xmlSecBufferInitialize(xmlSecBufferPtr buf, xmlSecSize size) {
     buf->data = NULL;
     buf->size = buf->maxSize = 0;
     buf->flags = 0;
+    buf->headSize = 0;
 
     switch(gAllocMode) {
         case xmlSecAllocModeExact:
@@ -166,6 +195,7 @@ xmlSecBufferFinalize(xmlSecBufferPtr buf) {
     buf->data = NULL;
     buf->size = buf->maxSize = 0;
     buf->flags = 0;
+    buf->headSize = 0;
 }
 
 /**
@@ -177,6 +207,11 @@ xmlSecBufferEmpty(xmlSecBufferPtr buf) {
     xmlSecAssert(buf != NULL);
 
     if(buf->data != 0) {
+        /* return the consumed head space, it is wiped below */
+        buf->data -= buf->headSize;
+        buf->maxSize += buf->headSize;
+        buf->headSize = 0;
+
         xmlSecAssert(buf->maxSize > 0);
         xmlSecBufferWipe(buf, buf->data, buf->maxSize);
     }
@@ -301,12 +336,23 @@ int
 xmlSecBufferSetMaxSize(xmlSecBufferPtr buf, xmlSecSize size) {
     xmlSecByte* newData;
     xmlSecSize newSize = 0;
+    xmlSecSize oldMaxSize;
 
     xmlSecAssert2(buf != NULL, -1);
     if(size <= buf->maxSize) {
         return(0);
     }
 
+    /* Reclaim the consumed head space if moving the data costs no more than
+     * the bytes we already consumed or if we have to re-allocate anyway.
+     * Otherwise, grow the buffer and keep the head: this keeps the
+     * amortized cost of #xmlSecBufferRemoveHead constant. */
+    if((buf->headSize > 0) && ((buf->headSize >= buf->size) || ((size - buf->maxSize) > buf->headSize))) {
+        xmlSecBufferCompact(buf);
+        if(size <= buf->maxSize) {
+            return(0);
+        }
+    }
 
     if((buf->flags & XMLSEC_BUFFER_FLAG_ALLOC_MODE_DOUBLE) != 0) {
       if(size > ((XMLSEC_SIZE_MAX - 32) / 2)) {
@@ -326,11 +372,15 @@ xmlSecBufferSetMaxSize(xmlSecBufferPtr buf, xmlSecSize size) {
     if(newSize < gInitialSize) {
         newSize = gInitialSize;
     }
-
+    if(newSize > XMLSEC_SIZE_MAX - buf->headSize) {
+        xmlSecInvalidSizeError("newSize", newSize, (XMLSEC_SIZE_MAX - buf->headSize), NULL);
+        return(-1);
+    }
 
     if(buf->data != NULL) {
-        newData = (xmlSecByte*)xmlRealloc(buf->data, newSize);
+        newData = (xmlSecByte*)xmlRealloc(buf->data - buf->headSize, buf->headSize + newSize);
     } else {
+        xmlSecAssert2(buf->headSize == 0, -1);
         newData = (xmlSecByte*)xmlMalloc(newSize);
     }
     if(newData == NULL) {
@@ -338,13 +388,13 @@ xmlSecBufferSetMaxSize(xmlSecBufferPtr buf, xmlSecSize size) {
         return(-1);
     }
 
-    buf->data = newData;
+    oldMaxSize = (buf->data != NULL) ? buf->maxSize : 0;
+    buf->data = newData + buf->headSize;
     buf->maxSize = newSize;
 
-    if(buf->size < buf->maxSize) {
-        xmlSecAssert2(buf->data != NULL, -1);
-        memset(buf->data + buf->size, 0, buf->maxSize - buf->size);
-    }
+    /* the bytes after the data are always zeroed, only the new ones need it */
+    xmlSecAssert2(oldMaxSize < buf->maxSize, -1);
+    memset(buf->data + oldMaxSize, 0, buf->maxSize - oldMaxSize);
 
     return(0);
 }
@@ -365,6 +415,7 @@ xmlSecBufferSwap(xmlSecBufferPtr buf1, xmlSecBufferPtr buf2) {
     SWAP(xmlSecSize,        buf1->size, buf2->size);
     SWAP(xmlSecSize,        buf1->maxSize, buf2->maxSize);
     SWAP(int,               buf1->flags, buf2->flags);
+    SWAP(xmlSecSize,        buf1->headSize, buf2->headSize);
 }
 
 /**
@@ -423,6 +474,18 @@ xmlSecBufferPrepend(xmlSecBufferPtr buf, const xmlSecByte* data, xmlSecSize size
             return(-1);
         }
 
+        /* use the consumed head space if we have enough */
+        if(size <= buf->headSize) {
+            xmlSecAssert2(buf->data != NULL, -1);
+
+            buf->data -= size;
+            buf->headSize -= size;
+            buf->maxSize += size;
+            memcpy(buf->data, data, size);
+            buf->size += size;
+            return(0);
+        }
+
         ret = xmlSecBufferSetMaxSize(buf, buf->size + size);
         if(ret < 0) {
             xmlSecInternalError2("xmlSecBufferSetMaxSize", NULL,
@@ -441,6 +504,11 @@ xmlSecBufferPrepend(xmlSecBufferPtr buf, const xmlSecByte* data, xmlSecSize size
 /**
  * @brief Removes bytes from the beginning of the buffer.
  * @details Removes @p size bytes from the beginning of the current buffer.
+ * The removed bytes are not moved: the buffer data pointer is advanced
+ * and the space is reclaimed later when the buffer needs to grow, thus
+ * consuming the buffer in small chunks takes linear time. As a result,
+ * the pointer returned by #xmlSecBufferGetData and the value returned by
+ * #xmlSecBufferGetMaxSize change after this call.
  * @param buf the pointer to buffer object.
  * @param size the number of bytes to be removed.
  * @return 0 on success or a negative value if an error occurs.
@@ -452,14 +520,19 @@ xmlSecBufferRemoveHead(xmlSecBufferPtr buf, xmlSecSize size) {
     if(size < buf->size) {
         xmlSecAssert2(buf->data != NULL, -1);
 
+        /* non-secure consumed bytes are wiped later if the space is reused */
+        if((buf->flags & XMLSEC_BUFFER_FLAG_SECURE) != 0) {
+            xmlSecMemCleanse(buf->data, size);
+        }
+        buf->data += size;
+        buf->headSize += size;
+        buf->maxSize -= size;
         buf->size -= size;
-        memmove(buf->data, buf->data + size, buf->size);
     } else {
+        /* everything is consumed: start from the beginning of the allocated memory */
+        xmlSecBufferWipe(buf, buf->data, buf->size);
         buf->size = 0;
-    }
-    if(buf->size < buf->maxSize) {
-        xmlSecAssert2(buf->data != NULL, -1);
-        xmlSecBufferWipe(buf, buf->data + buf->size, buf->maxSize - buf->size);
+        xmlSecBufferCompact(buf);
     }
     return(0);
 }
@@ -473,16 +546,20 @@ xmlSecBufferRemoveHead(xmlSecBufferPtr buf, xmlSecSize size) {
  */
 int
 xmlSecBufferRemoveTail(xmlSecBufferPtr buf, xmlSecSize size) {
+    xmlSecSize oldSize;
+
     xmlSecAssert2(buf != NULL, -1);
 
+    oldSize = buf->size;
     if(size < buf->size) {
         buf->size -= size;
     } else {
         buf->size = 0;
     }
-    if(buf->size < buf->maxSize) {
+    if(buf->size < oldSize) {
+        /* the bytes after the data are always zeroed, only the removed ones need it */
         xmlSecAssert2(buf->data != NULL, -1);
-        xmlSecBufferWipe(buf, buf->data + buf->size, buf->maxSize - buf->size);
+        xmlSecBufferWipe(buf, buf->data + buf->size, oldSize - buf->size);
     }
     return(0);
 }
@@ -17,6 +17,7 @@
 
 #include <libxml/tree.h>
 #include <libxml/c14n.h>
+#include <libxml/xpathInternals.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/keys.h>
@@ -26,6 +27,7 @@
 #include <xmlsec/errors.h>
 
 #include "cast_helpers.h"
+#include "transform_helpers.h"
 
 /******************************************************************************
  *
@@ -74,6 +76,32 @@ static int              xmlSecTransformC14NExecute      (xmlSecTransformId id,
                                                          xmlSecPtrListPtr nsList,
                                                          xmlOutputBufferPtr buf);
 
+typedef struct _xmlSecTransformC14NFeed {
+    xmlSecTransformPtr          transform;
+    xmlSecTransformCtxPtr       transformCtx;
+} xmlSecTransformC14NFeed, *xmlSecTransformC14NFeedPtr;
+
+static int              xmlSecTransformC14NCanFeedNext  (xmlSecTransformPtr transform);
+static int              xmlSecTransformC14NFeedNext     (xmlSecTransformPtr transform,
+                                                         xmlSecTransformCtxPtr transformCtx);
+
+typedef struct _xmlSecTransformC14NVisibility {
+    xmlSecNodeSetPtr            nodes;
+    xmlNodePtr                  excluded;           /* the excluded subtree (enveloped signature) */
+    int                         wholeDoc;           /* 1 if nodes = the whole document minus the excluded subtree */
+    int                         withComments;       /* valid only if wholeDoc is set */
+
+    /* the last checked element: c14n visits nodes in the document order */
+    xmlNodePtr                  lastElem;
+    int                         lastElemExcluded;
+} xmlSecTransformC14NVisibility, *xmlSecTransformC14NVisibilityPtr;
+
+static int              xmlSecTransformC14NVisibilityInitialize(xmlSecTransformC14NVisibilityPtr visibility,
+                                                         xmlSecNodeSetPtr nodes);
+static int              xmlSecTransformC14NIsVisible    (xmlSecTransformC14NVisibilityPtr visibility,
+                                                         xmlNodePtr node,
+                                                         xmlNodePtr parent);
+
 #define XMLSEC_IS_XML_SPACE(ch) \
     (((ch) == ' ') || ((ch) == '\t') || ((ch) == '\n') || ((ch) == '\r'))
 
@@ -289,6 +317,25 @@ xmlSecTransformC14NPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
             return(-1);
         }
 
+        /* feed the next transform directly if possible */
+        if(xmlSecTransformC14NCanFeedNext(transform) == 1) {
+            /* @data points to the next transform's input buffer which we
+             * are about to append to (and possibly re-allocate): don't
+             * touch it anymore, we return no data anyway */
+            data = NULL;
+            maxDataSize = 0;
+
+            ret = xmlSecTransformC14NFeedNext(transform, transformCtx);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecTransformC14NFeedNext",
+                                    xmlSecTransformGetName(transform));
+                return(-1);
+            }
+            transform->status = xmlSecTransformStatusFinished;
+            (*dataSize) = 0;
+            return(0);
+        }
+
         /* dump everything to internal buffer */
         buf = xmlSecBufferCreateOutputBuffer(out);
         if(buf == NULL) {
@@ -355,6 +402,9 @@ xmlSecTransformC14NPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
 static int
 xmlSecTransformC14NExecute(xmlSecTransformId id, xmlSecNodeSetPtr nodes, xmlSecPtrListPtr nsList,
                            xmlOutputBufferPtr buf) {
+    xmlSecTransformC14NVisibility visibility;
+    xmlC14NIsVisibleCallback isVisible;
+    void* isVisibleData;
     int ret;
 
     xmlSecAssert2(id != xmlSecTransformIdUnknown, -1);
@@ -364,35 +414,32 @@ xmlSecTransformC14NExecute(xmlSecTransformId id, xmlSecNodeSetPtr nodes, xmlSecP
     xmlSecAssert2(xmlSecPtrListCheckId(nsList, xmlSecStringListId), -1);
     xmlSecAssert2(buf != NULL, -1);
 
+    /* use the fast path for the enveloped signature if possible */
+    if(xmlSecTransformC14NVisibilityInitialize(&visibility, nodes) == 1) {
+        isVisible = (xmlC14NIsVisibleCallback)xmlSecTransformC14NIsVisible;
+        isVisibleData = &visibility;
+    } else {
+        isVisible = (xmlC14NIsVisibleCallback)xmlSecNodeSetContains;
+        isVisibleData = nodes;
+    }
+
     /* execute c14n transform */
     if(id == xmlSecTransformInclC14NId) {
-        ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_1_0, NULL, 0, buf);
+        ret = xmlC14NExecute(nodes->doc, isVisible, isVisibleData, XML_C14N_1_0, NULL, 0, buf);
     } else if(id == xmlSecTransformInclC14NWithCommentsId) {
-         ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_1_0, NULL, 1, buf);
+        ret = xmlC14NExecute(nodes->doc, isVisible, isVisibleData, XML_C14N_1_0, NULL, 1, buf);
     } else if(id == xmlSecTransformInclC14N11Id) {
-        ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_1_1, NULL, 0, buf);
+        ret = xmlC14NExecute(nodes->doc, isVisible, isVisibleData, XML_C14N_1_1, NULL, 0, buf);
     } else if(id == xmlSecTransformInclC14N11WithCommentsId) {
-         ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_1_1, NULL, 1, buf);
+        ret = xmlC14NExecute(nodes->doc, isVisible, isVisibleData, XML_C14N_1_1, NULL, 1, buf);
     } else if(id == xmlSecTransformExclC14NId) {
         /* we are using a semi-hack here: we know that xmlSecPtrList keeps
          * all pointers in the big array */
-        ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_EXCLUSIVE_1_0, (xmlChar**)(nsList->data), 0, buf);
+        ret = xmlC14NExecute(nodes->doc, isVisible, isVisibleData, XML_C14N_EXCLUSIVE_1_0, (xmlChar**)(nsList->data), 0, buf);
     } else if(id == xmlSecTransformExclC14NWithCommentsId) {
         /* we are using a semi-hack here: we know that xmlSecPtrList keeps
          * all pointers in the big array */
-        ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_EXCLUSIVE_1_0, (xmlChar**)(nsList->data), 1, buf);
+        ret = xmlC14NExecute(nodes->doc, isVisible, isVisibleData, XML_C14N_EXCLUSIVE_1_0, (xmlChar**)(nsList->data), 1, buf);
     } else if(id == xmlSecTransformRemoveXmlTagsC14NId) {
         ret = xmlSecNodeSetDumpTextNodes(nodes, buf);
     } else {
@@ -410,6 +457,236 @@ xmlSecTransformC14NExecute(xmlSecTransformId id, xmlSecNodeSetPtr nodes, xmlSecP
     return(0);
 }
 
+/******************************************************************************
+ *
+ * Enveloped signature fast path
+ *
+ * The enveloped signature transform intersects the input nodes set with
+ * the tree nodes set that excludes the <dsig:Signature/> subtree (see
+ * #xmlSecTransformEnvelopedGetKlass). Instead of checking every node
+ * against the nodes sets list, we skip the excluded subtree by comparing
+ * pointers and, if the input is the whole document (the most common
+ * same document reference), we don't check the nodes sets at all.
+ *
+  *****************************************************************************/
+/* returns 1 if the fast path can be used, 0 otherwise */
+static int
+xmlSecTransformC14NVisibilityInitialize(xmlSecTransformC14NVisibilityPtr visibility, xmlSecNodeSetPtr nodes) {
+    xmlSecNodeSetPtr base;
+    xmlSecNodeSetPtr excluded;
+    xmlNodePtr cur;
+
+    xmlSecAssert2(visibility != NULL, 0);
+    xmlSecAssert2(nodes != NULL, 0);
+    xmlSecAssert2(nodes->doc != NULL, 0);
+
+    memset(visibility, 0, sizeof(xmlSecTransformC14NVisibility));
+
+    /* the excluded subtree is the last in the list */
+    base = nodes;
+    excluded = nodes->prev;
+    if((excluded == NULL) || (excluded == base) || (excluded->op != xmlSecNodeSetIntersection)) {
+        return(0);
+    }
+    if((excluded->type != xmlSecNodeSetTreeInvert) && (excluded->type != xmlSecNodeSetTreeWithoutCommentsInvert)) {
+        return(0);
+    }
+    if((excluded->nodes == NULL) || (excluded->nodes->nodeNr != 1) || (excluded->nodes->nodeTab == NULL) ||
+       (excluded->nodes->nodeTab[0] == NULL) || (excluded->nodes->nodeTab[0]->type != XML_ELEMENT_NODE)
+    ) {
+        return(0);
+    }
+    visibility->nodes = nodes;
+    visibility->excluded = excluded->nodes->nodeTab[0];
+
+    /* check if the base nodes set is the whole document */
+    if((base->next != excluded) || ((base->type != xmlSecNodeSetTree) && (base->type != xmlSecNodeSetTreeWithoutComments))) {
+        return(1);
+    }
+    if(base->nodes != NULL) {
+        for(cur = nodes->doc->children; cur != NULL; cur = cur->next) {
+            if((cur->type == XML_COMMENT_NODE) && (base->type == xmlSecNodeSetTreeWithoutComments)) {
+                continue;
+            }
+            if(!xmlXPathNodeSetContains(base->nodes, cur)) {
+                return(1);
+            }
+        }
+    }
+    visibility->wholeDoc = 1;
+    visibility->withComments = ((base->type == xmlSecNodeSetTree) && (excluded->type == xmlSecNodeSetTreeInvert)) ? 1 : 0;
+    return(1);
+}
+
+static int
+xmlSecTransformC14NIsVisible(xmlSecTransformC14NVisibilityPtr visibility, xmlNodePtr node, xmlNodePtr parent) {
+    xmlNodePtr elem;
+    xmlNodePtr cur;
+    int excluded = 0;
+
+    xmlSecAssert2(visibility != NULL, 0);
+    xmlSecAssert2(visibility->nodes != NULL, 0);
+    xmlSecAssert2(visibility->excluded != NULL, 0);
+    xmlSecAssert2(node != NULL, 0);
+
+    /* same rules as for the tree nodes set: non element nodes are checked
+     * against their parent element (if any) */
+    if(node->type == XML_ELEMENT_NODE) {
+        elem = node;
+    } else if((parent != NULL) && (parent->type == XML_ELEMENT_NODE)) {
+        elem = parent;
+    } else {
+        elem = NULL;
+    }
+
+    if(elem == visibility->lastElem) {
+        excluded = visibility->lastElemExcluded;
+    } else if(elem != NULL) {
+        /* the parent is usually the last checked element */
+        for(cur = elem; (cur != NULL) && (cur->type == XML_ELEMENT_NODE); cur = cur->parent) {
+            if(cur == visibility->excluded) {
+                excluded = 1;
+                break;
+            }
+            if((cur != elem) && (cur == visibility->lastElem)) {
+                excluded = visibility->lastElemExcluded;
+                break;
+            }
+        }
+        visibility->lastElem = elem;
+        visibility->lastElemExcluded = excluded;
+    }
+    if(excluded) {
+        return(0);
+    }
+
+    if((visibility->wholeDoc != 0) && (elem != NULL)) {
+        return(((visibility->withComments != 0) || (node->type != XML_COMMENT_NODE)) ? 1 : 0);
+    }
+    return(xmlSecNodeSetContains(visibility->nodes, node, parent));
+}
+
+/******************************************************************************
+ *
+ * Pull mode: feed the next transform directly
+ *
+ * The next transform pulls the C14N output chunk by chunk (see
+ * #xmlSecTransformDefaultPopBin): it appends each chunk to its input
+ * buffer and executes. The xmlC14NExecute() can not be suspended and
+ * staging the whole canonical document in the output buffer requires
+ * O(document) memory. Instead, we do the same work from the libxml2
+ * output buffer callback: each chunk is added to the next transform's
+ * input buffer and the next transform is executed right away. Then we
+ * report "no more data" and the next transform finalizes itself.
+ *
+ * This is only done for the digest and signature transforms: they do not
+ * produce any output until the end, otherwise the output would pile up
+ * in the next transform's output buffer instead.
+ *
+  *****************************************************************************/
+static int      xmlSecTransformC14NFeedWrite            (xmlSecTransformC14NFeedPtr feed,
+                                                         const xmlSecByte* data,
+                                                         int len);
+static int      xmlSecTransformC14NFeedClose            (xmlSecTransformC14NFeedPtr feed);
+
+/* checks that the next transform is a digest or signature transform that pulls us
+ * from xmlSecTransformDefaultPopBin() into its input buffer */
+static int
+xmlSecTransformC14NCanFeedNext(xmlSecTransformPtr transform) {
+    xmlSecTransformPtr next;
+
+    xmlSecAssert2(transform != NULL, -1);
+
+    next = transform->next;
+    if((next == NULL) || (next->id == NULL) || (next->prev != transform)) {
+        return(0);
+    }
+    if((next->id->usage & (xmlSecTransformUsageDigestMethod | xmlSecTransformUsageSignatureMethod)) == 0) {
+        return(0);
+    }
+    if((next->id->popBin != xmlSecTransformDefaultPopBin) || (next->id->execute == NULL)) {
+        return(0);
+    }
+    if((next->flags & XMLSEC_TRANSFORM_FLAGS_POP_BIN_INTO_IN_BUF) == 0) {
+        return(0);
+    }
+    return(1);
+}
+
+static int
+xmlSecTransformC14NFeedNext(xmlSecTransformPtr transform, xmlSecTransformCtxPtr transformCtx) {
+    xmlSecTransformC14NFeed feed;
+    xmlOutputBufferPtr buf;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformC14NCheckId(transform), -1);
+    xmlSecAssert2(xmlSecTransformIsValid(transform->next), -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    feed.transform = transform->next;
+    feed.transformCtx = transformCtx;
+
+    buf = xmlOutputBufferCreateIO((xmlOutputWriteCallback)xmlSecTransformC14NFeedWrite,
+                                  (xmlOutputCloseCallback)xmlSecTransformC14NFeedClose,
+                                  &feed,
+                                  NULL);
+    if(buf == NULL) {
+        xmlSecXmlError("xmlOutputBufferCreateIO", xmlSecTransformGetName(transform));
+        return(-1);
+    }
+
+    ret = xmlSecTransformC14NExecute(transform->id, transform->inNodes,
+            xmlSecC14NGetCtx(transform), buf);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformC14NExecute",
+                            xmlSecTransformGetName(transform));
+        (void)xmlOutputBufferClose(buf);
+        return(-1);
+    }
+    ret = xmlOutputBufferClose(buf);
+    if(ret < 0) {
+        xmlSecXmlError("xmlOutputBufferClose", xmlSecTransformGetName(transform));
+        return(-1);
+    }
+    return(0);
+}
+
+static int
+xmlSecTransformC14NFeedWrite(xmlSecTransformC14NFeedPtr feed, const xmlSecByte* data, int len) {
+    xmlSecSize size;
+    int ret;
+
+    xmlSecAssert2(feed != NULL, -1);
+    xmlSecAssert2(xmlSecTransformIsValid(feed->transform), -1);
+    xmlSecAssert2(feed->transformCtx != NULL, -1);
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(len >= 0, -1);
+
+    XMLSEC_SAFE_CAST_INT_TO_SIZE(len, size, return(-1), xmlSecTransformGetName(feed->transform));
+    ret = xmlSecBufferAppend(&(feed->transform->inBuf), data, size);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecBufferAppend", xmlSecTransformGetName(feed->transform),
+            "size=" XMLSEC_SIZE_FMT, size);
+        return(-1);
+    }
+
+    ret = xmlSecTransformExecute(feed->transform, 0, feed->transformCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformExecute", xmlSecTransformGetName(feed->transform));
+        return(-1);
+    }
+
+    /* we consumed the whole input buffer */
+    return(len);
+}
+
+static int
+xmlSecTransformC14NFeedClose(xmlSecTransformC14NFeedPtr feed) {
+    xmlSecAssert2(feed != NULL, -1);
+
+    /* the next transform is finalized when we return no more data */
+    return(0);
+}
 /******************************************************************************
  *
  * C14N
@@ -19,7 +19,10 @@
 #include <ctype.h>
 #include <errno.h>
 
+#include <libxml/hash.h>
+
 #include <xmlsec/xmlsec.h>
+#include <xmlsec/buffer.h>
 #include <xmlsec/keys.h>
 #include <xmlsec/keyinfo.h>
 #include <xmlsec/keysmngr.h>
@@ -38,12 +41,47 @@
  * Internal GnuTLS X509 store CTX
  *
   *****************************************************************************/
+typedef struct _xmlSecGnuTLSX509IndexItem               xmlSecGnuTLSX509IndexItem,
+                                                        *xmlSecGnuTLSX509IndexItemPtr;
+struct _xmlSecGnuTLSX509IndexItem {
+    gnutls_x509_crt_t               cert;           /* NOT OWNED */
+    xmlSecSize                      pos;            /* the cert position in the certs list */
+    xmlSecGnuTLSX509IndexItemPtr    nextSameRawDn;  /* the next cert with the same raw subject DN */
+    xmlSecGnuTLSX509IndexItemPtr    next;           /* all items list */
+};
+
+typedef struct _xmlSecGnuTLSX509IndexDigest {
+    gnutls_digest_algorithm_t       algo;
+    xmlHashTablePtr                 certs;          /* hex digest -> first item */
+} xmlSecGnuTLSX509IndexDigest;
+
+#define XMLSEC_GNUTLS_X509_INDEX_DIGESTS_MAX    12
+
+/* the certs list indexes, the keys are built to match exactly the same certs as
+ * xmlSecGnuTLSX509FindCertCtxMatch() does */
+typedef struct _xmlSecGnuTLSX509CertsIndex {
+    int                             valid;
+    xmlSecSize                      size;
+    xmlSecSize                      unindexedDnsSize;   /* the certs with DNs that can't be indexed */
+    xmlSecGnuTLSX509IndexItemPtr    items;
+    xmlHashTablePtr                 bySubject;          /* canonical subject DN -> first item */
+    xmlHashTablePtr                 byIssuerSerial;     /* canonical issuer DN + serial -> first item */
+    xmlHashTablePtr                 bySki;              /* hex SKI -> first item */
+    xmlHashTablePtr                 byRawSubject;       /* hex raw subject DN -> items chain */
+    xmlSecGnuTLSX509IndexDigest     byDigest[XMLSEC_GNUTLS_X509_INDEX_DIGESTS_MAX];
+    xmlSecSize                      byDigestSize;
+} xmlSecGnuTLSX509CertsIndex, *xmlSecGnuTLSX509CertsIndexPtr;
+
 typedef struct _xmlSecGnuTLSX509StoreCtx                xmlSecGnuTLSX509StoreCtx,
                                                         *xmlSecGnuTLSX509StoreCtxPtr;
 struct _xmlSecGnuTLSX509StoreCtx {
     xmlSecPtrList certsTrusted;
     xmlSecPtrList certsUntrusted;
     xmlSecPtrList crls;
+
+    /* maintained in xmlSecGnuTLSX509StoreAdoptCert() */
+    xmlSecGnuTLSX509CertsIndex trustedIndex;
+    xmlSecGnuTLSX509CertsIndex untrustedIndex;
 };
 
 /******************************************************************************
@@ -74,10 +112,12 @@ static xmlSecKeyDataStoreKlass xmlSecGnuTLSX509StoreKlass = {
 };
 
 static gnutls_x509_crt_t xmlSecGnuTLSX509FindCert                       (xmlSecPtrListPtr certs,
+                                                                         xmlSecGnuTLSX509CertsIndexPtr index,
                                                                          xmlSecGnuTLSX509FindCertCtxPtr findCertCtx);
 static gnutls_x509_crt_t xmlSecGnuTLSX509FindSignedCert                 (xmlSecPtrListPtr certs,
                                                                          gnutls_x509_crt_t cert);
 static gnutls_x509_crt_t xmlSecGnuTLSX509FindSignerCert                 (xmlSecPtrListPtr certs,
+                                                                         xmlSecGnuTLSX509CertsIndexPtr index,
                                                                          gnutls_x509_crt_t cert);
 static int              xmlSecGnuTLSX509StoreVerifyCert                 (xmlSecGnuTLSX509StoreCtxPtr ctx,
                                                                          gnutls_x509_crt_t* certs_chain,
@@ -88,6 +128,22 @@ static int              xmlSecGnuTLSX509StoreVerifyCert                 (xmlSecG
                                                                          xmlSecSize crls_size,
                                                                          const xmlSecKeyInfoCtx* keyInfoCtx);
 
+static int              xmlSecGnuTLSX509CertsIndexInitialize            (xmlSecGnuTLSX509CertsIndexPtr index);
+static void             xmlSecGnuTLSX509CertsIndexFinalize              (xmlSecGnuTLSX509CertsIndexPtr index);
+static int              xmlSecGnuTLSX509CertsIndexIsValid               (xmlSecGnuTLSX509CertsIndexPtr index,
+                                                                         xmlSecPtrListPtr certs);
+static int              xmlSecGnuTLSX509CertsIndexAdd                   (xmlSecGnuTLSX509CertsIndexPtr index,
+                                                                         gnutls_x509_crt_t cert);
+static int              xmlSecGnuTLSX509CertsIndexFindCert              (xmlSecGnuTLSX509CertsIndexPtr index,
+                                                                         xmlSecGnuTLSX509FindCertCtxPtr findCertCtx,
+                                                                         gnutls_x509_crt_t* res);
+static int              xmlSecGnuTLSX509CertsIndexFindBySubject         (xmlSecGnuTLSX509CertsIndexPtr index,
+                                                                         const xmlChar* subject,
+                                                                         gnutls_x509_crt_t* res);
+static int              xmlSecGnuTLSX509CertsIndexFindByRawSubject      (xmlSecGnuTLSX509CertsIndexPtr index,
+                                                                         const gnutls_datum_t* rawSubject,
+                                                                         xmlSecGnuTLSX509IndexItemPtr* res);
+
 
 /**
  * @brief The GnuTLS X509 certificates key data store klass.
@@ -118,10 +174,10 @@ xmlSecGnuTLSX509StoreFindCertByValue(xmlSecKeyDataStorePtr store, xmlSecKeyX509D
     }
 
     if(res == NULL) {
-        res = xmlSecGnuTLSX509FindCert(&(ctx->certsTrusted), &findCertCtx);
+        res = xmlSecGnuTLSX509FindCert(&(ctx->certsTrusted), &(ctx->trustedIndex), &findCertCtx);
     }
     if(res == NULL) {
-        res = xmlSecGnuTLSX509FindCert(&(ctx->certsUntrusted), &findCertCtx);
+        res = xmlSecGnuTLSX509FindCert(&(ctx->certsUntrusted), &(ctx->untrustedIndex), &findCertCtx);
     }
 
     /* done */
@@ -392,9 +448,9 @@ xmlSecGnuTLSX509StoreGetCertsChain(xmlSecGnuTLSX509StoreCtxPtr ctx, gnutls_x509_
         certs_chain[ii] = cert;
 
         /* find the cert that signed this one */
-        tmp = xmlSecGnuTLSX509FindSignerCert(extra_certs, cert);
+        tmp = xmlSecGnuTLSX509FindSignerCert(extra_certs, NULL, cert);
         if(tmp == NULL) {
-            tmp = xmlSecGnuTLSX509FindSignerCert(&(ctx->certsUntrusted), cert);
+            tmp = xmlSecGnuTLSX509FindSignerCert(&(ctx->certsUntrusted), &(ctx->untrustedIndex), cert);
         }
 
         if(tmp == cert) {
@@ -480,7 +536,7 @@ xmlSecGnuTLSX509StoreVerifyIssuerCert(xmlSecGnuTLSX509StoreCtxPtr ctx,
         for(ii = 1; ii < certs_chain_size; ++ii) {
             gnutls_x509_crt_t tmp;
 
-            tmp = xmlSecGnuTLSX509FindSignerCert(&(ctx->certsUntrusted), cert);
+            tmp = xmlSecGnuTLSX509FindSignerCert(&(ctx->certsUntrusted), &(ctx->untrustedIndex), cert);
             if((tmp == NULL) || (tmp == cert)) {
                 break;
             }
@@ -844,6 +900,9 @@ done:
 int
 xmlSecGnuTLSX509StoreAdoptCert(xmlSecKeyDataStorePtr store, gnutls_x509_crt_t cert, xmlSecKeyDataType type) {
     xmlSecGnuTLSX509StoreCtxPtr ctx;
+    xmlSecPtrListPtr certs;
+    xmlSecGnuTLSX509CertsIndexPtr index;
+    int indexValid;
     int ret;
 
     xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecGnuTLSX509StoreId), -1);
@@ -853,17 +912,31 @@ xmlSecGnuTLSX509StoreAdoptCert(xmlSecKeyDataStorePtr store, gnutls_x509_crt_t ce
     xmlSecAssert2(ctx != NULL, -1);
 
     if((type & xmlSecKeyDataTypeTrusted) != 0) {
-        ret = xmlSecPtrListAdd(&(ctx->certsTrusted), cert);
-        if(ret < 0) {
-            xmlSecInternalError("xmlSecPtrListAdd(trusted)",
-                                xmlSecKeyDataStoreGetName(store));
-            return(-1);
-        }
+        certs = &(ctx->certsTrusted);
+        index = &(ctx->trustedIndex);
     } else {
-        ret = xmlSecPtrListAdd(&(ctx->certsUntrusted), cert);
+        certs = &(ctx->certsUntrusted);
+        index = &(ctx->untrustedIndex);
+    }
+
+    /* check the index before the cert is added to the list */
+    indexValid = xmlSecGnuTLSX509CertsIndexIsValid(index, certs);
+
+    ret = xmlSecPtrListAdd(certs, cert);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
+                            xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
+    if(indexValid == 1) {
+        ret = xmlSecGnuTLSX509CertsIndexAdd(index, cert);
         if(ret < 0) {
-            xmlSecInternalError("xmlSecPtrListAdd(untrusted)",
+            xmlSecInternalError("xmlSecGnuTLSX509CertsIndexAdd",
                                 xmlSecKeyDataStoreGetName(store));
+            /* the caller still owns the cert on error */
+            xmlSecPtrListPopLast(certs);
+            xmlSecGnuTLSX509CertsIndexFinalize(index);
             return(-1);
         }
     }
@@ -960,15 +1033,105 @@ xmlSecGnuTLSX509StoreVerifyCrlTimeValidity(gnutls_x509_crl_t crl, xmlSecKeyInfoC
     return(1);
 }
 
+/* returns 1 if the cert is the CRL issuer we can use, 0 if not, < 0 if error */
+static int
+xmlSecGnuTLSX509StoreCheckCrlIssuer(xmlSecGnuTLSX509StoreCtxPtr ctx, xmlSecPtrListPtr certs, gnutls_x509_crl_t crl,
+    gnutls_x509_crt_t cert, xmlSecKeyInfoCtxPtr keyInfoCtx
+) {
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(certs != NULL, -1);
+    xmlSecAssert2(crl != NULL, -1);
+    xmlSecAssert2(cert != NULL, -1);
+
+    if(gnutls_x509_crl_check_issuer(crl, cert) == 0) {
+        return(0);
+    }
+
+    /* trusted certs are used as-is, untrusted ones have to be verified first */
+    if(certs == &(ctx->certsTrusted)) {
+        return(1);
+    }
+    ret = xmlSecGnuTLSX509StoreVerifyIssuerCert(ctx, cert, keyInfoCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecGnuTLSX509StoreVerifyIssuerCert", NULL);
+        return(-1);
+    }
+    return(ret);
+}
+
+/* Finds CRL issuer in the certs list: 0 on success (*res is NULL if not found), < 0 if error */
+static int
+xmlSecGnuTLSX509StoreFindCrlIssuer(xmlSecGnuTLSX509StoreCtxPtr ctx, xmlSecPtrListPtr certs,
+    xmlSecGnuTLSX509CertsIndexPtr index, gnutls_x509_crl_t crl, const gnutls_datum_t* raw_issuer_dn,
+    xmlSecKeyInfoCtxPtr keyInfoCtx, gnutls_x509_crt_t* res
+) {
+    xmlSecGnuTLSX509IndexItemPtr item = NULL;
+    xmlSecSize ii, size;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(certs != NULL, -1);
+    xmlSecAssert2(index != NULL, -1);
+    xmlSecAssert2(crl != NULL, -1);
+    xmlSecAssert2(raw_issuer_dn != NULL, -1);
+    xmlSecAssert2(res != NULL, -1);
+
+    (*res) = NULL;
+
+    /* gnutls_x509_crl_check_issuer() compares the raw DNs, only the certs
+     * with the same raw subject need to be checked */
+    if(xmlSecGnuTLSX509CertsIndexIsValid(index, certs) == 1) {
+        ret = xmlSecGnuTLSX509CertsIndexFindByRawSubject(index, raw_issuer_dn, &item);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecGnuTLSX509CertsIndexFindByRawSubject", NULL);
+            return(-1);
+        } else if(ret == 1) {
+            for( ; item != NULL; item = item->nextSameRawDn) {
+                ret = xmlSecGnuTLSX509StoreCheckCrlIssuer(ctx, certs, crl, item->cert, keyInfoCtx);
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecGnuTLSX509StoreCheckCrlIssuer", NULL);
+                    return(-1);
+                } else if(ret == 1) {
+                    (*res) = item->cert;
+                    return(0);
+                }
+            }
+            return(0);
+        }
+    }
+
+    size = xmlSecPtrListGetSize(certs);
+    for(ii = 0; ii < size; ++ii) {
+        gnutls_x509_crt_t cert = xmlSecPtrListGetItem(certs, ii);
+        if(cert == NULL) {
+            continue;
+        }
+
+        ret = xmlSecGnuTLSX509StoreCheckCrlIssuer(ctx, certs, crl, cert, keyInfoCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecGnuTLSX509StoreCheckCrlIssuer", NULL);
+            return(-1);
+        } else if(ret == 1) {
+            (*res) = cert;
+            return(0);
+        }
+    }
+
+    /* not found */
+    return(0);
+}
+
 /* Verify CRL signature: 1 if verified, 0 if not verified, < 0 if error */
 static int
 xmlSecGnuTLSX509StoreVerifyCrlSignature(xmlSecGnuTLSX509StoreCtxPtr ctx, gnutls_x509_crl_t crl,
     xmlSecKeyInfoCtxPtr keyInfoCtx, const xmlChar* storeName
 ) {
     gnutls_x509_crt_t issuer_cert = NULL;
+    gnutls_datum_t raw_issuer_dn = { NULL, 0 };
     xmlChar *issuer_dn = NULL;
     unsigned int verify_result = 0;
-    xmlSecSize ii, trusted_size, untrusted_size;
     unsigned int flags = 0;
     int err;
     int res = -1;
@@ -978,45 +1141,28 @@ xmlSecGnuTLSX509StoreVerifyCrlSignature(xmlSecGnuTLSX509StoreCtxPtr ctx, gnutls_
     xmlSecAssert2(crl != NULL, -1);
     xmlSecAssert2(keyInfoCtx != NULL, -1);
 
-    /* Find the issuer certificate using gnutls_x509_crl_check_issuer - search trusted certs first */
-    trusted_size = xmlSecPtrListGetSize(&(ctx->certsTrusted));
-    for(ii = 0; ii < trusted_size; ++ii) {
-        gnutls_x509_crt_t cert = xmlSecPtrListGetItem(&(ctx->certsTrusted), ii);
-        unsigned int is_issuer;
-
-        if(cert == NULL) {
-            continue;
-        }
+    /* the certs indexes are keyed by the raw subject DN, the index lookup is skipped if we can't get it */
+    err = gnutls_x509_crl_get_raw_issuer_dn(crl, &raw_issuer_dn);
+    if(err != GNUTLS_E_SUCCESS) {
+        raw_issuer_dn.data = NULL;
+        raw_issuer_dn.size = 0;
+    }
 
-        is_issuer = gnutls_x509_crl_check_issuer(crl, cert);
-        if(is_issuer != 0) {
-            issuer_cert = cert;
-            break;
-        }
+    /* Find the issuer certificate using gnutls_x509_crl_check_issuer - search trusted certs first */
+    ret = xmlSecGnuTLSX509StoreFindCrlIssuer(ctx, &(ctx->certsTrusted), &(ctx->trustedIndex),
+        crl, &raw_issuer_dn, keyInfoCtx, &issuer_cert);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecGnuTLSX509StoreFindCrlIssuer(trusted)", storeName);
+        goto done;
     }
 
     /* If not found in trusted, search untrusted */
     if(issuer_cert == NULL) {
-        untrusted_size = xmlSecPtrListGetSize(&(ctx->certsUntrusted));
-        for(ii = 0; ii < untrusted_size; ++ii) {
-            gnutls_x509_crt_t cert = xmlSecPtrListGetItem(&(ctx->certsUntrusted), ii);
-            unsigned int is_issuer;
-
-            if(cert == NULL) {
-                continue;
-            }
-
-            is_issuer = gnutls_x509_crl_check_issuer(crl, cert);
-            if(is_issuer != 0) {
-                ret = xmlSecGnuTLSX509StoreVerifyIssuerCert(ctx, cert, keyInfoCtx);
-                if(ret < 0) {
-                    xmlSecInternalError("xmlSecGnuTLSX509StoreVerifyIssuerCert", storeName);
-                    goto done;
-                } else if(ret == 1) {
-                    issuer_cert = cert;
-                    break;
-                }
-            }
+        ret = xmlSecGnuTLSX509StoreFindCrlIssuer(ctx, &(ctx->certsUntrusted), &(ctx->untrustedIndex),
+            crl, &raw_issuer_dn, keyInfoCtx, &issuer_cert);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecGnuTLSX509StoreFindCrlIssuer(untrusted)", storeName);
+            goto done;
         }
     }
 
@@ -1080,6 +1226,9 @@ done:
     if(issuer_dn != NULL) {
         xmlFree(issuer_dn);
     }
+    if(raw_issuer_dn.data != NULL) {
+        gnutls_free(raw_issuer_dn.data);
+    }
     return(res);
 }
 
@@ -1171,6 +1320,20 @@ xmlSecGnuTLSX509StoreInitialize(xmlSecKeyDataStorePtr store) {
         return(-1);
     }
 
+    ret = xmlSecGnuTLSX509CertsIndexInitialize(&(ctx->trustedIndex));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecGnuTLSX509CertsIndexInitialize(trusted)",
+                            xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
+    ret = xmlSecGnuTLSX509CertsIndexInitialize(&(ctx->untrustedIndex));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecGnuTLSX509CertsIndexInitialize(untrusted)",
+                            xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
     return(0);
 }
 
@@ -1182,6 +1345,8 @@ xmlSecGnuTLSX509StoreFinalize(xmlSecKeyDataStorePtr store) {
     ctx = xmlSecGnuTLSX509StoreGetCtx(store);
     xmlSecAssert(ctx != NULL);
 
+    xmlSecGnuTLSX509CertsIndexFinalize(&(ctx->trustedIndex));
+    xmlSecGnuTLSX509CertsIndexFinalize(&(ctx->untrustedIndex));
     xmlSecPtrListFinalize(&(ctx->certsTrusted));
     xmlSecPtrListFinalize(&(ctx->certsUntrusted));
     xmlSecPtrListFinalize(&(ctx->crls));
@@ -1311,14 +1476,25 @@ done:
 }
 
 static gnutls_x509_crt_t
-xmlSecGnuTLSX509FindCert(xmlSecPtrListPtr certs, xmlSecGnuTLSX509FindCertCtxPtr findCertCtx) {
+xmlSecGnuTLSX509FindCert(xmlSecPtrListPtr certs, xmlSecGnuTLSX509CertsIndexPtr index, xmlSecGnuTLSX509FindCertCtxPtr findCertCtx) {
+    gnutls_x509_crt_t res = NULL;
     xmlSecSize ii, sz;
     int ret;
 
     xmlSecAssert2(certs != NULL, NULL);
     xmlSecAssert2(findCertCtx != NULL, NULL);
 
-    /* todo: this is not the fastest way to search certs */
+    /* try the index first */
+    if((index != NULL) && (xmlSecGnuTLSX509CertsIndexIsValid(index, certs) == 1)) {
+        ret = xmlSecGnuTLSX509CertsIndexFindCert(index, findCertCtx, &res);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecGnuTLSX509CertsIndexFindCert", NULL);
+            return(NULL);
+        } else if(ret == 1) {
+            return(res);
+        }
+    }
+
     sz = xmlSecPtrListGetSize(certs);
     for(ii = 0; (ii < sz); ++ii) {
         gnutls_x509_crt_t cert = xmlSecPtrListGetItem(certs, ii);
@@ -1394,10 +1570,11 @@ done:
 
 /* signer cert has subject dn equal to our's issuer dn */
 static gnutls_x509_crt_t
-xmlSecGnuTLSX509FindSignerCert(xmlSecPtrListPtr certs, gnutls_x509_crt_t cert) {
+xmlSecGnuTLSX509FindSignerCert(xmlSecPtrListPtr certs, xmlSecGnuTLSX509CertsIndexPtr index, gnutls_x509_crt_t cert) {
     gnutls_x509_crt_t res = NULL;
     xmlChar * issuer = NULL;
     xmlSecSize ii, sz;
+    int ret;
 
     xmlSecAssert2(certs != NULL, NULL);
     xmlSecAssert2(cert != NULL, NULL);
@@ -1409,6 +1586,18 @@ xmlSecGnuTLSX509FindSignerCert(xmlSecPtrListPtr certs, gnutls_x509_crt_t cert) {
         goto done;
     }
 
+    /* try the index first */
+    if((index != NULL) && (xmlSecGnuTLSX509CertsIndexIsValid(index, certs) == 1)) {
+        ret = xmlSecGnuTLSX509CertsIndexFindBySubject(index, issuer, &res);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecGnuTLSX509CertsIndexFindBySubject", NULL);
+            res = NULL;
+            goto done;
+        } else if(ret == 1) {
+            goto done;
+        }
+    }
+
     /* todo: this is not the fastest way to search certs */
     sz = xmlSecPtrListGetSize(certs);
     for(ii = 0; (ii < sz) && (res == NULL); ++ii) {
@@ -1443,4 +1632,718 @@ done:
     return(res);
 }
 
+
+
+/******************************************************************************
+ *
+ * Certificates lists indexes: the keys are built to match exactly the same
+ * certificates as xmlSecGnuTLSX509FindCertCtxMatch() does. If an index is
+ * not in sync with its certificates list (e.g. an error occured while adding
+ * a certificate), the lookups fall back to the full scan.
+ *
+  *****************************************************************************/
+static const char xmlSecGnuTLSX509IndexHexDigits[] = "0123456789abcdef";
+
+static int
+xmlSecGnuTLSX509IndexAppendHex(xmlSecBufferPtr buf, const xmlSecByte* data, xmlSecSize size) {
+    xmlSecByte hex[2];
+    xmlSecSize ii;
+    int ret;
+
+    xmlSecAssert2(buf != NULL, -1);
+
+    for(ii = 0; ii < size; ++ii) {
+        hex[0] = (xmlSecByte)xmlSecGnuTLSX509IndexHexDigits[(data[ii] >> 4) & 0x0F];
+        hex[1] = (xmlSecByte)xmlSecGnuTLSX509IndexHexDigits[data[ii] & 0x0F];
+        ret = xmlSecBufferAppend(buf, hex, sizeof(hex));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferAppend", NULL);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static xmlChar*
+xmlSecGnuTLSX509IndexBufferToKey(xmlSecBufferPtr buf) {
+    xmlChar* res;
+    int len;
+
+    xmlSecAssert2(buf != NULL, NULL);
+
+    XMLSEC_SAFE_CAST_SIZE_TO_INT(xmlSecBufferGetSize(buf), len, return(NULL), NULL);
+    res = xmlStrndup(xmlSecBufferGetData(buf), len);
+    if(res == NULL) {
+        xmlSecStrdupError(xmlSecBufferGetData(buf), NULL);
+        return(NULL);
+    }
+    return(res);
+}
+
+static xmlChar*
+xmlSecGnuTLSX509IndexHexKey(const xmlSecByte* data, xmlSecSize size) {
+    xmlSecBuffer buf;
+    xmlChar* res;
+    int ret;
+
+    ret = xmlSecBufferInitialize(&buf, 2 * size + 1);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        return(NULL);
+    }
+    ret = xmlSecGnuTLSX509IndexAppendHex(&buf, data, size);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecGnuTLSX509IndexAppendHex", NULL);
+        xmlSecBufferFinalize(&buf);
+        return(NULL);
+    }
+    res = xmlSecGnuTLSX509IndexBufferToKey(&buf);
+    xmlSecBufferFinalize(&buf);
+    return(res);
+}
+
+/* xmlSecGnuTLSDnAttrsFind() treats "email" and "emailAddress" as the same attribute */
+static const xmlChar*
+xmlSecGnuTLSX509IndexDnAttrKey(const xmlChar* key) {
+    if(xmlStrEqual(key, BAD_CAST "emailaddress")) {
+        return(BAD_CAST "email");
+    }
+    return(key);
+}
+
+static int
+xmlSecGnuTLSX509IndexDnAttrsCompare(const void* ll, const void* rr) {
+    const xmlSecGnuTLSDnAttr* llAttr = (const xmlSecGnuTLSDnAttr*)ll;
+    const xmlSecGnuTLSDnAttr* rrAttr = (const xmlSecGnuTLSDnAttr*)rr;
+    int ret;
+
+    ret = xmlStrcmp(xmlSecGnuTLSX509IndexDnAttrKey(llAttr->key), xmlSecGnuTLSX509IndexDnAttrKey(rrAttr->key));
+    if(ret != 0) {
+        return(ret);
+    }
+    return(xmlStrcmp(llAttr->value, rrAttr->value));
+}
+
+static int
+xmlSecGnuTLSX509IndexAppendString(xmlSecBufferPtr buf, const xmlChar* str) {
+    xmlChar prefix[32];
+    xmlSecSize prefixSize, strSize;
+    int len;
+    int ret;
+
+    xmlSecAssert2(buf != NULL, -1);
+    xmlSecAssert2(str != NULL, -1);
+
+    /* the length prefix makes the key unambiguous regardless of the string content */
+    len = xmlStrlen(str);
+    XMLSEC_SAFE_CAST_INT_TO_SIZE(len, strSize, return(-1), NULL);
+    ret = xmlStrPrintf(prefix, (int)sizeof(prefix), "%d:", len);
+    if(ret < 0) {
+        xmlSecXmlError("xmlStrPrintf", NULL);
+        return(-1);
+    }
+    XMLSEC_SAFE_CAST_INT_TO_SIZE(ret, prefixSize, return(-1), NULL);
+
+    ret = xmlSecBufferAppend(buf, prefix, prefixSize);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferAppend", NULL);
+        return(-1);
+    }
+    ret = xmlSecBufferAppend(buf, str, strSize);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferAppend", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * Builds the DN key: two DNs have the same key if and only if
+ * xmlSecGnuTLSX509DnsEqual() considers them equal. The attributes
+ * are sorted, the (ASCII case insensitive) names are lowercased and
+ * "emailAddress" is mapped to "email". The DNs with repeated attributes
+ * can not be matched this way.
+ *
+ * Returns 1 if the key was created, 0 if the DN can not be indexed or
+ * a negative value if an error occurs.
+ */
+static int
+xmlSecGnuTLSX509IndexDnKey(const xmlChar* dn, xmlChar** key) {
+    xmlSecGnuTLSDnAttr attrs[XMLSEC_GNUTLS_DN_ATTRS_SIZE];
+    xmlSecBuffer buf;
+    xmlSecSize ii, num;
+    xmlChar* ch;
+    int ret;
+    int res = -1;
+
+    xmlSecAssert2(dn != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    (*key) = NULL;
+    xmlSecGnuTLSDnAttrsInitialize(attrs, XMLSEC_GNUTLS_DN_ATTRS_SIZE);
+
+    ret = xmlSecBufferInitialize(&buf, 128);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        goto done;
+    }
+
+    /* the full scan reports the broken DNs */
+    ret = xmlSecGnuTLSDnAttrsParse(dn, attrs, XMLSEC_GNUTLS_DN_ATTRS_SIZE);
+    if(ret < 0) {
+        res = 0;
+        goto done;
+    }
+
+    /* normalize */
+    for(ii = num = 0; ii < XMLSEC_GNUTLS_DN_ATTRS_SIZE; ++ii) {
+        if(attrs[ii].key == NULL) {
+            continue;
+        }
+        if(attrs[ii].value == NULL) {
+            res = 0;
+            goto done;
+        }
+        for(ch = attrs[ii].key; (*ch) != '\0'; ++ch) {
+            if(((*ch) >= 'A') && ((*ch) <= 'Z')) {
+                (*ch) = (xmlChar)((*ch) - 'A' + 'a');
+            }
+        }
+        if(ii != num) {
+            attrs[num] = attrs[ii];
+            attrs[ii].key = NULL;
+            attrs[ii].value = NULL;
+        }
+        ++num;
+    }
+    if(num > 1) {
+        qsort(attrs, num, sizeof(attrs[0]), xmlSecGnuTLSX509IndexDnAttrsCompare);
+    }
+
+    /* write out */
+    for(ii = 0; ii < num; ++ii) {
+        if((ii > 0) && xmlStrEqual(xmlSecGnuTLSX509IndexDnAttrKey(attrs[ii - 1].key), xmlSecGnuTLSX509IndexDnAttrKey(attrs[ii].key))) {
+            res = 0;
+            goto done;
+        }
+        ret = xmlSecGnuTLSX509IndexAppendString(&buf, xmlSecGnuTLSX509IndexDnAttrKey(attrs[ii].key));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecGnuTLSX509IndexAppendString(key)", NULL);
+            goto done;
+        }
+        ret = xmlSecGnuTLSX509IndexAppendString(&buf, attrs[ii].value);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecGnuTLSX509IndexAppendString(value)", NULL);
+            goto done;
+        }
+    }
+
+    (*key) = xmlSecGnuTLSX509IndexBufferToKey(&buf);
+    if((*key) == NULL) {
+        xmlSecInternalError("xmlSecGnuTLSX509IndexBufferToKey", NULL);
+        goto done;
+    }
+
+    /* success */
+    res = 1;
+
+done:
+    xmlSecBufferFinalize(&buf);
+    xmlSecGnuTLSDnAttrsDeinitialize(attrs, XMLSEC_GNUTLS_DN_ATTRS_SIZE);
+    return(res);
+}
+
+/* the items are added in the certs list order, keep the first one */
+static int
+xmlSecGnuTLSX509IndexAddItem(xmlHashTablePtr table, const xmlChar* key, const xmlChar* key2, xmlSecGnuTLSX509IndexItemPtr item) {
+    int ret;
+
+    xmlSecAssert2(table != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(item != NULL, -1);
+
+    if(xmlHashLookup2(table, key, key2) != NULL) {
+        return(0);
+    }
+    ret = xmlHashAddEntry2(table, key, key2, item);
+    if(ret != 0) {
+        xmlSecXmlError2("xmlHashAddEntry2", NULL, "key=%s", xmlSecErrorsSafeString(key));
+        return(-1);
+    }
+    return(0);
+}
+
+static xmlSecGnuTLSX509IndexItemPtr
+xmlSecGnuTLSX509IndexLookup(xmlHashTablePtr table, const xmlChar* key, const xmlChar* key2, xmlSecGnuTLSX509IndexItemPtr best) {
+    xmlSecGnuTLSX509IndexItemPtr item;
+
+    xmlSecAssert2(table != NULL, best);
+    xmlSecAssert2(key != NULL, best);
+
+    item = (xmlSecGnuTLSX509IndexItemPtr)xmlHashLookup2(table, key, key2);
+    if((item == NULL) || ((best != NULL) && (best->pos < item->pos))) {
+        return(best);
+    }
+    return(item);
+}
+
+static int
+xmlSecGnuTLSX509CertsIndexAddDigest(xmlSecGnuTLSX509CertsIndexPtr index, gnutls_digest_algorithm_t algo) {
+    xmlSecAssert2(index != NULL, -1);
+    xmlSecAssert2(index->byDigestSize < XMLSEC_GNUTLS_X509_INDEX_DIGESTS_MAX, -1);
+
+    index->byDigest[index->byDigestSize].certs = xmlHashCreate(0);
+    if(index->byDigest[index->byDigestSize].certs == NULL) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        return(-1);
+    }
+    index->byDigest[index->byDigestSize].algo = algo;
+    ++index->byDigestSize;
+    return(0);
+}
+
+static int
+xmlSecGnuTLSX509CertsIndexInitialize(xmlSecGnuTLSX509CertsIndexPtr index) {
+    int ret;
+
+    xmlSecAssert2(index != NULL, -1);
+
+    memset(index, 0, sizeof(*index));
+    index->bySubject = xmlHashCreate(0);
+    index->byIssuerSerial = xmlHashCreate(0);
+    index->bySki = xmlHashCreate(0);
+    index->byRawSubject = xmlHashCreate(0);
+    if((index->bySubject == NULL) || (index->byIssuerSerial == NULL) || (index->bySki == NULL) || (index->byRawSubject == NULL)) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        xmlSecGnuTLSX509CertsIndexFinalize(index);
+        return(-1);
+    }
+
+    /* the digests supported in xmlSecGnuTLSX509GetDigestFromAlgorithm() */
+    ret = 0;
+#ifndef XMLSEC_NO_SHA1
+    ret = (ret < 0) ? ret : xmlSecGnuTLSX509CertsIndexAddDigest(index, GNUTLS_DIG_SHA1);
+#endif /* XMLSEC_NO_SHA1 */
+#ifndef XMLSEC_NO_SHA224
+    ret = (ret < 0) ? ret : xmlSecGnuTLSX509CertsIndexAddDigest(index, GNUTLS_DIG_SHA224);
+#endif /* XMLSEC_NO_SHA224 */
+#ifndef XMLSEC_NO_SHA256
+    ret = (ret < 0) ? ret : xmlSecGnuTLSX509CertsIndexAddDigest(index, GNUTLS_DIG_SHA256);
+#endif /* XMLSEC_NO_SHA256 */
+#ifndef XMLSEC_NO_SHA384
+    ret = (ret < 0) ? ret : xmlSecGnuTLSX509CertsIndexAddDigest(index, GNUTLS_DIG_SHA384);
+#endif /* XMLSEC_NO_SHA384 */
+#ifndef XMLSEC_NO_SHA512
+    ret = (ret < 0) ? ret : xmlSecGnuTLSX509CertsIndexAddDigest(index, GNUTLS_DIG_SHA512);
+#endif /* XMLSEC_NO_SHA512 */
+#ifndef XMLSEC_NO_SHA3
+    ret = (ret < 0) ? ret : xmlSecGnuTLSX509CertsIndexAddDigest(index, GNUTLS_DIG_SHA3_224);
+    ret = (ret < 0) ? ret : xmlSecGnuTLSX509CertsIndexAddDigest(index, GNUTLS_DIG_SHA3_256);
+    ret = (ret < 0) ? ret : xmlSecGnuTLSX509CertsIndexAddDigest(index, GNUTLS_DIG_SHA3_384);
+    ret = (ret < 0) ? ret : xmlSecGnuTLSX509CertsIndexAddDigest(index, GNUTLS_DIG_SHA3_512);
+#endif /* XMLSEC_NO_SHA3 */
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecGnuTLSX509CertsIndexAddDigest", NULL);
+        xmlSecGnuTLSX509CertsIndexFinalize(index);
+        return(-1);
+    }
+
+    index->valid = 1;
+    return(0);
+}
+
+static void
+xmlSecGnuTLSX509CertsIndexFinalize(xmlSecGnuTLSX509CertsIndexPtr index) {
+    xmlSecGnuTLSX509IndexItemPtr item;
+    xmlSecSize ii;
+
+    xmlSecAssert(index != NULL);
+
+    /* the tables don't own the items */
+    if(index->bySubject != NULL) {
+        xmlHashFree(index->bySubject, NULL);
+    }
+    if(index->byIssuerSerial != NULL) {
+        xmlHashFree(index->byIssuerSerial, NULL);
+    }
+    if(index->bySki != NULL) {
+        xmlHashFree(index->bySki, NULL);
+    }
+    if(index->byRawSubject != NULL) {
+        xmlHashFree(index->byRawSubject, NULL);
+    }
+    for(ii = 0; ii < index->byDigestSize; ++ii) {
+        if(index->byDigest[ii].certs != NULL) {
+            xmlHashFree(index->byDigest[ii].certs, NULL);
+        }
+    }
+    while(index->items != NULL) {
+        item = index->items;
+        index->items = item->next;
+        xmlFree(item);
+    }
+    memset(index, 0, sizeof(*index));
+}
+
+/* returns 1 if the index is in sync with the certs list or 0 otherwise */
+static int
+xmlSecGnuTLSX509CertsIndexIsValid(xmlSecGnuTLSX509CertsIndexPtr index, xmlSecPtrListPtr certs) {
+    xmlSecAssert2(index != NULL, 0);
+    xmlSecAssert2(certs != NULL, 0);
+
+    if((index->valid == 0) || (index->size != xmlSecPtrListGetSize(certs))) {
+        return(0);
+    }
+    return(1);
+}
+
+/* returns 1 if the key was added, 0 if the DN can not be indexed or a negative value if an error occurs */
+static int
+xmlSecGnuTLSX509CertsIndexAddDn(xmlHashTablePtr table, xmlChar* dn, const xmlChar* key2, xmlSecGnuTLSX509IndexItemPtr item) {
+    xmlChar* key = NULL;
+    int ret;
+
+    xmlSecAssert2(table != NULL, -1);
+    xmlSecAssert2(item != NULL, -1);
+
+    if(dn == NULL) {
+        return(-1);
+    }
+    ret = xmlSecGnuTLSX509IndexDnKey(dn, &key);
+    xmlFree(dn);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecGnuTLSX509IndexDnKey", NULL);
+        return(-1);
+    } else if(ret == 0) {
+        return(0);
+    }
+
+    ret = xmlSecGnuTLSX509IndexAddItem(table, key, key2, item);
+    xmlFree(key);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecGnuTLSX509IndexAddItem", NULL);
+        return(-1);
+    }
+    return(1);
+}
+
+static int
+xmlSecGnuTLSX509CertsIndexAdd(xmlSecGnuTLSX509CertsIndexPtr index, gnutls_x509_crt_t cert) {
+    xmlSecGnuTLSX509IndexItemPtr item, tmp;
+    xmlSecByte md[XMLSEC_GNUTLS_MAX_DIGEST_SIZE];
+    xmlSecByte* ski = NULL;
+    gnutls_datum_t rawDn = { NULL, 0 };
+    size_t mdLen, skiLen;
+    unsigned int critical = 0;
+    xmlChar* key = NULL;
+    xmlChar* serial = NULL;
+    xmlSecSize ii, size;
+    int indexedDns = 1;
+    int err;
+    int ret;
+    int res = -1;
+
+    xmlSecAssert2(index != NULL, -1);
+    xmlSecAssert2(index->valid != 0, -1);
+    xmlSecAssert2(cert != NULL, -1);
+
+    item = (xmlSecGnuTLSX509IndexItemPtr)xmlMalloc(sizeof(xmlSecGnuTLSX509IndexItem));
+    if(item == NULL) {
+        xmlSecMallocError(sizeof(xmlSecGnuTLSX509IndexItem), NULL);
+        return(-1);
+    }
+    memset(item, 0, sizeof(xmlSecGnuTLSX509IndexItem));
+    item->cert = cert;
+    item->pos = index->size;
+    item->next = index->items;
+    index->items = item;
+
+    /* subject */
+    ret = xmlSecGnuTLSX509CertsIndexAddDn(index->bySubject, xmlSecGnuTLSX509CertGetSubjectDN(cert), NULL, item);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecGnuTLSX509CertsIndexAddDn(subject)", NULL);
+        goto done;
+    } else if(ret == 0) {
+        indexedDns = 0;
+    }
+
+    /* issuer and serial */
+    serial = xmlSecGnuTLSX509CertGetIssuerSerial(cert);
+    if(serial == NULL) {
+        xmlSecInternalError("xmlSecGnuTLSX509CertGetIssuerSerial", NULL);
+        goto done;
+    }
+    ret = xmlSecGnuTLSX509CertsIndexAddDn(index->byIssuerSerial, xmlSecGnuTLSX509CertGetIssuerDN(cert), serial, item);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecGnuTLSX509CertsIndexAddDn(issuer)", NULL);
+        goto done;
+    } else if(ret == 0) {
+        indexedDns = 0;
+    }
+
+    /* ski (optional) */
+    skiLen = 0;
+    err = gnutls_x509_crt_get_subject_key_id(cert, NULL, &skiLen, &critical);
+    if((err == GNUTLS_E_SHORT_MEMORY_BUFFER) && (skiLen > 0)) {
+        ski = (xmlSecByte *)xmlMalloc(skiLen);
+        if(ski == NULL) {
+            xmlSecMallocError(skiLen, NULL);
+            goto done;
+        }
+        err = gnutls_x509_crt_get_subject_key_id(cert, ski, &skiLen, &critical);
+        if(err != GNUTLS_E_SUCCESS) {
+            xmlSecGnuTLSError("gnutls_x509_crt_get_subject_key_id", err, NULL);
+            goto done;
+        }
+        XMLSEC_SAFE_CAST_SIZE_T_TO_SIZE(skiLen, size, goto done, NULL);
+        key = xmlSecGnuTLSX509IndexHexKey(ski, size);
+        if(key == NULL) {
+            xmlSecInternalError("xmlSecGnuTLSX509IndexHexKey(ski)", NULL);
+            goto done;
+        }
+        ret = xmlSecGnuTLSX509IndexAddItem(index->bySki, key, NULL, item);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecGnuTLSX509IndexAddItem(ski)", NULL);
+            goto done;
+        }
+        xmlFree(key);
+        key = NULL;
+    }
+
+    /* raw subject: all the certs with the same subject are chained together */
+    err = gnutls_x509_crt_get_raw_dn(cert, &rawDn);
+    if(err != GNUTLS_E_SUCCESS) {
+        xmlSecGnuTLSError("gnutls_x509_crt_get_raw_dn", err, NULL);
+        goto done;
+    }
+    key = xmlSecGnuTLSX509IndexHexKey(rawDn.data, rawDn.size);
+    if(key == NULL) {
+        xmlSecInternalError("xmlSecGnuTLSX509IndexHexKey(rawDn)", NULL);
+        goto done;
+    }
+    tmp = (xmlSecGnuTLSX509IndexItemPtr)xmlHashLookup(index->byRawSubject, key);
+    if(tmp != NULL) {
+        while(tmp->nextSameRawDn != NULL) {
+            tmp = tmp->nextSameRawDn;
+        }
+        tmp->nextSameRawDn = item;
+    } else {
+        ret = xmlSecGnuTLSX509IndexAddItem(index->byRawSubject, key, NULL, item);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecGnuTLSX509IndexAddItem(rawDn)", NULL);
+            goto done;
+        }
+    }
+    xmlFree(key);
+    key = NULL;
+
+    /* digests */
+    for(ii = 0; ii < index->byDigestSize; ++ii) {
+        mdLen = sizeof(md);
+        err = gnutls_x509_crt_get_fingerprint(cert, index->byDigest[ii].algo, md, &mdLen);
+        if((err != GNUTLS_E_SUCCESS) || (mdLen <= 0)) {
+            xmlSecGnuTLSError("gnutls_x509_crt_get_fingerprint", err, NULL);
+            goto done;
+        }
+        XMLSEC_SAFE_CAST_SIZE_T_TO_SIZE(mdLen, size, goto done, NULL);
+        key = xmlSecGnuTLSX509IndexHexKey(md, size);
+        if(key == NULL) {
+            xmlSecInternalError("xmlSecGnuTLSX509IndexHexKey(digest)", NULL);
+            goto done;
+        }
+        ret = xmlSecGnuTLSX509IndexAddItem(index->byDigest[ii].certs, key, NULL, item);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecGnuTLSX509IndexAddItem(digest)", NULL);
+            goto done;
+        }
+        xmlFree(key);
+        key = NULL;
+    }
+
+    /* success */
+    if(indexedDns == 0) {
+        ++index->unindexedDnsSize;
+    }
+    ++index->size;
+    res = 0;
+
+done:
+    if(key != NULL) {
+        xmlFree(key);
+    }
+    if(serial != NULL) {
+        xmlFree(serial);
+    }
+    if(ski != NULL) {
+        xmlFree(ski);
+    }
+    if(rawDn.data != NULL) {
+        gnutls_free(rawDn.data);
+    }
+    return(res);
+}
+
+/* returns 1 if the index was used, 0 if the full scan is required or a negative value if an error occurs */
+static int
+xmlSecGnuTLSX509CertsIndexLookupDn(xmlSecGnuTLSX509CertsIndexPtr index, xmlHashTablePtr table,
+    const xmlChar* dn, const xmlChar* key2, xmlSecGnuTLSX509IndexItemPtr* best
+) {
+    xmlChar* key = NULL;
+    int ret;
+
+    xmlSecAssert2(index != NULL, -1);
+    xmlSecAssert2(table != NULL, -1);
+    xmlSecAssert2(dn != NULL, -1);
+    xmlSecAssert2(best != NULL, -1);
+
+    /* the certs with DNs we can't index might match anything */
+    if(index->unindexedDnsSize > 0) {
+        return(0);
+    }
+    ret = xmlSecGnuTLSX509IndexDnKey(dn, &key);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecGnuTLSX509IndexDnKey", NULL);
+        return(-1);
+    } else if(ret == 0) {
+        return(0);
+    }
+
+    (*best) = xmlSecGnuTLSX509IndexLookup(table, key, key2, (*best));
+    xmlFree(key);
+    return(1);
+}
+
+/* returns 1 if the index was used, 0 if the full scan is required or a negative value if an error occurs */
+static int
+xmlSecGnuTLSX509CertsIndexFindCert(xmlSecGnuTLSX509CertsIndexPtr index, xmlSecGnuTLSX509FindCertCtxPtr findCertCtx,
+    gnutls_x509_crt_t* res
+) {
+    xmlSecGnuTLSX509IndexItemPtr best = NULL;
+    xmlHashTablePtr digestCerts = NULL;
+    xmlChar* key = NULL;
+    xmlSecSize ii, size;
+    int ret;
+
+    xmlSecAssert2(index != NULL, -1);
+    xmlSecAssert2(findCertCtx != NULL, -1);
+    xmlSecAssert2(res != NULL, -1);
+
+    (*res) = NULL;
+    if(index->valid == 0) {
+        return(0);
+    }
+
+    /* do we have the digests index for this algorithm? */
+    if((findCertCtx->digestValue != NULL) && (findCertCtx->digestLen > 0) && (findCertCtx->digestAlgo != GNUTLS_DIG_UNKNOWN)) {
+        for(ii = 0; ii < index->byDigestSize; ++ii) {
+            if(index->byDigest[ii].algo == findCertCtx->digestAlgo) {
+                digestCerts = index->byDigest[ii].certs;
+                break;
+            }
+        }
+        if(digestCerts == NULL) {
+            return(0);
+        }
+    }
+
+    if(findCertCtx->subjectName != NULL) {
+        ret = xmlSecGnuTLSX509CertsIndexLookupDn(index, index->bySubject, findCertCtx->subjectName, NULL, &best);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecGnuTLSX509CertsIndexLookupDn(subject)", NULL);
+            return(-1);
+        } else if(ret == 0) {
+            return(0);
+        }
+    }
+    if((findCertCtx->issuerName != NULL) && (findCertCtx->issuerSerial != NULL)) {
+        ret = xmlSecGnuTLSX509CertsIndexLookupDn(index, index->byIssuerSerial, findCertCtx->issuerName, findCertCtx->issuerSerial, &best);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecGnuTLSX509CertsIndexLookupDn(issuer)", NULL);
+            return(-1);
+        } else if(ret == 0) {
+            return(0);
+        }
+    }
+    if((findCertCtx->ski != NULL) && (findCertCtx->skiSize > 0)) {
+        key = xmlSecGnuTLSX509IndexHexKey(findCertCtx->ski, findCertCtx->skiSize);
+        if(key == NULL) {
+            xmlSecInternalError("xmlSecGnuTLSX509IndexHexKey(ski)", NULL);
+            return(-1);
+        }
+        best = xmlSecGnuTLSX509IndexLookup(index->bySki, key, NULL, best);
+        xmlFree(key);
+    }
+    if(digestCerts != NULL) {
+        XMLSEC_SAFE_CAST_SIZE_T_TO_SIZE(findCertCtx->digestLen, size, return(-1), NULL);
+        key = xmlSecGnuTLSX509IndexHexKey(findCertCtx->digestValue, size);
+        if(key == NULL) {
+            xmlSecInternalError("xmlSecGnuTLSX509IndexHexKey(digest)", NULL);
+            return(-1);
+        }
+        best = xmlSecGnuTLSX509IndexLookup(digestCerts, key, NULL, best);
+        xmlFree(key);
+    }
+
+    /* success */
+    if(best != NULL) {
+        (*res) = best->cert;
+    }
+    return(1);
+}
+
+/* returns 1 if the index was used, 0 if the full scan is required or a negative value if an error occurs */
+static int
+xmlSecGnuTLSX509CertsIndexFindBySubject(xmlSecGnuTLSX509CertsIndexPtr index, const xmlChar* subject, gnutls_x509_crt_t* res) {
+    xmlSecGnuTLSX509IndexItemPtr best = NULL;
+    int ret;
+
+    xmlSecAssert2(index != NULL, -1);
+    xmlSecAssert2(subject != NULL, -1);
+    xmlSecAssert2(res != NULL, -1);
+
+    (*res) = NULL;
+    if(index->valid == 0) {
+        return(0);
+    }
+
+    ret = xmlSecGnuTLSX509CertsIndexLookupDn(index, index->bySubject, subject, NULL, &best);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecGnuTLSX509CertsIndexLookupDn", NULL);
+        return(-1);
+    } else if(ret == 0) {
+        return(0);
+    }
+    if(best != NULL) {
+        (*res) = best->cert;
+    }
+    return(1);
+}
+
+/* returns 1 if the index was used, 0 if the full scan is required or a negative value if an error occurs;
+ * the found items are chained with nextSameRawDn in the certs list order */
+static int
+xmlSecGnuTLSX509CertsIndexFindByRawSubject(xmlSecGnuTLSX509CertsIndexPtr index, const gnutls_datum_t* rawSubject,
+    xmlSecGnuTLSX509IndexItemPtr* res
+) {
+    xmlChar* key;
+
+    xmlSecAssert2(index != NULL, -1);
+    xmlSecAssert2(rawSubject != NULL, -1);
+    xmlSecAssert2(res != NULL, -1);
+
+    (*res) = NULL;
+    if((index->valid == 0) || (rawSubject->data == NULL)) {
+        return(0);
+    }
+
+    key = xmlSecGnuTLSX509IndexHexKey(rawSubject->data, rawSubject->size);
+    if(key == NULL) {
+        xmlSecInternalError("xmlSecGnuTLSX509IndexHexKey", NULL);
+        return(-1);
+    }
+    (*res) = (xmlSecGnuTLSX509IndexItemPtr)xmlHashLookup(index->byRawSubject, key);
+    xmlFree(key);
+    return(1);
+}
+
 #endif /* XMLSEC_NO_X509 */
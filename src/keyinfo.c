@@ -59,6 +59,18 @@
 #include "cast_helpers.h"
 #include "keysdata_helpers.h"
 
+/* checks if the <dsig:KeyName/> reader has handed the key found in the keys
+ * manager over to xmlSecKeysMngrGetKey() (see xmlSecKeyInfoFoundKey) */
+static int
+xmlSecKeyInfoCtxHasFoundKey(xmlSecKeyInfoCtxPtr keyInfoCtx, xmlSecKeyPtr key) {
+    xmlSecKeyInfoFoundKeyPtr foundKey;
+
+    xmlSecAssert2(keyInfoCtx != NULL, 0);
+
+    foundKey = (xmlSecKeyInfoFoundKeyPtr)keyInfoCtx->reserved1;
+    return(((foundKey != NULL) && (foundKey->key == key) && (foundKey->foundKey != NULL)) ? 1 : 0);
+}
+
 /******************************************************************************
  *
  * High-level functions
@@ -88,7 +100,7 @@ xmlSecKeyInfoNodeRead(xmlNodePtr keyInfoNode, xmlSecKeyPtr key, xmlSecKeyInfoCtx
     xmlSecAssert2(keyInfoCtx->mode == xmlSecKeyInfoModeRead, -1);
 
     for(cur = xmlSecGetNextElementNode(keyInfoNode->children);
-        (cur != NULL) &&
+        (cur != NULL) && (xmlSecKeyInfoCtxHasFoundKey(keyInfoCtx, key) == 0) &&
         (((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_DONT_STOP_ON_KEY_FOUND) != 0) ||
          (xmlSecKeyIsValid(key) == 0) ||
          (xmlSecKeyMatch(key, NULL, &(keyInfoCtx->keyReq)) == 0));
@@ -662,18 +674,29 @@ xmlSecKeyDataNameXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key, xmlNodePtr node,
 
     /* try to find key in the manager */
     if((xmlSecKeyGetValue(key) == NULL) && (keyInfoCtx->keysMngr != NULL)) {
+        xmlSecKeyInfoFoundKeyPtr foundKey;
         xmlSecKeyPtr tmpKey;
 
         tmpKey = xmlSecKeysMngrFindKey(keyInfoCtx->keysMngr, newName, keyInfoCtx);
         if(tmpKey != NULL) {
+            /* the found key is the final result: let the caller take it as-is
+             * (see xmlSecKeysMngrGetKey()) instead of copying it */
+            if(((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_DONT_STOP_ON_KEY_FOUND) == 0) &&
+               (xmlStrEqual(xmlSecKeyGetName(tmpKey), newName) == 1) &&
+               (xmlSecKeyIsValid(tmpKey) == 1) &&
+               (xmlSecKeyMatch(tmpKey, NULL, &(keyInfoCtx->keyReq)) == 1)
+            ) {
+                foundKey = (xmlSecKeyInfoFoundKeyPtr)keyInfoCtx->reserved1;
+                if((foundKey != NULL) && (foundKey->key == key) && (foundKey->foundKey == NULL)) {
+                    foundKey->foundKey = tmpKey;
+                    xmlFree(newName);
+                    return(0);
+                }
+            }
+
             /* erase any current information in the key */
             xmlSecKeyEmpty(key);
 
-            /* TODO: since we will destroy tmpKey anyway, we can easily
-             * just re-assign key data values. It'll save us some memory
-             * malloc/free
-             */
-
             /* and copy what we've found */
             ret = xmlSecKeyCopy(key, tmpKey);
             if(ret < 0) {
@@ -1481,6 +1504,21 @@ xmlSecKeyDataKeyInfoReferenceReadXmlResult(xmlSecKeyDataId typeId, xmlSecKeyPtr
 
 #ifndef XMLSEC_NO_XMLENC
 
+/*
+ * The nested &lt;enc:EncryptedKey/&gt;, &lt;enc11:DerivedKey/&gt; and similar
+ * elements are processed within the outer sign/verify or encrypt/decrypt operation:
+ * share its IDs registry (stored in keyInfoCtx->reserved0) with the nested encCtx.
+ */
+static void
+xmlSecKeyInfoCtxSetEncCtxIdsRegistry(xmlSecKeyInfoCtxPtr keyInfoCtx, void* registry) {
+    xmlSecAssert(keyInfoCtx != NULL);
+    xmlSecAssert(keyInfoCtx->encCtx != NULL);
+
+    keyInfoCtx->encCtx->reserved1 = registry;
+    keyInfoCtx->encCtx->keyInfoReadCtx.reserved0 = registry;
+    keyInfoCtx->encCtx->keyInfoWriteCtx.reserved0 = registry;
+}
+
 /******************************************************************************
  *
  * &lt;enc:EncryptedKey/&gt; processing
@@ -1587,7 +1625,9 @@ xmlSecKeyDataEncryptedKeyXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key, xmlNodePt
 
     /* decrypt */
     ++keyInfoCtx->curEncryptedKeyLevel;
+    xmlSecKeyInfoCtxSetEncCtxIdsRegistry(keyInfoCtx, keyInfoCtx->reserved0);
     result = xmlSecEncCtxDecryptToBuffer(keyInfoCtx->encCtx, node);
+    xmlSecKeyInfoCtxSetEncCtxIdsRegistry(keyInfoCtx, NULL);
     --keyInfoCtx->curEncryptedKeyLevel;
     if((result == NULL) || (xmlSecBufferGetData(result) == NULL)) {
         /* We might have multiple EncryptedKey elements, encrypted
@@ -1665,7 +1705,9 @@ xmlSecKeyDataEncryptedKeyXmlWrite(xmlSecKeyDataId id, xmlSecKeyPtr key, xmlNodeP
     xmlSecAssert2(keyInfoCtx->encCtx != NULL, -1);
 
     /* encrypt */
+    xmlSecKeyInfoCtxSetEncCtxIdsRegistry(keyInfoCtx, keyInfoCtx->reserved0);
     ret = xmlSecEncCtxBinaryEncrypt(keyInfoCtx->encCtx, node, keyBuf, keySize);
+    xmlSecKeyInfoCtxSetEncCtxIdsRegistry(keyInfoCtx, NULL);
     if(ret < 0) {
         xmlSecInternalError("xmlSecEncCtxBinaryEncrypt", xmlSecKeyDataKlassGetName(id));
         goto done;
@@ -1789,7 +1831,9 @@ xmlSecKeyDataDerivedKeyXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key, xmlNodePtr
     xmlSecAssert2(keyInfoCtx->encCtx != NULL, -1);
 
     ++keyInfoCtx->curEncryptedKeyLevel;
+    xmlSecKeyInfoCtxSetEncCtxIdsRegistry(keyInfoCtx, keyInfoCtx->reserved0);
     generatedKey = xmlSecEncCtxDerivedKeyGenerate(keyInfoCtx->encCtx, keyInfoCtx->keyReq.keyId, node, keyInfoCtx);
+    xmlSecKeyInfoCtxSetEncCtxIdsRegistry(keyInfoCtx, NULL);
     --keyInfoCtx->curEncryptedKeyLevel;
 
     if(generatedKey == NULL) {
@@ -1946,7 +1990,9 @@ xmlSecKeyDataAgreementMethodXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key, xmlNod
     xmlSecAssert2(keyInfoCtx->encCtx != NULL, -1);
 
     ++keyInfoCtx->curEncryptedKeyLevel;
+    xmlSecKeyInfoCtxSetEncCtxIdsRegistry(keyInfoCtx, keyInfoCtx->reserved0);
     generatedKey = xmlSecEncCtxAgreementMethodGenerate(keyInfoCtx->encCtx, keyInfoCtx->keyReq.keyId, node, keyInfoCtx);
+    xmlSecKeyInfoCtxSetEncCtxIdsRegistry(keyInfoCtx, NULL);
     --keyInfoCtx->curEncryptedKeyLevel;
 
     if(generatedKey == NULL) {
@@ -2052,7 +2098,9 @@ xmlSecKeyDataAgreementMethodXmlWrite(xmlSecKeyDataId id, xmlSecKeyPtr key, xmlNo
     }
 
     ++keyInfoCtx->curEncryptedKeyLevel;
+    xmlSecKeyInfoCtxSetEncCtxIdsRegistry(keyInfoCtx, keyInfoCtx->reserved0);
     ret = xmlSecEncCtxAgreementMethodXmlWrite(keyInfoCtx->encCtx, node, keyInfoCtx);
+    xmlSecKeyInfoCtxSetEncCtxIdsRegistry(keyInfoCtx, NULL);
     --keyInfoCtx->curEncryptedKeyLevel;
 
     if(ret < 0) {
@@ -2169,7 +2217,9 @@ xmlSecKeyDataEncapsulationMechanismXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
     xmlSecAssert2(keyInfoCtx->encCtx != NULL, -1);
 
     ++keyInfoCtx->curEncryptedKeyLevel;
+    xmlSecKeyInfoCtxSetEncCtxIdsRegistry(keyInfoCtx, keyInfoCtx->reserved0);
     generatedKey = xmlSecEncCtxEncapsulationMechanismGenerate(keyInfoCtx->encCtx, keyInfoCtx->keyReq.keyId, node, keyInfoCtx);
+    xmlSecKeyInfoCtxSetEncCtxIdsRegistry(keyInfoCtx, NULL);
     --keyInfoCtx->curEncryptedKeyLevel;
 
     if(generatedKey == NULL) {
@@ -2276,7 +2326,9 @@ xmlSecKeyDataEncapsulationMechanismXmlWrite(xmlSecKeyDataId id, xmlSecKeyPtr key
     /* kemKeyDataDup is now owned by the transform context */
 
     ++keyInfoCtx->curEncryptedKeyLevel;
+    xmlSecKeyInfoCtxSetEncCtxIdsRegistry(keyInfoCtx, keyInfoCtx->reserved0);
     ret = xmlSecEncCtxEncapsulationMechanismXmlWrite(keyInfoCtx->encCtx, node, keyInfoCtx);
+    xmlSecKeyInfoCtxSetEncCtxIdsRegistry(keyInfoCtx, NULL);
     --keyInfoCtx->curEncryptedKeyLevel;
 
     if(ret < 0) {
@@ -25,7 +25,9 @@
 #include <xmlsec/keyinfo.h>
 #include <xmlsec/errors.h>
 
+#include "atomic_helpers.h"
 #include "cast_helpers.h"
+#include "keysdata_helpers.h"
 
 /******************************************************************************
  *
@@ -472,6 +474,19 @@ xmlSecKeyReqDebugXmlDump(xmlSecKeyReqPtr keyReq, FILE* output) {
  * xmlSecKey
  *
   *****************************************************************************/
+/* The key reference count is kept outside of the public xmlSecKey structure:
+ * the keys created with xmlSecKeyCreate() are allocated as xmlSecKeyImpl. Only
+ * the functions that require the key to be created with xmlSecKeyCreate()
+ * (xmlSecKeyDestroy, xmlSecKeyRef, xmlSecKeyIsShared, xmlSecKeyEnsureWritable)
+ * access it. The reference count is changed from the keys stores lookups that
+ * might be running in parallel. */
+typedef struct _xmlSecKeyImpl {
+    xmlSecKey                   key;            /* must be the first */
+    xmlSecAtomicInt             refCount;
+} xmlSecKeyImpl, *xmlSecKeyImplPtr;
+
+#define xmlSecKeyGetImpl(key)   ((xmlSecKeyImplPtr)(key))
+
 /**
  * @brief Allocates and initializes a new key object.
  * @details Allocates and initializes new key. Caller is responsible for
@@ -482,21 +497,24 @@ xmlSecKeyReqDebugXmlDump(xmlSecKeyReqPtr keyReq, FILE* output) {
  */
 xmlSecKeyPtr
 xmlSecKeyCreate(void)  {
-    xmlSecKeyPtr key;
+    xmlSecKeyImplPtr impl;
 
     /* Allocate a new xmlSecKey and fill the fields. */
-    key = (xmlSecKeyPtr)xmlMalloc(sizeof(xmlSecKey));
-    if(key == NULL) {
-        xmlSecMallocError(sizeof(xmlSecKey), NULL);
+    impl = (xmlSecKeyImplPtr)xmlMalloc(sizeof(xmlSecKeyImpl));
+    if(impl == NULL) {
+        xmlSecMallocError(sizeof(xmlSecKeyImpl), NULL);
         return(NULL);
     }
-    memset(key, 0, sizeof(xmlSecKey));
-    key->usage = xmlSecKeyUsageAny;
-    return(key);
+    memset(impl, 0, sizeof(xmlSecKeyImpl));
+    impl->key.usage = xmlSecKeyUsageAny;
+    impl->refCount = 1;
+    return(&(impl->key));
 }
 
 /**
  * @brief Clears the @p key data.
+ * @details Clears the @p key data. The @p key must not be shared
+ * (see #xmlSecKeyIsShared).
  * @param key the pointer to key.
  */
 void
@@ -518,19 +536,88 @@ xmlSecKeyEmpty(xmlSecKeyPtr key) {
 
 /**
  * @brief Destroys a key object.
- * @details Destroys the key created using #xmlSecKeyCreate function.
+ * @details Releases a reference to the @p key and destroys the key created
+ * using #xmlSecKeyCreate function when the last reference is released.
  * @param key the pointer to key.
  */
 void
 xmlSecKeyDestroy(xmlSecKeyPtr key) {
     xmlSecAssert(key != NULL);
 
+    if(xmlSecAtomicIntDecrement(&(xmlSecKeyGetImpl(key)->refCount)) > 0) {
+        return;
+    }
+
     xmlSecKeyEmpty(key);
-    xmlFree(key);
+    xmlFree(xmlSecKeyGetImpl(key));
+}
+
+/**
+ * @brief Adds a reference to the key.
+ * @details Adds a reference to the @p key created with #xmlSecKeyCreate function,
+ * the keys stores return the shared keys to avoid copying the keys data on every
+ * lookup if #XMLSEC_KEYSMNGR_FLAGS_SHARE_KEYS flag is set. The shared key must
+ * not be modified with the key mutators (#xmlSecKeySetName, #xmlSecKeySetValue,
+ * #xmlSecKeyAdoptData, #xmlSecKeyCopy, ...), use #xmlSecKeyEnsureWritable to get
+ * a key that can be modified. Every reference is released with #xmlSecKeyDestroy
+ * function.
+ * @param key the pointer to key.
+ *
+ * @return the @p key.
+ */
+xmlSecKeyPtr
+xmlSecKeyRef(xmlSecKeyPtr key) {
+    xmlSecAssert2(key != NULL, NULL);
+
+    xmlSecAtomicIntIncrement(&(xmlSecKeyGetImpl(key)->refCount));
+    return(key);
+}
+
+/**
+ * @brief Checks if the key has more than one reference.
+ * @param key the pointer to key created with #xmlSecKeyCreate function.
+ *
+ * @return 1 if the @p key is shared, 0 if not or a negative value if an error occurs.
+ */
+int
+xmlSecKeyIsShared(xmlSecKeyPtr key) {
+    xmlSecAssert2(key != NULL, -1);
+
+    return((xmlSecAtomicIntLoad(&(xmlSecKeyGetImpl(key)->refCount)) > 1) ? 1 : 0);
+}
+
+/**
+ * @brief Gets a key that can be modified (copy on write).
+ * @details Returns the @p key itself if it is not shared, otherwise creates a
+ * copy of the @p key and releases the caller's reference to the @p key.
+ * @param key the pointer to key created with #xmlSecKeyCreate function.
+ *
+ * @return the pointer to the not shared key or NULL if an error occurs (the
+ * reference to the @p key is not released in this case).
+ */
+xmlSecKeyPtr
+xmlSecKeyEnsureWritable(xmlSecKeyPtr key) {
+    xmlSecKeyPtr newKey;
+
+    xmlSecAssert2(key != NULL, NULL);
+
+    if(xmlSecKeyIsShared(key) == 0) {
+        return(key);
+    }
+
+    newKey = xmlSecKeyDuplicate(key);
+    if(newKey == NULL) {
+        xmlSecInternalError("xmlSecKeyDuplicate", NULL);
+        return(NULL);
+    }
+    xmlSecKeyDestroy(key);
+    return(newKey);
 }
 
 /**
  * @brief Copies key data from @p keySrc to @p keyDst.
+ * @details Copies key data from @p keySrc to @p keyDst. The @p keyDst must not
+ * be shared (see #xmlSecKeyIsShared).
  * @param keyDst the destination key.
  * @param keySrc the source key.
  *
@@ -584,6 +671,8 @@ xmlSecKeyCopy(xmlSecKeyPtr keyDst, xmlSecKeyPtr keySrc) {
 
 /**
  * @brief Swaps key data for @p key1 and @p key2
+ * @details Swaps key data for @p key1 and @p key2. The keys must not be shared
+ * (see #xmlSecKeyIsShared).
  * @param key1 the first key.
  * @param key2 the second key.
  *
@@ -690,6 +779,7 @@ xmlSecKeyGetName(xmlSecKeyPtr key) {
 /**
  * @brief Sets the key name.
  * @details Sets key name (see also #xmlSecKeyGetName function).
+ * The @p key must not be shared (see #xmlSecKeyIsShared).
  * @param key the pointer to key.
  * @param name the new key name.
  *
@@ -718,6 +808,7 @@ xmlSecKeySetName(xmlSecKeyPtr key, const xmlChar* name) {
 /**
  * @brief Sets the key name with a specific length.
  * @details Sets key name (see also #xmlSecKeyGetName function).
+ * The @p key must not be shared (see #xmlSecKeyIsShared).
  * @param key the pointer to key.
  * @param name the new key name.
  * @param nameSize the size of @p name.
@@ -764,6 +855,7 @@ xmlSecKeyGetValue(xmlSecKeyPtr key) {
 /**
  * @brief Sets the key value (crypto material).
  * @details Sets key value (see also #xmlSecKeyGetValue function).
+ * The @p key must not be shared (see #xmlSecKeyIsShared).
  * @param key the pointer to key.
  * @param value the new value.
  *
@@ -834,6 +926,7 @@ xmlSecKeyGetData(xmlSecKeyPtr key, xmlSecKeyDataId dataId) {
 /**
  * @brief Ensures key data of the requested klass exists.
  * @details If necessary, creates key data of @p dataId klass and adds to @p key.
+ * The @p key must not be shared (see #xmlSecKeyIsShared).
  * @param key the pointer to key.
  * @param dataId the requested data klass.
  *
@@ -875,7 +968,7 @@ xmlSecKeyEnsureData(xmlSecKeyPtr key, xmlSecKeyDataId dataId) {
 /**
  * @brief Adds key data to a key object (takes ownership).
  * @details Adds @p data to the @p key. The @p data object will be destroyed
- * by @p key.
+ * by @p key. The @p key must not be shared (see #xmlSecKeyIsShared).
  * @param key the pointer to key.
  * @param data the pointer to key data.
  *
@@ -1248,6 +1341,8 @@ xmlSecKeyReadMemory(xmlSecKeyDataId dataId, const xmlSecByte* data, xmlSecSize d
  */
 xmlSecKeyPtr
 xmlSecKeysMngrGetKey(xmlNodePtr keyInfoNode, xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    xmlSecKeyInfoFoundKey foundKey;
+    void* prevReserved1;
     xmlSecKeyPtr key;
     int ret;
 
@@ -1261,16 +1356,31 @@ xmlSecKeysMngrGetKey(xmlNodePtr keyInfoNode, xmlSecKeyInfoCtxPtr keyInfoCtx) {
     }
 
     if(keyInfoNode != NULL) {
+        /* the key found by <dsig:KeyName/> in the keys manager is returned as-is */
+        memset(&foundKey, 0, sizeof(foundKey));
+        foundKey.key = key;
+        prevReserved1 = keyInfoCtx->reserved1;
+        keyInfoCtx->reserved1 = &foundKey;
+
         ret = xmlSecKeyInfoNodeRead(keyInfoNode, key, keyInfoCtx);
+        keyInfoCtx->reserved1 = prevReserved1;
         if(ret < 0) {
             xmlSecInternalError2("xmlSecKeyInfoNodeRead",
                                  NULL,
                                  "node=%s",
                                  xmlSecErrorsSafeString(xmlSecNodeGetName(keyInfoNode)));
+            if(foundKey.foundKey != NULL) {
+                xmlSecKeyDestroy(foundKey.foundKey);
+            }
             xmlSecKeyDestroy(key);
             return(NULL);
         }
 
+        if(foundKey.foundKey != NULL) {
+            xmlSecKeyDestroy(key);
+            return(foundKey.foundKey);
+        }
+
         if((xmlSecKeyGetValue(key) != NULL) &&
            (xmlSecKeyMatch(key, NULL, &(keyInfoCtx->keyReq)) != 0)) {
             return(key);
@@ -24,6 +24,14 @@
 XMLSEC_EXPORT void          xmlSecKeyDataDebugDumpImpl(xmlSecKeyDataPtr data, FILE* output);
 XMLSEC_EXPORT void          xmlSecKeyDataDebugXmlDumpImpl(xmlSecKeyDataPtr data, FILE* output);
 
+/* The key found by the <dsig:KeyName/> reader in the keys manager is handed over
+ * to xmlSecKeysMngrGetKey() as-is instead of being copied into the empty key created
+ * there; xmlSecKeysMngrGetKey() passes this structure in keyInfoCtx->reserved1. */
+typedef struct _xmlSecKeyInfoFoundKey {
+    xmlSecKeyPtr                key;            /* the key passed to xmlSecKeyInfoNodeRead() */
+    xmlSecKeyPtr                foundKey;       /* the key found in the keys manager or NULL */
+} xmlSecKeyInfoFoundKey, *xmlSecKeyInfoFoundKeyPtr;
+
 /******************************************************************************
  *
  * xmlSecKeyDataBinary (for HMAC, AES, DES, ...)
@@ -18,6 +18,8 @@
 
 #include <libxml/tree.h>
 #include <libxml/parser.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/xmltree.h>
@@ -29,6 +31,7 @@
 #include <xmlsec/parser.h>
 #include <xmlsec/private.h>
 
+#include "atomic_helpers.h"
 #include "cast_helpers.h"
 
 /******************************************************************************
@@ -91,7 +94,10 @@ xmlSecKeysMngrDestroy(xmlSecKeysMngrPtr mngr) {
 /**
  * @brief Looks up a key in the keys manager keys store.
  * @details Lookups key in the keys manager keys store. The caller is responsible
- * for destroying the returned key using #xmlSecKeyDestroy method.
+ * for destroying the returned key using #xmlSecKeyDestroy method. The returned
+ * key might be shared with the store (see #XMLSEC_KEYSMNGR_FLAGS_SHARE_KEYS)
+ * and must not be modified in this case, use #xmlSecKeyEnsureWritable to get
+ * a key that can be modified.
  * @param mngr the pointer to keys manager.
  * @param name the desired key name.
  * @param keyInfoCtx the pointer to &lt;dsig:KeyInfo/&gt; node processing context.
@@ -295,7 +301,10 @@ xmlSecKeyStoreDestroy(xmlSecKeyStorePtr store) {
 /**
  * @brief Looks up a key in the store by name.
  * @details Lookups key in the store. The caller is responsible for destroying
- * the returned key using #xmlSecKeyDestroy method.
+ * the returned key using #xmlSecKeyDestroy method. The returned key might be
+ * shared with the store (see #XMLSEC_KEYSMNGR_FLAGS_SHARE_KEYS) and must not be
+ * modified in this case, use #xmlSecKeyEnsureWritable to get a key that can
+ * be modified.
  * @param store the pointer to keys store.
  * @param name the desired key name.
  * @param keyInfoCtx the pointer to &lt;dsig:KeyInfo/&gt; node processing context.
@@ -350,6 +359,17 @@ static void                     xmlSecSimpleKeysStoreFinalize   (xmlSecKeyStoreP
 static xmlSecKeyPtr             xmlSecSimpleKeysStoreFindKey    (xmlSecKeyStorePtr store,
                                                                  const xmlChar* name,
                                                                  xmlSecKeyInfoCtxPtr keyInfoCtx);
+static xmlSecKeyPtr             xmlSecSimpleKeysStoreFindKeyInList(xmlSecPtrListPtr list,
+                                                                 const xmlChar* name,
+                                                                 xmlSecKeyInfoCtxPtr keyInfoCtx);
+static xmlSecPtrListPtr         xmlSecSimpleKeysStoreGetList    (xmlSecKeyStorePtr store);
+static int                      xmlSecIndexedKeysStoreAddKey    (xmlSecKeyStorePtr store,
+                                                                 xmlSecKeyPtr key);
+
+/* the simple keys store functions work with the indexed keys store as well */
+#define xmlSecSimpleKeysStoreCheckAnyId(store) \
+    (xmlSecKeyStoreCheckId((store), xmlSecSimpleKeysStoreId) || \
+     xmlSecKeyStoreCheckId((store), xmlSecIndexedKeysStoreId))
 
 static xmlSecKeyStoreKlass xmlSecSimpleKeysStoreKlass = {
     sizeof(xmlSecKeyStoreKlass),
@@ -380,7 +400,10 @@ xmlSecSimpleKeysStoreGetKlass(void) {
 
 /**
  * @brief Adds @p key to the @p store.
- * @param store the pointer to simple keys store.
+ * @details Adds @p key to the @p store after all the keys in the @p store,
+ * including the keys not read yet from the snapshot loaded with
+ * #xmlSecSimpleKeysStoreLoadSnapshot (these are read first).
+ * @param store the pointer to simple or indexed keys store.
  * @param key the pointer to key.
  *
  * @return 0 on success or a negative value if an error occurs.
@@ -390,9 +413,25 @@ xmlSecSimpleKeysStoreAdoptKey(xmlSecKeyStorePtr store, xmlSecKeyPtr key) {
     xmlSecPtrListPtr list;
     int ret;
 
-    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
+    xmlSecAssert2(xmlSecSimpleKeysStoreCheckAnyId(store), -1);
     xmlSecAssert2(key != NULL, -1);
 
+    if(xmlSecKeyStoreCheckId(store, xmlSecIndexedKeysStoreId)) {
+        /* the keys from the snapshot go before the new key */
+        if(xmlSecSimpleKeysStoreGetList(store) == NULL) {
+            xmlSecInternalError("xmlSecSimpleKeysStoreGetList",
+                                xmlSecKeyStoreGetName(store));
+            return(-1);
+        }
+        ret = xmlSecIndexedKeysStoreAddKey(store, key);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecIndexedKeysStoreAddKey",
+                                xmlSecKeyStoreGetName(store));
+            return(-1);
+        }
+        return(0);
+    }
+
     list = xmlSecSimpleKeysStoreGetCtx(store);
     xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), -1);
 
@@ -408,7 +447,7 @@ xmlSecSimpleKeysStoreAdoptKey(xmlSecKeyStorePtr store, xmlSecKeyPtr key) {
 
 /**
  * @brief Reads keys from an XML file.
- * @param store the pointer to simple keys store.
+ * @param store the pointer to simple or indexed keys store.
  * @param uri the filename.
  * @param keysMngr the pointer to associated keys manager.
  *
@@ -417,7 +456,7 @@ xmlSecSimpleKeysStoreAdoptKey(xmlSecKeyStorePtr store, xmlSecKeyPtr key) {
 int
 xmlSecSimpleKeysStoreLoad(xmlSecKeyStorePtr store, const char *uri,
                             xmlSecKeysMngrPtr keysMngr) {
-    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
+    xmlSecAssert2(xmlSecSimpleKeysStoreCheckAnyId(store), -1);
 
     return(xmlSecSimpleKeysStoreLoad_ex(store, uri, keysMngr,
         xmlSecSimpleKeysStoreAdoptKey));
@@ -451,6 +490,146 @@ xmlSecSimpleKeysStoreEnableAllKeyData(xmlSecKeyInfoCtxPtr keyInfoCtx) {
     return(0);
 }
 
+/* reads the key from the <dsig:KeyInfo/> node, returns 0 and NULL key if the key is unknown */
+static int
+xmlSecSimpleKeysStoreReadKey(xmlSecKeyStorePtr store, xmlNodePtr node, xmlSecKeyPtr* key) {
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlSecKeyPtr res;
+    int ret;
+
+    xmlSecAssert2(store != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    (*key) = NULL;
+    res = xmlSecKeyCreate();
+    if(res == NULL) {
+        xmlSecInternalError("xmlSecKeyCreate", xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+
+    ret = xmlSecKeyInfoCtxInitialize(&keyInfoCtx, NULL);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyInfoCtxInitialize", xmlSecKeyStoreGetName(store));
+        xmlSecKeyDestroy(res);
+        return(-1);
+    }
+
+    keyInfoCtx.mode           = xmlSecKeyInfoModeRead;
+    keyInfoCtx.keysMngr       = NULL;
+    keyInfoCtx.flags          = XMLSEC_KEYINFO_FLAGS_DONT_STOP_ON_KEY_FOUND |
+                                XMLSEC_KEYINFO_FLAGS_X509DATA_DONT_VERIFY_CERTS;
+    keyInfoCtx.keyReq.keyId   = xmlSecKeyDataIdUnknown;
+    keyInfoCtx.keyReq.keyType = xmlSecKeyDataTypeAny;
+    keyInfoCtx.keyReq.keyUsage= xmlSecKeyDataUsageAny;
+
+    /* enable all keydata for store */
+    ret = xmlSecSimpleKeysStoreEnableAllKeyData(&keyInfoCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecSimpleKeysStoreEnableAllKeyData", xmlSecKeyStoreGetName(store));
+        xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+        xmlSecKeyDestroy(res);
+        return(-1);
+    }
+
+    ret = xmlSecKeyInfoNodeRead(node, res, &keyInfoCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyInfoNodeRead", xmlSecKeyStoreGetName(store));
+        xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+        xmlSecKeyDestroy(res);
+        return(-1);
+    }
+    xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+
+    if(!xmlSecKeyIsValid(res)) {
+        /* we have an unknown key in our file, just ignore it */
+        xmlSecKeyDestroy(res);
+        return(0);
+    }
+
+    (*key) = res;
+    return(0);
+}
+
+/* writes the key into the <dsig:KeyInfo/> node */
+static int
+xmlSecSimpleKeysStoreWriteKey(xmlSecKeyStorePtr store, xmlNodePtr node, xmlSecKeyPtr key, xmlSecKeyDataType type) {
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlSecPtrListPtr idsList;
+    xmlSecKeyDataId dataId;
+    xmlSecKeyDataPtr data;
+    xmlSecSize idsSize, ii;
+    int ret;
+
+    xmlSecAssert2(store != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    /* special data key name */
+    if(xmlSecKeyGetName(key) != NULL) {
+        if(xmlSecAddChild(node, xmlSecNodeKeyName, xmlSecDSigNs) == NULL) {
+            xmlSecInternalError2("xmlSecAddChild", xmlSecKeyStoreGetName(store),
+                "node=%s", xmlSecErrorsSafeString(xmlSecNodeKeyName));
+            return(-1);
+        }
+    }
+
+    /* create nodes for other keys data */
+    idsList = xmlSecKeyDataIdsGet();
+    xmlSecAssert2(idsList != NULL, -1);
+
+    idsSize = xmlSecPtrListGetSize(idsList);
+    for(ii = 0; ii < idsSize; ++ii) {
+        dataId = (xmlSecKeyDataId)xmlSecPtrListGetItem(idsList, ii);
+        xmlSecAssert2(dataId != xmlSecKeyDataIdUnknown, -1);
+
+        if(dataId->dataNodeName == NULL) {
+            continue;
+        }
+
+        data = xmlSecKeyGetData(key, dataId);
+        if(data == NULL) {
+            continue;
+        }
+
+        if(xmlSecAddChild(node, dataId->dataNodeName, dataId->dataNodeNs) == NULL) {
+            xmlSecInternalError2("xmlSecAddChild", xmlSecKeyStoreGetName(store),
+                "node=%s", xmlSecErrorsSafeString(dataId->dataNodeName));
+            return(-1);
+        }
+    }
+
+    ret = xmlSecKeyInfoCtxInitialize(&keyInfoCtx, NULL);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyInfoCtxInitialize", xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+
+    keyInfoCtx.mode                 = xmlSecKeyInfoModeWrite;
+    keyInfoCtx.keyReq.keyId         = xmlSecKeyDataIdUnknown;
+    keyInfoCtx.keyReq.keyType       = type;
+    keyInfoCtx.keyReq.keyUsage      = xmlSecKeyDataUsageAny;
+
+    /* enable all keydata for store */
+    ret = xmlSecSimpleKeysStoreEnableAllKeyData(&keyInfoCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecSimpleKeysStoreEnableAllKeyData", xmlSecKeyStoreGetName(store));
+        xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+        return(-1);
+    }
+
+    /* finally write key in the node */
+    ret = xmlSecKeyInfoNodeWrite(node, key, &keyInfoCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyInfoNodeWrite", xmlSecKeyStoreGetName(store));
+        xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+        return(-1);
+    }
+    xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+
+    return(0);
+}
+
 /**
  * @brief Reads keys from an XML file using a custom adopt callback.
  * @details Reads keys from an XML file.
@@ -468,8 +647,7 @@ xmlSecSimpleKeysStoreLoad_ex(xmlSecKeyStorePtr store, const char *uri,
     xmlDocPtr doc;
     xmlNodePtr root;
     xmlNodePtr cur;
-    xmlSecKeyPtr key;
-    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlSecKeyPtr key = NULL;
     int ret;
 
     /* don't check store ID here because it might not be simple store ID;
@@ -495,50 +673,14 @@ xmlSecSimpleKeysStoreLoad_ex(xmlSecKeyStorePtr store, const char *uri,
 
     cur = xmlSecGetNextElementNode(root->children);
     while((cur != NULL) && xmlSecCheckNodeName(cur, xmlSecNodeKeyInfo, xmlSecDSigNs)) {
-        key = xmlSecKeyCreate();
-        if(key == NULL) {
-            xmlSecInternalError("xmlSecKeyCreate", xmlSecKeyStoreGetName(store));
-            xmlFreeDoc(doc);
-            return(-1);
-        }
-
-        ret = xmlSecKeyInfoCtxInitialize(&keyInfoCtx, NULL);
-        if(ret < 0) {
-            xmlSecInternalError("xmlSecKeyInfoCtxInitialize", xmlSecKeyStoreGetName(store));
-            xmlSecKeyDestroy(key);
-            xmlFreeDoc(doc);
-            return(-1);
-        }
-
-        keyInfoCtx.mode           = xmlSecKeyInfoModeRead;
-        keyInfoCtx.keysMngr       = NULL;
-        keyInfoCtx.flags          = XMLSEC_KEYINFO_FLAGS_DONT_STOP_ON_KEY_FOUND |
-                                    XMLSEC_KEYINFO_FLAGS_X509DATA_DONT_VERIFY_CERTS;
-        keyInfoCtx.keyReq.keyId   = xmlSecKeyDataIdUnknown;
-        keyInfoCtx.keyReq.keyType = xmlSecKeyDataTypeAny;
-        keyInfoCtx.keyReq.keyUsage= xmlSecKeyDataUsageAny;
-
-        /* enable all keydata for store */
-        ret = xmlSecSimpleKeysStoreEnableAllKeyData(&keyInfoCtx);
-        if(ret < 0) {
-            xmlSecInternalError("xmlSecSimpleKeysStoreEnableAllKeyData", xmlSecKeyStoreGetName(store));
-            xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
-            xmlSecKeyDestroy(key);
-            xmlFreeDoc(doc);
-            return(-1);
-        }
-
-        ret = xmlSecKeyInfoNodeRead(cur, key, &keyInfoCtx);
+        ret = xmlSecSimpleKeysStoreReadKey(store, cur, &key);
         if(ret < 0) {
-            xmlSecInternalError("xmlSecKeyInfoNodeRead", xmlSecKeyStoreGetName(store));
-            xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
-            xmlSecKeyDestroy(key);
+            xmlSecInternalError("xmlSecSimpleKeysStoreReadKey", xmlSecKeyStoreGetName(store));
             xmlFreeDoc(doc);
             return(-1);
         }
-        xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
 
-        if(xmlSecKeyIsValid(key)) {
+        if(key != NULL) {
             ret = adoptKeyFunc(store, key);
             if(ret < 0) {
                 xmlSecInternalError("adoptKeyFunc", xmlSecKeyStoreGetName(store));
@@ -546,9 +688,6 @@ xmlSecSimpleKeysStoreLoad_ex(xmlSecKeyStorePtr store, const char *uri,
                 xmlFreeDoc(doc);
                 return(-1);
             }
-        } else {
-            /* we have an unknown key in our file, just ignore it */
-            xmlSecKeyDestroy(key);
         }
         cur = xmlSecGetNextElementNode(cur->next);
     }
@@ -566,7 +705,7 @@ xmlSecSimpleKeysStoreLoad_ex(xmlSecKeyStorePtr store, const char *uri,
 
 /**
  * @brief Writes keys from @p store to an XML file.
- * @param store the pointer to simple keys store.
+ * @param store the pointer to simple or indexed keys store.
  * @param filename the filename.
  * @param type the saved keys type (public, private, ...).
  *
@@ -574,22 +713,21 @@ xmlSecSimpleKeysStoreLoad_ex(xmlSecKeyStorePtr store, const char *uri,
  */
 int
 xmlSecSimpleKeysStoreSave(xmlSecKeyStorePtr store, const char *filename, xmlSecKeyDataType type) {
-    xmlSecKeyInfoCtx keyInfoCtx;
     xmlSecPtrListPtr list;
     xmlSecKeyPtr key;
     xmlSecSize i, keysSize;
     xmlDocPtr doc;
     xmlNodePtr cur;
-    xmlSecKeyDataPtr data;
-    xmlSecPtrListPtr idsList;
-    xmlSecKeyDataId dataId;
-    xmlSecSize idsSize, j;
     int ret;
 
-    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
+    xmlSecAssert2(xmlSecSimpleKeysStoreCheckAnyId(store), -1);
     xmlSecAssert2(filename != NULL, -1);
 
-    list = xmlSecSimpleKeysStoreGetCtx(store);
+    list = xmlSecSimpleKeysStoreGetList(store);
+    if(list == NULL) {
+        xmlSecInternalError("xmlSecSimpleKeysStoreGetList", xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
     xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), -1);
 
     /* create doc */
@@ -599,11 +737,7 @@ xmlSecSimpleKeysStoreSave(xmlSecKeyStorePtr store, const char *filename, xmlSecK
         return(-1);
     }
 
-    idsList = xmlSecKeyDataIdsGet();
-    xmlSecAssert2(idsList != NULL, -1);
-
     keysSize = xmlSecPtrListGetSize(list);
-    idsSize = xmlSecPtrListGetSize(idsList);
     for(i = 0; i < keysSize; ++i) {
         key = (xmlSecKeyPtr)xmlSecPtrListGetItem(list, i);
         xmlSecAssert2(key != NULL, -1);
@@ -616,68 +750,12 @@ xmlSecSimpleKeysStoreSave(xmlSecKeyStorePtr store, const char *filename, xmlSecK
             return(-1);
         }
 
-        /* special data key name */
-        if(xmlSecKeyGetName(key) != NULL) {
-            if(xmlSecAddChild(cur, xmlSecNodeKeyName, xmlSecDSigNs) == NULL) {
-                xmlSecInternalError2("xmlSecAddChild", xmlSecKeyStoreGetName(store),
-                    "node=%s", xmlSecErrorsSafeString(xmlSecNodeKeyName));
-                xmlFreeDoc(doc);
-                return(-1);
-            }
-        }
-
-        /* create nodes for other keys data */
-        for(j = 0; j < idsSize; ++j) {
-            dataId = (xmlSecKeyDataId)xmlSecPtrListGetItem(idsList, j);
-            xmlSecAssert2(dataId != xmlSecKeyDataIdUnknown, -1);
-
-            if(dataId->dataNodeName == NULL) {
-                continue;
-            }
-
-            data = xmlSecKeyGetData(key, dataId);
-            if(data == NULL) {
-                continue;
-            }
-
-            if(xmlSecAddChild(cur, dataId->dataNodeName, dataId->dataNodeNs) == NULL) {
-                xmlSecInternalError2("xmlSecAddChild", xmlSecKeyStoreGetName(store),
-                    "node=%s", xmlSecErrorsSafeString(dataId->dataNodeName));
-                xmlFreeDoc(doc);
-                return(-1);
-            }
-        }
-
-        ret = xmlSecKeyInfoCtxInitialize(&keyInfoCtx, NULL);
-        if(ret < 0) {
-            xmlSecInternalError("xmlSecKeyInfoCtxInitialize", xmlSecKeyStoreGetName(store));
-            xmlFreeDoc(doc);
-            return(-1);
-        }
-
-        keyInfoCtx.mode                 = xmlSecKeyInfoModeWrite;
-        keyInfoCtx.keyReq.keyId         = xmlSecKeyDataIdUnknown;
-        keyInfoCtx.keyReq.keyType       = type;
-        keyInfoCtx.keyReq.keyUsage      = xmlSecKeyDataUsageAny;
-
-        /* enable all keydata for store */
-        ret = xmlSecSimpleKeysStoreEnableAllKeyData(&keyInfoCtx);
-        if(ret < 0) {
-            xmlSecInternalError("xmlSecSimpleKeysStoreEnableAllKeyData", xmlSecKeyStoreGetName(store));
-            xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
-            xmlFreeDoc(doc);
-            return(-1);
-        }
-
-        /* finally write key in the node */
-        ret = xmlSecKeyInfoNodeWrite(cur, key, &keyInfoCtx);
+        ret = xmlSecSimpleKeysStoreWriteKey(store, cur, key, type);
         if(ret < 0) {
-            xmlSecInternalError("xmlSecKeyInfoNodeWrite", xmlSecKeyStoreGetName(store));
-            xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+            xmlSecInternalError("xmlSecSimpleKeysStoreWriteKey", xmlSecKeyStoreGetName(store));
             xmlFreeDoc(doc);
             return(-1);
         }
-        xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
     }
 
     /* now write result */
@@ -695,7 +773,12 @@ xmlSecSimpleKeysStoreSave(xmlSecKeyStorePtr store, const char *filename, xmlSecK
 
 /**
  * @brief Gets list of keys from simple keys store.
- * @param store the pointer to simple keys store.
+ * @details Gets list of keys from simple or indexed keys store. The keys
+ * should be added to the indexed keys store with #xmlSecSimpleKeysStoreAdoptKey,
+ * the keys lookups fall back to the full list scan if the list is changed directly.
+ * All the remaining keys are read from the keys snapshot (see
+ * #xmlSecSimpleKeysStoreLoadSnapshot) first.
+ * @param store the pointer to simple or indexed keys store.
  *
  * @return pointer to the list of keys stored in the keys store or NULL
  * if an error occurs.
@@ -704,9 +787,13 @@ xmlSecPtrListPtr
 xmlSecSimpleKeysStoreGetKeys(xmlSecKeyStorePtr store) {
     xmlSecPtrListPtr list;
 
-    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), NULL);
+    xmlSecAssert2(xmlSecSimpleKeysStoreCheckAnyId(store), NULL);
 
-    list = xmlSecSimpleKeysStoreGetCtx(store);
+    list = xmlSecSimpleKeysStoreGetList(store);
+    if(list == NULL) {
+        xmlSecInternalError("xmlSecSimpleKeysStoreGetList", xmlSecKeyStoreGetName(store));
+        return(NULL);
+    }
     xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), NULL);
 
     return list;
@@ -747,8 +834,6 @@ xmlSecSimpleKeysStoreFinalize(xmlSecKeyStorePtr store) {
 static xmlSecKeyPtr
 xmlSecSimpleKeysStoreFindKey(xmlSecKeyStorePtr store, const xmlChar* name, xmlSecKeyInfoCtxPtr keyInfoCtx) {
     xmlSecPtrListPtr list;
-    xmlSecKeyPtr key;
-    xmlSecSize pos, size;
 
     xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), NULL);
     xmlSecAssert2(keyInfoCtx != NULL, NULL);
@@ -756,12 +841,1258 @@ xmlSecSimpleKeysStoreFindKey(xmlSecKeyStorePtr store, const xmlChar* name, xmlSe
     list = xmlSecSimpleKeysStoreGetCtx(store);
     xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), NULL);
 
+    return(xmlSecSimpleKeysStoreFindKeyInList(list, name, keyInfoCtx));
+}
+
+/* returns a copy of (or a reference to, see XMLSEC_KEYSMNGR_FLAGS_SHARE_KEYS) the first
+ * key in the list that matches the name and the requirements */
+static xmlSecKeyPtr
+xmlSecSimpleKeysStoreFindKeyInList(xmlSecPtrListPtr list, const xmlChar* name, xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    xmlSecKeyPtr key;
+    xmlSecSize pos, size;
+
+    xmlSecAssert2(list != NULL, NULL);
+    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+
     size = xmlSecPtrListGetSize(list);
     for(pos = 0; pos < size; ++pos) {
         key = (xmlSecKeyPtr)xmlSecPtrListGetItem(list, pos);
-        if((key != NULL) && (xmlSecKeyMatch(key, name, &(keyInfoCtx->keyReq)) == 1)) {
-            return(xmlSecKeyDuplicate(key));
+        if((key == NULL) || (xmlSecKeyMatch(key, name, &(keyInfoCtx->keyReq)) != 1)) {
+            continue;
         }
+        if((keyInfoCtx->keysMngr != NULL) && ((keyInfoCtx->keysMngr->flags & XMLSEC_KEYSMNGR_FLAGS_SHARE_KEYS) != 0)) {
+            return(xmlSecKeyRef(key));
+        }
+        return(xmlSecKeyDuplicate(key));
     }
     return(NULL);
 }
+
+/******************************************************************************
+ *
+ * Keys Snapshot
+ *
+ * The binary alternative to the keys XML file for the fast start: the keys
+ * index (the key names) is read upfront and the keys are read from the
+ * snapshot only when they are looked up by name for the first time (the
+ * indexed keys store) or right away (the simple keys store). The lookups
+ * without a name read all the remaining keys to preserve the keys order.
+ *
+ * All the numbers are 32 bit unsigned big-endian integers, the offsets are
+ * from the beginning of the file thus the file can be used as-is in memory:
+ *
+ *   header (32 bytes):
+ *     magic "XMLSECKS" (8 bytes), version, records number, index size,
+ *     keys data size, index CRC-32, header CRC-32 (of the previous 28 bytes)
+ *   index (one entry per key):
+ *     key data offset, key data size, key data CRC-32, name size, name
+ *     (the name size is 0xFFFFFFFF if the key has no name)
+ *   keys data:
+ *     the serialized &lt;dsig:KeyInfo/&gt; XML documents, one per key
+ *
+  *****************************************************************************/
+#define XMLSEC_KEYS_SNAPSHOT_MAGIC              "XMLSECKS"
+#define XMLSEC_KEYS_SNAPSHOT_MAGIC_SIZE         8
+#define XMLSEC_KEYS_SNAPSHOT_VERSION            1
+#define XMLSEC_KEYS_SNAPSHOT_HEADER_SIZE        32
+#define XMLSEC_KEYS_SNAPSHOT_INDEX_ENTRY_SIZE   16
+#define XMLSEC_KEYS_SNAPSHOT_NO_STRING          0xFFFFFFFFU
+
+typedef struct _xmlSecKeysSnapshotRecord        xmlSecKeysSnapshotRecord,
+                                                *xmlSecKeysSnapshotRecordPtr;
+struct _xmlSecKeysSnapshotRecord {
+    xmlChar*                    name;           /* the key name or NULL */
+    xmlSecSize                  offset;
+    xmlSecSize                  size;
+    uint32_t                    checksum;
+    int                         pending;        /* 1 if the key was not read yet */
+    xmlSecKeysSnapshotRecordPtr nextSameName;
+    xmlSecKeyPtr                key;            /* the key read from the snapshot (not owned) or NULL */
+};
+
+typedef struct _xmlSecKeysSnapshot {
+    xmlSecBuffer                data;           /* the snapshot file */
+    xmlSecKeysSnapshotRecordPtr records;
+    xmlSecSize                  recordsSize;
+    xmlSecSize                  pendingSize;    /* the number of the keys not read yet */
+    xmlHashTablePtr             byName;         /* name -> first record */
+} xmlSecKeysSnapshot, *xmlSecKeysSnapshotPtr;
+
+static int                      xmlSecIndexedKeysStoreAdoptSnapshot(xmlSecKeyStorePtr store,
+                                                                 xmlSecKeysSnapshotPtr snapshot);
+
+static uint32_t
+xmlSecKeysSnapshotCrc32(const xmlSecByte* data, xmlSecSize size) {
+    uint32_t crc = 0xFFFFFFFFU;
+    xmlSecSize ii;
+    int jj;
+
+    xmlSecAssert2((data != NULL) || (size == 0), 0);
+
+    for(ii = 0; ii < size; ++ii) {
+        crc ^= data[ii];
+        for(jj = 0; jj < 8; ++jj) {
+            crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+        }
+    }
+    return(~crc);
+}
+
+static uint32_t
+xmlSecKeysSnapshotGetUInt32(const xmlSecByte* data) {
+    xmlSecAssert2(data != NULL, 0);
+
+    return(((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+           ((uint32_t)data[2] << 8)  | ((uint32_t)data[3]));
+}
+
+static void
+xmlSecKeysSnapshotSetUInt32(xmlSecByte* data, uint32_t val) {
+    xmlSecAssert(data != NULL);
+
+    data[0] = (xmlSecByte)((val >> 24) & 0xFF);
+    data[1] = (xmlSecByte)((val >> 16) & 0xFF);
+    data[2] = (xmlSecByte)((val >> 8) & 0xFF);
+    data[3] = (xmlSecByte)(val & 0xFF);
+}
+
+static int
+xmlSecKeysSnapshotAppendUInt32(xmlSecBufferPtr buf, xmlSecSize val) {
+    xmlSecByte data[4];
+    int ret;
+
+    xmlSecAssert2(buf != NULL, -1);
+
+#if (XMLSEC_SIZE_MAX > 0xFFFFFFFFU)
+    if(val > 0xFFFFFFFFU) {
+        xmlSecInvalidSizeMoreThanError("Keys snapshot value", val, (xmlSecSize)0xFFFFFFFFU, NULL);
+        return(-1);
+    }
+#endif /* (XMLSEC_SIZE_MAX > 0xFFFFFFFFU) */
+    xmlSecKeysSnapshotSetUInt32(data, (uint32_t)val);
+    ret = xmlSecBufferAppend(buf, data, sizeof(data));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferAppend", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+static int
+xmlSecKeysSnapshotAppendString(xmlSecBufferPtr buf, const xmlChar* str) {
+    int ret;
+
+    xmlSecAssert2(buf != NULL, -1);
+
+    if(str == NULL) {
+        return(0);
+    }
+    ret = xmlSecBufferAppend(buf, str, (xmlSecSize)xmlStrlen(str));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferAppend", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+static xmlSecSize
+xmlSecKeysSnapshotStringSize(const xmlChar* str) {
+    return((str != NULL) ? (xmlSecSize)xmlStrlen(str) : (xmlSecSize)XMLSEC_KEYS_SNAPSHOT_NO_STRING);
+}
+
+/* writes the key as <dsig:KeyInfo/> document and adds the index entry */
+static int
+xmlSecKeysSnapshotWriteKey(xmlSecKeyStorePtr store, xmlSecKeyPtr key, xmlSecKeyDataType type,
+    xmlSecBufferPtr index, xmlSecBufferPtr keys
+) {
+    xmlDocPtr doc;
+    xmlChar* xml = NULL;
+    int xmlLen = 0;
+    xmlSecSize offset, size;
+    int ret;
+    int res = -1;
+
+    xmlSecAssert2(store != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(index != NULL, -1);
+    xmlSecAssert2(keys != NULL, -1);
+
+    doc = xmlSecCreateTree(xmlSecNodeKeyInfo, xmlSecDSigNs);
+    if(doc == NULL) {
+        xmlSecInternalError("xmlSecCreateTree", xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+    ret = xmlSecSimpleKeysStoreWriteKey(store, xmlDocGetRootElement(doc), key, type);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecSimpleKeysStoreWriteKey", xmlSecKeyStoreGetName(store));
+        goto done;
+    }
+    xmlDocDumpMemory(doc, &xml, &xmlLen);
+    if((xml == NULL) || (xmlLen <= 0)) {
+        xmlSecXmlError("xmlDocDumpMemory", xmlSecKeyStoreGetName(store));
+        goto done;
+    }
+    XMLSEC_SAFE_CAST_INT_TO_SIZE(xmlLen, size, goto done, xmlSecKeyStoreGetName(store));
+
+    offset = XMLSEC_KEYS_SNAPSHOT_HEADER_SIZE + xmlSecBufferGetSize(keys);
+    if((xmlSecKeysSnapshotAppendUInt32(index, offset) < 0) ||
+       (xmlSecKeysSnapshotAppendUInt32(index, size) < 0) ||
+       (xmlSecKeysSnapshotAppendUInt32(index, xmlSecKeysSnapshotCrc32(xml, size)) < 0) ||
+       (xmlSecKeysSnapshotAppendUInt32(index, xmlSecKeysSnapshotStringSize(xmlSecKeyGetName(key))) < 0) ||
+       (xmlSecKeysSnapshotAppendString(index, xmlSecKeyGetName(key)) < 0)
+    ) {
+        xmlSecInternalError("xmlSecKeysSnapshotAppendUInt32", xmlSecKeyStoreGetName(store));
+        goto done;
+    }
+    ret = xmlSecBufferAppend(keys, xml, size);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferAppend", xmlSecKeyStoreGetName(store));
+        goto done;
+    }
+
+    /* success */
+    res = 0;
+
+done:
+    if(xml != NULL) {
+        xmlFree(xml);
+    }
+    xmlFreeDoc(doc);
+    return(res);
+}
+
+static void
+xmlSecKeysSnapshotDestroy(xmlSecKeysSnapshotPtr snapshot) {
+    xmlSecSize ii;
+
+    xmlSecAssert(snapshot != NULL);
+
+    if(snapshot->byName != NULL) {
+        xmlHashFree(snapshot->byName, NULL);
+    }
+    if(snapshot->records != NULL) {
+        for(ii = 0; ii < snapshot->recordsSize; ++ii) {
+            if(snapshot->records[ii].name != NULL) {
+                xmlFree(snapshot->records[ii].name);
+            }
+        }
+        xmlFree(snapshot->records);
+    }
+    xmlSecBufferFinalize(&(snapshot->data));
+    memset(snapshot, 0, sizeof(xmlSecKeysSnapshot));
+    xmlFree(snapshot);
+}
+
+/* reads the string from the index entry, the string is NULL if the size is XMLSEC_KEYS_SNAPSHOT_NO_STRING */
+static int
+xmlSecKeysSnapshotReadString(const xmlSecByte* data, xmlSecSize dataSize, xmlSecSize* pos,
+    uint32_t strSize, xmlChar** str
+) {
+    int len;
+
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(pos != NULL, -1);
+    xmlSecAssert2(str != NULL, -1);
+
+    (*str) = NULL;
+    if(strSize == XMLSEC_KEYS_SNAPSHOT_NO_STRING) {
+        return(0);
+    }
+    if(((*pos) > dataSize) || (strSize > dataSize - (*pos))) {
+        xmlSecInvalidSizeOtherError("Keys snapshot index entry is truncated", NULL);
+        return(-1);
+    }
+    XMLSEC_SAFE_CAST_SIZE_TO_INT((xmlSecSize)strSize, len, return(-1), NULL);
+    (*str) = xmlStrndup(data + (*pos), len);
+    if((*str) == NULL) {
+        xmlSecStrdupError(data + (*pos), NULL);
+        return(-1);
+    }
+    (*pos) += strSize;
+    return(0);
+}
+
+/* adds the record in front of the chain (the records are added in the reverse order) */
+static int
+xmlSecKeysSnapshotIndexAdd(xmlSecKeysSnapshotPtr snapshot, xmlSecKeysSnapshotRecordPtr record) {
+    int ret;
+
+    xmlSecAssert2(snapshot != NULL, -1);
+    xmlSecAssert2(snapshot->byName != NULL, -1);
+    xmlSecAssert2(record != NULL, -1);
+
+    if(record->name == NULL) {
+        return(0);
+    }
+    record->nextSameName = (xmlSecKeysSnapshotRecordPtr)xmlHashLookup(snapshot->byName, record->name);
+    ret = xmlHashUpdateEntry(snapshot->byName, record->name, record, NULL);
+    if(ret < 0) {
+        xmlSecXmlError2("xmlHashUpdateEntry", NULL,
+            "name=%s", xmlSecErrorsSafeString(record->name));
+        return(-1);
+    }
+    return(0);
+}
+
+static xmlSecKeysSnapshotPtr
+xmlSecKeysSnapshotCreate(const char* filename) {
+    xmlSecKeysSnapshotPtr snapshot;
+    xmlSecKeysSnapshotRecordPtr record;
+    const xmlSecByte* data;
+    xmlSecSize dataSize, pos, ii;
+    uint32_t recordsNum, indexSize, keysSize;
+    uint32_t nameSize;
+    int ret;
+
+    xmlSecAssert2(filename != NULL, NULL);
+
+    snapshot = (xmlSecKeysSnapshotPtr)xmlMalloc(sizeof(xmlSecKeysSnapshot));
+    if(snapshot == NULL) {
+        xmlSecMallocError(sizeof(xmlSecKeysSnapshot), NULL);
+        return(NULL);
+    }
+    memset(snapshot, 0, sizeof(xmlSecKeysSnapshot));
+
+    ret = xmlSecBufferInitialize(&(snapshot->data), 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        xmlFree(snapshot);
+        return(NULL);
+    }
+    ret = xmlSecBufferReadFile(&(snapshot->data), filename);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecBufferReadFile", NULL,
+            "filename=%s", xmlSecErrorsSafeString(filename));
+        goto error;
+    }
+    data = xmlSecBufferGetData(&(snapshot->data));
+    dataSize = xmlSecBufferGetSize(&(snapshot->data));
+
+    /* header */
+    if(dataSize < XMLSEC_KEYS_SNAPSHOT_HEADER_SIZE) {
+        xmlSecInvalidSizeLessThanError("Keys snapshot", dataSize, (xmlSecSize)XMLSEC_KEYS_SNAPSHOT_HEADER_SIZE, NULL);
+        goto error;
+    }
+    if(memcmp(data, XMLSEC_KEYS_SNAPSHOT_MAGIC, XMLSEC_KEYS_SNAPSHOT_MAGIC_SIZE) != 0) {
+        xmlSecInvalidDataError("Keys snapshot magic doesn't match", NULL);
+        goto error;
+    }
+    if(xmlSecKeysSnapshotCrc32(data, XMLSEC_KEYS_SNAPSHOT_HEADER_SIZE - 4) != xmlSecKeysSnapshotGetUInt32(data + 28)) {
+        xmlSecInvalidDataError("Keys snapshot header checksum doesn't match", NULL);
+        goto error;
+    }
+    if(xmlSecKeysSnapshotGetUInt32(data + 8) != XMLSEC_KEYS_SNAPSHOT_VERSION) {
+        xmlSecInvalidIntegerDataError("version", (int)xmlSecKeysSnapshotGetUInt32(data + 8),
+            "XMLSEC_KEYS_SNAPSHOT_VERSION", NULL);
+        goto error;
+    }
+    recordsNum = xmlSecKeysSnapshotGetUInt32(data + 12);
+    indexSize  = xmlSecKeysSnapshotGetUInt32(data + 16);
+    keysSize   = xmlSecKeysSnapshotGetUInt32(data + 20);
+    if((indexSize > dataSize - XMLSEC_KEYS_SNAPSHOT_HEADER_SIZE) ||
+       (keysSize != dataSize - XMLSEC_KEYS_SNAPSHOT_HEADER_SIZE - indexSize) ||
+       (recordsNum > indexSize / XMLSEC_KEYS_SNAPSHOT_INDEX_ENTRY_SIZE)
+    ) {
+        xmlSecInvalidSizeOtherError("Keys snapshot index or keys data size doesn't match the file size", NULL);
+        goto error;
+    }
+    if(xmlSecKeysSnapshotCrc32(data + XMLSEC_KEYS_SNAPSHOT_HEADER_SIZE, indexSize) != xmlSecKeysSnapshotGetUInt32(data + 24)) {
+        xmlSecInvalidDataError("Keys snapshot index checksum doesn't match", NULL);
+        goto error;
+    }
+
+    /* index */
+    snapshot->byName = xmlHashCreate(0);
+    if(snapshot->byName == NULL) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        goto error;
+    }
+    if(recordsNum > 0) {
+        snapshot->records = (xmlSecKeysSnapshotRecordPtr)xmlMalloc(sizeof(xmlSecKeysSnapshotRecord) * recordsNum);
+        if(snapshot->records == NULL) {
+            xmlSecMallocError(sizeof(xmlSecKeysSnapshotRecord) * recordsNum, NULL);
+            goto error;
+        }
+        memset(snapshot->records, 0, sizeof(xmlSecKeysSnapshotRecord) * recordsNum);
+    }
+
+    pos = XMLSEC_KEYS_SNAPSHOT_HEADER_SIZE;
+    for(ii = 0; ii < recordsNum; ++ii) {
+        record = &(snapshot->records[ii]);
+        ++snapshot->recordsSize;
+
+        if(XMLSEC_KEYS_SNAPSHOT_INDEX_ENTRY_SIZE > XMLSEC_KEYS_SNAPSHOT_HEADER_SIZE + indexSize - pos) {
+            xmlSecInvalidSizeOtherError("Keys snapshot index is truncated", NULL);
+            goto error;
+        }
+        record->offset   = xmlSecKeysSnapshotGetUInt32(data + pos);
+        record->size     = xmlSecKeysSnapshotGetUInt32(data + pos + 4);
+        record->checksum = xmlSecKeysSnapshotGetUInt32(data + pos + 8);
+        nameSize         = xmlSecKeysSnapshotGetUInt32(data + pos + 12);
+        pos += XMLSEC_KEYS_SNAPSHOT_INDEX_ENTRY_SIZE;
+
+        if((record->offset < XMLSEC_KEYS_SNAPSHOT_HEADER_SIZE + indexSize) ||
+           (record->offset > dataSize) || (record->size > dataSize - record->offset)
+        ) {
+            xmlSecInvalidSizeOtherError("Keys snapshot key is outside of the keys data", NULL);
+            goto error;
+        }
+        ret = xmlSecKeysSnapshotReadString(data, XMLSEC_KEYS_SNAPSHOT_HEADER_SIZE + indexSize, &pos,
+            nameSize, &(record->name));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKeysSnapshotReadString(name)", NULL);
+            goto error;
+        }
+        record->pending = 1;
+        ++snapshot->pendingSize;
+    }
+
+    /* the chains are in the keys order */
+    for(ii = snapshot->recordsSize; ii > 0; --ii) {
+        record = &(snapshot->records[ii - 1]);
+        ret = xmlSecKeysSnapshotIndexAdd(snapshot, record);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKeysSnapshotIndexAdd", NULL);
+            goto error;
+        }
+    }
+
+    /* done */
+    return(snapshot);
+
+error:
+    xmlSecKeysSnapshotDestroy(snapshot);
+    return(NULL);
+}
+
+/* reads the key and adds it to the store */
+static int
+xmlSecKeysSnapshotReadKey(xmlSecKeysSnapshotPtr snapshot, xmlSecKeysSnapshotRecordPtr record, xmlSecKeyStorePtr store) {
+    const xmlSecByte* data;
+    xmlDocPtr doc;
+    xmlNodePtr root;
+    xmlSecKeyPtr key = NULL;
+    int len;
+    int ret;
+
+    xmlSecAssert2(snapshot != NULL, -1);
+    xmlSecAssert2(record != NULL, -1);
+    xmlSecAssert2(store != NULL, -1);
+
+    if(record->pending == 0) {
+        return(0);
+    }
+
+    /* don't try again if anything goes wrong */
+    record->pending = 0;
+    --snapshot->pendingSize;
+
+    data = xmlSecBufferGetData(&(snapshot->data)) + record->offset;
+    if(xmlSecKeysSnapshotCrc32(data, record->size) != record->checksum) {
+        xmlSecInvalidDataError("Keys snapshot key checksum doesn't match", xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+
+    XMLSEC_SAFE_CAST_SIZE_TO_INT(record->size, len, return(-1), xmlSecKeyStoreGetName(store));
+    doc = xmlReadMemory((const char*)data, len, NULL, NULL, xmlSecParserGetDefaultOptions() | XML_PARSE_PEDANTIC);
+    if(doc == NULL) {
+        xmlSecXmlError("xmlReadMemory", xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+    root = xmlDocGetRootElement(doc);
+    if((root == NULL) || (!xmlSecCheckNodeName(root, xmlSecNodeKeyInfo, xmlSecDSigNs))) {
+        xmlSecInvalidNodeError(root, xmlSecNodeKeyInfo, xmlSecKeyStoreGetName(store));
+        xmlFreeDoc(doc);
+        return(-1);
+    }
+
+    ret = xmlSecSimpleKeysStoreReadKey(store, root, &key);
+    xmlFreeDoc(doc);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecSimpleKeysStoreReadKey", xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+    if(key == NULL) {
+        /* unknown key */
+        return(0);
+    }
+
+    /* don't use xmlSecSimpleKeysStoreAdoptKey(): it reads the whole snapshot first */
+    if(xmlSecKeyStoreCheckId(store, xmlSecIndexedKeysStoreId)) {
+        ret = xmlSecIndexedKeysStoreAddKey(store, key);
+    } else {
+        ret = xmlSecSimpleKeysStoreAdoptKey(store, key);
+    }
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecSimpleKeysStoreAdoptKey", xmlSecKeyStoreGetName(store));
+        xmlSecKeyDestroy(key);
+        return(-1);
+    }
+    record->key = key;
+    return(0);
+}
+
+/* reads all the keys with the given name (if not NULL) or all the remaining keys */
+static int
+xmlSecKeysSnapshotReadKeys(xmlSecKeysSnapshotPtr snapshot, const xmlChar* name, xmlSecKeyStorePtr store) {
+    xmlSecKeysSnapshotRecordPtr record;
+    xmlSecSize ii;
+    int ret;
+
+    xmlSecAssert2(snapshot != NULL, -1);
+    xmlSecAssert2(store != NULL, -1);
+
+    if(snapshot->pendingSize == 0) {
+        return(0);
+    }
+
+    if(name != NULL) {
+        record = (xmlSecKeysSnapshotRecordPtr)xmlHashLookup(snapshot->byName, name);
+        for( ; record != NULL; record = record->nextSameName) {
+            ret = xmlSecKeysSnapshotReadKey(snapshot, record, store);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecKeysSnapshotReadKey", xmlSecKeyStoreGetName(store));
+                return(-1);
+            }
+        }
+    } else {
+        for(ii = 0; ii < snapshot->recordsSize; ++ii) {
+            ret = xmlSecKeysSnapshotReadKey(snapshot, &(snapshot->records[ii]), store);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecKeysSnapshotReadKey", xmlSecKeyStoreGetName(store));
+                return(-1);
+            }
+        }
+    }
+    return(0);
+}
+
+/**
+ * @brief Writes keys from @p store to a binary snapshot file.
+ * @details Writes keys from @p store to a binary snapshot file that can be
+ * loaded with #xmlSecSimpleKeysStoreLoadSnapshot. The keys are stored in the
+ * same &lt;dsig:KeyInfo/&gt; format as #xmlSecSimpleKeysStoreSave uses.
+ * @param store the pointer to simple or indexed keys store.
+ * @param filename the filename.
+ * @param type the saved keys type (public, private, ...).
+ *
+ * @return 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecSimpleKeysStoreSaveSnapshot(xmlSecKeyStorePtr store, const char *filename, xmlSecKeyDataType type) {
+    xmlSecPtrListPtr list;
+    xmlSecKeyPtr key;
+    xmlSecBuffer index, keys, header;
+    xmlSecByte* data;
+    xmlSecSize ii, keysNum;
+    FILE* f = NULL;
+    int ret;
+    int res = -1;
+
+    xmlSecAssert2(xmlSecSimpleKeysStoreCheckAnyId(store), -1);
+    xmlSecAssert2(filename != NULL, -1);
+
+    list = xmlSecSimpleKeysStoreGetList(store);
+    if(list == NULL) {
+        xmlSecInternalError("xmlSecSimpleKeysStoreGetList", xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+
+    ret = xmlSecBufferInitialize(&index, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+    ret = xmlSecBufferInitialize(&keys, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", xmlSecKeyStoreGetName(store));
+        xmlSecBufferFinalize(&index);
+        return(-1);
+    }
+    ret = xmlSecBufferInitialize(&header, XMLSEC_KEYS_SNAPSHOT_HEADER_SIZE);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", xmlSecKeyStoreGetName(store));
+        xmlSecBufferFinalize(&keys);
+        xmlSecBufferFinalize(&index);
+        return(-1);
+    }
+
+    /* the keys offsets are adjusted when the index size is known */
+    keysNum = xmlSecPtrListGetSize(list);
+    for(ii = 0; ii < keysNum; ++ii) {
+        key = (xmlSecKeyPtr)xmlSecPtrListGetItem(list, ii);
+        xmlSecAssert2(key != NULL, -1);
+
+        ret = xmlSecKeysSnapshotWriteKey(store, key, type, &index, &keys);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKeysSnapshotWriteKey", xmlSecKeyStoreGetName(store));
+            goto done;
+        }
+    }
+    for(ii = 0; ii < xmlSecBufferGetSize(&index); ) {
+        xmlSecSize offset;
+
+        data = xmlSecBufferGetData(&index) + ii;
+        offset = xmlSecKeysSnapshotGetUInt32(data) + xmlSecBufferGetSize(&index);
+#if (XMLSEC_SIZE_MAX > 0xFFFFFFFFU)
+        if(offset > 0xFFFFFFFFU) {
+            xmlSecInvalidSizeMoreThanError("Keys snapshot offset", offset, (xmlSecSize)0xFFFFFFFFU, xmlSecKeyStoreGetName(store));
+            goto done;
+        }
+#endif /* (XMLSEC_SIZE_MAX > 0xFFFFFFFFU) */
+        if(offset < xmlSecBufferGetSize(&index)) {
+            xmlSecInvalidSizeOtherError("Keys snapshot offset is too large", xmlSecKeyStoreGetName(store));
+            goto done;
+        }
+        xmlSecKeysSnapshotSetUInt32(data, (uint32_t)offset);
+
+        ii += XMLSEC_KEYS_SNAPSHOT_INDEX_ENTRY_SIZE;
+        if(xmlSecKeysSnapshotGetUInt32(data + 12) != XMLSEC_KEYS_SNAPSHOT_NO_STRING) {
+            ii += xmlSecKeysSnapshotGetUInt32(data + 12);
+        }
+    }
+
+    /* header */
+    ret = xmlSecBufferAppend(&header, BAD_CAST XMLSEC_KEYS_SNAPSHOT_MAGIC, XMLSEC_KEYS_SNAPSHOT_MAGIC_SIZE);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferAppend", xmlSecKeyStoreGetName(store));
+        goto done;
+    }
+    if((xmlSecKeysSnapshotAppendUInt32(&header, XMLSEC_KEYS_SNAPSHOT_VERSION) < 0) ||
+       (xmlSecKeysSnapshotAppendUInt32(&header, keysNum) < 0) ||
+       (xmlSecKeysSnapshotAppendUInt32(&header, xmlSecBufferGetSize(&index)) < 0) ||
+       (xmlSecKeysSnapshotAppendUInt32(&header, xmlSecBufferGetSize(&keys)) < 0) ||
+       (xmlSecKeysSnapshotAppendUInt32(&header, xmlSecKeysSnapshotCrc32(xmlSecBufferGetData(&index), xmlSecBufferGetSize(&index))) < 0) ||
+       (xmlSecKeysSnapshotAppendUInt32(&header, xmlSecKeysSnapshotCrc32(xmlSecBufferGetData(&header), xmlSecBufferGetSize(&header))) < 0)
+    ) {
+        xmlSecInternalError("xmlSecKeysSnapshotAppendUInt32", xmlSecKeyStoreGetName(store));
+        goto done;
+    }
+    xmlSecAssert2(xmlSecBufferGetSize(&header) == XMLSEC_KEYS_SNAPSHOT_HEADER_SIZE, -1);
+
+    /* now write result */
+#ifndef _MSC_VER
+    f = fopen(filename, "wb");
+#else
+    fopen_s(&f, filename, "wb");
+#endif /* _MSC_VER */
+    if(f == NULL) {
+        xmlSecIOError("fopen", filename, xmlSecKeyStoreGetName(store));
+        goto done;
+    }
+    if((fwrite(xmlSecBufferGetData(&header), 1, xmlSecBufferGetSize(&header), f) != xmlSecBufferGetSize(&header)) ||
+       (fwrite(xmlSecBufferGetData(&index), 1, xmlSecBufferGetSize(&index), f) != xmlSecBufferGetSize(&index)) ||
+       (fwrite(xmlSecBufferGetData(&keys), 1, xmlSecBufferGetSize(&keys), f) != xmlSecBufferGetSize(&keys))
+    ) {
+        xmlSecIOError("fwrite", filename, xmlSecKeyStoreGetName(store));
+        goto done;
+    }
+    ret = fclose(f);
+    f = NULL;
+    if(ret != 0) {
+        xmlSecIOError("fclose", filename, xmlSecKeyStoreGetName(store));
+        goto done;
+    }
+
+    /* success */
+    res = 0;
+
+done:
+    if(f != NULL) {
+        fclose(f);
+    }
+    xmlSecBufferFinalize(&header);
+    xmlSecBufferFinalize(&keys);
+    xmlSecBufferFinalize(&index);
+    return(res);
+}
+
+/**
+ * @brief Reads keys from a binary snapshot file.
+ * @details Reads keys from a binary snapshot file created with
+ * #xmlSecSimpleKeysStoreSaveSnapshot. Only the snapshot index is read by the
+ * indexed keys store, the keys are read from the snapshot when they are looked
+ * up for the first time: the lookup by name reads all the keys with this name,
+ * the lookup by the key value klass only reads all the keys of this klass, and
+ * the lookup without name or klass (or #xmlSecSimpleKeysStoreGetKeys) reads all
+ * the remaining keys. The keys from the snapshot keep the snapshot order and
+ * go after the keys already in the store: #xmlSecSimpleKeysStoreAdoptKey reads
+ * all the remaining keys from the snapshot before adding a new key. The simple
+ * keys store reads all the keys right away.
+ * @param store the pointer to simple or indexed keys store.
+ * @param filename the filename.
+ *
+ * @return 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecSimpleKeysStoreLoadSnapshot(xmlSecKeyStorePtr store, const char *filename) {
+    xmlSecKeysSnapshotPtr snapshot;
+    int ret;
+
+    xmlSecAssert2(xmlSecSimpleKeysStoreCheckAnyId(store), -1);
+    xmlSecAssert2(filename != NULL, -1);
+
+    snapshot = xmlSecKeysSnapshotCreate(filename);
+    if(snapshot == NULL) {
+        xmlSecInternalError2("xmlSecKeysSnapshotCreate", xmlSecKeyStoreGetName(store),
+            "filename=%s", xmlSecErrorsSafeString(filename));
+        return(-1);
+    }
+
+    if(xmlSecKeyStoreCheckId(store, xmlSecIndexedKeysStoreId)) {
+        ret = xmlSecIndexedKeysStoreAdoptSnapshot(store, snapshot);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecIndexedKeysStoreAdoptSnapshot", xmlSecKeyStoreGetName(store));
+            xmlSecKeysSnapshotDestroy(snapshot);
+            return(-1);
+        }
+        return(0);
+    }
+
+    ret = xmlSecKeysSnapshotReadKeys(snapshot, NULL, store);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeysSnapshotReadKeys", xmlSecKeyStoreGetName(store));
+        xmlSecKeysSnapshotDestroy(snapshot);
+        return(-1);
+    }
+    xmlSecKeysSnapshotDestroy(snapshot);
+    return(0);
+}
+
+/******************************************************************************
+ *
+ * Indexed Keys Store
+ *
+ * xmlSecKeyStore + xmlSecIndexedKeysStoreCtx
+ *
+ * Same as the Simple Keys Store but the keys are also placed in the buckets
+ * (the lists of the keys pointers in the keys list order):
+ *   - (name): all the keys with the given name;
+ *   - (name, key data klass name): the keys with the given name and key value klass;
+ *   - (key data klass name): the keys with the given key value klass.
+ * The lookup checks only the keys in the bucket selected by the key name and
+ * by the required key data klass. The key usage and type are bit masks, these
+ * are checked by xmlSecKeyMatch() for the keys in the bucket.
+ *
+ * The key name and value are indexed when the key is added to the store: the
+ * stored keys are immutable, the index is not updated if the key name or value
+ * are changed later.
+ *
+  *****************************************************************************/
+typedef struct _xmlSecIndexedKeysStoreCtx {
+    xmlSecPtrList               keys;           /* all the keys (owned) */
+    xmlHashTablePtr             byName;         /* (name) and (name, klass name) buckets */
+    xmlHashTablePtr             byKlass;        /* (klass name) buckets */
+    xmlSecSize                  indexedSize;    /* the number of indexed keys */
+    int                         indexValid;     /* 0 if the buckets are out of sync with the keys list */
+    xmlSecKeysSnapshotPtr       snapshot;       /* the keys not read from the snapshot yet or NULL */
+    xmlSecSize                  snapshotStart;  /* the number of keys in the store before the snapshot */
+    xmlMutexPtr                 mutex;          /* serializes the lookups while the snapshot keys are read */
+} xmlSecIndexedKeysStoreCtx, *xmlSecIndexedKeysStoreCtxPtr;
+
+XMLSEC_KEY_STORE_DECLARE(IndexedKeysStore, xmlSecIndexedKeysStoreCtx)
+#define xmlSecIndexedKeysStoreSize XMLSEC_KEY_STORE_SIZE(IndexedKeysStore)
+
+static int                      xmlSecIndexedKeysStoreInitialize(xmlSecKeyStorePtr store);
+static void                     xmlSecIndexedKeysStoreFinalize  (xmlSecKeyStorePtr store);
+static xmlSecKeyPtr             xmlSecIndexedKeysStoreFindKey   (xmlSecKeyStorePtr store,
+                                                                 const xmlChar* name,
+                                                                 xmlSecKeyInfoCtxPtr keyInfoCtx);
+static xmlSecKeyPtr             xmlSecIndexedKeysStoreFindKeyInBuckets(xmlSecIndexedKeysStoreCtxPtr ctx,
+                                                                 const xmlChar* name,
+                                                                 const xmlChar* klassName,
+                                                                 xmlSecKeyInfoCtxPtr keyInfoCtx);
+static int                      xmlSecIndexedKeysStoreReadSnapshot(xmlSecKeyStorePtr store,
+                                                                 xmlSecIndexedKeysStoreCtxPtr ctx);
+
+static xmlSecKeyStoreKlass xmlSecIndexedKeysStoreKlass = {
+    sizeof(xmlSecKeyStoreKlass),
+    xmlSecIndexedKeysStoreSize,
+
+    /* data */
+    BAD_CAST "indexed-keys-store",              /* const xmlChar* name; */
+
+    /* constructors/destructor */
+    xmlSecIndexedKeysStoreInitialize,           /* xmlSecKeyStoreInitializeMethod initialize; */
+    xmlSecIndexedKeysStoreFinalize,             /* xmlSecKeyStoreFinalizeMethod finalize; */
+    xmlSecIndexedKeysStoreFindKey,              /* xmlSecKeyStoreFindKeyMethod findKey; */
+    NULL,                                       /* xmlSecKeyStoreFindKeyFromX509DataMethod findKeyFromX509Data; */
+
+    /* reserved for the future */
+    NULL,                                       /* void* reserved0; */
+};
+
+/* the buckets don't own the keys */
+static xmlSecPtrListKlass xmlSecIndexedKeysStoreBucketKlass = {
+    BAD_CAST "indexed-keys-store-bucket",
+    NULL,                                       /* xmlSecPtrDuplicateItemMethod duplicateItem; */
+    NULL,                                       /* xmlSecPtrDestroyItemMethod destroyItem; */
+    NULL,                                       /* xmlSecPtrDebugDumpItemMethod debugDumpItem; */
+    NULL,                                       /* xmlSecPtrDebugDumpItemMethod debugXmlDumpItem; */
+};
+
+/**
+ * @brief The indexed keys store klass.
+ * @details The indexed keys store klass: the same as the simple keys store
+ * (#xmlSecSimpleKeysStoreAdoptKey, #xmlSecSimpleKeysStoreLoad, #xmlSecSimpleKeysStoreSave
+ * and #xmlSecSimpleKeysStoreGetKeys functions work with it) but the keys are indexed
+ * by the key name and the key data klass to avoid the full keys list scan for
+ * every key lookup. The keys must not be changed after they are added to
+ * the store.
+ *
+ * @return indexed keys store klass.
+ */
+xmlSecKeyStoreId
+xmlSecIndexedKeysStoreGetKlass(void) {
+    return(&xmlSecIndexedKeysStoreKlass);
+}
+
+/* reads all the remaining keys from the snapshot (if any) */
+static xmlSecPtrListPtr
+xmlSecSimpleKeysStoreGetList(xmlSecKeyStorePtr store) {
+    xmlSecIndexedKeysStoreCtxPtr ctx;
+    int ret;
+
+    xmlSecAssert2(xmlSecSimpleKeysStoreCheckAnyId(store), NULL);
+
+    if(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId)) {
+        return(xmlSecSimpleKeysStoreGetCtx(store));
+    }
+
+    ctx = xmlSecIndexedKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, NULL);
+
+    /* see xmlSecIndexedKeysStoreFindKey() */
+    if((ctx->mutex != NULL) && (xmlSecAtomicPtrLoad(&(ctx->snapshot)) != NULL)) {
+        xmlMutexLock(ctx->mutex);
+        ret = (ctx->snapshot != NULL) ? xmlSecIndexedKeysStoreReadSnapshot(store, ctx) : 0;
+        xmlMutexUnlock(ctx->mutex);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecIndexedKeysStoreReadSnapshot", xmlSecKeyStoreGetName(store));
+            return(NULL);
+        }
+    }
+    return(&(ctx->keys));
+}
+
+static void
+xmlSecIndexedKeysStoreBucketDeallocator(void* payload, const xmlChar* name XMLSEC_ATTRIBUTE_UNUSED) {
+    UNREFERENCED_PARAMETER(name);
+    xmlSecAssert(payload != NULL);
+
+    xmlSecPtrListDestroy((xmlSecPtrListPtr)payload);
+}
+
+static int
+xmlSecIndexedKeysStoreBucketAdd(xmlHashTablePtr table, const xmlChar* name, const xmlChar* name2, xmlSecKeyPtr key) {
+    xmlSecPtrListPtr bucket;
+    int ret;
+
+    xmlSecAssert2(table != NULL, -1);
+    xmlSecAssert2(name != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    bucket = (xmlSecPtrListPtr)xmlHashLookup2(table, name, name2);
+    if(bucket == NULL) {
+        bucket = xmlSecPtrListCreate(&xmlSecIndexedKeysStoreBucketKlass);
+        if(bucket == NULL) {
+            xmlSecInternalError("xmlSecPtrListCreate", NULL);
+            return(-1);
+        }
+        ret = xmlHashAddEntry2(table, name, name2, bucket);
+        if(ret < 0) {
+            xmlSecXmlError2("xmlHashAddEntry2", NULL,
+                "name=%s", xmlSecErrorsSafeString(name));
+            xmlSecPtrListDestroy(bucket);
+            return(-1);
+        }
+    }
+
+    ret = xmlSecPtrListAdd(bucket, key);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/* adds the key to the buckets */
+static int
+xmlSecIndexedKeysStoreIndexKey(xmlSecIndexedKeysStoreCtxPtr ctx, xmlSecKeyPtr key) {
+    xmlSecKeyDataPtr value;
+    const xmlChar* name;
+    const xmlChar* klassName = NULL;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->byName != NULL, -1);
+    xmlSecAssert2(ctx->byKlass != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    name = xmlSecKeyGetName(key);
+    value = xmlSecKeyGetValue(key);
+    if((value != NULL) && (value->id != NULL)) {
+        klassName = value->id->name;
+    }
+
+    if(name != NULL) {
+        ret = xmlSecIndexedKeysStoreBucketAdd(ctx->byName, name, NULL, key);
+        if((ret >= 0) && (klassName != NULL)) {
+            ret = xmlSecIndexedKeysStoreBucketAdd(ctx->byName, name, klassName, key);
+        }
+    } else {
+        ret = 0;
+    }
+    if((ret >= 0) && (klassName != NULL)) {
+        ret = xmlSecIndexedKeysStoreBucketAdd(ctx->byKlass, klassName, NULL, key);
+    }
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecIndexedKeysStoreBucketAdd", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/* rebuilds the buckets from the keys list */
+static int
+xmlSecIndexedKeysStoreReindex(xmlSecIndexedKeysStoreCtxPtr ctx) {
+    xmlSecKeyPtr key;
+    xmlSecSize ii, size;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+
+    ctx->indexValid = 0;
+    ctx->indexedSize = 0;
+    if(ctx->byName != NULL) {
+        xmlHashFree(ctx->byName, xmlSecIndexedKeysStoreBucketDeallocator);
+        ctx->byName = NULL;
+    }
+    if(ctx->byKlass != NULL) {
+        xmlHashFree(ctx->byKlass, xmlSecIndexedKeysStoreBucketDeallocator);
+        ctx->byKlass = NULL;
+    }
+
+    ctx->byName = xmlHashCreate(0);
+    ctx->byKlass = xmlHashCreate(0);
+    if((ctx->byName == NULL) || (ctx->byKlass == NULL)) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        return(-1);
+    }
+
+    size = xmlSecPtrListGetSize(&(ctx->keys));
+    for(ii = 0; ii < size; ++ii) {
+        key = (xmlSecKeyPtr)xmlSecPtrListGetItem(&(ctx->keys), ii);
+        xmlSecAssert2(key != NULL, -1);
+
+        ret = xmlSecIndexedKeysStoreIndexKey(ctx, key);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecIndexedKeysStoreIndexKey", NULL);
+            return(-1);
+        }
+        ++ctx->indexedSize;
+    }
+    ctx->indexValid = 1;
+    return(0);
+}
+
+static int
+xmlSecIndexedKeysStoreAddKey(xmlSecKeyStorePtr store, xmlSecKeyPtr key) {
+    xmlSecIndexedKeysStoreCtxPtr ctx;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecIndexedKeysStoreId), -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    ctx = xmlSecIndexedKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    ret = xmlSecPtrListAdd(&(ctx->keys), key);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd", xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+
+    /* the keys list was changed directly, don't bother with the buckets */
+    if((ctx->indexValid == 0) || ((ctx->indexedSize + 1) != xmlSecPtrListGetSize(&(ctx->keys)))) {
+        ctx->indexValid = 0;
+        return(0);
+    }
+
+    ret = xmlSecIndexedKeysStoreIndexKey(ctx, key);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecIndexedKeysStoreIndexKey", xmlSecKeyStoreGetName(store));
+        /* the key might be in some buckets already: give up on the index and
+         * return the key back to the caller */
+        ctx->indexValid = 0;
+        xmlSecPtrListRemoveAndReturn(&(ctx->keys), xmlSecPtrListGetSize(&(ctx->keys)) - 1);
+        return(-1);
+    }
+
+    ++ctx->indexedSize;
+    return(0);
+}
+
+static int
+xmlSecIndexedKeysStoreInitialize(xmlSecKeyStorePtr store) {
+    xmlSecIndexedKeysStoreCtxPtr ctx;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecIndexedKeysStoreId), -1);
+
+    ctx = xmlSecIndexedKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+    memset(ctx, 0, sizeof(xmlSecIndexedKeysStoreCtx));
+
+    ret = xmlSecPtrListInitialize(&(ctx->keys), xmlSecKeyPtrListId);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecPtrListInitialize(xmlSecKeyPtrListId)",
+                            xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+
+    ctx->byName = xmlHashCreate(0);
+    if(ctx->byName == NULL) {
+        xmlSecXmlError("xmlHashCreate", xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+    ctx->byKlass = xmlHashCreate(0);
+    if(ctx->byKlass == NULL) {
+        xmlSecXmlError("xmlHashCreate", xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+    ctx->indexValid = 1;
+
+    return(0);
+}
+
+static void
+xmlSecIndexedKeysStoreFinalize(xmlSecKeyStorePtr store) {
+    xmlSecIndexedKeysStoreCtxPtr ctx;
+
+    xmlSecAssert(xmlSecKeyStoreCheckId(store, xmlSecIndexedKeysStoreId));
+
+    ctx = xmlSecIndexedKeysStoreGetCtx(store);
+    xmlSecAssert(ctx != NULL);
+
+    /* destroy the buckets first, the keys are owned by the list */
+    if(ctx->byName != NULL) {
+        xmlHashFree(ctx->byName, xmlSecIndexedKeysStoreBucketDeallocator);
+    }
+    if(ctx->byKlass != NULL) {
+        xmlHashFree(ctx->byKlass, xmlSecIndexedKeysStoreBucketDeallocator);
+    }
+    if(ctx->snapshot != NULL) {
+        xmlSecKeysSnapshotDestroy(ctx->snapshot);
+    }
+    if(ctx->mutex != NULL) {
+        xmlFreeMutex(ctx->mutex);
+    }
+    xmlSecPtrListFinalize(&(ctx->keys));
+    memset(ctx, 0, sizeof(xmlSecIndexedKeysStoreCtx));
+}
+
+static xmlSecKeyPtr
+xmlSecIndexedKeysStoreFindKey(xmlSecKeyStorePtr store, const xmlChar* name, xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    xmlSecIndexedKeysStoreCtxPtr ctx;
+    xmlSecKeyPtr res;
+    const xmlChar* klassName = NULL;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecIndexedKeysStoreId), NULL);
+    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+
+    ctx = xmlSecIndexedKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, NULL);
+
+    if(keyInfoCtx->keyReq.keyId != xmlSecKeyDataIdUnknown) {
+        klassName = keyInfoCtx->keyReq.keyId->name;
+    }
+
+    /* the snapshot is never set again once all its keys are read (the keys
+     * must not be added to the store while it is used for lookups), then
+     * the keys list and the buckets don't change and no lock is needed */
+    if((ctx->mutex == NULL) || (xmlSecAtomicPtrLoad(&(ctx->snapshot)) == NULL)) {
+        return(xmlSecIndexedKeysStoreFindKeyInBuckets(ctx, name, klassName, keyInfoCtx));
+    }
+
+    /* read the keys that might match from the snapshot first (re-check under the lock) */
+    xmlMutexLock(ctx->mutex);
+    if(ctx->snapshot != NULL) {
+        if((name == NULL) || (ctx->indexValid == 0) || (ctx->indexedSize != xmlSecPtrListGetSize(&(ctx->keys)))) {
+            ret = xmlSecIndexedKeysStoreReadSnapshot(store, ctx);
+        } else {
+            ret = xmlSecKeysSnapshotReadKeys(ctx->snapshot, name, store);
+        }
+        if(ret < 0) {
+            xmlMutexUnlock(ctx->mutex);
+            xmlSecInternalError("xmlSecIndexedKeysStoreReadSnapshot", xmlSecKeyStoreGetName(store));
+            return(NULL);
+        }
+    }
+    res = xmlSecIndexedKeysStoreFindKeyInBuckets(ctx, name, klassName, keyInfoCtx);
+    xmlMutexUnlock(ctx->mutex);
+    return(res);
+}
+
+static xmlSecKeyPtr
+xmlSecIndexedKeysStoreFindKeyInBuckets(xmlSecIndexedKeysStoreCtxPtr ctx, const xmlChar* name,
+    const xmlChar* klassName, xmlSecKeyInfoCtxPtr keyInfoCtx
+) {
+    xmlSecPtrListPtr bucket;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+
+    /* the keys list was changed directly or nothing to look up by: scan all the keys */
+    if((ctx->indexValid == 0) || (ctx->indexedSize != xmlSecPtrListGetSize(&(ctx->keys))) ||
+       ((name == NULL) && (klassName == NULL))
+    ) {
+        return(xmlSecSimpleKeysStoreFindKeyInList(&(ctx->keys), name, keyInfoCtx));
+    }
+
+    if(name != NULL) {
+        bucket = (xmlSecPtrListPtr)xmlHashLookup2(ctx->byName, name, klassName);
+    } else {
+        bucket = (xmlSecPtrListPtr)xmlHashLookup2(ctx->byKlass, klassName, NULL);
+    }
+    if(bucket == NULL) {
+        return(NULL);
+    }
+    return(xmlSecSimpleKeysStoreFindKeyInList(bucket, name, keyInfoCtx));
+}
+
+static int
+xmlSecIndexedKeysStoreAdoptSnapshot(xmlSecKeyStorePtr store, xmlSecKeysSnapshotPtr snapshot) {
+    xmlSecIndexedKeysStoreCtxPtr ctx;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecIndexedKeysStoreId), -1);
+    xmlSecAssert2(snapshot != NULL, -1);
+
+    ctx = xmlSecIndexedKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if(ctx->mutex == NULL) {
+        ctx->mutex = xmlNewMutex();
+        if(ctx->mutex == NULL) {
+            xmlSecXmlError("xmlNewMutex", xmlSecKeyStoreGetName(store));
+            return(-1);
+        }
+    }
+
+    /* the keys from the previous snapshot go first */
+    xmlMutexLock(ctx->mutex);
+    if(ctx->snapshot != NULL) {
+        ret = xmlSecIndexedKeysStoreReadSnapshot(store, ctx);
+        if(ret < 0) {
+            xmlMutexUnlock(ctx->mutex);
+            xmlSecInternalError("xmlSecIndexedKeysStoreReadSnapshot", xmlSecKeyStoreGetName(store));
+            return(-1);
+        }
+    }
+    ctx->snapshotStart = xmlSecPtrListGetSize(&(ctx->keys));
+    xmlSecAtomicPtrStore(&(ctx->snapshot), snapshot);
+    xmlMutexUnlock(ctx->mutex);
+    return(0);
+}
+
+static int
+xmlSecIndexedKeysStoreKeyPtrCompare(const void* a, const void* b) {
+    uintptr_t aa = (uintptr_t)(*(const xmlSecKeyPtr*)a);
+    uintptr_t bb = (uintptr_t)(*(const xmlSecKeyPtr*)b);
+
+    return((aa < bb) ? -1 : ((aa > bb) ? 1 : 0));
+}
+
+/* reads all the remaining keys from the snapshot and puts the snapshot keys in the
+ * keys list in the snapshot order (the lookups by name read the keys out of order),
+ * i.e. the keys list is the same as if the whole snapshot was read at once */
+static int
+xmlSecIndexedKeysStoreReadSnapshot(xmlSecKeyStorePtr store, xmlSecIndexedKeysStoreCtxPtr ctx) {
+    xmlSecKeysSnapshotPtr snapshot;
+    xmlSecKeyPtr* snapshotKeys = NULL;
+    xmlSecKeyPtr* sortedKeys = NULL;
+    xmlSecKeyPtr* keys = NULL;
+    xmlSecSize ii, snapshotKeysSize, keysSize, pos;
+    int ordered;
+    int ret;
+    int res = -1;
+
+    xmlSecAssert2(store != NULL, -1);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->snapshot != NULL, -1);
+
+    snapshot = ctx->snapshot;
+    ordered = ((snapshot->pendingSize == snapshot->recordsSize) &&
+               (ctx->snapshotStart == xmlSecPtrListGetSize(&(ctx->keys)))) ? 1 : 0;
+
+    ret = xmlSecKeysSnapshotReadKeys(snapshot, NULL, store);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeysSnapshotReadKeys", xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+    keysSize = xmlSecPtrListGetSize(&(ctx->keys));
+    if((ordered != 0) || (snapshot->recordsSize == 0) || (ctx->snapshotStart > keysSize)) {
+        goto done;
+    }
+
+    snapshotKeys = (xmlSecKeyPtr*)xmlMalloc(sizeof(xmlSecKeyPtr) * snapshot->recordsSize);
+    sortedKeys = (xmlSecKeyPtr*)xmlMalloc(sizeof(xmlSecKeyPtr) * snapshot->recordsSize);
+    keys = (xmlSecKeyPtr*)xmlMalloc(sizeof(xmlSecKeyPtr) * keysSize);
+    if((snapshotKeys == NULL) || (sortedKeys == NULL) || (keys == NULL)) {
+        xmlSecMallocError(sizeof(xmlSecKeyPtr) * keysSize, xmlSecKeyStoreGetName(store));
+        goto cleanup;
+    }
+    for(ii = 0, snapshotKeysSize = 0; ii < snapshot->recordsSize; ++ii) {
+        if(snapshot->records[ii].key != NULL) {
+            snapshotKeys[snapshotKeysSize++] = snapshot->records[ii].key;
+        }
+    }
+    memcpy(sortedKeys, snapshotKeys, sizeof(xmlSecKeyPtr) * snapshotKeysSize);
+    qsort(sortedKeys, snapshotKeysSize, sizeof(xmlSecKeyPtr), xmlSecIndexedKeysStoreKeyPtrCompare);
+
+    /* the keys before the snapshot, the snapshot keys, the keys added after the snapshot */
+    for(ii = 0, pos = 0; ii < ctx->snapshotStart; ++ii) {
+        keys[pos++] = (xmlSecKeyPtr)xmlSecPtrListGetItem(&(ctx->keys), ii);
+    }
+    for(ii = 0; (ii < snapshotKeysSize) && (pos < keysSize); ++ii) {
+        keys[pos++] = snapshotKeys[ii];
+    }
+    for(ii = ctx->snapshotStart; (ii < keysSize) && (pos < keysSize); ++ii) {
+        xmlSecKeyPtr key = (xmlSecKeyPtr)xmlSecPtrListGetItem(&(ctx->keys), ii);
+        if(bsearch(&key, sortedKeys, snapshotKeysSize, sizeof(xmlSecKeyPtr), xmlSecIndexedKeysStoreKeyPtrCompare) == NULL) {
+            keys[pos++] = key;
+        }
+    }
+    if(pos != keysSize) {
+        /* the keys list was changed directly, leave it as-is */
+        goto done;
+    }
+    memcpy(ctx->keys.data, keys, sizeof(xmlSecKeyPtr) * keysSize);
+
+    ret = xmlSecIndexedKeysStoreReindex(ctx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecIndexedKeysStoreReindex", xmlSecKeyStoreGetName(store));
+        goto cleanup;
+    }
+
+done:
+    /* everything is read, the snapshot is not needed anymore: the lookups
+     * that see the NULL snapshot see the final keys list and buckets too */
+    xmlSecAtomicPtrStore(&(ctx->snapshot), NULL);
+    xmlSecKeysSnapshotDestroy(snapshot);
+    res = 0;
+
+cleanup:
+    if(snapshotKeys != NULL) {
+        xmlFree(snapshotKeys);
+    }
+    if(sortedKeys != NULL) {
+        xmlFree(sortedKeys);
+    }
+    if(keys != NULL) {
+        xmlFree(keys);
+    }
+    return(res);
+}
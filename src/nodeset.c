@@ -31,7 +31,62 @@
         (node)->parent : \
         (xmlNodePtr)((xmlNsPtr)(node))->next)
 
-
+/* the LibXML2 nodes list is scanned linearly (and the tree nodes sets walk up the
+ * tree without the document order index) if it has less nodes than this */
+#define XMLSEC_NODESET_INDEX_MIN_SIZE   16
+
+/*
+ * The membership index for the LibXML2 nodes list: an open addressing hash
+ * table keyed by the node pointer. The namespace nodes in the XPath nodes
+ * sets are copies created by LibXML2, thus (similar to xmlXPathNodeSetContains)
+ * these are keyed by the parent element and the namespace prefix.
+ */
+typedef struct _xmlSecNodeSetIndexEntry {
+    const void*                 key;        /* the node or the namespace parent element */
+    const xmlChar*              prefix;     /* the namespace prefix (namespaces only) */
+    int                         isNs;
+} xmlSecNodeSetIndexEntry, *xmlSecNodeSetIndexEntryPtr;
+
+/*
+ * The document order index: the pre-order number of each element in the
+ * document and the pre-order number of the first element after its subtree.
+ * Element B is in the subtree of element A iff pre(A) <= pre(B) < end(A).
+ * The index is shared by all the tree nodes sets in the list.
+ */
+typedef struct _xmlSecNodeSetDocOrderEntry {
+    xmlNodePtr                  node;
+    xmlSecSize                  pre;
+    xmlSecSize                  end;
+} xmlSecNodeSetDocOrderEntry, *xmlSecNodeSetDocOrderEntryPtr;
+
+typedef struct _xmlSecNodeSetDocOrder {
+    xmlDocPtr                   doc;
+    int                         refCount;
+    xmlSecSize                  mask;       /* the table size minus one (the table size is a power of 2) */
+    xmlSecNodeSetDocOrderEntryPtr entries;
+} xmlSecNodeSetDocOrder, *xmlSecNodeSetDocOrderPtr;
+
+typedef struct _xmlSecNodeSetInterval {
+    xmlSecSize                  pre;
+    xmlSecSize                  end;
+} xmlSecNodeSetInterval, *xmlSecNodeSetIntervalPtr;
+
+typedef struct _xmlSecNodeSetIndex {
+    xmlNodeSetPtr               nodes;      /* the nodes list this index was built for */
+    int                         nodeNr;     /* the nodes list size when this index was built */
+
+    /* the membership hash table (NULL if it failed to build) */
+    xmlSecSize                  mask;       /* the table size minus one (the table size is a power of 2) */
+    xmlSecNodeSetIndexEntryPtr  entries;
+
+    /* the sorted non-overlapping subtrees of the element nodes in the list (tree nodes sets only) */
+    xmlSecNodeSetDocOrderPtr    docOrder;
+    xmlSecNodeSetIntervalPtr    intervals;
+    xmlSecSize                  intervalsSize;
+} xmlSecNodeSetIndex, *xmlSecNodeSetIndexPtr;
+
+
+static void     xmlSecNodeSetIndexDestroy               (xmlSecNodeSetIndexPtr idx);
 static int      xmlSecNodeSetContainsNode                (xmlSecNodeSetPtr nset,
                                                          xmlNodePtr node,
                                                          xmlNodePtr parent);
@@ -88,6 +143,9 @@ xmlSecNodeSetDestroy(xmlSecNodeSetPtr nset) {
             nset = NULL;
         }
 
+        if(tmp->reserved != NULL) {
+            xmlSecNodeSetIndexDestroy((xmlSecNodeSetIndexPtr)tmp->reserved);
+        }
         if(tmp->nodes != NULL) {
             xmlXPathFreeNodeSet(tmp->nodes);
         }
@@ -118,16 +176,515 @@ xmlSecNodeSetDocDestroy(xmlSecNodeSetPtr nset) {
     nset->destroyDoc = 1;
 }
 
+static xmlSecSize
+xmlSecNodeSetIndexHash(const void* key, const xmlChar* prefix) {
+    uintptr_t hash;
+
+    /* nodes are at least pointer aligned, drop the low bits */
+    hash = ((uintptr_t)key) >> 3;
+    if(prefix != NULL) {
+        for(; (*prefix) != '\0'; ++prefix) {
+            hash = hash * 31 + (*prefix);
+        }
+    }
+    /* Fibonacci hashing to spread sequentially allocated nodes */
+    hash *= (uintptr_t)0x9E3779B97F4A7C15ULL;
+    return((xmlSecSize)(hash ^ (hash >> 17)));
+}
+
+/* returns the power of 2 table size for the load factor at or below 1/2 */
+static xmlSecSize
+xmlSecNodeSetIndexGetTableSize(xmlSecSize count, xmlSecSize entrySize) {
+    xmlSecSize size;
+
+    xmlSecAssert2(entrySize > 0, 0);
+
+    for(size = 2 * XMLSEC_NODESET_INDEX_MIN_SIZE; size < 2 * count; size *= 2) {
+        if(size > XMLSEC_SIZE_MAX / (4 * entrySize)) {
+            xmlSecInvalidSizeOtherError("nodes set is too big", NULL);
+            return(0);
+        }
+    }
+    return(size);
+}
+
+static void
+xmlSecNodeSetDocOrderRelease(xmlSecNodeSetDocOrderPtr docOrder) {
+    xmlSecAssert(docOrder != NULL);
+    xmlSecAssert(docOrder->refCount > 0);
+
+    --(docOrder->refCount);
+    if(docOrder->refCount > 0) {
+        return;
+    }
+    if(docOrder->entries != NULL) {
+        xmlFree(docOrder->entries);
+    }
+    memset(docOrder, 0, sizeof(xmlSecNodeSetDocOrder));
+    xmlFree(docOrder);
+}
+
+static xmlSecNodeSetDocOrderEntryPtr
+xmlSecNodeSetDocOrderLookup(xmlSecNodeSetDocOrderPtr docOrder, xmlNodePtr node) {
+    xmlSecNodeSetDocOrderEntryPtr entry;
+    xmlSecSize pos;
+
+    xmlSecAssert2(docOrder != NULL, NULL);
+    xmlSecAssert2(docOrder->entries != NULL, NULL);
+    xmlSecAssert2(node != NULL, NULL);
+
+    for(pos = xmlSecNodeSetIndexHash(node, NULL) & docOrder->mask; ; pos = (pos + 1) & docOrder->mask) {
+        entry = &(docOrder->entries[pos]);
+        if(entry->node == node) {
+            return(entry);
+        }
+        if(entry->node == NULL) {
+            return(NULL);
+        }
+    }
+}
+
+/* walks the elements in the document in pre-order: numbers them if docOrder is not NULL
+ * or just counts them otherwise */
+static xmlSecSize
+xmlSecNodeSetDocOrderWalk(xmlDocPtr doc, xmlSecNodeSetDocOrderPtr docOrder) {
+    xmlSecNodeSetDocOrderEntryPtr entry;
+    xmlNodePtr cur;
+    xmlSecSize pre = 0;
+    xmlSecSize pos;
+
+    xmlSecAssert2(doc != NULL, 0);
+
+    cur = doc->children;
+    while(cur != NULL) {
+        if(cur->type == XML_ELEMENT_NODE) {
+            if(docOrder != NULL) {
+                for(pos = xmlSecNodeSetIndexHash(cur, NULL) & docOrder->mask; ; pos = (pos + 1) & docOrder->mask) {
+                    if(docOrder->entries[pos].node == NULL) {
+                        break;
+                    }
+                }
+                entry = &(docOrder->entries[pos]);
+                entry->node = cur;
+                entry->pre  = pre;
+                entry->end  = pre + 1;
+            }
+            ++pre;
+
+            /* only elements subtrees are numbered */
+            if(cur->children != NULL) {
+                cur = cur->children;
+                continue;
+            }
+        }
+
+        /* go to the next sibling, close the parent elements subtrees on the way up */
+        while((cur != NULL) && (cur->next == NULL)) {
+            cur = cur->parent;
+            if((cur == NULL) || (cur == (xmlNodePtr)doc)) {
+                cur = NULL;
+                break;
+            }
+            if(docOrder != NULL) {
+                entry = xmlSecNodeSetDocOrderLookup(docOrder, cur);
+                xmlSecAssert2(entry != NULL, 0);
+                entry->end = pre;
+            }
+        }
+        if(cur != NULL) {
+            cur = cur->next;
+        }
+    }
+    return(pre);
+}
+
+static xmlSecNodeSetDocOrderPtr
+xmlSecNodeSetDocOrderCreate(xmlDocPtr doc) {
+    xmlSecNodeSetDocOrderPtr docOrder;
+    xmlSecSize count, size;
+
+    xmlSecAssert2(doc != NULL, NULL);
+
+    docOrder = (xmlSecNodeSetDocOrderPtr)xmlMalloc(sizeof(xmlSecNodeSetDocOrder));
+    if(docOrder == NULL) {
+        xmlSecMallocError(sizeof(xmlSecNodeSetDocOrder), NULL);
+        return(NULL);
+    }
+    memset(docOrder, 0, sizeof(xmlSecNodeSetDocOrder));
+    docOrder->doc = doc;
+    docOrder->refCount = 1;
+
+    count = xmlSecNodeSetDocOrderWalk(doc, NULL);
+    size = xmlSecNodeSetIndexGetTableSize(count, sizeof(xmlSecNodeSetDocOrderEntry));
+    if(size == 0) {
+        xmlSecInternalError("xmlSecNodeSetIndexGetTableSize", NULL);
+        xmlSecNodeSetDocOrderRelease(docOrder);
+        return(NULL);
+    }
+    docOrder->mask = size - 1;
+    docOrder->entries = (xmlSecNodeSetDocOrderEntryPtr)xmlMalloc(size * sizeof(xmlSecNodeSetDocOrderEntry));
+    if(docOrder->entries == NULL) {
+        xmlSecMallocError(size * sizeof(xmlSecNodeSetDocOrderEntry), NULL);
+        xmlSecNodeSetDocOrderRelease(docOrder);
+        return(NULL);
+    }
+    memset(docOrder->entries, 0, size * sizeof(xmlSecNodeSetDocOrderEntry));
+
+    if(xmlSecNodeSetDocOrderWalk(doc, docOrder) != count) {
+        xmlSecInternalError("xmlSecNodeSetDocOrderWalk", NULL);
+        xmlSecNodeSetDocOrderRelease(docOrder);
+        return(NULL);
+    }
+
+    /* done */
+    return(docOrder);
+}
+
+static void
+xmlSecNodeSetIndexDestroy(xmlSecNodeSetIndexPtr idx) {
+    xmlSecAssert(idx != NULL);
+
+    if(idx->entries != NULL) {
+        xmlFree(idx->entries);
+    }
+    if(idx->intervals != NULL) {
+        xmlFree(idx->intervals);
+    }
+    if(idx->docOrder != NULL) {
+        xmlSecNodeSetDocOrderRelease(idx->docOrder);
+    }
+    memset(idx, 0, sizeof(xmlSecNodeSetIndex));
+    xmlFree(idx);
+}
+
+static void
+xmlSecNodeSetIndexInsert(xmlSecNodeSetIndexPtr idx, const void* key, const xmlChar* prefix, int isNs) {
+    xmlSecNodeSetIndexEntryPtr entry;
+    xmlSecSize pos;
+
+    xmlSecAssert(idx != NULL);
+    xmlSecAssert(idx->entries != NULL);
+    xmlSecAssert(key != NULL);
+
+    for(pos = xmlSecNodeSetIndexHash(key, prefix) & idx->mask; ; pos = (pos + 1) & idx->mask) {
+        entry = &(idx->entries[pos]);
+        if(entry->key == NULL) {
+            entry->key    = key;
+            entry->prefix = prefix;
+            entry->isNs   = isNs;
+            return;
+        }
+        if((entry->key == key) && (entry->isNs == isNs) && ((isNs == 0) || xmlStrEqual(entry->prefix, prefix))) {
+            /* duplicate */
+            return;
+        }
+    }
+}
+
+static int
+xmlSecNodeSetIndexLookup(xmlSecNodeSetIndexPtr idx, const void* key, const xmlChar* prefix, int isNs) {
+    xmlSecNodeSetIndexEntryPtr entry;
+    xmlSecSize pos;
+
+    xmlSecAssert2(idx != NULL, 0);
+    xmlSecAssert2(idx->entries != NULL, 0);
+
+    if(key == NULL) {
+        return(0);
+    }
+    for(pos = xmlSecNodeSetIndexHash(key, prefix) & idx->mask; ; pos = (pos + 1) & idx->mask) {
+        entry = &(idx->entries[pos]);
+        if(entry->key == NULL) {
+            return(0);
+        }
+        if((entry->key == key) && (entry->isNs == isNs) && ((isNs == 0) || xmlStrEqual(entry->prefix, prefix))) {
+            return(1);
+        }
+    }
+}
+
+static int
+xmlSecNodeSetIndexCreateHash(xmlSecNodeSetIndexPtr idx) {
+    xmlSecSize nodesSize, size;
+    int ii;
+
+    xmlSecAssert2(idx != NULL, -1);
+    xmlSecAssert2(idx->nodes != NULL, -1);
+    xmlSecAssert2(idx->entries == NULL, -1);
+
+    XMLSEC_SAFE_CAST_INT_TO_SIZE(idx->nodes->nodeNr, nodesSize, return(-1), NULL);
+    size = xmlSecNodeSetIndexGetTableSize(nodesSize, sizeof(xmlSecNodeSetIndexEntry));
+    if(size == 0) {
+        xmlSecInternalError("xmlSecNodeSetIndexGetTableSize", NULL);
+        return(-1);
+    }
+    idx->mask = size - 1;
+    idx->entries = (xmlSecNodeSetIndexEntryPtr)xmlMalloc(size * sizeof(xmlSecNodeSetIndexEntry));
+    if(idx->entries == NULL) {
+        xmlSecMallocError(size * sizeof(xmlSecNodeSetIndexEntry), NULL);
+        return(-1);
+    }
+    memset(idx->entries, 0, size * sizeof(xmlSecNodeSetIndexEntry));
+
+    for(ii = 0; ii < idx->nodes->nodeNr; ++ii) {
+        xmlNodePtr cur = idx->nodes->nodeTab[ii];
+        if(cur == NULL) {
+            continue;
+        }
+        if(cur->type != XML_NAMESPACE_DECL) {
+            xmlSecNodeSetIndexInsert(idx, cur, NULL, 0);
+        } else if(((xmlNsPtr)cur)->next != NULL) {
+            /* see xmlXPathNodeSetContains(): namespace nodes without parent never match */
+            xmlSecNodeSetIndexInsert(idx, ((xmlNsPtr)cur)->next, ((xmlNsPtr)cur)->prefix, 1);
+        }
+    }
+
+    /* done */
+    return(0);
+}
+
+static int
+xmlSecNodeSetIntervalCompare(const void* a, const void* b) {
+    const xmlSecNodeSetInterval* ia = (const xmlSecNodeSetInterval*)a;
+    const xmlSecNodeSetInterval* ib = (const xmlSecNodeSetInterval*)b;
+
+    if(ia->pre < ib->pre) {
+        return(-1);
+    } else if(ia->pre > ib->pre) {
+        return(1);
+    }
+    return(0);
+}
+
+/* returns 1 if the subtrees are indexed, 0 if they can't be indexed
+ * (e.g. nodes not in the document tree) or a negative value if an error occurs */
+static int
+xmlSecNodeSetIndexCreateIntervals(xmlSecNodeSetIndexPtr idx, xmlSecNodeSetPtr nset) {
+    xmlSecNodeSetDocOrderEntryPtr entry;
+    xmlSecNodeSetPtr cur;
+    xmlSecSize nodesSize, size;
+    int ii;
+
+    xmlSecAssert2(idx != NULL, -1);
+    xmlSecAssert2(idx->nodes != NULL, -1);
+    xmlSecAssert2(idx->docOrder == NULL, -1);
+    xmlSecAssert2(idx->intervals == NULL, -1);
+    xmlSecAssert2(nset != NULL, -1);
+
+    if(nset->doc == NULL) {
+        return(0);
+    }
+
+    /* share the document order with other nodes sets in the list if possible */
+    for(cur = nset->next; (cur != NULL) && (cur != nset); cur = cur->next) {
+        xmlSecNodeSetIndexPtr curIdx = (xmlSecNodeSetIndexPtr)cur->reserved;
+        if((curIdx != NULL) && (curIdx->docOrder != NULL) && (curIdx->docOrder->doc == nset->doc)) {
+            idx->docOrder = curIdx->docOrder;
+            ++(idx->docOrder->refCount);
+            break;
+        }
+    }
+    if(idx->docOrder == NULL) {
+        idx->docOrder = xmlSecNodeSetDocOrderCreate(nset->doc);
+        if(idx->docOrder == NULL) {
+            xmlSecInternalError("xmlSecNodeSetDocOrderCreate", NULL);
+            return(-1);
+        }
+    }
+
+    XMLSEC_SAFE_CAST_INT_TO_SIZE(idx->nodes->nodeNr, nodesSize, return(-1), NULL);
+    if(nodesSize > 0) {
+        idx->intervals = (xmlSecNodeSetIntervalPtr)xmlMalloc(nodesSize * sizeof(xmlSecNodeSetInterval));
+        if(idx->intervals == NULL) {
+            xmlSecMallocError(nodesSize * sizeof(xmlSecNodeSetInterval), NULL);
+            return(-1);
+        }
+    }
+
+    /* other nodes only match themselves */
+    for(ii = 0, size = 0; ii < idx->nodes->nodeNr; ++ii) {
+        xmlNodePtr node = idx->nodes->nodeTab[ii];
+        if((node == NULL) || (node->type != XML_ELEMENT_NODE)) {
+            continue;
+        }
+        entry = xmlSecNodeSetDocOrderLookup(idx->docOrder, node);
+        if(entry == NULL) {
+            /* not in the document tree */
+            return(0);
+        }
+        idx->intervals[size].pre = entry->pre;
+        idx->intervals[size].end = entry->end;
+        ++size;
+    }
+
+    /* subtrees are either nested or disjoint: sort them and drop the nested ones */
+    if(size > 1) {
+        xmlSecSize jj, kk;
+
+        qsort(idx->intervals, size, sizeof(xmlSecNodeSetInterval), xmlSecNodeSetIntervalCompare);
+        for(jj = 1, kk = 0; jj < size; ++jj) {
+            if(idx->intervals[jj].pre >= idx->intervals[kk].end) {
+                idx->intervals[++kk] = idx->intervals[jj];
+            }
+        }
+        size = kk + 1;
+    }
+    idx->intervalsSize = size;
+    return(1);
+}
+
+/* returns 1 if element is in one of the indexed subtrees, 0 if it is not or
+ * a negative value if the element is not in the document order index */
+static int
+xmlSecNodeSetIndexCheckSubtrees(xmlSecNodeSetIndexPtr idx, xmlNodePtr elem) {
+    xmlSecNodeSetDocOrderEntryPtr entry;
+    xmlSecSize lo, hi, mid;
+
+    xmlSecAssert2(idx != NULL, -1);
+    xmlSecAssert2(idx->docOrder != NULL, -1);
+    xmlSecAssert2(elem != NULL, -1);
+
+    entry = xmlSecNodeSetDocOrderLookup(idx->docOrder, elem);
+    if(entry == NULL) {
+        return(-1);
+    }
+
+    /* find the last subtree that starts at or before the element */
+    for(lo = 0, hi = idx->intervalsSize; lo < hi; ) {
+        mid = lo + (hi - lo) / 2;
+        if(idx->intervals[mid].pre <= entry->pre) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if((lo > 0) && (entry->pre < idx->intervals[lo - 1].end)) {
+        return(1);
+    }
+    return(0);
+}
+
+static int
+xmlSecNodeSetIsTree(xmlSecNodeSetPtr nset) {
+    xmlSecAssert2(nset != NULL, 0);
+
+    switch(nset->type) {
+    case xmlSecNodeSetTree:
+    case xmlSecNodeSetTreeWithoutComments:
+    case xmlSecNodeSetTreeInvert:
+    case xmlSecNodeSetTreeWithoutCommentsInvert:
+        return(1);
+    default:
+        return(0);
+    }
+}
+
+static xmlSecNodeSetIndexPtr
+xmlSecNodeSetIndexCreate(xmlSecNodeSetPtr nset) {
+    xmlSecNodeSetIndexPtr idx;
+    int ret;
+
+    xmlSecAssert2(nset != NULL, NULL);
+    xmlSecAssert2(nset->nodes != NULL, NULL);
+
+    idx = (xmlSecNodeSetIndexPtr)xmlMalloc(sizeof(xmlSecNodeSetIndex));
+    if(idx == NULL) {
+        xmlSecMallocError(sizeof(xmlSecNodeSetIndex), NULL);
+        return(NULL);
+    }
+    memset(idx, 0, sizeof(xmlSecNodeSetIndex));
+    idx->nodes = nset->nodes;
+    idx->nodeNr = nset->nodes->nodeNr;
+
+    /* if any part of the index fails to build then we keep the index without
+     * it (thus we don't try to rebuild it on every lookup) and fall back to
+     * the linear scan or to walking up the tree */
+    ret = xmlSecNodeSetIndexCreateHash(idx);
+    if(ret < 0) {
+        if(idx->entries != NULL) {
+            xmlFree(idx->entries);
+            idx->entries = NULL;
+        }
+        idx->mask = 0;
+    }
+
+    if(xmlSecNodeSetIsTree(nset)) {
+        ret = xmlSecNodeSetIndexCreateIntervals(idx, nset);
+        if(ret <= 0) {
+            if(idx->docOrder != NULL) {
+                xmlSecNodeSetDocOrderRelease(idx->docOrder);
+                idx->docOrder = NULL;
+            }
+            if(idx->intervals != NULL) {
+                xmlFree(idx->intervals);
+                idx->intervals = NULL;
+            }
+            idx->intervalsSize = 0;
+        }
+    }
+
+    /* done */
+    return(idx);
+}
+
+/* returns the index for the nodes set, (re)builds it if needed */
+static xmlSecNodeSetIndexPtr
+xmlSecNodeSetGetIndex(xmlSecNodeSetPtr nset) {
+    xmlSecNodeSetIndexPtr idx;
+
+    xmlSecAssert2(nset != NULL, NULL);
+
+    /* small sets are faster to scan */
+    if((nset->nodes == NULL) || (nset->nodes->nodeNr < XMLSEC_NODESET_INDEX_MIN_SIZE)) {
+        return(NULL);
+    }
+
+    idx = (xmlSecNodeSetIndexPtr)nset->reserved;
+    if((idx != NULL) && (idx->nodes == nset->nodes) && (idx->nodeNr == nset->nodes->nodeNr)) {
+        return(idx);
+    }
+
+    /* the nodes list was changed or we don't have an index yet */
+    if(idx != NULL) {
+        xmlSecNodeSetIndexDestroy(idx);
+        nset->reserved = NULL;
+    }
+    /* the allocation error is already reported, fall back to the linear scan */
+    idx = xmlSecNodeSetIndexCreate(nset);
+    if(idx == NULL) {
+        return(NULL);
+    }
+    nset->reserved = idx;
+    return(idx);
+}
+
 /* checks node against LibXML2 nodeset */
 static int
-xmlSecNodeSetCheckNode(xmlNodeSetPtr nodes, xmlNodePtr node, xmlNodePtr parent) {
+xmlSecNodeSetCheckNode(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr parent) {
+    xmlSecNodeSetIndexPtr idx;
+    xmlNodeSetPtr nodes;
+
+    xmlSecAssert2(nset != NULL, 0);
     xmlSecAssert2(node != NULL, 0);
 
     /* assume whole tree is included if nodes is NULL */
+    nodes = nset->nodes;
     if(nodes == NULL) {
         return(1);
     }
 
+    /* use the index if we have one (falls back to the linear scan otherwise) */
+    idx = xmlSecNodeSetGetIndex(nset);
+    if((idx != NULL) && (idx->entries != NULL)) {
+        if(node->type != XML_NAMESPACE_DECL) {
+            return(xmlSecNodeSetIndexLookup(idx, node, NULL, 0));
+        }
+        if((parent != NULL) && (parent->type == XML_ATTRIBUTE_NODE)) {
+            return(xmlSecNodeSetIndexLookup(idx, parent->parent, ((xmlNsPtr)node)->prefix, 1));
+        }
+        return(xmlSecNodeSetIndexLookup(idx, parent, ((xmlNsPtr)node)->prefix, 1));
+    }
+
     if(node->type != XML_NAMESPACE_DECL) {
         return(xmlXPathNodeSetContains(nodes, node));
     } else {
@@ -151,15 +708,41 @@ xmlSecNodeSetCheckNode(xmlNodeSetPtr nodes, xmlNodePtr node, xmlNodePtr parent)
 
 /* checks node or parents against LibXML2 nodeset */
 static int
-xmlSecNodeSetCheckNodeOrParent(xmlNodeSetPtr nodes, xmlNodePtr node, xmlNodePtr parent) {
+xmlSecNodeSetCheckNodeOrParent(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr parent) {
+    xmlSecNodeSetIndexPtr idx;
+
+    xmlSecAssert2(nset != NULL, 0);
     xmlSecAssert2(node != NULL, 0);
 
     /* assume whole tree is included if nodes is NULL */
-    if(nodes == NULL) {
+    if(nset->nodes == NULL) {
         return(1);
     }
+
+    /* check the node itself and then use the subtrees index for the nearest
+     * element (the node itself or its parent) instead of walking up the tree */
+    idx = xmlSecNodeSetGetIndex(nset);
+    if((idx != NULL) && (idx->docOrder != NULL)) {
+        xmlNodePtr elem;
+        int ret;
+
+        if(xmlSecNodeSetCheckNode(nset, node, parent)) {
+            return(1);
+        }
+        if((parent == NULL) || (parent->type != XML_ELEMENT_NODE)) {
+            /* we don't go up the tree */
+            return(0);
+        }
+        elem = (node->type == XML_ELEMENT_NODE) ? node : parent;
+        ret = xmlSecNodeSetIndexCheckSubtrees(idx, elem);
+        if(ret >= 0) {
+            return(ret);
+        }
+        /* the element is not in the document order index: walk up the tree */
+    }
+
     do {
-        if(xmlSecNodeSetCheckNode(nodes, node, parent)) {
+        if(xmlSecNodeSetCheckNode(nset, node, parent)) {
             return(1);
         }
 
@@ -186,30 +769,30 @@ xmlSecNodeSetContainsNode(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr par
     switch(nset->type) {
     case xmlSecNodeSetNormal:
         /* simple case */
-        return(xmlSecNodeSetCheckNode(nset->nodes, node, parent));
+        return(xmlSecNodeSetCheckNode(nset, node, parent));
     case xmlSecNodeSetInvert:
         /* simple case: return inverted result */
-        return(!xmlSecNodeSetCheckNode(nset->nodes, node, parent));
+        return(!xmlSecNodeSetCheckNode(nset, node, parent));
     case xmlSecNodeSetTree:
         /* just traverse up the tree to see if any parents are in the nodeset */
-        return(xmlSecNodeSetCheckNodeOrParent(nset->nodes, node, parent));
+        return(xmlSecNodeSetCheckNodeOrParent(nset, node, parent));
     case xmlSecNodeSetTreeWithoutComments:
         /* drop comments */
         if(node->type == XML_COMMENT_NODE) {
             return(0);
         }
         /* just traverse up the tree to see if any parents are in the nodeset */
-        return(xmlSecNodeSetCheckNodeOrParent(nset->nodes, node, parent));
+        return(xmlSecNodeSetCheckNodeOrParent(nset, node, parent));
     case xmlSecNodeSetTreeInvert:
         /* just traverse up the tree to see if any parents are in the nodeset and invert result */
-        return(!xmlSecNodeSetCheckNodeOrParent(nset->nodes, node, parent));
+        return(!xmlSecNodeSetCheckNodeOrParent(nset, node, parent));
     case xmlSecNodeSetTreeWithoutCommentsInvert:
         /* drop comments */
         if(node->type == XML_COMMENT_NODE) {
             return(0);
         }
         /* just traverse up the tree to see if any parents are in the nodeset and invert result */
-        return(!xmlSecNodeSetCheckNodeOrParent(nset->nodes, node, parent));
+        return(!xmlSecNodeSetCheckNodeOrParent(nset, node, parent));
     default:
         xmlSecUnsupportedEnumValueError("node set type", nset->type, NULL);
         return(0);
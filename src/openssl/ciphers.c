@@ -30,6 +30,7 @@
 #include "../cast_helpers.h"
 #include "../keysdata_helpers.h"
 #include "../transform_helpers.h"
+#include "private.h"
 
 #define XMLSEC_OPENSSL_EVP_CIPHER_PAD_SIZE    (2 * EVP_MAX_BLOCK_LENGTH)
 #define XMLSEC_OPENSSL_AES_GCM_NONCE_SIZE     12
@@ -849,9 +850,9 @@ xmlSecOpenSSLEvpBlockCipherInitialize(xmlSecTransformPtr transform) {
 #ifdef XMLSEC_OPENSSL_API_300
     /* fetch cipher */
     xmlSecAssert2(ctx->cipherName != NULL, -1);
-    ctx->cipher = EVP_CIPHER_fetch(xmlSecOpenSSLGetLibCtx(), ctx->cipherName, NULL);
+    ctx->cipher = xmlSecOpenSSLFetchCipher(ctx->cipherName, NULL);
     if(ctx->cipher == NULL) {
-        xmlSecOpenSSLError2("EVP_CIPHER_fetch", xmlSecTransformGetName(transform),
+        xmlSecOpenSSLError2("xmlSecOpenSSLFetchCipher", xmlSecTransformGetName(transform),
             "cipherName=%s", xmlSecErrorsSafeString(ctx->cipherName));
         xmlSecOpenSSLEvpBlockCipherFinalize(transform);
         return(-1);
@@ -14,6 +14,9 @@
 
 #include <string.h>
 
+#include <libxml/hash.h>
+#include <libxml/threads.h>
+
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/dl.h>
 #include <xmlsec/errors.h>
@@ -32,7 +35,14 @@
 #include <xmlsec/openssl/x509.h>
 
 #include "openssl_compat.h"
+
+#ifdef XMLSEC_OPENSSL_API_300
+#include <openssl/kdf.h>
+#endif /* XMLSEC_OPENSSL_API_300 */
+
+#include "../atomic_helpers.h"
 #include "../cast_helpers.h"
+#include "private.h"
 
 static int              xmlSecOpenSSLErrorsInit                 (void);
 static void             xmlSecOpenSSLErrorsShutdown             (void);
@@ -538,6 +548,23 @@ xmlSecOpenSSLInit (void)  {
         return(-1);
     }
 
+#ifndef XMLSEC_NO_X509
+    if(xmlSecOpenSSLX509CertsCacheInit() < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509CertsCacheInit", NULL);
+        return(-1);
+    }
+    if(xmlSecOpenSSLX509NamesCacheInit() < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509NamesCacheInit", NULL);
+        return(-1);
+    }
+#endif /* XMLSEC_NO_X509 */
+#ifdef XMLSEC_OPENSSL_API_300
+    if(xmlSecOpenSSLFetchCacheInit() < 0) {
+        xmlSecInternalError("xmlSecOpenSSLFetchCacheInit", NULL);
+        return(-1);
+    }
+#endif /* XMLSEC_OPENSSL_API_300 */
+
     /* register our klasses */
     if(xmlSecCryptoDLFunctionsRegisterKeyDataAndTransforms(xmlSecCryptoGetFunctions_openssl()) < 0) {
         xmlSecInternalError("xmlSecCryptoDLFunctionsRegisterKeyDataAndTransforms", NULL);
@@ -554,6 +581,13 @@ xmlSecOpenSSLInit (void)  {
 int
 xmlSecOpenSSLShutdown(void) {
     xmlSecOpenSSLSetDefaultTrustedCertsFolder(NULL);
+#ifdef XMLSEC_OPENSSL_API_300
+    xmlSecOpenSSLFetchCacheShutdown();
+#endif /* XMLSEC_OPENSSL_API_300 */
+#ifndef XMLSEC_NO_X509
+    xmlSecOpenSSLX509NamesCacheShutdown();
+    xmlSecOpenSSLX509CertsCacheShutdown();
+#endif /* XMLSEC_NO_X509 */
     xmlSecOpenSSLErrorsShutdown();
     return(0);
 }
@@ -793,11 +827,15 @@ static OSSL_LIB_CTX* gXmlSecOpenSSLLibCtx = NULL;
  * @brief Sets the OpenSSL library context used by xmlsec.
  * @details The caller retains ownership of @p libctx and must keep it alive for as long as
  * xmlsec uses it; freeing it while xmlsec still references it is a use-after-free.
+ * The library context must not be changed while xmlsec is used by other threads.
  * @return 0 on success or a negative value if an error occurs.
  */
 int
 xmlSecOpenSSLSetLibCtx(OSSL_LIB_CTX* libctx) {
     gXmlSecOpenSSLLibCtx = libctx;
+
+    /* the algorithms fetched from the previous library context can't be used anymore */
+    xmlSecOpenSSLFetchCacheFlush();
     return(0);
 }
 
@@ -809,6 +847,430 @@ OSSL_LIB_CTX*
 xmlSecOpenSSLGetLibCtx(void) {
     return(gXmlSecOpenSSLLibCtx);
 }
+
+/******************************************************************************
+ *
+ * Fetched algorithms cache
+ *
+ * The EVP_*_fetch() functions go through the provider store locks for every
+ * transform, the fetched algorithms are immutable and reference counted thus
+ * these are fetched once per (name, kind, properties) and shared. The cache is
+ * flushed when the library context is changed with #xmlSecOpenSSLSetLibCtx.
+ *
+ * The cache is an open addressing hash table with a fixed number of slots. An
+ * entry is never changed or moved once it is published in a slot, thus the
+ * lookups don't take the lock: only the new entries are added under the lock.
+ * The entries are removed only by the flush and the shutdown, these must not
+ * run concurrently with the lookups.
+ *
+  *****************************************************************************/
+#define XMLSEC_OPENSSL_FETCH_CACHE_MAX_SIZE     256
+#define XMLSEC_OPENSSL_FETCH_CACHE_SLOTS        512     /* a power of 2, at most half full */
+
+typedef enum {
+    xmlSecOpenSSLFetchKindDigest = 0,
+    xmlSecOpenSSLFetchKindCipher,
+    xmlSecOpenSSLFetchKindMac,
+    xmlSecOpenSSLFetchKindKdf,
+    xmlSecOpenSSLFetchKindSignature
+} xmlSecOpenSSLFetchKind;
+
+typedef struct _xmlSecOpenSSLFetchCacheEntry {
+    xmlSecOpenSSLFetchKind      kind;
+    char*                       name;
+    char*                       properties;     /* NULL for the default properties query */
+    void*                       alg;
+} xmlSecOpenSSLFetchCacheEntry, *xmlSecOpenSSLFetchCacheEntryPtr;
+
+static xmlMutexPtr                      gXmlSecOpenSSLFetchCacheMutex = NULL;
+static xmlSecOpenSSLFetchCacheEntryPtr  gXmlSecOpenSSLFetchCacheSlots[XMLSEC_OPENSSL_FETCH_CACHE_SLOTS];
+static xmlSecSize                       gXmlSecOpenSSLFetchCacheSize = 0;
+
+static void*
+xmlSecOpenSSLFetchAlg(xmlSecOpenSSLFetchKind kind, const char* name, const char* properties) {
+    xmlSecAssert2(name != NULL, NULL);
+
+    switch(kind) {
+    case xmlSecOpenSSLFetchKindDigest:
+        return(EVP_MD_fetch(xmlSecOpenSSLGetLibCtx(), name, properties));
+    case xmlSecOpenSSLFetchKindCipher:
+        return(EVP_CIPHER_fetch(xmlSecOpenSSLGetLibCtx(), name, properties));
+    case xmlSecOpenSSLFetchKindMac:
+        return(EVP_MAC_fetch(xmlSecOpenSSLGetLibCtx(), name, properties));
+    case xmlSecOpenSSLFetchKindKdf:
+        return(EVP_KDF_fetch(xmlSecOpenSSLGetLibCtx(), name, properties));
+    case xmlSecOpenSSLFetchKindSignature:
+        return(EVP_SIGNATURE_fetch(xmlSecOpenSSLGetLibCtx(), name, properties));
+    }
+    return(NULL);
+}
+
+static int
+xmlSecOpenSSLFetchAlgUpRef(xmlSecOpenSSLFetchKind kind, void* alg) {
+    xmlSecAssert2(alg != NULL, 0);
+
+    switch(kind) {
+    case xmlSecOpenSSLFetchKindDigest:
+        return(EVP_MD_up_ref((EVP_MD*)alg));
+    case xmlSecOpenSSLFetchKindCipher:
+        return(EVP_CIPHER_up_ref((EVP_CIPHER*)alg));
+    case xmlSecOpenSSLFetchKindMac:
+        return(EVP_MAC_up_ref((EVP_MAC*)alg));
+    case xmlSecOpenSSLFetchKindKdf:
+        return(EVP_KDF_up_ref((EVP_KDF*)alg));
+    case xmlSecOpenSSLFetchKindSignature:
+        return(EVP_SIGNATURE_up_ref((EVP_SIGNATURE*)alg));
+    }
+    return(0);
+}
+
+static void
+xmlSecOpenSSLFetchAlgFree(xmlSecOpenSSLFetchKind kind, void* alg) {
+    xmlSecAssert(alg != NULL);
+
+    switch(kind) {
+    case xmlSecOpenSSLFetchKindDigest:
+        EVP_MD_free((EVP_MD*)alg);
+        break;
+    case xmlSecOpenSSLFetchKindCipher:
+        EVP_CIPHER_free((EVP_CIPHER*)alg);
+        break;
+    case xmlSecOpenSSLFetchKindMac:
+        EVP_MAC_free((EVP_MAC*)alg);
+        break;
+    case xmlSecOpenSSLFetchKindKdf:
+        EVP_KDF_free((EVP_KDF*)alg);
+        break;
+    case xmlSecOpenSSLFetchKindSignature:
+        EVP_SIGNATURE_free((EVP_SIGNATURE*)alg);
+        break;
+    }
+}
+
+static void
+xmlSecOpenSSLFetchCacheEntryDestroy(xmlSecOpenSSLFetchCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+
+    if(entry->alg != NULL) {
+        xmlSecOpenSSLFetchAlgFree(entry->kind, entry->alg);
+    }
+    if(entry->name != NULL) {
+        xmlFree(entry->name);
+    }
+    if(entry->properties != NULL) {
+        xmlFree(entry->properties);
+    }
+    memset(entry, 0, sizeof(xmlSecOpenSSLFetchCacheEntry));
+    xmlFree(entry);
+}
+
+static xmlSecOpenSSLFetchCacheEntryPtr
+xmlSecOpenSSLFetchCacheEntryCreate(xmlSecOpenSSLFetchKind kind, const char* name, const char* properties, void* alg) {
+    xmlSecOpenSSLFetchCacheEntryPtr entry;
+
+    xmlSecAssert2(name != NULL, NULL);
+    xmlSecAssert2(alg != NULL, NULL);
+
+    entry = (xmlSecOpenSSLFetchCacheEntryPtr)xmlMalloc(sizeof(xmlSecOpenSSLFetchCacheEntry));
+    if(entry == NULL) {
+        xmlSecMallocError(sizeof(xmlSecOpenSSLFetchCacheEntry), NULL);
+        return(NULL);
+    }
+    memset(entry, 0, sizeof(xmlSecOpenSSLFetchCacheEntry));
+    entry->kind = kind;
+
+    entry->name = (char*)xmlStrdup(BAD_CAST name);
+    if(entry->name == NULL) {
+        xmlSecStrdupError(BAD_CAST name, NULL);
+        xmlSecOpenSSLFetchCacheEntryDestroy(entry);
+        return(NULL);
+    }
+    if(properties != NULL) {
+        entry->properties = (char*)xmlStrdup(BAD_CAST properties);
+        if(entry->properties == NULL) {
+            xmlSecStrdupError(BAD_CAST properties, NULL);
+            xmlSecOpenSSLFetchCacheEntryDestroy(entry);
+            return(NULL);
+        }
+    }
+
+    /* the entry owns a reference */
+    if(xmlSecOpenSSLFetchAlgUpRef(kind, alg) != 1) {
+        xmlSecOpenSSLError("xmlSecOpenSSLFetchAlgUpRef", NULL);
+        xmlSecOpenSSLFetchCacheEntryDestroy(entry);
+        return(NULL);
+    }
+    entry->alg = alg;
+    return(entry);
+}
+
+static int
+xmlSecOpenSSLFetchCacheEntryMatch(xmlSecOpenSSLFetchCacheEntryPtr entry, xmlSecOpenSSLFetchKind kind,
+    const char* name, const char* properties
+) {
+    xmlSecAssert2(entry != NULL, 0);
+    xmlSecAssert2(name != NULL, 0);
+
+    if((entry->kind != kind) || (strcmp(entry->name, name) != 0)) {
+        return(0);
+    }
+    if((entry->properties == NULL) || (properties == NULL)) {
+        return((entry->properties == properties) ? 1 : 0);
+    }
+    return((strcmp(entry->properties, properties) == 0) ? 1 : 0);
+}
+
+/* FNV-1a hash of (kind, name, properties) */
+static xmlSecSize
+xmlSecOpenSSLFetchCacheHash(xmlSecOpenSSLFetchKind kind, const char* name, const char* properties) {
+    unsigned int hash = 2166136261U;
+    const char* p;
+
+    xmlSecAssert2(name != NULL, 0);
+
+    hash = (hash ^ (unsigned int)kind) * 16777619U;
+    for(p = name; (*p) != '\0'; ++p) {
+        hash = (hash ^ (unsigned char)(*p)) * 16777619U;
+    }
+    if(properties != NULL) {
+        hash = (hash ^ 0xFFU) * 16777619U;
+        for(p = properties; (*p) != '\0'; ++p) {
+            hash = (hash ^ (unsigned char)(*p)) * 16777619U;
+        }
+    }
+    return((xmlSecSize)hash);
+}
+
+/* removes all the entries, called with the cache mutex locked */
+static void
+xmlSecOpenSSLFetchCacheClear(void) {
+    xmlSecOpenSSLFetchCacheEntryPtr entry;
+    xmlSecSize ii;
+
+    for(ii = 0; ii < XMLSEC_OPENSSL_FETCH_CACHE_SLOTS; ++ii) {
+        entry = gXmlSecOpenSSLFetchCacheSlots[ii];
+        if(entry != NULL) {
+            xmlSecAtomicPtrStore(&(gXmlSecOpenSSLFetchCacheSlots[ii]), NULL);
+            xmlSecOpenSSLFetchCacheEntryDestroy(entry);
+        }
+    }
+    gXmlSecOpenSSLFetchCacheSize = 0;
+}
+
+/**
+ * @brief Initializes the fetched algorithms cache.
+ * @details Initializes the process-wide cache of the algorithms fetched from
+ * the OpenSSL providers. Called from #xmlSecOpenSSLInit.
+ * @return 0 on success or a negative value otherwise.
+ */
+int
+xmlSecOpenSSLFetchCacheInit(void) {
+    if(gXmlSecOpenSSLFetchCacheMutex == NULL) {
+        gXmlSecOpenSSLFetchCacheMutex = xmlNewMutex();
+        if(gXmlSecOpenSSLFetchCacheMutex == NULL) {
+            xmlSecXmlError("xmlNewMutex", NULL);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/**
+ * @brief Shuts down the fetched algorithms cache.
+ * @details Frees the process-wide cache of the fetched algorithms. The
+ * algorithms still used by the existing transforms are freed when these
+ * transforms are destroyed. Called from #xmlSecOpenSSLShutdown.
+ */
+void
+xmlSecOpenSSLFetchCacheShutdown(void) {
+    if(gXmlSecOpenSSLFetchCacheMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(gXmlSecOpenSSLFetchCacheMutex);
+    xmlSecOpenSSLFetchCacheClear();
+    xmlMutexUnlock(gXmlSecOpenSSLFetchCacheMutex);
+
+    xmlFreeMutex(gXmlSecOpenSSLFetchCacheMutex);
+    gXmlSecOpenSSLFetchCacheMutex = NULL;
+}
+
+/**
+ * @brief Removes all the algorithms from the fetched algorithms cache.
+ * @details Removes all the algorithms from the fetched algorithms cache,
+ * e.g. when the OpenSSL library context is changed. The lookups don't
+ * take the cache lock: this function must not be called while xmlsec is
+ * used by other threads.
+ */
+void
+xmlSecOpenSSLFetchCacheFlush(void) {
+    if(gXmlSecOpenSSLFetchCacheMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(gXmlSecOpenSSLFetchCacheMutex);
+    xmlSecOpenSSLFetchCacheClear();
+    xmlMutexUnlock(gXmlSecOpenSSLFetchCacheMutex);
+}
+
+/* returns the published entry or NULL */
+static xmlSecOpenSSLFetchCacheEntryPtr
+xmlSecOpenSSLFetchCacheFind(xmlSecOpenSSLFetchKind kind, const char* name, const char* properties, xmlSecSize hash) {
+    xmlSecOpenSSLFetchCacheEntryPtr entry;
+    xmlSecSize ii;
+
+    xmlSecAssert2(name != NULL, NULL);
+
+    for(ii = 0; ii < XMLSEC_OPENSSL_FETCH_CACHE_SLOTS; ++ii) {
+        entry = xmlSecAtomicPtrLoad(&(gXmlSecOpenSSLFetchCacheSlots[(hash + ii) & (XMLSEC_OPENSSL_FETCH_CACHE_SLOTS - 1)]));
+        if(entry == NULL) {
+            return(NULL);
+        }
+        if(xmlSecOpenSSLFetchCacheEntryMatch(entry, kind, name, properties) == 1) {
+            return(entry);
+        }
+    }
+    return(NULL);
+}
+
+/* publishes the entry, called with the cache mutex locked; returns 1 if the entry
+ * is added, 0 if the cache is full or the same entry is already there */
+static int
+xmlSecOpenSSLFetchCacheAdd(xmlSecOpenSSLFetchCacheEntryPtr entry, xmlSecSize hash) {
+    xmlSecOpenSSLFetchCacheEntryPtr cur;
+    xmlSecSize ii, pos;
+
+    xmlSecAssert2(entry != NULL, 0);
+
+    /* don't bother with LRU, it is unlikely to have that many algorithms */
+    if(gXmlSecOpenSSLFetchCacheSize >= XMLSEC_OPENSSL_FETCH_CACHE_MAX_SIZE) {
+        return(0);
+    }
+    for(ii = 0; ii < XMLSEC_OPENSSL_FETCH_CACHE_SLOTS; ++ii) {
+        pos = (hash + ii) & (XMLSEC_OPENSSL_FETCH_CACHE_SLOTS - 1);
+        cur = gXmlSecOpenSSLFetchCacheSlots[pos];
+        if(cur == NULL) {
+            /* the entry is fully initialized before it is published */
+            xmlSecAtomicPtrStore(&(gXmlSecOpenSSLFetchCacheSlots[pos]), entry);
+            ++gXmlSecOpenSSLFetchCacheSize;
+            return(1);
+        }
+        if(xmlSecOpenSSLFetchCacheEntryMatch(cur, entry->kind, entry->name, entry->properties) == 1) {
+            /* another thread has added it already */
+            return(0);
+        }
+    }
+    return(0);
+}
+
+/* returns the fetched algorithm with the reference added (the caller frees it) or NULL */
+static void*
+xmlSecOpenSSLFetchCacheGet(xmlSecOpenSSLFetchKind kind, const char* name, const char* properties) {
+    xmlSecOpenSSLFetchCacheEntryPtr entry;
+    xmlSecSize hash;
+    void* alg;
+    int ret;
+
+    xmlSecAssert2(name != NULL, NULL);
+
+    /* the cache is not initialized: just fetch it */
+    if(gXmlSecOpenSSLFetchCacheMutex == NULL) {
+        return(xmlSecOpenSSLFetchAlg(kind, name, properties));
+    }
+
+    /* no lock: the published entries never change */
+    hash = xmlSecOpenSSLFetchCacheHash(kind, name, properties);
+    entry = xmlSecOpenSSLFetchCacheFind(kind, name, properties, hash);
+    if((entry != NULL) && (xmlSecOpenSSLFetchAlgUpRef(kind, entry->alg) == 1)) {
+        return(entry->alg);
+    }
+
+    /* fetch it without holding the lock */
+    alg = xmlSecOpenSSLFetchAlg(kind, name, properties);
+    if(alg == NULL) {
+        return(NULL);
+    }
+
+    entry = xmlSecOpenSSLFetchCacheEntryCreate(kind, name, properties, alg);
+    if(entry == NULL) {
+        /* not fatal, just don't cache it */
+        xmlSecInternalError("xmlSecOpenSSLFetchCacheEntryCreate", NULL);
+        return(alg);
+    }
+
+    xmlMutexLock(gXmlSecOpenSSLFetchCacheMutex);
+    ret = xmlSecOpenSSLFetchCacheAdd(entry, hash);
+    xmlMutexUnlock(gXmlSecOpenSSLFetchCacheMutex);
+    if(ret != 1) {
+        xmlSecOpenSSLFetchCacheEntryDestroy(entry);
+    }
+    return(alg);
+}
+
+/**
+ * @brief Fetches the digest algorithm.
+ * @details The same as EVP_MD_fetch() with the xmlsec library context but
+ * the fetched digests are cached.
+ * @param name the digest name.
+ * @param properties the properties query or NULL.
+ * @return the digest (the caller frees it with EVP_MD_free()) or NULL if an error occurs.
+ */
+EVP_MD*
+xmlSecOpenSSLFetchDigest(const char* name, const char* properties) {
+    return((EVP_MD*)xmlSecOpenSSLFetchCacheGet(xmlSecOpenSSLFetchKindDigest, name, properties));
+}
+
+/**
+ * @brief Fetches the cipher algorithm.
+ * @details The same as EVP_CIPHER_fetch() with the xmlsec library context but
+ * the fetched ciphers are cached.
+ * @param name the cipher name.
+ * @param properties the properties query or NULL.
+ * @return the cipher (the caller frees it with EVP_CIPHER_free()) or NULL if an error occurs.
+ */
+EVP_CIPHER*
+xmlSecOpenSSLFetchCipher(const char* name, const char* properties) {
+    return((EVP_CIPHER*)xmlSecOpenSSLFetchCacheGet(xmlSecOpenSSLFetchKindCipher, name, properties));
+}
+
+/**
+ * @brief Fetches the MAC algorithm.
+ * @details The same as EVP_MAC_fetch() with the xmlsec library context but
+ * the fetched MACs are cached.
+ * @param name the MAC name.
+ * @param properties the properties query or NULL.
+ * @return the MAC (the caller frees it with EVP_MAC_free()) or NULL if an error occurs.
+ */
+EVP_MAC*
+xmlSecOpenSSLFetchMac(const char* name, const char* properties) {
+    return((EVP_MAC*)xmlSecOpenSSLFetchCacheGet(xmlSecOpenSSLFetchKindMac, name, properties));
+}
+
+/**
+ * @brief Fetches the KDF algorithm.
+ * @details The same as EVP_KDF_fetch() with the xmlsec library context but
+ * the fetched KDFs are cached.
+ * @param name the KDF name.
+ * @param properties the properties query or NULL.
+ * @return the KDF (the caller frees it with EVP_KDF_free()) or NULL if an error occurs.
+ */
+EVP_KDF*
+xmlSecOpenSSLFetchKdf(const char* name, const char* properties) {
+    return((EVP_KDF*)xmlSecOpenSSLFetchCacheGet(xmlSecOpenSSLFetchKindKdf, name, properties));
+}
+
+/**
+ * @brief Fetches the signature algorithm.
+ * @details The same as EVP_SIGNATURE_fetch() with the xmlsec library context but
+ * the fetched signatures are cached.
+ * @param name the signature name.
+ * @param properties the properties query or NULL.
+ * @return the signature (the caller frees it with EVP_SIGNATURE_free()) or NULL if an error occurs.
+ */
+EVP_SIGNATURE*
+xmlSecOpenSSLFetchSignature(const char* name, const char* properties) {
+    return((EVP_SIGNATURE*)xmlSecOpenSSLFetchCacheGet(xmlSecOpenSSLFetchKindSignature, name, properties));
+}
 #endif /* XMLSEC_OPENSSL_API_300 */
 
 /******************************************************************************
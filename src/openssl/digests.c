@@ -30,6 +30,7 @@
 #endif /* XMLSEC_OPENSSL_API_300 */
 
 #include "../cast_helpers.h"
+#include "private.h"
 
 /******************************************************************************
  *
@@ -62,6 +63,11 @@ static int      xmlSecOpenSSLEvpDigestVerify            (xmlSecTransformPtr tran
 static int      xmlSecOpenSSLEvpDigestExecute           (xmlSecTransformPtr transform,
                                                          int last,
                                                          xmlSecTransformCtxPtr transformCtx);
+static int      xmlSecOpenSSLEvpDigestPushBin           (xmlSecTransformPtr transform,
+                                                         const xmlSecByte* data,
+                                                         xmlSecSize dataSize,
+                                                         int final,
+                                                         xmlSecTransformCtxPtr transformCtx);
 static int      xmlSecOpenSSLEvpDigestCheckId           (xmlSecTransformPtr transform);
 
 static int
@@ -158,9 +164,9 @@ xmlSecOpenSSLEvpDigestSetDigestByName(xmlSecOpenSSLEvpDigestCtxPtr ctx, const ch
     xmlSecAssert2(ctx->digest == NULL, -1);
     xmlSecAssert2(digestName != NULL, -1);
 
-    ctx->digest = EVP_MD_fetch(xmlSecOpenSSLGetLibCtx(), digestName, NULL);
+    ctx->digest = xmlSecOpenSSLFetchDigest(digestName, NULL);
     if(ctx->digest == NULL) {
-        xmlSecOpenSSLError2("EVP_MD_fetch", NULL, "digestName=%s", xmlSecErrorsSafeString(digestName));
+        xmlSecOpenSSLError2("xmlSecOpenSSLFetchDigest", NULL, "digestName=%s", xmlSecErrorsSafeString(digestName));
         return(-1);
     }
     ctx->digestNeedsToBeFreed = 1;
@@ -475,6 +481,54 @@ xmlSecOpenSSLEvpDigestExecute(xmlSecTransformPtr transform, int last, xmlSecTran
     return(0);
 }
 
+/* Digest the pushed data in place instead of copying it to the input buffer first
+ * (e.g. the C14N output is pushed directly from the libxml2 output buffer). */
+static int
+xmlSecOpenSSLEvpDigestPushBin(xmlSecTransformPtr transform, const xmlSecByte* data,
+                            xmlSecSize dataSize, int final, xmlSecTransformCtxPtr transformCtx) {
+    xmlSecOpenSSLEvpDigestCtxPtr ctx;
+    int ret;
+
+    xmlSecAssert2(xmlSecOpenSSLEvpDigestCheckId(transform), -1);
+    xmlSecAssert2(xmlSecTransformCheckSize(transform, xmlSecOpenSSLEvpDigestSize), -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    ctx = xmlSecOpenSSLEvpDigestGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->digestCtx != NULL, -1);
+
+    /* fall back to the default processing if we have something buffered */
+    if((dataSize <= 0) || (xmlSecBufferGetSize(&(transform->inBuf)) > 0) ||
+       ((transform->status != xmlSecTransformStatusNone) && (transform->status != xmlSecTransformStatusWorking))
+    ) {
+        return(xmlSecTransformDefaultPushBin(transform, data, dataSize, final, transformCtx));
+    }
+    xmlSecAssert2(data != NULL, -1);
+
+    /* initialize digest if needed */
+    if(transform->status == xmlSecTransformStatusNone) {
+        ret = xmlSecTransformExecute(transform, 0, transformCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformExecute", xmlSecTransformGetName(transform));
+            return(-1);
+        }
+    }
+    xmlSecAssert2(transform->status == xmlSecTransformStatusWorking, -1);
+
+    ret = EVP_DigestUpdate(ctx->digestCtx, data, dataSize);
+    if(ret != 1) {
+        xmlSecOpenSSLError2("EVP_DigestUpdate", xmlSecTransformGetName(transform),
+            "size=" XMLSEC_SIZE_FMT, dataSize);
+        return(-1);
+    }
+
+    /* nothing to finalize or to push to the next transform */
+    if(final == 0) {
+        return(0);
+    }
+    return(xmlSecTransformDefaultPushBin(transform, NULL, 0, final, transformCtx));
+}
+
 
 /* Helper macros to define the digest transform klass */
 #define XMLSEC_OPENSSL_EVP_DIGEST_KLASS_EX(name, readNode)                                              \
@@ -492,7 +546,7 @@ static xmlSecTransformKlass xmlSecOpenSSL ## name ## Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */               \
     xmlSecOpenSSLEvpDigestVerify,               /* xmlSecTransformVerifyMethod verify; */               \
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */     \
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */             \
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */             \
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */               \
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */             \
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */               \
@@ -13,6 +13,7 @@
 
 #include <string.h>
 
+#include <openssl/err.h>
 #include <openssl/evp.h>
 #include <openssl/rand.h>
 #include <openssl/x509.h>
@@ -35,6 +36,7 @@
 #include <openssl/param_build.h>
 #endif /* XMLSEC_OPENSSL_API_300 */
 
+#include "../atomic_helpers.h"
 #include "../cast_helpers.h"
 #include "../keysdata_helpers.h"
 #include "openssl_compat.h"
@@ -116,10 +118,22 @@ xmlSecOpenSSLSetBNValue(const BIGNUM *bigNum, xmlSecBufferPtr buf) {
   *****************************************************************************/
 typedef struct _xmlSecOpenSSLEvpKeyDataCtx      xmlSecOpenSSLEvpKeyDataCtx,
                                                 *xmlSecOpenSSLEvpKeyDataCtxPtr;
+#define XMLSEC_OPENSSL_EVP_PKEY_CTX_CACHE_SIZE      4
+
+typedef struct _xmlSecOpenSSLEvpPkeyCtxCacheEntry {
+    xmlChar*            name;
+    EVP_PKEY_CTX*       pKeyCtx;
+} xmlSecOpenSSLEvpPkeyCtxCacheEntry, *xmlSecOpenSSLEvpPkeyCtxCacheEntryPtr;
+
 struct _xmlSecOpenSSLEvpKeyDataCtx {
     EVP_PKEY*           pKey;
+
+    /* configured EVP_PKEY_CTX templates (see xmlSecOpenSSLEvpKeyDataGetPkeyCtx) */
+    xmlSecOpenSSLEvpPkeyCtxCacheEntryPtr pKeyCtxCache[XMLSEC_OPENSSL_EVP_PKEY_CTX_CACHE_SIZE];
 };
 
+static void             xmlSecOpenSSLEvpKeyDataCtxFlushPkeyCtxCache (xmlSecOpenSSLEvpKeyDataCtxPtr ctx);
+
 /******************************************************************************
  *
  * EVP key data
@@ -159,6 +173,9 @@ xmlSecOpenSSLEvpKeyDataAdoptEvp(xmlSecKeyDataPtr data, EVP_PKEY* pKey) {
         EVP_PKEY_free(ctx->pKey);
     }
     ctx->pKey = pKey;
+
+    /* the cached contexts were created for the old key */
+    xmlSecOpenSSLEvpKeyDataCtxFlushPkeyCtxCache(ctx);
     return(0);
 }
 
@@ -255,12 +272,194 @@ xmlSecOpenSSLEvpKeyDataFinalize(xmlSecKeyDataPtr data) {
     ctx = xmlSecOpenSSLEvpKeyDataGetCtx(data);
     xmlSecAssert(ctx != NULL);
 
+    xmlSecOpenSSLEvpKeyDataCtxFlushPkeyCtxCache(ctx);
     if(ctx->pKey != NULL) {
         EVP_PKEY_free(ctx->pKey);
     }
     OPENSSL_cleanse(ctx, sizeof(xmlSecOpenSSLEvpKeyDataCtx));
 }
 
+/******************************************************************************
+ *
+ * Per-key EVP_PKEY_CTX cache: setting up EVP_PKEY_CTX (operation init, padding,
+ * digest, salt length, ...) is a noticeable part of the cost of an RSA operation.
+ * The EVP key data keeps a few fully configured contexts and hands out their
+ * copies (EVP_PKEY_CTX_dup) to the transforms. The contexts are identified by
+ * the caller-provided name that must encode all the configuration parameters.
+ *
+ * The key data objects are shared between threads (see xmlSecKeyRef). The cache
+ * entries are published with an atomic compare-and-swap into an empty slot and
+ * are never replaced or freed while the key is in use: once all the slots are
+ * taken, the new contexts are simply not cached. The templates are only read
+ * (EVP_PKEY_CTX_dup) by the transforms and no lock is taken. The cache is
+ * flushed when the key data is destroyed or gets a new EVP_PKEY, i.e. when no
+ * other thread can use it.
+ *
+  *****************************************************************************/
+static xmlSecOpenSSLEvpPkeyCtxCacheEntryPtr
+xmlSecOpenSSLEvpPkeyCtxCacheEntryCreate(const xmlChar* name, EVP_PKEY_CTX* pKeyCtx) {
+    xmlSecOpenSSLEvpPkeyCtxCacheEntryPtr entry;
+
+    xmlSecAssert2(name != NULL, NULL);
+    xmlSecAssert2(pKeyCtx != NULL, NULL);
+
+    entry = (xmlSecOpenSSLEvpPkeyCtxCacheEntryPtr)xmlMalloc(sizeof(xmlSecOpenSSLEvpPkeyCtxCacheEntry));
+    if(entry == NULL) {
+        xmlSecMallocError(sizeof(xmlSecOpenSSLEvpPkeyCtxCacheEntry), NULL);
+        return(NULL);
+    }
+    memset(entry, 0, sizeof(xmlSecOpenSSLEvpPkeyCtxCacheEntry));
+
+    entry->name = xmlStrdup(name);
+    if(entry->name == NULL) {
+        xmlSecStrdupError(name, NULL);
+        xmlFree(entry);
+        return(NULL);
+    }
+    entry->pKeyCtx = pKeyCtx;
+    return(entry);
+}
+
+static void
+xmlSecOpenSSLEvpPkeyCtxCacheEntryDestroy(xmlSecOpenSSLEvpPkeyCtxCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+
+    if(entry->pKeyCtx != NULL) {
+        EVP_PKEY_CTX_free(entry->pKeyCtx);
+    }
+    if(entry->name != NULL) {
+        xmlFree(entry->name);
+    }
+    xmlFree(entry);
+}
+
+/* the caller must be the only user of the key data */
+static void
+xmlSecOpenSSLEvpKeyDataCtxFlushPkeyCtxCache(xmlSecOpenSSLEvpKeyDataCtxPtr ctx) {
+    xmlSecSize ii;
+
+    xmlSecAssert(ctx != NULL);
+
+    for(ii = 0; ii < XMLSEC_OPENSSL_EVP_PKEY_CTX_CACHE_SIZE; ++ii) {
+        if(ctx->pKeyCtxCache[ii] != NULL) {
+            xmlSecOpenSSLEvpPkeyCtxCacheEntryDestroy(ctx->pKeyCtxCache[ii]);
+            ctx->pKeyCtxCache[ii] = NULL;
+        }
+    }
+}
+
+static EVP_PKEY_CTX*
+xmlSecOpenSSLEvpKeyDataCtxFindCachedPkeyCtx(xmlSecOpenSSLEvpKeyDataCtxPtr ctx, const xmlChar* name) {
+    xmlSecOpenSSLEvpPkeyCtxCacheEntryPtr entry;
+    xmlSecSize ii;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(name != NULL, NULL);
+
+    /* the slots are filled in order, stop at the first empty one */
+    for(ii = 0; ii < XMLSEC_OPENSSL_EVP_PKEY_CTX_CACHE_SIZE; ++ii) {
+        entry = xmlSecAtomicPtrLoad(&(ctx->pKeyCtxCache[ii]));
+        if(entry == NULL) {
+            break;
+        }
+        if(xmlStrEqual(entry->name, name) != 0) {
+            return(entry->pKeyCtx);
+        }
+    }
+    return(NULL);
+}
+
+/* takes ownership of pKeyCtx */
+static void
+xmlSecOpenSSLEvpKeyDataCtxAddCachedPkeyCtx(xmlSecOpenSSLEvpKeyDataCtxPtr ctx, const xmlChar* name, EVP_PKEY_CTX* pKeyCtx) {
+    xmlSecOpenSSLEvpPkeyCtxCacheEntryPtr entry;
+    xmlSecOpenSSLEvpPkeyCtxCacheEntryPtr cur;
+    xmlSecSize ii;
+
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(name != NULL);
+    xmlSecAssert(pKeyCtx != NULL);
+
+    entry = xmlSecOpenSSLEvpPkeyCtxCacheEntryCreate(name, pKeyCtx);
+    if(entry == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLEvpPkeyCtxCacheEntryCreate", NULL);
+        EVP_PKEY_CTX_free(pKeyCtx);
+        return;
+    }
+
+    for(ii = 0; ii < XMLSEC_OPENSSL_EVP_PKEY_CTX_CACHE_SIZE; ++ii) {
+        cur = xmlSecAtomicPtrCompareExchange(&(ctx->pKeyCtxCache[ii]), NULL, entry);
+        if(cur == NULL) {
+            /* published */
+            return;
+        }
+        if(xmlStrEqual(cur->name, name) != 0) {
+            /* another thread added it already */
+            break;
+        }
+    }
+
+    /* the cache is full or has this context already */
+    xmlSecOpenSSLEvpPkeyCtxCacheEntryDestroy(entry);
+}
+
+/**
+ * @brief Gets a configured EVP_PKEY_CTX for the key.
+ * @details Returns a copy of the context cached in the key data under @p name or,
+ * if there is none, creates the context with @p createMethod and caches its copy.
+ * No lock is taken; the key data must not be modified while it is in use.
+ * The @p name must uniquely identify all the parameters that @p createMethod sets
+ * on the context (operation, padding, digest, salt length, ...).
+ * @param data the pointer to OpenSSL EVP key data.
+ * @param name the cached context name.
+ * @param createMethod the method to create and configure a new context for the key.
+ * @param context the @p createMethod context.
+ * @return the pointer to EVP_PKEY_CTX that must be freed by the caller with
+ * EVP_PKEY_CTX_free or NULL if an error occurs.
+ */
+EVP_PKEY_CTX*
+xmlSecOpenSSLEvpKeyDataGetPkeyCtx(xmlSecKeyDataPtr data, const xmlChar* name,
+                                  xmlSecOpenSSLEvpPkeyCtxCreateMethod createMethod, void* context) {
+    xmlSecOpenSSLEvpKeyDataCtxPtr ctx;
+    EVP_PKEY_CTX* pKeyCtx;
+    EVP_PKEY_CTX* pKeyCtxTemplate;
+
+    xmlSecAssert2(xmlSecKeyDataIsValid(data), NULL);
+    xmlSecAssert2(xmlSecKeyDataCheckSize(data, xmlSecOpenSSLEvpKeyDataSize), NULL);
+    xmlSecAssert2(name != NULL, NULL);
+    xmlSecAssert2(createMethod != NULL, NULL);
+
+    ctx = xmlSecOpenSSLEvpKeyDataGetCtx(data);
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(ctx->pKey != NULL, NULL);
+
+    pKeyCtxTemplate = xmlSecOpenSSLEvpKeyDataCtxFindCachedPkeyCtx(ctx, name);
+    if(pKeyCtxTemplate != NULL) {
+        pKeyCtx = EVP_PKEY_CTX_dup(pKeyCtxTemplate);
+        if(pKeyCtx != NULL) {
+            return(pKeyCtx);
+        }
+        /* fall back to a new context */
+        ERR_clear_error();
+    }
+
+    pKeyCtx = createMethod(ctx->pKey, context);
+    if(pKeyCtx == NULL) {
+        return(NULL);
+    }
+
+    /* not all the providers / engines support EVP_PKEY_CTX_dup(): just don't cache */
+    pKeyCtxTemplate = EVP_PKEY_CTX_dup(pKeyCtx);
+    if(pKeyCtxTemplate == NULL) {
+        ERR_clear_error();
+        return(pKeyCtx);
+    }
+
+    xmlSecOpenSSLEvpKeyDataCtxAddCachedPkeyCtx(ctx, name, pKeyCtxTemplate);
+
+    return(pKeyCtx);
+}
+
 #ifndef XMLSEC_OPENSSL_API_300
 static xmlSecSize
 xmlSecOpenSSLEvpKeyDataGetKeySize(xmlSecKeyDataPtr data) {
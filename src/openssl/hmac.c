@@ -29,12 +29,12 @@
 
 #ifdef XMLSEC_OPENSSL_API_300
 #include <openssl/core_names.h>
-#include <openssl/param_build.h>
 #endif /* XMLSEC_OPENSSL_API_300 */
 
 #include "../cast_helpers.h"
 #include "../keysdata_helpers.h"
 #include "../transform_helpers.h"
+#include "private.h"
 
 #ifndef XMLSEC_NO_HMAC
 
@@ -67,7 +67,6 @@ struct _xmlSecOpenSSLHmacCtx {
     HMAC_CTX*           hmacCtx;
 #else /* XMLSEC_OPENSSL_API_300 */
     const char*         evpHmacDgstName;
-    EVP_MAC*            evpHmac;
     EVP_MAC_CTX*        evpHmacCtx;
 #endif /* XMLSEC_OPENSSL_API_300 */
     int                 ctxInitialized;
@@ -230,19 +229,6 @@ xmlSecOpenSSLHmacInitialize(xmlSecTransformPtr transform) {
         xmlSecOpenSSLHmacFinalize(transform);
         return(-1);
     }
-#else /* XMLSEC_OPENSSL_API_300 */
-    ctx->evpHmac = EVP_MAC_fetch(xmlSecOpenSSLGetLibCtx(), OSSL_MAC_NAME_HMAC, NULL);
-    if (ctx->evpHmac == NULL) {
-        xmlSecOpenSSLError("EVP_MAC_fetch", xmlSecTransformGetName(transform));
-        xmlSecOpenSSLHmacFinalize(transform);
-        return(-1);
-    }
-    ctx->evpHmacCtx = EVP_MAC_CTX_new(ctx->evpHmac);
-    if (ctx->evpHmacCtx == NULL) {
-        xmlSecOpenSSLError("EVP_MAC_CTX_new", xmlSecTransformGetName(transform));
-        xmlSecOpenSSLHmacFinalize(transform);
-        return(-1);
-    }
 #endif /* XMLSEC_OPENSSL_API_300 */
 
     /* done */
@@ -267,9 +253,6 @@ xmlSecOpenSSLHmacFinalize(xmlSecTransformPtr transform) {
     if(ctx->evpHmacCtx != NULL) {
         EVP_MAC_CTX_free(ctx->evpHmacCtx);
     }
-    if (ctx->evpHmac != NULL) {
-        EVP_MAC_free(ctx->evpHmac);
-    }
 #endif /* XMLSEC_OPENSSL_API_300 */
 
     OPENSSL_cleanse(ctx, sizeof(xmlSecOpenSSLHmacCtx));
@@ -321,13 +304,22 @@ xmlSecOpenSSLHmacSetKeyReq(xmlSecTransformPtr transform,  xmlSecKeyReqPtr keyReq
 
 #ifndef XMLSEC_OPENSSL_API_300
 static int
-xmlSecOpenSSLHmacSetKeyImpl(xmlSecOpenSSLHmacCtxPtr ctx, const xmlSecByte* key, xmlSecSize keySize) {
+xmlSecOpenSSLHmacSetKeyImpl(xmlSecOpenSSLHmacCtxPtr ctx, xmlSecKeyDataPtr keyValue) {
+    xmlSecBufferPtr buffer;
+    const xmlSecByte* key;
+    xmlSecSize keySize;
     xmlSecOpenSSLSizeT keyLen;
     int ret;
 
     xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(ctx->hmacCtx != NULL, -1);
     xmlSecAssert2(ctx->hmacDgst != NULL, -1);
+    xmlSecAssert2(keyValue != NULL, -1);
+
+    buffer = xmlSecKeyDataBinaryValueGetBuffer(keyValue);
+    xmlSecAssert2(buffer != NULL, -1);
+    key = xmlSecBufferGetData(buffer);
+    keySize = xmlSecBufferGetSize(buffer);
     xmlSecAssert2(key != NULL, -1);
     xmlSecAssert2(keySize > 0, -1);
 
@@ -344,56 +336,22 @@ xmlSecOpenSSLHmacSetKeyImpl(xmlSecOpenSSLHmacCtxPtr ctx, const xmlSecByte* key,
 
 #else /* XMLSEC_OPENSSL_API_300 */
 
+/* the HMAC key data caches the contexts initialized with the key */
 static int
-xmlSecOpenSSLHmacSetKeyImpl(xmlSecOpenSSLHmacCtxPtr ctx, const xmlSecByte* key, xmlSecSize keySize) {
-    OSSL_PARAM_BLD* param_bld = NULL;
-    OSSL_PARAM* params = NULL;
-    int ret;
-    int res = -1;
-
+xmlSecOpenSSLHmacSetKeyImpl(xmlSecOpenSSLHmacCtxPtr ctx, xmlSecKeyDataPtr keyValue) {
     xmlSecAssert2(ctx != NULL, -1);
-    xmlSecAssert2(ctx->evpHmacCtx != NULL, -1);
+    xmlSecAssert2(ctx->evpHmacCtx == NULL, -1);
     xmlSecAssert2(ctx->evpHmacDgstName != NULL, -1);
-    xmlSecAssert2(key != NULL, -1);
-    xmlSecAssert2(keySize > 0, -1);
-
-    param_bld = OSSL_PARAM_BLD_new();
-    if (param_bld == NULL) {
-        xmlSecOpenSSLError("OSSL_PARAM_BLD_new", NULL);
-        goto done;
-    }
-
-    ret = OSSL_PARAM_BLD_push_utf8_string(param_bld, OSSL_MAC_PARAM_DIGEST,
-        ctx->evpHmacDgstName, strlen(ctx->evpHmacDgstName));
-    if(ret != 1) {
-        xmlSecOpenSSLError("OSSL_PARAM_BLD_push_utf8_string", NULL);
-        goto done;
-    }
-
-    params = OSSL_PARAM_BLD_to_param(param_bld);
-    if (params == NULL) {
-        xmlSecOpenSSLError("OSSL_PARAM_BLD_to_param", NULL);
-        goto done;
-    }
+    xmlSecAssert2(keyValue != NULL, -1);
 
-    ret = EVP_MAC_init(ctx->evpHmacCtx, key, keySize, params);
-    if (ret != 1) {
-        xmlSecOpenSSLError("EVP_MAC_init", NULL);
-        goto done;
+    ctx->evpHmacCtx = xmlSecOpenSSLKeyDataHmacGetMacCtx(keyValue, ctx->evpHmacDgstName);
+    if (ctx->evpHmacCtx == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLKeyDataHmacGetMacCtx", NULL);
+        return(-1);
     }
 
     /* success */
-    res = 0;
-
-done:
-    if(params != NULL) {
-        OSSL_PARAM_free(params);
-    }
-    if(param_bld != NULL) {
-        OSSL_PARAM_BLD_free(param_bld);
-    }
-    return(res);
-
+    return(0);
 }
 
 #endif /* XMLSEC_OPENSSL_API_300 */
@@ -426,7 +384,7 @@ xmlSecOpenSSLHmacSetKey(xmlSecTransformPtr transform, xmlSecKeyPtr key) {
     }
     xmlSecAssert2(xmlSecBufferGetData(buffer) != NULL, -1);
 
-    ret = xmlSecOpenSSLHmacSetKeyImpl(ctx, xmlSecBufferGetData(buffer), xmlSecBufferGetSize(buffer));
+    ret = xmlSecOpenSSLHmacSetKeyImpl(ctx, value);
     if(ret < 0) {
         xmlSecInternalError("xmlSecOpenSSLHmacSetKeyImpl", xmlSecTransformGetName(transform));
        return(-1);
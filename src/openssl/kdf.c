@@ -29,6 +29,7 @@
 #include "../cast_helpers.h"
 #include "../keysdata_helpers.h"
 #include "../transform_helpers.h"
+#include "private.h"
 
 /* KDF is only supported in OpenSSL 3.0.0+ */
 #if defined(XMLSEC_OPENSSL_API_300)
@@ -156,9 +157,9 @@ xmlSecOpenSSLKdfInitialize(xmlSecTransformPtr transform) {
 
     /* create EVP KDF context */
     xmlSecAssert2(ctx->kdfName != NULL, -1);
-    kdf = EVP_KDF_fetch(NULL, ctx->kdfName, NULL);
+    kdf = xmlSecOpenSSLFetchKdf(ctx->kdfName, NULL);
     if(kdf == NULL) {
-        xmlSecOpenSSLError2("EVP_KDF_fetch", NULL, "kdf=%s", xmlSecErrorsSafeString(ctx->kdfName));
+        xmlSecOpenSSLError2("xmlSecOpenSSLFetchKdf", NULL, "kdf=%s", xmlSecErrorsSafeString(ctx->kdfName));
         xmlSecOpenSSLKdfFinalize(transform);
         return(-1);
     }
@@ -118,14 +118,15 @@ xmlSecOpenSSLTransformRsaPkcs1GetKlass(void) {
 #if !defined(XMLSEC_OPENSSL_API_300)
 
 static int
-xmlSecOpenSSLRsaPkcs1SetKeyImpl(xmlSecOpenSSLRsaPkcs1CtxPtr ctx, EVP_PKEY* pKey,
-                                int encrypt XMLSEC_ATTRIBUTE_UNUSED) {
+xmlSecOpenSSLRsaPkcs1SetKeyImpl(xmlSecOpenSSLRsaPkcs1CtxPtr ctx, xmlSecKeyDataPtr keyValue XMLSEC_ATTRIBUTE_UNUSED,
+                                EVP_PKEY* pKey, int encrypt XMLSEC_ATTRIBUTE_UNUSED) {
     RSA *rsa = NULL;
     xmlSecOpenSSLSizeT keyLen;
 
     xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(ctx->pKey == NULL, -1);
     xmlSecAssert2(pKey != NULL, -1);
+    UNREFERENCED_PARAMETER(keyValue);
     UNREFERENCED_PARAMETER(encrypt);
 
     rsa = EVP_PKEY_get0_RSA(pKey);
@@ -191,52 +192,72 @@ xmlSecOpenSSLRsaPkcs1ProcessImpl(xmlSecOpenSSLRsaPkcs1CtxPtr ctx, const xmlSecBy
 
 #else /* !defined(XMLSEC_OPENSSL_API_300) */
 
-static int
-xmlSecOpenSSLRsaPkcs1SetKeyImpl(xmlSecOpenSSLRsaPkcs1CtxPtr ctx, EVP_PKEY* pKey,
-                                int encrypt) {
-    int keyLen;
+static EVP_PKEY_CTX*
+xmlSecOpenSSLRsaPkcs1CreatePkeyCtx(EVP_PKEY* pKey, void* context) {
+    EVP_PKEY_CTX* pKeyCtx;
+    int encrypt;
     int ret;
 
-    xmlSecAssert2(ctx != NULL, -1);
-    xmlSecAssert2(ctx->pKeyCtx == NULL, -1);
-    xmlSecAssert2(pKey != NULL, -1);
+    xmlSecAssert2(pKey != NULL, NULL);
+    xmlSecAssert2(context != NULL, NULL);
 
-    keyLen = EVP_PKEY_get_size(pKey);
-    if(keyLen <= 0) {
-        xmlSecOpenSSLError("EVP_PKEY_get_size", NULL);
-        return (-1);
-    }
-    XMLSEC_SAFE_CAST_INT_TO_SIZE(keyLen, ctx->keySize, return(-1), NULL);
+    encrypt = *((int*)context);
 
-    ctx->pKeyCtx = EVP_PKEY_CTX_new_from_pkey(xmlSecOpenSSLGetLibCtx(), pKey, NULL);
-    if (ctx->pKeyCtx == NULL) {
+    pKeyCtx = EVP_PKEY_CTX_new_from_pkey(xmlSecOpenSSLGetLibCtx(), pKey, NULL);
+    if (pKeyCtx == NULL) {
         xmlSecOpenSSLError("EVP_PKEY_CTX_new_from_pkey", NULL);
-        return (-1);
+        return (NULL);
     }
 
     if (encrypt != 0) {
-        ret = EVP_PKEY_encrypt_init(ctx->pKeyCtx);
+        ret = EVP_PKEY_encrypt_init(pKeyCtx);
         if (ret <= 0) {
             xmlSecOpenSSLError("EVP_PKEY_encrypt_init", NULL);
-            EVP_PKEY_CTX_free(ctx->pKeyCtx);
-            ctx->pKeyCtx = NULL;
-            return (-1);
+            EVP_PKEY_CTX_free(pKeyCtx);
+            return (NULL);
         }
     } else {
-        ret = EVP_PKEY_decrypt_init(ctx->pKeyCtx);
+        ret = EVP_PKEY_decrypt_init(pKeyCtx);
         if (ret <= 0) {
             xmlSecOpenSSLError("EVP_PKEY_decrypt_init", NULL);
-            EVP_PKEY_CTX_free(ctx->pKeyCtx);
-            ctx->pKeyCtx = NULL;
-            return (-1);
+            EVP_PKEY_CTX_free(pKeyCtx);
+            return (NULL);
         }
     }
 
-    ret = EVP_PKEY_CTX_set_rsa_padding(ctx->pKeyCtx, RSA_PKCS1_PADDING);
+    ret = EVP_PKEY_CTX_set_rsa_padding(pKeyCtx, RSA_PKCS1_PADDING);
     if (ret <= 0) {
         xmlSecOpenSSLError("EVP_PKEY_CTX_set_rsa_padding", NULL);
-        EVP_PKEY_CTX_free(ctx->pKeyCtx);
-        ctx->pKeyCtx = NULL;
+        EVP_PKEY_CTX_free(pKeyCtx);
+        return (NULL);
+    }
+
+    /* success */
+    return(pKeyCtx);
+}
+
+static int
+xmlSecOpenSSLRsaPkcs1SetKeyImpl(xmlSecOpenSSLRsaPkcs1CtxPtr ctx, xmlSecKeyDataPtr keyValue,
+                                EVP_PKEY* pKey, int encrypt) {
+    int keyLen;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->pKeyCtx == NULL, -1);
+    xmlSecAssert2(keyValue != NULL, -1);
+    xmlSecAssert2(pKey != NULL, -1);
+
+    keyLen = EVP_PKEY_get_size(pKey);
+    if(keyLen <= 0) {
+        xmlSecOpenSSLError("EVP_PKEY_get_size", NULL);
+        return (-1);
+    }
+    XMLSEC_SAFE_CAST_INT_TO_SIZE(keyLen, ctx->keySize, return(-1), NULL);
+
+    ctx->pKeyCtx = xmlSecOpenSSLEvpKeyDataGetPkeyCtx(keyValue,
+        (encrypt != 0) ? BAD_CAST "rsa-1_5-encrypt" : BAD_CAST "rsa-1_5-decrypt",
+        xmlSecOpenSSLRsaPkcs1CreatePkeyCtx, &encrypt);
+    if (ctx->pKeyCtx == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLEvpKeyDataGetPkeyCtx", NULL);
         return (-1);
     }
 
@@ -379,7 +400,7 @@ xmlSecOpenSSLRsaPkcs1SetKey(xmlSecTransformPtr transform, xmlSecKeyPtr key) {
         return(-1);
     }
 
-    ret = xmlSecOpenSSLRsaPkcs1SetKeyImpl(ctx, pKey, encrypt);
+    ret = xmlSecOpenSSLRsaPkcs1SetKeyImpl(ctx, xmlSecKeyGetValue(key), pKey, encrypt);
     if(ret < 0) {
         xmlSecInternalError("xmlSecOpenSSLRsaPkcs1SetKeyImpl",
             xmlSecTransformGetName(transform));
@@ -530,7 +551,6 @@ struct _xmlSecOpenSSLRsaOaepCtx {
     EVP_PKEY_CTX*       pKeyCtx;
     const char*         mdName;
     const char*         mgf1mdName;
-    int                 paramsInitialized;
 #endif /* XMLSEC_OPENSSL_API_300 */
     xmlSecSize          keySize;
     xmlSecBuffer        oaepParams;
@@ -649,14 +669,15 @@ xmlSecOpenSSLRsaOaepCheckId(xmlSecTransformPtr transform) {
 #ifndef XMLSEC_OPENSSL_API_300
 
 static int
-xmlSecOpenSSLRsaOaepSetKeyImpl(xmlSecOpenSSLRsaOaepCtxPtr ctx, EVP_PKEY* pKey,
-                            int encrypt XMLSEC_ATTRIBUTE_UNUSED) {
+xmlSecOpenSSLRsaOaepSetKeyImpl(xmlSecOpenSSLRsaOaepCtxPtr ctx, xmlSecKeyDataPtr keyValue XMLSEC_ATTRIBUTE_UNUSED,
+                            EVP_PKEY* pKey, int encrypt XMLSEC_ATTRIBUTE_UNUSED) {
     RSA *rsa = NULL;
     int keyLen;
 
     xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(ctx->pKey == NULL, -1);
     xmlSecAssert2(pKey != NULL, -1);
+    UNREFERENCED_PARAMETER(keyValue);
     UNREFERENCED_PARAMETER(encrypt);
 
     rsa = EVP_PKEY_get0_RSA(pKey);
@@ -805,77 +826,23 @@ xmlSecOpenSSLRsaOaepProcessImpl(xmlSecOpenSSLRsaOaepCtxPtr ctx, const xmlSecByte
 
 #else /* XMLSEC_OPENSSL_API_300 */
 
-static int
-xmlSecOpenSSLRsaOaepSetKeyImpl(xmlSecOpenSSLRsaOaepCtxPtr ctx, EVP_PKEY* pKey,
-                            int encrypt) {
-    int keyLen;
-    int ret;
-
-    xmlSecAssert2(ctx != NULL, -1);
-    xmlSecAssert2(ctx->pKeyCtx == NULL, -1);
-    xmlSecAssert2(pKey != NULL, -1);
-
-    keyLen = EVP_PKEY_get_size(pKey);
-    if(keyLen <= 0) {
-        xmlSecOpenSSLError("EVP_PKEY_get_size", NULL);
-        return (-1);
-    }
-    XMLSEC_SAFE_CAST_INT_TO_SIZE(keyLen, ctx->keySize, return(-1), NULL);
-
-    ctx->pKeyCtx = EVP_PKEY_CTX_new_from_pkey(xmlSecOpenSSLGetLibCtx(), pKey, NULL);
-    if (ctx->pKeyCtx == NULL) {
-        xmlSecOpenSSLError("EVP_PKEY_CTX_new_from_pkey", NULL);
-        return (-1);
-    }
-
-    if (encrypt != 0) {
-        ret = EVP_PKEY_encrypt_init(ctx->pKeyCtx);
-        if (ret <= 0) {
-            xmlSecOpenSSLError("EVP_PKEY_encrypt_init", NULL);
-            EVP_PKEY_CTX_free(ctx->pKeyCtx);
-            ctx->pKeyCtx = NULL;
-            return (-1);
-        }
-    } else {
-        ret = EVP_PKEY_decrypt_init(ctx->pKeyCtx);
-        if (ret <= 0) {
-            xmlSecOpenSSLError("EVP_PKEY_decrypt_init", NULL);
-            EVP_PKEY_CTX_free(ctx->pKeyCtx);
-            ctx->pKeyCtx = NULL;
-            return (-1);
-        }
-    }
-
-    ret = EVP_PKEY_CTX_set_rsa_padding(ctx->pKeyCtx, RSA_PKCS1_OAEP_PADDING);
-    if (ret <= 0) {
-         xmlSecOpenSSLError("EVP_PKEY_CTX_set_rsa_padding", NULL);
-        EVP_PKEY_CTX_free(ctx->pKeyCtx);
-        ctx->pKeyCtx = NULL;
-        return(-1);
-    }
-
-    /* success */
-    return(0);
-}
+typedef struct _xmlSecOpenSSLRsaOaepPkeyCtxParams {
+    xmlSecOpenSSLRsaOaepCtxPtr  ctx;
+    int                         encrypt;
+} xmlSecOpenSSLRsaOaepPkeyCtxParams;
 
 // We can put all the params into one OSSL_PARAM array and setup everything at-once.
 // However, in OpenSSL <= 3.0.7 there is a bug that mixes OAEP digest and
 // OAEP MGF1 digest (https://pullanswer.com/questions/mgf1-digest-not-set-correctly-when-configuring-rsa-evp_pkey_ctx-with-ossl_params)
 // so we do one param at a time.
 static int
-xmlSecOpenSSLRsaOaepSetParamsIfNeeded(xmlSecOpenSSLRsaOaepCtxPtr ctx) {
+xmlSecOpenSSLRsaOaepSetParams(xmlSecOpenSSLRsaOaepCtxPtr ctx, EVP_PKEY_CTX* pKeyCtx) {
     xmlSecByte* label;
     xmlSecSize labelSize;
     int ret;
-    int res = -1;
 
     xmlSecAssert2(ctx != NULL, -1);
-    xmlSecAssert2(ctx->pKeyCtx != NULL, -1);
-
-    /* check if we already initialized oaep params */
-    if(ctx->paramsInitialized != 0) {
-        return(0);
-    }
+    xmlSecAssert2(pKeyCtx != NULL, -1);
 
     /* OAEP label */
     label = xmlSecBufferGetData(&(ctx->oaepParams));
@@ -885,10 +852,10 @@ xmlSecOpenSSLRsaOaepSetParamsIfNeeded(xmlSecOpenSSLRsaOaepCtxPtr ctx) {
         params[0] = OSSL_PARAM_construct_octet_string(OSSL_ASYM_CIPHER_PARAM_OAEP_LABEL, label, labelSize);
         params[1] = OSSL_PARAM_construct_end();
 
-        ret = EVP_PKEY_CTX_set_params(ctx->pKeyCtx, params);
+        ret = EVP_PKEY_CTX_set_params(pKeyCtx, params);
         if(ret <= 0) {
             xmlSecOpenSSLError("EVP_PKEY_CTX_set_params", NULL);
-            goto done;
+            return(-1);
         }
     }
 
@@ -898,10 +865,10 @@ xmlSecOpenSSLRsaOaepSetParamsIfNeeded(xmlSecOpenSSLRsaOaepCtxPtr ctx) {
         params[0] = OSSL_PARAM_construct_utf8_string(OSSL_ASYM_CIPHER_PARAM_OAEP_DIGEST, (char*)ctx->mdName, 0);
         params[1] = OSSL_PARAM_construct_end();
 
-        ret = EVP_PKEY_CTX_set_params(ctx->pKeyCtx, params);
+        ret = EVP_PKEY_CTX_set_params(pKeyCtx, params);
         if(ret <= 0) {
             xmlSecOpenSSLError("EVP_PKEY_CTX_set_params", NULL);
-            goto done;
+            return(-1);
         }
     }
 
@@ -911,19 +878,120 @@ xmlSecOpenSSLRsaOaepSetParamsIfNeeded(xmlSecOpenSSLRsaOaepCtxPtr ctx) {
         params[0] = OSSL_PARAM_construct_utf8_string(OSSL_ASYM_CIPHER_PARAM_MGF1_DIGEST, (char*)ctx->mgf1mdName, 0);
         params[1] = OSSL_PARAM_construct_end();
 
-        ret = EVP_PKEY_CTX_set_params(ctx->pKeyCtx, params);
+        ret = EVP_PKEY_CTX_set_params(pKeyCtx, params);
         if(ret <= 0) {
             xmlSecOpenSSLError("EVP_PKEY_CTX_set_params", NULL);
-            goto done;
+            return(-1);
         }
     }
 
     /* success */
-    ctx->paramsInitialized = 1;
-    res = 0;
+    return(0);
+}
+
+static EVP_PKEY_CTX*
+xmlSecOpenSSLRsaOaepCreatePkeyCtx(EVP_PKEY* pKey, void* context) {
+    xmlSecOpenSSLRsaOaepPkeyCtxParams* pKeyCtxParams;
+    EVP_PKEY_CTX* pKeyCtx;
+    int ret;
+
+    xmlSecAssert2(pKey != NULL, NULL);
+    xmlSecAssert2(context != NULL, NULL);
+
+    pKeyCtxParams = (xmlSecOpenSSLRsaOaepPkeyCtxParams*)context;
+    xmlSecAssert2(pKeyCtxParams->ctx != NULL, NULL);
 
-done:
-    return(res);
+    pKeyCtx = EVP_PKEY_CTX_new_from_pkey(xmlSecOpenSSLGetLibCtx(), pKey, NULL);
+    if (pKeyCtx == NULL) {
+        xmlSecOpenSSLError("EVP_PKEY_CTX_new_from_pkey", NULL);
+        return (NULL);
+    }
+
+    if (pKeyCtxParams->encrypt != 0) {
+        ret = EVP_PKEY_encrypt_init(pKeyCtx);
+        if (ret <= 0) {
+            xmlSecOpenSSLError("EVP_PKEY_encrypt_init", NULL);
+            EVP_PKEY_CTX_free(pKeyCtx);
+            return (NULL);
+        }
+    } else {
+        ret = EVP_PKEY_decrypt_init(pKeyCtx);
+        if (ret <= 0) {
+            xmlSecOpenSSLError("EVP_PKEY_decrypt_init", NULL);
+            EVP_PKEY_CTX_free(pKeyCtx);
+            return (NULL);
+        }
+    }
+
+    ret = EVP_PKEY_CTX_set_rsa_padding(pKeyCtx, RSA_PKCS1_OAEP_PADDING);
+    if (ret <= 0) {
+        xmlSecOpenSSLError("EVP_PKEY_CTX_set_rsa_padding", NULL);
+        EVP_PKEY_CTX_free(pKeyCtx);
+        return(NULL);
+    }
+
+    ret = xmlSecOpenSSLRsaOaepSetParams(pKeyCtxParams->ctx, pKeyCtx);
+    if (ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLRsaOaepSetParams", NULL);
+        EVP_PKEY_CTX_free(pKeyCtx);
+        return(NULL);
+    }
+
+    /* success */
+    return(pKeyCtx);
+}
+
+/* the OAEP params are read from the transform node before the key is set */
+static int
+xmlSecOpenSSLRsaOaepSetKeyImpl(xmlSecOpenSSLRsaOaepCtxPtr ctx, xmlSecKeyDataPtr keyValue,
+                            EVP_PKEY* pKey, int encrypt) {
+    xmlSecOpenSSLRsaOaepPkeyCtxParams pKeyCtxParams;
+    int keyLen;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->pKeyCtx == NULL, -1);
+    xmlSecAssert2(keyValue != NULL, -1);
+    xmlSecAssert2(pKey != NULL, -1);
+
+    keyLen = EVP_PKEY_get_size(pKey);
+    if(keyLen <= 0) {
+        xmlSecOpenSSLError("EVP_PKEY_get_size", NULL);
+        return (-1);
+    }
+    XMLSEC_SAFE_CAST_INT_TO_SIZE(keyLen, ctx->keySize, return(-1), NULL);
+
+    pKeyCtxParams.ctx = ctx;
+    pKeyCtxParams.encrypt = encrypt;
+
+    /* OAEP label is arbitrary data: don't cache these contexts */
+    if(xmlSecBufferGetSize(&(ctx->oaepParams)) == 0) {
+        xmlChar name[128];
+        int ret;
+
+        ret = xmlStrPrintf(name, sizeof(name), "rsa-oaep-%s-%s-%s",
+            (encrypt != 0) ? "encrypt" : "decrypt",
+            xmlSecErrorsSafeString(ctx->mdName),
+            xmlSecErrorsSafeString(ctx->mgf1mdName));
+        if(ret < 0) {
+            xmlSecXmlError("xmlStrPrintf", NULL);
+            return(-1);
+        }
+        ctx->pKeyCtx = xmlSecOpenSSLEvpKeyDataGetPkeyCtx(keyValue, name,
+            xmlSecOpenSSLRsaOaepCreatePkeyCtx, &pKeyCtxParams);
+        if (ctx->pKeyCtx == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLEvpKeyDataGetPkeyCtx", NULL);
+            return (-1);
+        }
+    } else {
+        ctx->pKeyCtx = xmlSecOpenSSLRsaOaepCreatePkeyCtx(pKey, &pKeyCtxParams);
+        if (ctx->pKeyCtx == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLRsaOaepCreatePkeyCtx", NULL);
+            return (-1);
+        }
+    }
+
+    /* success */
+    return(0);
 }
 
 static int
@@ -939,12 +1007,6 @@ xmlSecOpenSSLRsaOaepProcessImpl(xmlSecOpenSSLRsaOaepCtxPtr ctx, const xmlSecByte
     xmlSecAssert2(outBuf != NULL, -1);
     xmlSecAssert2(outSize != NULL, -1);
 
-    ret = xmlSecOpenSSLRsaOaepSetParamsIfNeeded(ctx);
-    if(ret != 0) {
-        xmlSecInternalError("xmlSecOpenSSLRsaOaepSetParamsIfNeeded", NULL);
-        return(-1);
-    }
-
     outSizeT = (*outSize);
     if(encrypt != 0) {
         ret = EVP_PKEY_encrypt(ctx->pKeyCtx, outBuf, &outSizeT, inBuf, inSize);
@@ -1244,7 +1306,7 @@ xmlSecOpenSSLRsaOaepSetKey(xmlSecTransformPtr transform, xmlSecKeyPtr key) {
         return(-1);
     }
 
-    ret = xmlSecOpenSSLRsaOaepSetKeyImpl(ctx, pKey, encrypt);
+    ret = xmlSecOpenSSLRsaOaepSetKeyImpl(ctx, xmlSecKeyGetValue(key), pKey, encrypt);
     if(ret < 0) {
         xmlSecInternalError("xmlSecOpenSSLRsaOaepSetKeyImpl",
             xmlSecTransformGetName(transform));
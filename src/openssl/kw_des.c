@@ -30,6 +30,7 @@
 #include "../kw_helpers.h"
 #include "../cast_helpers.h"
 #include "openssl_compat.h"
+#include "private.h"
 
 #ifdef XMLSEC_OPENSSL_API_300
 #include <openssl/core_names.h>
@@ -444,9 +445,9 @@ xmlSecOpenSSLKWDes3Encrypt(const xmlSecByte* key, xmlSecSize keySize,
         goto done;
     }
 #else /* XMLSEC_OPENSSL_API_300 */
-    cipher = EVP_CIPHER_fetch(xmlSecOpenSSLGetLibCtx(), XMLSEC_OPENSSL_CIPHER_NAME_DES3_EDE, NULL);
+    cipher = xmlSecOpenSSLFetchCipher(XMLSEC_OPENSSL_CIPHER_NAME_DES3_EDE, NULL);
     if(cipher == NULL) {
-        xmlSecOpenSSLError("EVP_CIPHER_fetch(des3)", NULL);
+        xmlSecOpenSSLError("xmlSecOpenSSLFetchCipher(des3)", NULL);
         goto done;
     }
 #endif /* XMLSEC_OPENSSL_API_300 */
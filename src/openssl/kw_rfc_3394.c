@@ -28,6 +28,7 @@
 #include "../kw_helpers.h"
 #include "../cast_helpers.h"
 #include "openssl_compat.h"
+#include "private.h"
 
 
 #ifndef XMLSEC_NO_AES
@@ -284,9 +285,9 @@ xmlSecOpenSSLKWRfc3394Initialize(xmlSecTransformPtr transform) {
 #ifdef XMLSEC_OPENSSL_API_300
     /* fetch cipher */
     xmlSecAssert2(ctx->cipherName != NULL, -1);
-    ctx->cipher = EVP_CIPHER_fetch(xmlSecOpenSSLGetLibCtx(), ctx->cipherName, NULL);
+    ctx->cipher = xmlSecOpenSSLFetchCipher(ctx->cipherName, NULL);
     if(ctx->cipher == NULL) {
-        xmlSecOpenSSLError2("EVP_CIPHER_fetch", xmlSecTransformGetName(transform),
+        xmlSecOpenSSLError2("xmlSecOpenSSLFetchCipher", xmlSecTransformGetName(transform),
             "cipherName=%s", xmlSecErrorsSafeString(ctx->cipherName));
         xmlSecOpenSSLKWRfc3394Finalize(transform);
         return(-1);
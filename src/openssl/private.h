@@ -46,8 +46,8 @@ int             xmlSecOpenSSLKeyValueRsaCheckKeyType            (EVP_PKEY* pKey)
 #ifndef XMLSEC_NO_X509
 
 typedef struct _xmlSecOpenSSLX509FindCertCtx {
-    X509_NAME * subjectName;
-    X509_NAME * issuerName;
+    xmlChar * subjectNameKey;       /* canonical name key, see xmlSecOpenSSLX509NamesCacheInit() */
+    xmlChar * issuerNameKey;        /* canonical name key, see xmlSecOpenSSLX509NamesCacheInit() */
     ASN1_INTEGER * issuerSerial;
     ASN1_OCTET_STRING * ski;
 
@@ -94,8 +94,62 @@ void            xmlSecOpenSSLX509NameToString                   (XMLSEC_OPENSSL4
 STACK_OF(X509)*        xmlSecOpenSSLKeyDataX509GetCerts         (xmlSecKeyDataPtr data);
 STACK_OF(X509_CRL)*    xmlSecOpenSSLKeyDataX509GetCrls          (xmlSecKeyDataPtr data);
 
+int             xmlSecOpenSSLX509CertsCacheInit                 (void);
+void            xmlSecOpenSSLX509CertsCacheShutdown             (void);
+int             xmlSecOpenSSLX509NamesCacheInit                 (void);
+void            xmlSecOpenSSLX509NamesCacheShutdown             (void);
+
 #endif /* XMLSEC_NO_X509 */
 
+/******************************************************************************
+ *
+ * Per-key EVP_PKEY_CTX cache
+ *
+  *****************************************************************************/
+typedef EVP_PKEY_CTX*  (*xmlSecOpenSSLEvpPkeyCtxCreateMethod)          (EVP_PKEY* pKey,
+                                                                 void* context);
+
+EVP_PKEY_CTX*   xmlSecOpenSSLEvpKeyDataGetPkeyCtx               (xmlSecKeyDataPtr data,
+                                                                 const xmlChar* name,
+                                                                 xmlSecOpenSSLEvpPkeyCtxCreateMethod createMethod,
+                                                                 void* context);
+
+/******************************************************************************
+ *
+ * HMAC keys contexts cache
+ *
+  *****************************************************************************/
+#if !defined(XMLSEC_NO_HMAC) && defined(XMLSEC_OPENSSL_API_300)
+
+EVP_MAC_CTX*    xmlSecOpenSSLKeyDataHmacGetMacCtx               (xmlSecKeyDataPtr data,
+                                                                 const char* digestName);
+
+#endif /* !defined(XMLSEC_NO_HMAC) && defined(XMLSEC_OPENSSL_API_300) */
+
+/******************************************************************************
+ *
+ * Fetched algorithms cache
+ *
+  *****************************************************************************/
+#ifdef XMLSEC_OPENSSL_API_300
+
+int             xmlSecOpenSSLFetchCacheInit                     (void);
+void            xmlSecOpenSSLFetchCacheShutdown                 (void);
+void            xmlSecOpenSSLFetchCacheFlush                    (void);
+
+EVP_MD*         xmlSecOpenSSLFetchDigest                        (const char* name,
+                                                                 const char* properties);
+EVP_CIPHER*     xmlSecOpenSSLFetchCipher                        (const char* name,
+                                                                 const char* properties);
+EVP_MAC*        xmlSecOpenSSLFetchMac                           (const char* name,
+                                                                 const char* properties);
+EVP_KDF*        xmlSecOpenSSLFetchKdf                           (const char* name,
+                                                                 const char* properties);
+EVP_SIGNATURE*  xmlSecOpenSSLFetchSignature                     (const char* name,
+                                                                 const char* properties);
+
+#endif /* XMLSEC_OPENSSL_API_300 */
+
 /******************************************************************************
  *
  * EVP Util functions
@@ -76,6 +76,7 @@ struct _xmlSecOpenSSLEvpSignatureCtx {
     /* key  */
     xmlSecKeyDataId     keyId;
     EVP_PKEY*           pKey;
+    EVP_PKEY_CTX*       pKeyCtx;
     xmlSecSize          keySizeBits;
 
     /* digest (if any) */
@@ -135,6 +136,8 @@ static int      xmlSecOpenSSLEvpSignatureSetKeyReq              (xmlSecTransform
                                                                  xmlSecKeyReqPtr keyReq);
 static int      xmlSecOpenSSLEvpSignatureSetKey                 (xmlSecTransformPtr transform,
                                                                  xmlSecKeyPtr key);
+static EVP_PKEY_CTX* xmlSecOpenSSLEvpSignatureCreatePkeyCtxCallback(EVP_PKEY* pKey,
+                                                                 void* context);
 static int      xmlSecOpenSSLEvpSignatureVerify                 (xmlSecTransformPtr transform,
                                                                  const xmlSecByte* data,
                                                                  xmlSecSize dataSize,
@@ -142,6 +145,11 @@ static int      xmlSecOpenSSLEvpSignatureVerify                 (xmlSecTransform
 static int      xmlSecOpenSSLEvpSignatureExecute                (xmlSecTransformPtr transform,
                                                                  int last,
                                                                  xmlSecTransformCtxPtr transformCtx);
+static int      xmlSecOpenSSLEvpSignaturePushBin                (xmlSecTransformPtr transform,
+                                                                 const xmlSecByte* data,
+                                                                 xmlSecSize dataSize,
+                                                                 int final,
+                                                                 xmlSecTransformCtxPtr transformCtx);
 
 
 /* Helper macros to define the transform klass */
@@ -161,7 +169,7 @@ static xmlSecTransformKlass xmlSecOpenSSL ## name ## Klass = {
     xmlSecOpenSSLEvpSignatureSetKey,            /* xmlSecTransformSetKeyMethod setKey; */               \
     xmlSecOpenSSLEvpSignatureVerify,            /* xmlSecTransformVerifyMethod verify; */               \
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */     \
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */             \
+    xmlSecOpenSSLEvpSignaturePushBin,           /* xmlSecTransformPushBinMethod pushBin; */             \
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */               \
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */             \
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */               \
@@ -463,9 +471,9 @@ xmlSecOpenSSLEvpSignatureSetByName(xmlSecOpenSSLEvpSignatureCtxPtr ctx, const ch
     xmlSecAssert2(ctx->digest == NULL, -1);
     xmlSecAssert2(digestName != NULL, -1);
 
-    ctx->digest = EVP_MD_fetch(xmlSecOpenSSLGetLibCtx(), digestName, NULL);
+    ctx->digest = xmlSecOpenSSLFetchDigest(digestName, NULL);
     if(ctx->digest == NULL) {
-        xmlSecOpenSSLError2("EVP_MD_fetch", NULL, "digestName=%s", xmlSecErrorsSafeString(digestName));
+        xmlSecOpenSSLError2("xmlSecOpenSSLFetchDigest", NULL, "digestName=%s", xmlSecErrorsSafeString(digestName));
         return(-1);
     }
     ctx->digestNeedsToBeFreed = 1;
@@ -945,6 +953,9 @@ xmlSecOpenSSLEvpSignatureFinalize(xmlSecTransformPtr transform) {
     ctx = xmlSecOpenSSLEvpSignatureGetCtx(transform);
     xmlSecAssert(ctx != NULL);
 
+    if(ctx->pKeyCtx != NULL) {
+        EVP_PKEY_CTX_free(ctx->pKeyCtx);
+    }
     if(ctx->pKey != NULL) {
         EVP_PKEY_free(ctx->pKey);
     }
@@ -1008,6 +1019,30 @@ xmlSecOpenSSLEvpSignatureSetKey(xmlSecTransformPtr transform, xmlSecKeyPtr key)
         return(-1);
     }
 
+    /* the digest based signatures are fully defined by the transform klass and the key:
+     * get the configured context from the key's cache */
+    if(ctx->pKeyCtx != NULL) {
+        EVP_PKEY_CTX_free(ctx->pKeyCtx);
+        ctx->pKeyCtx = NULL;
+    }
+    if(ctx->digest != NULL) {
+        xmlChar name[128];
+        int ret;
+
+        ret = xmlStrPrintf(name, sizeof(name), "%s-%s", xmlSecTransformGetName(transform),
+            (transform->operation == xmlSecTransformOperationSign) ? "sign" : "verify");
+        if(ret < 0) {
+            xmlSecXmlError("xmlStrPrintf", xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        ctx->pKeyCtx = xmlSecOpenSSLEvpKeyDataGetPkeyCtx(xmlSecKeyGetValue(key), name,
+            xmlSecOpenSSLEvpSignatureCreatePkeyCtxCallback, transform);
+        if(ctx->pKeyCtx == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLEvpKeyDataGetPkeyCtx", xmlSecTransformGetName(transform));
+            return(-1);
+        }
+    }
+
     return(0);
 }
 
@@ -1102,9 +1137,9 @@ xmlSecOpenSSLEvpSignatureCreatePkeyCtx(xmlSecTransformPtr transform, xmlSecOpenS
         /* Fetch the signature implementation from the key's owning provider.
          * Otherwise, pass NULL to EVP_SIGNATURE_fetch to use the default provider. */
         providerQuery = xmlSecOpenSslEvpGetProviderQuery(pKeyCtx, providerQueryBuffer, sizeof(providerQueryBuffer));
-        sigAlg = EVP_SIGNATURE_fetch(xmlSecOpenSSLGetLibCtx(), ctx->signatureName, (const char*)providerQuery);
+        sigAlg = xmlSecOpenSSLFetchSignature(ctx->signatureName, (const char*)providerQuery);
         if(sigAlg == NULL) {
-            xmlSecOpenSSLError2("EVP_SIGNATURE_fetch", xmlSecTransformGetName(transform),
+            xmlSecOpenSSLError2("xmlSecOpenSSLFetchSignature", xmlSecTransformGetName(transform),
                 "name=%s", xmlSecErrorsSafeString(ctx->signatureName));
             goto error;
         }
@@ -1169,6 +1204,36 @@ error:
     return(NULL);
 }
 
+static EVP_PKEY_CTX*
+xmlSecOpenSSLEvpSignatureCreatePkeyCtxCallback(EVP_PKEY* pKey, void* context) {
+    xmlSecTransformPtr transform = (xmlSecTransformPtr)context;
+    xmlSecOpenSSLEvpSignatureCtxPtr ctx;
+
+    xmlSecAssert2(pKey != NULL, NULL);
+    xmlSecAssert2(xmlSecOpenSSLEvpSignatureCheckId(transform), NULL);
+
+    ctx = xmlSecOpenSSLEvpSignatureGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(ctx->pKey == pKey, NULL);
+
+    return(xmlSecOpenSSLEvpSignatureCreatePkeyCtx(transform, ctx));
+}
+
+/* returns the context prepared in SetKey (if any) or creates a new one */
+static EVP_PKEY_CTX*
+xmlSecOpenSSLEvpSignatureGetPkeyCtx(xmlSecTransformPtr transform, xmlSecOpenSSLEvpSignatureCtxPtr ctx) {
+    EVP_PKEY_CTX *pKeyCtx;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+
+    if(ctx->pKeyCtx != NULL) {
+        pKeyCtx = ctx->pKeyCtx;
+        ctx->pKeyCtx = NULL;
+        return(pKeyCtx);
+    }
+    return(xmlSecOpenSSLEvpSignatureCreatePkeyCtx(transform, ctx));
+}
+
 static int
 xmlSecOpenSSLEvpSignatureVerify(xmlSecTransformPtr transform,
                         const xmlSecByte* data, xmlSecSize dataSize,
@@ -1204,9 +1269,9 @@ xmlSecOpenSSLEvpSignatureVerify(xmlSecTransformPtr transform,
     xmlSecAssert2(dataToSignSize > 0, -1);
 
     /* create and setup verification context */
-    pKeyCtx = xmlSecOpenSSLEvpSignatureCreatePkeyCtx(transform, ctx);
+    pKeyCtx = xmlSecOpenSSLEvpSignatureGetPkeyCtx(transform, ctx);
     if(pKeyCtx == NULL) {
-        xmlSecInternalError("xmlSecOpenSSLEvpSignatureCreatePkeyCtx", xmlSecTransformGetName(transform));
+        xmlSecInternalError("xmlSecOpenSSLEvpSignatureGetPkeyCtx", xmlSecTransformGetName(transform));
         goto done;
     }
 
@@ -1307,9 +1372,9 @@ xmlSecOpenSSLEvpSignatureSign(xmlSecTransformPtr transform, xmlSecTransformCtxPt
     xmlSecAssert2(dataToSignSize > 0, -1);
 
     /* create and setup signature context */
-    pKeyCtx = xmlSecOpenSSLEvpSignatureCreatePkeyCtx(transform, ctx);
+    pKeyCtx = xmlSecOpenSSLEvpSignatureGetPkeyCtx(transform, ctx);
     if(pKeyCtx == NULL) {
-        xmlSecInternalError("xmlSecOpenSSLEvpSignatureCreatePkeyCtx", xmlSecTransformGetName(transform));
+        xmlSecInternalError("xmlSecOpenSSLEvpSignatureGetPkeyCtx", xmlSecTransformGetName(transform));
         goto done;
     }
 
@@ -1414,18 +1479,14 @@ xmlSecOpenSSLEvpSignatureStart(xmlSecTransformPtr transform, xmlSecOpenSSLEvpSig
 }
 
 static int
-xmlSecOpenSSLEvpSignatureUpdate(xmlSecTransformPtr transform, xmlSecOpenSSLEvpSignatureCtxPtr ctx, xmlSecBufferPtr in)
+xmlSecOpenSSLEvpSignatureUpdate(xmlSecTransformPtr transform, xmlSecOpenSSLEvpSignatureCtxPtr ctx,
+                                const xmlSecByte* inData, xmlSecSize inSize)
 {
-    const xmlSecByte* inData;
-    xmlSecSize inSize;
     int ret;
 
     xmlSecAssert2(transform != NULL, -1);
     xmlSecAssert2(ctx != NULL, -1);
-    xmlSecAssert2(in != NULL, -1);
 
-    inData = xmlSecBufferGetData(in);
-    inSize = xmlSecBufferGetSize(in);
     if((inData == NULL) || (inSize <= 0)) {
         return(0);
     }
@@ -1449,13 +1510,6 @@ xmlSecOpenSSLEvpSignatureUpdate(xmlSecTransformPtr transform, xmlSecOpenSSLEvpSi
         }
     }
 
-    ret = xmlSecBufferRemoveHead(in, inSize);
-    if(ret < 0) {
-        xmlSecInternalError2("xmlSecBufferRemoveHead", xmlSecTransformGetName(transform),
-            "size=" XMLSEC_SIZE_FMT, inSize);
-        return(-1);
-    }
-
     /* done */
     return(0);
 }
@@ -1468,7 +1522,31 @@ xmlSecOpenSSLEvpSignatureFinish(xmlSecTransformPtr transform, xmlSecOpenSSLEvpSi
     xmlSecAssert2(transform != NULL, -1);
     xmlSecAssert2(ctx != NULL, -1);
 
-    if(ctx->digest != NULL) {
+    if(ctx->digest == NULL) {
+        xmlSecBufferPtr in = &(transform->inBuf);
+
+        /* the message is in the input buffer unless it was pushed directly
+         * to the preSignBuffer (see xmlSecOpenSSLEvpSignaturePushBin): take
+         * the input buffer instead of making another copy of the message */
+        if(xmlSecBufferGetSize(&(ctx->preSignBuffer)) == 0) {
+            xmlSecBufferSwap(in, &(ctx->preSignBuffer));
+        } else if(xmlSecBufferGetSize(in) > 0) {
+            xmlSecSize inSize = xmlSecBufferGetSize(in);
+
+            ret = xmlSecBufferAppend(&(ctx->preSignBuffer), xmlSecBufferGetData(in), inSize);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecBufferAppend", xmlSecTransformGetName(transform));
+                return(-1);
+            }
+            ret = xmlSecBufferRemoveHead(in, inSize);
+            if(ret < 0) {
+                xmlSecInternalError2("xmlSecBufferRemoveHead", xmlSecTransformGetName(transform),
+                    "size=" XMLSEC_SIZE_FMT, inSize);
+                return(-1);
+            }
+        }
+        xmlSecAssert2(xmlSecBufferGetSize(in) == 0, -1);
+    } else {
         xmlSecOpenSSLSizeT mdSize;
         xmlSecByte* outData;
         unsigned int outSize;
@@ -1544,15 +1622,26 @@ xmlSecOpenSSLEvpSignatureExecute(xmlSecTransformPtr transform, int last, xmlSecT
         transform->status = xmlSecTransformStatusWorking;
     }
 
-    /* update digest */
-    if(transform->status == xmlSecTransformStatusWorking) {
+    /* update digest; the signatures without digest need the whole message thus
+     * we keep accumulating it in the input buffer (see xmlSecOpenSSLEvpSignatureFinish) */
+    if((transform->status == xmlSecTransformStatusWorking) && (ctx->digest != NULL)) {
+        xmlSecSize inSize;
+
         xmlSecAssert2(outSize == 0, -1);
 
-        ret = xmlSecOpenSSLEvpSignatureUpdate(transform, ctx, in);
+        inSize = xmlSecBufferGetSize(in);
+        ret = xmlSecOpenSSLEvpSignatureUpdate(transform, ctx, xmlSecBufferGetData(in), inSize);
         if(ret < 0) {
             xmlSecInternalError("xmlSecOpenSSLEvpSignatureUpdate", xmlSecTransformGetName(transform));
             return(-1);
         }
+
+        ret = xmlSecBufferRemoveHead(in, inSize);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBufferRemoveHead", xmlSecTransformGetName(transform),
+                "size=" XMLSEC_SIZE_FMT, inSize);
+            return(-1);
+        }
     }
 
     if((transform->status == xmlSecTransformStatusWorking) && (last != 0)) {
@@ -1574,7 +1663,9 @@ xmlSecOpenSSLEvpSignatureExecute(xmlSecTransformPtr transform, int last, xmlSecT
         transform->status = xmlSecTransformStatusFinished;
     }
 
-    if((transform->status == xmlSecTransformStatusWorking) || (transform->status == xmlSecTransformStatusFinished)) {
+    if((transform->status == xmlSecTransformStatusWorking) && (ctx->digest == NULL)) {
+        /* the message is accumulated in the input buffer */
+    } else if((transform->status == xmlSecTransformStatusWorking) || (transform->status == xmlSecTransformStatusFinished)) {
         /* the only way we can get here is if there is no input */
         xmlSecAssert2(xmlSecBufferGetSize(&(transform->inBuf)) == 0, -1);
     } else {
@@ -1585,6 +1676,52 @@ xmlSecOpenSSLEvpSignatureExecute(xmlSecTransformPtr transform, int last, xmlSecT
     return(0);
 }
 
+/* Process the pushed data in place instead of copying it to the input buffer first
+ * (e.g. the C14N output is pushed directly from the libxml2 output buffer). */
+static int
+xmlSecOpenSSLEvpSignaturePushBin(xmlSecTransformPtr transform, const xmlSecByte* data,
+                                xmlSecSize dataSize, int final, xmlSecTransformCtxPtr transformCtx) {
+    xmlSecOpenSSLEvpSignatureCtxPtr ctx;
+    int ret;
+
+    xmlSecAssert2(xmlSecOpenSSLEvpSignatureCheckId(transform), -1);
+    xmlSecAssert2(xmlSecTransformCheckSize(transform, xmlSecOpenSSLEvpSignatureSize), -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    ctx = xmlSecOpenSSLEvpSignatureGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    /* fall back to the default processing if we have something buffered */
+    if((dataSize <= 0) || (xmlSecBufferGetSize(&(transform->inBuf)) > 0) ||
+       ((transform->status != xmlSecTransformStatusNone) && (transform->status != xmlSecTransformStatusWorking))
+    ) {
+        return(xmlSecTransformDefaultPushBin(transform, data, dataSize, final, transformCtx));
+    }
+    xmlSecAssert2(data != NULL, -1);
+
+    /* start signature if needed */
+    if(transform->status == xmlSecTransformStatusNone) {
+        ret = xmlSecTransformExecute(transform, 0, transformCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformExecute", xmlSecTransformGetName(transform));
+            return(-1);
+        }
+    }
+    xmlSecAssert2(transform->status == xmlSecTransformStatusWorking, -1);
+
+    ret = xmlSecOpenSSLEvpSignatureUpdate(transform, ctx, data, dataSize);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLEvpSignatureUpdate", xmlSecTransformGetName(transform));
+        return(-1);
+    }
+
+    /* nothing to finalize or to push to the next transform */
+    if(final == 0) {
+        return(0);
+    }
+    return(xmlSecTransformDefaultPushBin(transform, NULL, 0, final, transformCtx));
+}
+
 
 /******************************************************************************
  *
@@ -15,6 +15,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <openssl/evp.h>
+
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/keys.h>
 #include <xmlsec/keyinfo.h>
@@ -25,7 +27,15 @@
 #include <xmlsec/openssl/crypto.h>
 
 #include "openssl_compat.h"
+
+#if !defined(XMLSEC_NO_HMAC) && defined(XMLSEC_OPENSSL_API_300)
+#include <openssl/core_names.h>
+#include <openssl/err.h>
+#endif /* !defined(XMLSEC_NO_HMAC) && defined(XMLSEC_OPENSSL_API_300) */
+
+#include "../atomic_helpers.h"
 #include "../keysdata_helpers.h"
+#include "private.h"
 
 /******************************************************************************
  *
@@ -70,6 +80,10 @@ static int      xmlSecOpenSSLSymKeyDataKlassCheck       (xmlSecKeyDataKlass* kla
     (xmlSecKeyDataIsValid((data)) && \
      xmlSecOpenSSLSymKeyDataKlassCheck((data)->id))
 
+#if !defined(XMLSEC_NO_HMAC) && defined(XMLSEC_OPENSSL_API_300)
+static void     xmlSecOpenSSLKeyDataHmacFlushMacCtxCache(xmlSecKeyDataPtr data);
+#endif /* !defined(XMLSEC_NO_HMAC) && defined(XMLSEC_OPENSSL_API_300) */
+
 static int
 xmlSecOpenSSLSymKeyDataInitialize(xmlSecKeyDataPtr data) {
     xmlSecAssert2(xmlSecOpenSSLSymKeyDataCheckId(data), -1);
@@ -90,6 +104,12 @@ static void
 xmlSecOpenSSLSymKeyDataFinalize(xmlSecKeyDataPtr data) {
     xmlSecAssert(xmlSecOpenSSLSymKeyDataCheckId(data));
 
+#if !defined(XMLSEC_NO_HMAC) && defined(XMLSEC_OPENSSL_API_300)
+    if(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataHmacId)) {
+        xmlSecOpenSSLKeyDataHmacFlushMacCtxCache(data);
+    }
+#endif /* !defined(XMLSEC_NO_HMAC) && defined(XMLSEC_OPENSSL_API_300) */
+
     xmlSecKeyDataBinaryValueFinalize(data);
 }
 
@@ -137,6 +157,13 @@ xmlSecOpenSSLSymKeyDataGenerate(xmlSecKeyDataPtr data, xmlSecSize sizeBits, xmlS
     xmlSecAssert2(sizeBits > 0, -1);
     UNREFERENCED_PARAMETER(type);
 
+#if !defined(XMLSEC_NO_HMAC) && defined(XMLSEC_OPENSSL_API_300)
+    /* the cached contexts were created for the old key */
+    if(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataHmacId)) {
+        xmlSecOpenSSLKeyDataHmacFlushMacCtxCache(data);
+    }
+#endif /* !defined(XMLSEC_NO_HMAC) && defined(XMLSEC_OPENSSL_API_300) */
+
     buffer = xmlSecKeyDataBinaryValueGetBuffer(data);
     xmlSecAssert2(buffer != NULL, -1);
 
@@ -239,10 +266,10 @@ xmlSecOpenSSLSymKeyDataKlassCheck(xmlSecKeyDataKlass* klass) {
 }
 
 /* Helper macros to define the key data klass */
-#define XMLSEC_OPENSSL_SYMKEY_KLASS_EX(name, keyName, keyHref, usage, node, ns, xmlRead, xmlWrite)     \
+#define XMLSEC_OPENSSL_SYMKEY_KLASS_EX(name, objSize, keyName, keyHref, usage, node, ns, xmlRead, xmlWrite) \
 static xmlSecKeyDataKlass xmlSecOpenSSLKeyData ## name ## Klass = {                                  \
     sizeof(xmlSecKeyDataKlass),                 /* xmlSecSize klassSize */                           \
-    xmlSecKeyDataBinarySize,                    /* xmlSecSize objSize */                             \
+    objSize,                                    /* xmlSecSize objSize */                             \
                                                                                                      \
     /* data */                                                                                       \
     keyName,                                    /* const xmlChar* name; */                           \
@@ -279,6 +306,7 @@ static xmlSecKeyDataKlass xmlSecOpenSSLKeyData ## name ## Klass = {
 
 #define XMLSEC_OPENSSL_SYMKEY_KLASS(name, keyValueName)                                              \
     XMLSEC_OPENSSL_SYMKEY_KLASS_EX(name,                                                             \
+        xmlSecKeyDataBinarySize,                                                                     \
         xmlSecName ## keyValueName ## KeyValue,                                                      \
         xmlSecHref ## keyValueName ## KeyValue,                                                      \
         xmlSecKeyDataUsageReadFromFile | xmlSecKeyDataUsageKeyValueNode | xmlSecKeyDataUsageRetrievalMethodNodeXml, \
@@ -412,6 +440,7 @@ xmlSecOpenSSLKeyDataChaCha20Set(xmlSecKeyDataPtr data, const xmlSecByte* buf, xm
  *
   *****************************************************************************/
 XMLSEC_OPENSSL_SYMKEY_KLASS_EX(ConcatKdf,
+    xmlSecKeyDataBinarySize,
     xmlSecNameConcatKdf,
     xmlSecHrefConcatKdf,
     xmlSecKeyDataUsageReadFromFile,
@@ -496,9 +525,48 @@ xmlSecOpenSSLKeyDataDesSet(xmlSecKeyDataPtr data, const xmlSecByte* buf, xmlSecS
 /******************************************************************************
  *
  * <xmlsec:HMACKeyValue> processing
+ *
+ * With OpenSSL 3.x, the HMAC key data also keeps the EVP_MAC_CTX objects
+ * initialized with the key (i.e. with the inner and outer pads already
+ * hashed) for each digest the key was used with. The HMAC transforms get
+ * copies of these contexts (see xmlSecOpenSSLKeyDataHmacGetMacCtx) instead
+ * of initializing a new context with the key for every signature.
+ *
+ * The cache entries are published with an atomic compare-and-swap into an
+ * empty slot and are never replaced while the key is in use, so no lock is
+ * taken. The cache is flushed when the key value is set or generated (see
+ * xmlSecOpenSSLKeyDataHmacSet), i.e. the key value must not be changed
+ * directly in the binary buffer once the key was used.
  *
   *****************************************************************************/
-XMLSEC_OPENSSL_SYMKEY_KLASS(Hmac, HMAC)
+#define XMLSEC_OPENSSL_HMAC_MAC_CTX_CACHE_SIZE      4
+
+#ifdef XMLSEC_OPENSSL_API_300
+typedef struct _xmlSecOpenSSLHmacMacCtxCacheEntry {
+    const char*         digestName;
+    EVP_MAC_CTX*        macCtx;
+} xmlSecOpenSSLHmacMacCtxCacheEntry, *xmlSecOpenSSLHmacMacCtxCacheEntryPtr;
+#endif /* XMLSEC_OPENSSL_API_300 */
+
+typedef struct _xmlSecOpenSSLKeyDataHmac {
+    xmlSecKeyDataBinary binary;
+#ifdef XMLSEC_OPENSSL_API_300
+    /* the contexts initialized with the key value (see xmlSecOpenSSLKeyDataHmacGetMacCtx) */
+    xmlSecOpenSSLHmacMacCtxCacheEntryPtr macCtxCache[XMLSEC_OPENSSL_HMAC_MAC_CTX_CACHE_SIZE];
+#endif /* XMLSEC_OPENSSL_API_300 */
+} xmlSecOpenSSLKeyDataHmac;
+
+#define xmlSecOpenSSLKeyDataHmacSize (sizeof(xmlSecOpenSSLKeyDataHmac))
+
+XMLSEC_OPENSSL_SYMKEY_KLASS_EX(Hmac,
+    xmlSecOpenSSLKeyDataHmacSize,
+    xmlSecNameHMACKeyValue,
+    xmlSecHrefHMACKeyValue,
+    xmlSecKeyDataUsageReadFromFile | xmlSecKeyDataUsageKeyValueNode | xmlSecKeyDataUsageRetrievalMethodNodeXml,
+    xmlSecNodeHMACKeyValue,
+    xmlSecNs,
+    xmlSecOpenSSLSymKeyDataXmlRead,
+    xmlSecOpenSSLSymKeyDataXmlWrite)
 
 /**
  * @brief The HMAC key data klass.
@@ -511,6 +579,7 @@ xmlSecOpenSSLKeyDataHmacGetKlass(void) {
 
 /**
  * @brief Sets the value of HMAC key data.
+ * @details The key data must not be used by other threads during this call.
  * @param data the pointer to HMAC key data.
  * @param buf the pointer to key value.
  * @param bufSize the key value size (in bytes).
@@ -524,12 +593,195 @@ xmlSecOpenSSLKeyDataHmacSet(xmlSecKeyDataPtr data, const xmlSecByte* buf, xmlSec
     xmlSecAssert2(buf != NULL, -1);
     xmlSecAssert2(bufSize > 0, -1);
 
+#ifdef XMLSEC_OPENSSL_API_300
+    /* the cached contexts were created for the old key */
+    xmlSecOpenSSLKeyDataHmacFlushMacCtxCache(data);
+#endif /* XMLSEC_OPENSSL_API_300 */
+
     buffer = xmlSecKeyDataBinaryValueGetBuffer(data);
     xmlSecAssert2(buffer != NULL, -1);
 
     return(xmlSecBufferSetData(buffer, buf, bufSize));
 }
 
+#ifdef XMLSEC_OPENSSL_API_300
+
+/* the caller must be the only user of the key data */
+static void
+xmlSecOpenSSLKeyDataHmacFlushMacCtxCache(xmlSecKeyDataPtr data) {
+    xmlSecOpenSSLKeyDataHmac* hmacData;
+    xmlSecSize ii;
+
+    xmlSecAssert(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataHmacId));
+    xmlSecAssert(xmlSecKeyDataCheckSize(data, xmlSecOpenSSLKeyDataHmacSize));
+
+    hmacData = (xmlSecOpenSSLKeyDataHmac*)data;
+    for(ii = 0; ii < XMLSEC_OPENSSL_HMAC_MAC_CTX_CACHE_SIZE; ++ii) {
+        if(hmacData->macCtxCache[ii] != NULL) {
+            EVP_MAC_CTX_free(hmacData->macCtxCache[ii]->macCtx);
+            xmlFree(hmacData->macCtxCache[ii]);
+            hmacData->macCtxCache[ii] = NULL;
+        }
+    }
+}
+
+static EVP_MAC_CTX*
+xmlSecOpenSSLKeyDataHmacFindMacCtx(xmlSecOpenSSLKeyDataHmac* hmacData, const char* digestName) {
+    xmlSecOpenSSLHmacMacCtxCacheEntryPtr entry;
+    xmlSecSize ii;
+
+    xmlSecAssert2(hmacData != NULL, NULL);
+    xmlSecAssert2(digestName != NULL, NULL);
+
+    /* the slots are filled in order, stop at the first empty one */
+    for(ii = 0; ii < XMLSEC_OPENSSL_HMAC_MAC_CTX_CACHE_SIZE; ++ii) {
+        entry = xmlSecAtomicPtrLoad(&(hmacData->macCtxCache[ii]));
+        if(entry == NULL) {
+            break;
+        }
+        if(strcmp(entry->digestName, digestName) == 0) {
+            return(entry->macCtx);
+        }
+    }
+    return(NULL);
+}
+
+/* takes ownership of macCtx */
+static void
+xmlSecOpenSSLKeyDataHmacAddMacCtx(xmlSecOpenSSLKeyDataHmac* hmacData, const char* digestName, EVP_MAC_CTX* macCtx) {
+    xmlSecOpenSSLHmacMacCtxCacheEntryPtr entry;
+    xmlSecOpenSSLHmacMacCtxCacheEntryPtr cur;
+    xmlSecSize ii;
+
+    xmlSecAssert(hmacData != NULL);
+    xmlSecAssert(digestName != NULL);
+    xmlSecAssert(macCtx != NULL);
+
+    entry = (xmlSecOpenSSLHmacMacCtxCacheEntryPtr)xmlMalloc(sizeof(xmlSecOpenSSLHmacMacCtxCacheEntry));
+    if(entry == NULL) {
+        xmlSecMallocError(sizeof(xmlSecOpenSSLHmacMacCtxCacheEntry), NULL);
+        EVP_MAC_CTX_free(macCtx);
+        return;
+    }
+    entry->digestName = digestName;
+    entry->macCtx = macCtx;
+
+    for(ii = 0; ii < XMLSEC_OPENSSL_HMAC_MAC_CTX_CACHE_SIZE; ++ii) {
+        cur = xmlSecAtomicPtrCompareExchange(&(hmacData->macCtxCache[ii]), NULL, entry);
+        if(cur == NULL) {
+            /* published */
+            return;
+        }
+        if(strcmp(cur->digestName, digestName) == 0) {
+            /* another thread added it already */
+            break;
+        }
+    }
+
+    /* the cache is full or has this context already */
+    EVP_MAC_CTX_free(entry->macCtx);
+    xmlFree(entry);
+}
+
+static EVP_MAC_CTX*
+xmlSecOpenSSLKeyDataHmacCreateMacCtx(const char* digestName, const xmlSecByte* key, xmlSecSize keySize) {
+    EVP_MAC* mac;
+    EVP_MAC_CTX* macCtx;
+    OSSL_PARAM params[2];
+    int ret;
+
+    xmlSecAssert2(digestName != NULL, NULL);
+    xmlSecAssert2(key != NULL, NULL);
+    xmlSecAssert2(keySize > 0, NULL);
+
+    mac = xmlSecOpenSSLFetchMac(OSSL_MAC_NAME_HMAC, NULL);
+    if(mac == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLFetchMac", NULL);
+        return(NULL);
+    }
+    macCtx = EVP_MAC_CTX_new(mac);
+    EVP_MAC_free(mac);
+    if(macCtx == NULL) {
+        xmlSecOpenSSLError("EVP_MAC_CTX_new", NULL);
+        return(NULL);
+    }
+
+    params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char*)digestName, 0);
+    params[1] = OSSL_PARAM_construct_end();
+    ret = EVP_MAC_init(macCtx, key, keySize, params);
+    if(ret != 1) {
+        xmlSecOpenSSLError2("EVP_MAC_init", NULL, "digest=%s", digestName);
+        EVP_MAC_CTX_free(macCtx);
+        return(NULL);
+    }
+
+    /* success */
+    return(macCtx);
+}
+
+/**
+ * @brief Gets the HMAC context initialized with the key.
+ * @details Returns a copy of the context cached in the key data for @p digestName
+ * or, if there is none, initializes a new context and caches its copy. No lock
+ * is taken; the key data must not be modified while it is in use.
+ * @param data the pointer to HMAC key data.
+ * @param digestName the HMAC digest name (e.g. OSSL_DIGEST_NAME_SHA2_256), the
+ * string must be static.
+ * @return the pointer to EVP_MAC_CTX ready for EVP_MAC_update() that must be freed
+ * by the caller with EVP_MAC_CTX_free or NULL if an error occurs.
+ */
+EVP_MAC_CTX*
+xmlSecOpenSSLKeyDataHmacGetMacCtx(xmlSecKeyDataPtr data, const char* digestName) {
+    xmlSecOpenSSLKeyDataHmac* hmacData;
+    xmlSecBufferPtr buffer;
+    const xmlSecByte* key;
+    xmlSecSize keySize;
+    EVP_MAC_CTX* macCtx;
+    EVP_MAC_CTX* macCtxTemplate;
+
+    xmlSecAssert2(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataHmacId), NULL);
+    xmlSecAssert2(xmlSecKeyDataCheckSize(data, xmlSecOpenSSLKeyDataHmacSize), NULL);
+    xmlSecAssert2(digestName != NULL, NULL);
+
+    hmacData = (xmlSecOpenSSLKeyDataHmac*)data;
+
+    buffer = xmlSecKeyDataBinaryValueGetBuffer(data);
+    xmlSecAssert2(buffer != NULL, NULL);
+    key = xmlSecBufferGetData(buffer);
+    keySize = xmlSecBufferGetSize(buffer);
+    xmlSecAssert2(key != NULL, NULL);
+    xmlSecAssert2(keySize > 0, NULL);
+
+    macCtxTemplate = xmlSecOpenSSLKeyDataHmacFindMacCtx(hmacData, digestName);
+    if(macCtxTemplate != NULL) {
+        macCtx = EVP_MAC_CTX_dup(macCtxTemplate);
+        if(macCtx != NULL) {
+            return(macCtx);
+        }
+        /* fall back to a new context */
+        ERR_clear_error();
+    }
+
+    macCtx = xmlSecOpenSSLKeyDataHmacCreateMacCtx(digestName, key, keySize);
+    if(macCtx == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLKeyDataHmacCreateMacCtx", xmlSecKeyDataGetName(data));
+        return(NULL);
+    }
+
+    /* not all the providers support EVP_MAC_CTX_dup(): just don't cache */
+    macCtxTemplate = EVP_MAC_CTX_dup(macCtx);
+    if(macCtxTemplate == NULL) {
+        ERR_clear_error();
+        return(macCtx);
+    }
+
+    xmlSecOpenSSLKeyDataHmacAddMacCtx(hmacData, digestName, macCtxTemplate);
+
+    return(macCtx);
+}
+
+#endif /* XMLSEC_OPENSSL_API_300 */
+
 #endif /* XMLSEC_NO_HMAC */
 
 #ifndef XMLSEC_NO_PBKDF2
@@ -539,6 +791,7 @@ xmlSecOpenSSLKeyDataHmacSet(xmlSecKeyDataPtr data, const xmlSecByte* buf, xmlSec
  *
   *****************************************************************************/
 XMLSEC_OPENSSL_SYMKEY_KLASS_EX(Pbkdf2,
+    xmlSecKeyDataBinarySize,
     xmlSecNamePbkdf2,
     xmlSecHrefPbkdf2,
     xmlSecKeyDataUsageReadFromFile,
@@ -585,6 +838,7 @@ xmlSecOpenSSLKeyDataPbkdf2Set(xmlSecKeyDataPtr data, const xmlSecByte* buf, xmlS
  *
   *****************************************************************************/
 XMLSEC_OPENSSL_SYMKEY_KLASS_EX(Hkdf,
+    xmlSecKeyDataBinarySize,
     xmlSecNameHkdf,
     xmlSecHrefHkdf,
     xmlSecKeyDataUsageReadFromFile,
@@ -19,6 +19,9 @@
 #include <errno.h>
 #include <time.h>
 
+#include <libxml/hash.h>
+#include <libxml/threads.h>
+
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/base64.h>
 #include <xmlsec/keys.h>
@@ -198,6 +201,7 @@ xmlSecOpenSSLKeyDataX509GetKeyCert(xmlSecKeyDataPtr data) {
 
 static int
 xmlSecOpenSSLKeyDataX509AddCertInternal(xmlSecOpenSSLX509DataCtxPtr ctx, X509* cert, int keyCert) {
+    X509* dup;
     xmlSecOpenSSLSizeT ret;
 
     xmlSecAssert2(ctx != NULL, -1);
@@ -213,23 +217,33 @@ xmlSecOpenSSLKeyDataX509AddCertInternal(xmlSecOpenSSLX509DataCtxPtr ctx, X509* c
 
     /* we don't want duplicates: if this exact cert object is already in the list,
        remove it so it can be re-inserted below (do not free it - we re-add the
-       same object) */
-    (void)sk_X509_delete_ptr(ctx->certsList, cert);
+       same object). The same object comes again from the parsed certificates
+       cache with a new reference that we own now. */
+    dup = sk_X509_delete_ptr(ctx->certsList, cert);
 
     /* ensure that key cert is the first one */
     if(keyCert != 0) {
         ret = sk_X509_insert(ctx->certsList, cert, 0);
         if(ret <= 0) {
             xmlSecOpenSSLError("sk_X509_insert(0)", NULL);
+            if(dup != NULL) {
+                X509_free(dup);
+            }
             return(-1);
         }
     } else {
         ret = sk_X509_push(ctx->certsList, cert);
         if(ret <= 0) {
             xmlSecOpenSSLError("sk_X509_push", NULL);
+            if(dup != NULL) {
+                X509_free(dup);
+            }
             return(-1);
         }
     }
+    if(dup != NULL) {
+        X509_free(dup);
+    }
 
     /* done */
     return(0);
@@ -1730,14 +1744,194 @@ done:
     return(res);
 }
 
+/******************************************************************************
+ *
+ * Parsed certificates cache
+ *
+ * The same certificates (intermediate CAs, signers) come in the X509Data
+ * again and again. The process-wide cache maps the DER digest to the parsed
+ * certificate and returns a new reference to it instead of parsing the DER
+ * again. The certificates are never modified after parsing thus can be shared.
+ * The cache is flushed when it is full: the certificates are reference counted
+ * and stay valid while used by the key data.
+ *
+  *****************************************************************************/
+#define XMLSEC_OPENSSL_X509_CERTS_CACHE_MAX_SIZE        256
+
+static xmlMutexPtr      xmlSecOpenSSLX509CertsCacheMutex = NULL;
+static xmlHashTablePtr  xmlSecOpenSSLX509CertsCacheHash = NULL;
+
+/* called with the cache mutex locked */
+static void
+xmlSecOpenSSLX509CertsCacheDeallocator(void* payload, const xmlChar* name XMLSEC_ATTRIBUTE_UNUSED) {
+    UNREFERENCED_PARAMETER(name);
+    xmlSecAssert(payload != NULL);
+
+    X509_free((X509*)payload);
+}
+
+/**
+ * @brief Initializes the parsed certificates cache.
+ * @details Initializes the process-wide cache of the certificates parsed from
+ * the X509Data elements. Called from #xmlSecOpenSSLInit.
+ * @return 0 on success or a negative value otherwise.
+ */
+int
+xmlSecOpenSSLX509CertsCacheInit(void) {
+    if(xmlSecOpenSSLX509CertsCacheMutex == NULL) {
+        xmlSecOpenSSLX509CertsCacheMutex = xmlNewMutex();
+        if(xmlSecOpenSSLX509CertsCacheMutex == NULL) {
+            xmlSecXmlError("xmlNewMutex", NULL);
+            return(-1);
+        }
+    }
+
+    xmlMutexLock(xmlSecOpenSSLX509CertsCacheMutex);
+    if(xmlSecOpenSSLX509CertsCacheHash == NULL) {
+        xmlSecOpenSSLX509CertsCacheHash = xmlHashCreate(XMLSEC_OPENSSL_X509_CERTS_CACHE_MAX_SIZE);
+        if(xmlSecOpenSSLX509CertsCacheHash == NULL) {
+            xmlMutexUnlock(xmlSecOpenSSLX509CertsCacheMutex);
+            xmlSecXmlError("xmlHashCreate", NULL);
+            return(-1);
+        }
+    }
+    xmlMutexUnlock(xmlSecOpenSSLX509CertsCacheMutex);
+    return(0);
+}
+
+/**
+ * @brief Shuts down the parsed certificates cache.
+ * @details Releases the cache references to the parsed certificates. The
+ * certificates still used by the key data are freed when the key data are
+ * destroyed. Called from #xmlSecOpenSSLShutdown.
+ */
+void
+xmlSecOpenSSLX509CertsCacheShutdown(void) {
+    if(xmlSecOpenSSLX509CertsCacheMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecOpenSSLX509CertsCacheMutex);
+    if(xmlSecOpenSSLX509CertsCacheHash != NULL) {
+        xmlHashFree(xmlSecOpenSSLX509CertsCacheHash, xmlSecOpenSSLX509CertsCacheDeallocator);
+        xmlSecOpenSSLX509CertsCacheHash = NULL;
+    }
+    xmlMutexUnlock(xmlSecOpenSSLX509CertsCacheMutex);
+
+    xmlFreeMutex(xmlSecOpenSSLX509CertsCacheMutex);
+    xmlSecOpenSSLX509CertsCacheMutex = NULL;
+}
+
+/* the key is the hex encoded SHA256 digest of the certificate DER */
+static int
+xmlSecOpenSSLX509CertsCacheKey(const xmlSecByte* buf, xmlSecSize size, xmlChar* key, xmlSecSize keySize) {
+    static const char hex[] = "0123456789abcdef";
+    xmlSecByte md[EVP_MAX_MD_SIZE];
+    unsigned int mdLen = 0;
+    unsigned int ii;
+    int ret;
+
+    xmlSecAssert2(buf != NULL, -1);
+    xmlSecAssert2(size > 0, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    ret = EVP_Digest(buf, (size_t)size, md, &mdLen, EVP_sha256(), NULL);
+    if((ret != 1) || (mdLen <= 0)) {
+        xmlSecOpenSSLError("EVP_Digest", NULL);
+        return(-1);
+    }
+    xmlSecAssert2(2 * mdLen < keySize, -1);
+
+    for(ii = 0; ii < mdLen; ++ii) {
+        key[2 * ii]     = (xmlChar)hex[(md[ii] >> 4) & 0x0F];
+        key[2 * ii + 1] = (xmlChar)hex[md[ii] & 0x0F];
+    }
+    key[2 * mdLen] = '\0';
+    return(0);
+}
+
+/* returns the cached certificate with the reference added or NULL if not found */
+static X509*
+xmlSecOpenSSLX509CertsCacheGet(const xmlChar* key) {
+    X509* cert = NULL;
+
+    xmlSecAssert2(key != NULL, NULL);
+
+    if(xmlSecOpenSSLX509CertsCacheMutex == NULL) {
+        return(NULL);
+    }
+    xmlMutexLock(xmlSecOpenSSLX509CertsCacheMutex);
+    if(xmlSecOpenSSLX509CertsCacheHash != NULL) {
+        cert = (X509*)xmlHashLookup(xmlSecOpenSSLX509CertsCacheHash, key);
+        if((cert != NULL) && (X509_up_ref(cert) != 1)) {
+            cert = NULL;
+        }
+    }
+    xmlMutexUnlock(xmlSecOpenSSLX509CertsCacheMutex);
+    return(cert);
+}
+
+/* not being able to cache the certificate is not an error */
+static void
+xmlSecOpenSSLX509CertsCacheAdd(const xmlChar* key, X509* cert) {
+    int ret;
+
+    xmlSecAssert(key != NULL);
+    xmlSecAssert(cert != NULL);
+
+    if(xmlSecOpenSSLX509CertsCacheMutex == NULL) {
+        return;
+    }
+    xmlMutexLock(xmlSecOpenSSLX509CertsCacheMutex);
+    if(xmlSecOpenSSLX509CertsCacheHash == NULL) {
+        xmlMutexUnlock(xmlSecOpenSSLX509CertsCacheMutex);
+        return;
+    }
+    if(xmlHashLookup(xmlSecOpenSSLX509CertsCacheHash, key) != NULL) {
+        /* another thread did it already */
+        xmlMutexUnlock(xmlSecOpenSSLX509CertsCacheMutex);
+        return;
+    }
+    if(xmlHashSize(xmlSecOpenSSLX509CertsCacheHash) >= XMLSEC_OPENSSL_X509_CERTS_CACHE_MAX_SIZE) {
+        xmlHashFree(xmlSecOpenSSLX509CertsCacheHash, xmlSecOpenSSLX509CertsCacheDeallocator);
+        xmlSecOpenSSLX509CertsCacheHash = xmlHashCreate(XMLSEC_OPENSSL_X509_CERTS_CACHE_MAX_SIZE);
+        if(xmlSecOpenSSLX509CertsCacheHash == NULL) {
+            xmlMutexUnlock(xmlSecOpenSSLX509CertsCacheMutex);
+            xmlSecXmlError("xmlHashCreate", NULL);
+            return;
+        }
+    }
+    if(X509_up_ref(cert) != 1) {
+        xmlMutexUnlock(xmlSecOpenSSLX509CertsCacheMutex);
+        return;
+    }
+    ret = xmlHashAddEntry(xmlSecOpenSSLX509CertsCacheHash, key, cert);
+    if(ret != 0) {
+        X509_free(cert);
+    }
+    xmlMutexUnlock(xmlSecOpenSSLX509CertsCacheMutex);
+}
+
 static X509*
 xmlSecOpenSSLX509CertDerRead(const xmlSecByte* buf, xmlSecSize size) {
+    xmlChar key[2 * EVP_MAX_MD_SIZE + 1];
     X509 *cert = NULL;
     BIO * bio = NULL;
+    int ret;
 
     xmlSecAssert2(buf != NULL, NULL);
     xmlSecAssert2(size > 0, NULL);
 
+    ret = xmlSecOpenSSLX509CertsCacheKey(buf, size, key, sizeof(key));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509CertsCacheKey", NULL);
+        return(NULL);
+    }
+    cert = xmlSecOpenSSLX509CertsCacheGet(key);
+    if(cert != NULL) {
+        return(cert);
+    }
+
     bio = xmlSecOpenSSLCreateMemBufBio(buf, size);
     if(bio == NULL) {
         xmlSecInternalError2("xmlSecOpenSSLCreateMemBufBio", NULL,
@@ -1750,6 +1944,7 @@ xmlSecOpenSSLX509CertDerRead(const xmlSecByte* buf, xmlSecSize size) {
         xmlSecInternalError("xmlSecOpenSSLX509CertLoadBIO", NULL);
         goto done;
     }
+    xmlSecOpenSSLX509CertsCacheAdd(key, cert);
 
 done:
     if(bio != NULL) {
@@ -17,7 +17,11 @@
 #include <ctype.h>
 #include <errno.h>
 
+#include <libxml/hash.h>
+#include <libxml/threads.h>
+
 #include <xmlsec/xmlsec.h>
+#include <xmlsec/buffer.h>
 #include <xmlsec/keys.h>
 #include <xmlsec/keyinfo.h>
 #include <xmlsec/keysmngr.h>
@@ -47,6 +51,73 @@
  * Internal OpenSSL X509 store CTX
  *
   *****************************************************************************/
+typedef struct _xmlSecOpenSSLX509IndexItem              xmlSecOpenSSLX509IndexItem,
+                                                        *xmlSecOpenSSLX509IndexItemPtr;
+struct _xmlSecOpenSSLX509IndexItem {
+    X509*                           cert;           /* NOT OWNED */
+    xmlSecSize                      pos;            /* the cert position in the untrusted certs list */
+    xmlSecOpenSSLX509IndexItemPtr   nextSameHash;   /* the next cert with the same subject name hash */
+    xmlSecOpenSSLX509IndexItemPtr   next;           /* all items list */
+};
+
+typedef struct _xmlSecOpenSSLX509IndexDigest {
+    const EVP_MD*                   md;
+    xmlHashTablePtr                 certs;          /* hex digest -> first item */
+} xmlSecOpenSSLX509IndexDigest;
+
+#define XMLSEC_OPENSSL_X509_INDEX_DIGESTS_MAX   8
+
+typedef struct _xmlSecOpenSSLX509VerifyCacheItem        xmlSecOpenSSLX509VerifyCacheItem,
+                                                        *xmlSecOpenSSLX509VerifyCacheItemPtr;
+struct _xmlSecOpenSSLX509VerifyCacheItem {
+    xmlChar*                            key;
+    xmlSecOpenSSLSizeT                  pos;        /* the verified cert position in the certs stack */
+    time_t                              expires;    /* the result is valid before this time (0 if no limit) */
+    xmlSecOpenSSLX509VerifyCacheItemPtr prev;       /* LRU list, the most recently used first */
+    xmlSecOpenSSLX509VerifyCacheItemPtr next;
+};
+
+/* the successful certs verification results, see xmlSecOpenSSLX509StoreSetVerifyCacheSize() */
+typedef struct _xmlSecOpenSSLX509VerifyCache {
+    xmlMutexPtr                         mutex;
+    xmlHashTablePtr                     items;      /* key -> item */
+    xmlSecOpenSSLX509VerifyCacheItemPtr head;
+    xmlSecOpenSSLX509VerifyCacheItemPtr tail;
+    xmlSecSize                          size;
+    xmlSecSize                          maxSize;    /* 0 if disabled */
+    xmlSecSize                          hits;
+    xmlSecSize                          misses;
+} xmlSecOpenSSLX509VerifyCache, *xmlSecOpenSSLX509VerifyCachePtr;
+
+/* the store CRL revoked entries sorted by the serial number, see xmlSecOpenSSLX509StoreAdoptCrl() */
+typedef struct _xmlSecOpenSSLX509CrlIndexItem {
+    const ASN1_INTEGER*             serial;         /* NOT OWNED */
+    X509_REVOKED*                   revoked;        /* NOT OWNED */
+    xmlSecSize                      pos;            /* the entry position in the CRL revoked list */
+} xmlSecOpenSSLX509CrlIndexItem, *xmlSecOpenSSLX509CrlIndexItemPtr;
+
+typedef struct _xmlSecOpenSSLX509CrlIndex               xmlSecOpenSSLX509CrlIndex,
+                                                        *xmlSecOpenSSLX509CrlIndexPtr;
+struct _xmlSecOpenSSLX509CrlIndex {
+    X509_CRL*                           crl;        /* NOT OWNED */
+    xmlSecOpenSSLX509CrlIndexItemPtr    items;      /* sorted by the serial number, then by the position */
+    xmlSecSize                          size;
+    xmlSecOpenSSLX509CrlIndexPtr        next;
+};
+
+#define XMLSEC_OPENSSL_X509_CRLS_CACHE_VERIFIED_MAX_SIZE    256
+
+/* the CRLs signatures and time filtering results, see xmlSecOpenSSLX509VerifyCRLSignature()
+ * and xmlSecOpenSSLX509StoreFilterCrlsByTime() */
+typedef struct _xmlSecOpenSSLX509CrlsCache {
+    xmlMutexPtr                         mutex;
+    xmlHashTablePtr                     verified;       /* CRL digest + issuer cert digest -> non-NULL */
+    int                                 filteredValid;
+    STACK_OF(X509_CRL)*                 filtered;       /* the store CRLs valid in [filteredFrom, filteredUntil) */
+    time_t                              filteredFrom;
+    time_t                              filteredUntil;  /* 0 if no limit */
+} xmlSecOpenSSLX509CrlsCache, *xmlSecOpenSSLX509CrlsCachePtr;
+
 typedef struct _xmlSecOpenSSLX509StoreCtx               xmlSecOpenSSLX509StoreCtx,
                                                         *xmlSecOpenSSLX509StoreCtxPtr;
 struct _xmlSecOpenSSLX509StoreCtx {
@@ -54,6 +125,26 @@ struct _xmlSecOpenSSLX509StoreCtx {
     STACK_OF(X509)*     untrusted;
     STACK_OF(X509_CRL)* crls;
     X509_VERIFY_PARAM * vpm;
+
+    /* the untrusted certs indexes, maintained in xmlSecOpenSSLX509StoreAdoptCert() */
+    int                             indexValid;
+    xmlSecSize                      indexSize;
+    xmlSecOpenSSLX509IndexItemPtr   indexItems;
+    xmlHashTablePtr                 bySubject;          /* canonical subject name -> first item */
+    xmlHashTablePtr                 byIssuerSerial;     /* canonical issuer name + serial -> first item */
+    xmlHashTablePtr                 bySki;              /* hex SKI -> first item */
+    xmlHashTablePtr                 bySubjectHash;      /* subject name hash -> items chain */
+    xmlSecOpenSSLX509IndexDigest    byDigest[XMLSEC_OPENSSL_X509_INDEX_DIGESTS_MAX];
+    xmlSecSize                      byDigestSize;
+
+    /* the store CRLs revoked entries indexes, maintained in xmlSecOpenSSLX509StoreAdoptCrl() */
+    xmlSecOpenSSLX509CrlIndexPtr    crlIndexes;
+
+    /* cleared whenever certs or CRLs are added to the store */
+    xmlSecOpenSSLX509VerifyCache    verifyCache;
+
+    /* the filtered CRLs are cleared whenever CRLs are added to the store */
+    xmlSecOpenSSLX509CrlsCache      crlsCache;
 };
 
 /******************************************************************************
@@ -85,25 +176,81 @@ static xmlSecKeyDataStoreKlass xmlSecOpenSSLX509StoreKlass = {
 
 static int              xmlSecOpenSSLX509VerifyCRLTimeValidity          (X509_CRL *crl,
                                                                          xmlSecKeyInfoCtx* keyInfoCtx);
-static int              xmlSecOpenSSLX509VerifyCRL                      (X509_STORE* xst,
+static int              xmlSecOpenSSLX509VerifyCRL                      (xmlSecOpenSSLX509StoreCtxPtr ctx,
                                                                          X509_STORE_CTX* xsc,
+                                                                         STACK_OF(X509)* certs,
                                                                          STACK_OF(X509)* untrusted,
                                                                          X509_CRL *crl,
                                                                          xmlSecKeyInfoCtx* keyInfoCtx);
 static X509*            xmlSecOpenSSLX509FindChildCert                  (STACK_OF(X509) *chain,
                                                                          X509 *cert);
 static X509_NAME*       xmlSecOpenSSLX509NameRead                       (const xmlChar *str);
+static xmlChar*         xmlSecOpenSSLX509NameStringKey                  (const xmlChar* str);
+static xmlChar*         xmlSecOpenSSLX509NameKey                        (XMLSEC_OPENSSL400_CONST X509_NAME* name);
+static int              xmlSecOpenSSLX509NameMatchesKey                 (XMLSEC_OPENSSL400_CONST X509_NAME* name,
+                                                                         const xmlChar* key);
 
 static int              xmlSecOpenSSLX509NamesCompare                   (XMLSEC_OPENSSL400_CONST X509_NAME *a,
                                                                          XMLSEC_OPENSSL400_CONST X509_NAME *b);
 static STACK_OF(X509_NAME_ENTRY)*  xmlSecOpenSSLX509_NAME_ENTRIES_copy  (XMLSEC_OPENSSL400_CONST X509_NAME *a);
-static int              xmlSecOpenSSLX509_NAME_ENTRIES_cmp              (STACK_OF(X509_NAME_ENTRY) * a,
-                                                                         STACK_OF(X509_NAME_ENTRY) * b);
 static int              xmlSecOpenSSLX509_NAME_ENTRY_cmp                (const X509_NAME_ENTRY * const *a,
                                                                          const X509_NAME_ENTRY * const *b);
 
 static STACK_OF(X509)*  xmlSecOpenSSLX509StoreCombineCerts              (STACK_OF(X509)* certs1,
                                                                          STACK_OF(X509)* certs2);
+static unsigned long    xmlSecOpenSSLX509GetSubjectHash                 (X509* x);
+
+static int              xmlSecOpenSSLX509StoreIndexInitialize           (xmlSecOpenSSLX509StoreCtxPtr ctx);
+static void             xmlSecOpenSSLX509StoreIndexFinalize             (xmlSecOpenSSLX509StoreCtxPtr ctx);
+static int              xmlSecOpenSSLX509StoreIndexIsValid              (xmlSecOpenSSLX509StoreCtxPtr ctx);
+static int              xmlSecOpenSSLX509StoreIndexAdd                  (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         X509* cert);
+static int              xmlSecOpenSSLX509StoreIndexFindCert             (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         xmlSecOpenSSLX509FindCertCtxPtr findCertCtx,
+                                                                         X509** res);
+
+static xmlSecOpenSSLX509CrlIndexPtr xmlSecOpenSSLX509CrlIndexCreate    (X509_CRL* crl);
+static void             xmlSecOpenSSLX509CrlIndexesDestroy              (xmlSecOpenSSLX509CrlIndexPtr indexes);
+static xmlSecOpenSSLX509CrlIndexPtr xmlSecOpenSSLX509CrlIndexesFind     (xmlSecOpenSSLX509CrlIndexPtr indexes,
+                                                                         X509_CRL* crl);
+static xmlSecSize       xmlSecOpenSSLX509CrlIndexLowerBound             (xmlSecOpenSSLX509CrlIndexPtr index,
+                                                                         const ASN1_INTEGER* serial);
+
+static int              xmlSecOpenSSLX509VerifyCacheInitialize          (xmlSecOpenSSLX509VerifyCachePtr cache);
+static void             xmlSecOpenSSLX509VerifyCacheFinalize            (xmlSecOpenSSLX509VerifyCachePtr cache);
+static void             xmlSecOpenSSLX509VerifyCacheClear               (xmlSecOpenSSLX509VerifyCachePtr cache);
+static int              xmlSecOpenSSLX509VerifyCacheIsEnabled           (xmlSecOpenSSLX509VerifyCachePtr cache);
+static xmlChar*         xmlSecOpenSSLX509VerifyCacheKey                 (STACK_OF(X509)* certs,
+                                                                         STACK_OF(X509_CRL)* crls,
+                                                                         xmlSecKeyInfoCtx* keyInfoCtx);
+static int              xmlSecOpenSSLX509VerifyCacheLookup              (xmlSecOpenSSLX509VerifyCachePtr cache,
+                                                                         const xmlChar* key,
+                                                                         time_t verificationTime,
+                                                                         xmlSecOpenSSLSizeT* pos);
+static int              xmlSecOpenSSLX509VerifyCacheAdd                 (xmlSecOpenSSLX509VerifyCachePtr cache,
+                                                                         const xmlChar* key,
+                                                                         xmlSecOpenSSLSizeT pos,
+                                                                         time_t expires);
+static int              xmlSecOpenSSLX509VerifyCacheCrlsExpires         (STACK_OF(X509_CRL)* crls,
+                                                                         time_t verificationTime,
+                                                                         time_t* expires);
+
+static int              xmlSecOpenSSLX509CrlsCacheInitialize            (xmlSecOpenSSLX509CrlsCachePtr cache);
+static void             xmlSecOpenSSLX509CrlsCacheFinalize              (xmlSecOpenSSLX509CrlsCachePtr cache);
+static void             xmlSecOpenSSLX509CrlsCacheClearFiltered         (xmlSecOpenSSLX509CrlsCachePtr cache);
+static xmlChar*         xmlSecOpenSSLX509CrlsCacheSignatureKey          (X509_CRL* crl,
+                                                                         X509* issuer_cert);
+static int              xmlSecOpenSSLX509CrlsCacheIsVerified            (xmlSecOpenSSLX509CrlsCachePtr cache,
+                                                                         const xmlChar* key);
+static int              xmlSecOpenSSLX509CrlsCacheAddVerified           (xmlSecOpenSSLX509CrlsCachePtr cache,
+                                                                         const xmlChar* key);
+static int              xmlSecOpenSSLX509CrlsCacheGetFiltered           (xmlSecOpenSSLX509CrlsCachePtr cache,
+                                                                         time_t verificationTime,
+                                                                         STACK_OF(X509_CRL)** out_crls);
+static int              xmlSecOpenSSLX509CrlsCacheSetFiltered           (xmlSecOpenSSLX509CrlsCachePtr cache,
+                                                                         STACK_OF(X509_CRL)* crls,
+                                                                         STACK_OF(X509_CRL)* filtered,
+                                                                         time_t verificationTime);
 /**
  * @brief The OpenSSL X509 certificates store klass.
  * @details The OpenSSL X509 certificates key data store klass.
@@ -194,7 +341,17 @@ xmlSecOpenSSLX509StoreFindCert_ex(xmlSecKeyDataStorePtr store,
         xmlSecOpenSSLX509FindCertCtxFinalize(&findCertCtx);
         return(NULL);
     }
-    for(ii = 0; ii < sk_X509_num(ctx->untrusted); ++ii) {
+
+    /* try the indexes first */
+    ret = xmlSecOpenSSLX509StoreIndexFindCert(ctx, &findCertCtx, &res);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509StoreIndexFindCert", NULL);
+        xmlSecOpenSSLX509FindCertCtxFinalize(&findCertCtx);
+        return(NULL);
+    }
+
+    /* full scan if the indexes can't answer the query */
+    for(ii = 0; (ret == 0) && (ii < sk_X509_num(ctx->untrusted)); ++ii) {
         X509 * cert = sk_X509_value(ctx->untrusted, ii);
         if(cert == NULL) {
             continue;
@@ -241,7 +398,17 @@ xmlSecOpenSSLX509StoreFindCertByValue(xmlSecKeyDataStorePtr store, xmlSecKeyX509
         xmlSecOpenSSLX509FindCertCtxFinalize(&findCertCtx);
         return(NULL);
     }
-    for(ii = 0; ii < sk_X509_num(ctx->untrusted); ++ii) {
+
+    /* try the indexes first */
+    ret = xmlSecOpenSSLX509StoreIndexFindCert(ctx, &findCertCtx, &res);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509StoreIndexFindCert", NULL);
+        xmlSecOpenSSLX509FindCertCtxFinalize(&findCertCtx);
+        return(NULL);
+    }
+
+    /* full scan if the indexes can't answer the query */
+    for(ii = 0; (ret == 0) && (ii < sk_X509_num(ctx->untrusted)); ++ii) {
         X509 * cert = sk_X509_value(ctx->untrusted, ii);
         if(cert == NULL) {
             continue;
@@ -319,14 +486,15 @@ xmlSecOpenSSLX509FindKeyByValue(xmlSecPtrListPtr keysList, xmlSecKeyX509DataValu
 
 
 static int
-xmlSecOpenSSLX509StoreVerifyAndCopyCrls(X509_STORE* xst, X509_STORE_CTX* xsc, STACK_OF(X509)* untrusted, STACK_OF(X509_CRL)* crls,
+xmlSecOpenSSLX509StoreVerifyAndCopyCrls(xmlSecOpenSSLX509StoreCtxPtr ctx, X509_STORE_CTX* xsc, STACK_OF(X509)* certs,
+    STACK_OF(X509)* untrusted, STACK_OF(X509_CRL)* crls,
     xmlSecKeyInfoCtx* keyInfoCtx, STACK_OF(X509_CRL)** out_crls
 ) {
     STACK_OF(X509_CRL)* verified_crls = NULL;
     xmlSecOpenSSLSizeT ii, num, num2;
     int ret;
 
-    xmlSecAssert2(xst != NULL, -1);
+    xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(xsc != NULL, -1);
     xmlSecAssert2(keyInfoCtx != NULL, -1);
     xmlSecAssert2(out_crls != NULL, -1);
@@ -362,7 +530,7 @@ xmlSecOpenSSLX509StoreVerifyAndCopyCrls(X509_STORE* xst, X509_STORE_CTX* xsc, ST
             continue;
         }
 
-        ret = xmlSecOpenSSLX509VerifyCRL(xst, xsc, untrusted, crl, keyInfoCtx);
+        ret = xmlSecOpenSSLX509VerifyCRL(ctx, xsc, certs, untrusted, crl, keyInfoCtx);
         if(ret < 0) {
             xmlSecInternalError("xmlSecOpenSSLX509VerifyCRL", NULL);
             sk_X509_CRL_free(verified_crls);
@@ -420,12 +588,89 @@ xmlSecOpenSSLAsn1TimeIsAfter(const ASN1_TIME * a, time_t * b) {
 #endif /* defined(XMLSEC_OPENSSL_API_400) */
 }
 
+/* returns 0 if the CRL entry revokes the cert, 1 if the entry doesn't apply at
+ * the verification time or a negative value if an error occurs */
+static int
+xmlSecOpenSSLX509StoreCheckRevokedEntry(X509 * cert, X509_REVOKED * revoked_cert, xmlSecKeyInfoCtx* keyInfoCtx) {
+    ASN1_ENUMERATED * reason;
+    int crit = -1;
+    int ret;
+
+    xmlSecAssert2(cert != NULL, -1);
+    xmlSecAssert2(revoked_cert != NULL, -1);
+    xmlSecAssert2(keyInfoCtx != NULL, -1);
+
+    /* the "removeFromCRL" entries (delta CRLs) say that the cert is NOT revoked
+     * anymore, OpenSSL X509_CRL_get0_by_cert() returns 2 for these entries */
+    reason = (ASN1_ENUMERATED *)X509_REVOKED_get_ext_d2i(revoked_cert, NID_crl_reason, &crit, NULL);
+    if(reason != NULL) {
+        long reasonCode = ASN1_ENUMERATED_get(reason);
+        ASN1_ENUMERATED_free(reason);
+        if(reasonCode == CRL_REASON_REMOVE_FROM_CRL) {
+            return(1);
+        }
+    } else if(crit != -1) {
+        /* -1 means no reason code, otherwise the extension is invalid or duplicated */
+        xmlSecOpenSSLError("X509_REVOKED_get_ext_d2i(NID_crl_reason)", NULL);
+        return(-1);
+    }
+
+    /* don't bother checking the revocation date if we are checking against
+     * current time. In this case we assume that CRL didn't come from the future */
+    if(keyInfoCtx->certsVerificationTime > 0) {
+        const ASN1_TIME * revocationDate;
+        time_t tt = keyInfoCtx->certsVerificationTime;
+
+        revocationDate = X509_REVOKED_get0_revocationDate(revoked_cert);
+        if(revocationDate == NULL) {
+            xmlSecOpenSSLError("X509_REVOKED_get0_revocationDate(revoked_cert)", NULL);
+            return(-1);
+        }
+        ret = xmlSecOpenSSLAsn1TimeIsAfter(revocationDate, &tt);
+        if (ret < 0) {
+            xmlSecOpenSSLError("xmlSecOpenSSLAsn1TimeIsAfter(revocationDate)", NULL);
+            return(-1);
+        }
+        /* ret > 0: revocationDate is later than the verification time */
+        if (ret > 0) {
+            XMLSEC_OPENSSL400_CONST X509_NAME *issuer;
+            char issuer_name[256];
+            time_t ts;
+
+            /* revocationDate > certsVerificationTime, we are good */
+            ret = xmlSecOpenSSLX509Asn1TimeToTime(revocationDate, &ts);
+            if (ret < 0) {
+                xmlSecInternalError("xmlSecOpenSSLX509Asn1TimeToTime", NULL);
+                return(-1);
+            }
+            issuer = X509_get_issuer_name(cert);
+            if(issuer != NULL) {
+                xmlSecOpenSSLX509NameToString(issuer, issuer_name, sizeof(issuer_name));
+                xmlSecOtherError3(XMLSEC_ERRORS_R_CRL_NOT_YET_VALID, NULL,
+                    "issuer=%s; revocationDate=%lf", issuer_name, (double)ts);
+            } else {
+                xmlSecOtherError2(XMLSEC_ERRORS_R_CRL_NOT_YET_VALID, NULL,
+                    "revocationDate=%lf", (double)ts);
+            }
+            return(1);
+        }
+    }
+
+    /* cert matches revoked */
+    return(0);
+}
+
+/* The store CRLs have the revoked entries index (see xmlSecOpenSSLX509StoreAdoptCrl()),
+ * the other CRLs (e.g. from the document) are scanned. */
 static int
-xmlSecOpenSSLX509StoreVerifyCertAgainstRevoked(X509 * cert, STACK_OF(X509_REVOKED) *revoked_certs, xmlSecKeyInfoCtx* keyInfoCtx) {
+xmlSecOpenSSLX509StoreVerifyCertAgainstRevoked(X509 * cert, STACK_OF(X509_REVOKED) *revoked_certs,
+    xmlSecOpenSSLX509CrlIndexPtr crlIndex, xmlSecKeyInfoCtx* keyInfoCtx
+) {
     X509_REVOKED * revoked_cert;
     const ASN1_INTEGER * revoked_cert_serial;
     const ASN1_INTEGER * cert_serial;
     xmlSecOpenSSLSizeT ii, num;
+    xmlSecSize pos;
     int ret;
 
     xmlSecAssert2(cert != NULL, -1);
@@ -438,6 +683,26 @@ xmlSecOpenSSLX509StoreVerifyCertAgainstRevoked(X509 * cert, STACK_OF(X509_REVOKE
         return(-1);
     }
 
+    if(crlIndex != NULL) {
+        /* check all the entries with the same serial in the CRL order */
+        for(pos = xmlSecOpenSSLX509CrlIndexLowerBound(crlIndex, cert_serial); pos < crlIndex->size; ++pos) {
+            if(ASN1_INTEGER_cmp(cert_serial, crlIndex->items[pos].serial) != 0) {
+                break;
+            }
+            ret = xmlSecOpenSSLX509StoreCheckRevokedEntry(cert, crlIndex->items[pos].revoked, keyInfoCtx);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecOpenSSLX509StoreCheckRevokedEntry", NULL);
+                return(-1);
+            } else if(ret != 1) {
+                /* cert matches revoked */
+                return(0);
+            }
+        }
+
+        /* success: nomatch */
+        return(1);
+    }
+
     num = sk_X509_REVOKED_num(revoked_certs);
     for(ii = 0; ii < num; ++ii) {
         revoked_cert = sk_X509_REVOKED_value(revoked_certs, ii);
@@ -455,49 +720,14 @@ xmlSecOpenSSLX509StoreVerifyCertAgainstRevoked(X509 * cert, STACK_OF(X509_REVOKE
             continue;
         }
 
-        /* don't bother checking the revocation date if we are checking against
-         * current time. In this case we assume that CRL didn't come from the future */
-        if(keyInfoCtx->certsVerificationTime > 0) {
-            const ASN1_TIME * revocationDate;
-            time_t tt = keyInfoCtx->certsVerificationTime;
-
-            revocationDate = X509_REVOKED_get0_revocationDate(revoked_cert);
-            if(revocationDate == NULL) {
-                xmlSecOpenSSLError("X509_REVOKED_get0_revocationDate(revoked_cert)", NULL);
-                return(-1);
-            }
-            ret = xmlSecOpenSSLAsn1TimeIsAfter(revocationDate, &tt);
-            if (ret < 0) {
-                xmlSecOpenSSLError("xmlSecOpenSSLAsn1TimeIsAfter(revocationDate)", NULL);
-                return(-1);
-            }
-            /* ret > 0: revocationDate is later than the verification time */
-            if (ret > 0) {
-                XMLSEC_OPENSSL400_CONST X509_NAME *issuer;
-                char issuer_name[256];
-                time_t ts;
-
-                /* revocationDate > certsVerificationTime, we are good */
-                ret = xmlSecOpenSSLX509Asn1TimeToTime(revocationDate, &ts);
-                if (ret < 0) {
-                    xmlSecInternalError("xmlSecOpenSSLX509Asn1TimeToTime", NULL);
-                    return(-1);
-                }
-                issuer = X509_get_issuer_name(cert);
-                if(issuer != NULL) {
-                    xmlSecOpenSSLX509NameToString(issuer, issuer_name, sizeof(issuer_name));
-                    xmlSecOtherError3(XMLSEC_ERRORS_R_CRL_NOT_YET_VALID, NULL,
-                        "issuer=%s; revocationDate=%lf", issuer_name, (double)ts);
-                } else {
-                    xmlSecOtherError2(XMLSEC_ERRORS_R_CRL_NOT_YET_VALID, NULL,
-                        "revocationDate=%lf", (double)ts);
-                }
-                continue;
-            }
+        ret = xmlSecOpenSSLX509StoreCheckRevokedEntry(cert, revoked_cert, keyInfoCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509StoreCheckRevokedEntry", NULL);
+            return(-1);
+        } else if(ret != 1) {
+            /* cert matches revoked */
+            return(0);
         }
-
-        /* cert matches revoked */
-        return(0);
     }
 
     /* success: nomatch */
@@ -580,7 +810,9 @@ xmlSecOpenSSLX509StoreFindBestCrl(XMLSEC_OPENSSL400_CONST X509_NAME *cert_issuer
 }
 
 static int
-xmlSecOpenSSLX509StoreVerifyCertAgainstCrls(STACK_OF(X509_CRL) *crls, X509* cert, xmlSecKeyInfoCtx* keyInfoCtx) {
+xmlSecOpenSSLX509StoreVerifyCertAgainstCrls(STACK_OF(X509_CRL) *crls, xmlSecOpenSSLX509CrlIndexPtr crlIndexes,
+    X509* cert, xmlSecKeyInfoCtx* keyInfoCtx
+) {
     XMLSEC_OPENSSL400_CONST X509_NAME *cert_issuer;
     X509_CRL *crl = NULL;
     STACK_OF(X509_REVOKED) * revoked_certs;
@@ -618,7 +850,8 @@ xmlSecOpenSSLX509StoreVerifyCertAgainstCrls(STACK_OF(X509_CRL) *crls, X509* cert
         return(-1);
     }
 
-    ret = xmlSecOpenSSLX509StoreVerifyCertAgainstRevoked(cert, revoked_certs, keyInfoCtx);
+    ret = xmlSecOpenSSLX509StoreVerifyCertAgainstRevoked(cert, revoked_certs,
+        xmlSecOpenSSLX509CrlIndexesFind(crlIndexes, crl), keyInfoCtx);
     if(ret < 0) {
         xmlSecInternalError("xmlSecOpenSSLX509StoreVerifyCertAgainstRevoked", NULL);
         return(-1);
@@ -638,7 +871,9 @@ xmlSecOpenSSLX509StoreVerifyCertAgainstCrls(STACK_OF(X509_CRL) *crls, X509* cert
 
 
 static int
-xmlSecOpenSSLX509StoreVerifyCertsAgainstCrls(STACK_OF(X509)* chain, STACK_OF(X509_CRL)* crls, xmlSecKeyInfoCtx* keyInfoCtx) {
+xmlSecOpenSSLX509StoreVerifyCertsAgainstCrls(STACK_OF(X509)* chain, STACK_OF(X509_CRL)* crls,
+    xmlSecOpenSSLX509CrlIndexPtr crlIndexes, xmlSecKeyInfoCtx* keyInfoCtx
+) {
     X509 * cert;
     xmlSecOpenSSLSizeT ii, num_certs;
     int ret;
@@ -654,7 +889,7 @@ xmlSecOpenSSLX509StoreVerifyCertsAgainstCrls(STACK_OF(X509)* chain, STACK_OF(X50
         if(cert == NULL) {
             continue;
         }
-        ret = xmlSecOpenSSLX509StoreVerifyCertAgainstCrls(crls, cert, keyInfoCtx);
+        ret = xmlSecOpenSSLX509StoreVerifyCertAgainstCrls(crls, crlIndexes, cert, keyInfoCtx);
         if(ret < 0) {
             xmlSecInternalError("xmlSecOpenSSLX509StoreVerifyCertAgainstCrls", NULL);
             return(-1);
@@ -706,12 +941,16 @@ xmlSecOpenSSLX509StoreSetCtx(X509_STORE_CTX* xsc, xmlSecKeyInfoCtx* keyInfoCtx)
     return(0);
 }
 
+/* the optional chainExpires is set to the earliest notAfter in the verified chain,
+ * the optional crls2Indexes are the revoked entries indexes for the crls2 */
 static int
 xmlSecOpenSSLX509StoreVerifyCert(X509_STORE* xst, X509_STORE_CTX* xsc, X509* cert,
     STACK_OF(X509)* untrusted, STACK_OF(X509_CRL)* crls, STACK_OF(X509_CRL)* crls2,
-    xmlSecKeyInfoCtx* keyInfoCtx
+    xmlSecOpenSSLX509CrlIndexPtr crls2Indexes, xmlSecKeyInfoCtx* keyInfoCtx, time_t* chainExpires
 ) {
     STACK_OF(X509)* chain;
+    xmlSecOpenSSLSizeT ii, num;
+    time_t notAfter;
     int ret;
     int res = -1;
 
@@ -799,7 +1038,7 @@ xmlSecOpenSSLX509StoreVerifyCert(X509_STORE* xst, X509_STORE_CTX* xsc, X509* cer
 
     /* now check against crls */
     if(crls != NULL) {
-        ret = xmlSecOpenSSLX509StoreVerifyCertsAgainstCrls(chain, crls, keyInfoCtx);
+        ret = xmlSecOpenSSLX509StoreVerifyCertsAgainstCrls(chain, crls, NULL, keyInfoCtx);
         if(ret < 0) {
             xmlSecInternalError("xmlSecOpenSSLX509StoreVerifyCertsAgainstCrls(crls)", NULL);
             goto done;
@@ -810,7 +1049,7 @@ xmlSecOpenSSLX509StoreVerifyCert(X509_STORE* xst, X509_STORE_CTX* xsc, X509* cer
         }
     }
     if(crls2 != NULL) {
-        ret = xmlSecOpenSSLX509StoreVerifyCertsAgainstCrls(chain, crls2, keyInfoCtx);
+        ret = xmlSecOpenSSLX509StoreVerifyCertsAgainstCrls(chain, crls2, crls2Indexes, keyInfoCtx);
         if(ret < 0) {
             xmlSecInternalError("xmlSecOpenSSLX509StoreVerifyCertsAgainstCrls(crls2)", NULL);
             goto done;
@@ -821,6 +1060,25 @@ xmlSecOpenSSLX509StoreVerifyCert(X509_STORE* xst, X509_STORE_CTX* xsc, X509* cer
         }
     }
 
+    if(chainExpires != NULL) {
+        (*chainExpires) = 0;
+        num = sk_X509_num(chain);
+        for(ii = 0; ii < num; ++ii) {
+            X509* chainCert = sk_X509_value(chain, ii);
+            if((chainCert == NULL) || (X509_get0_notAfter(chainCert) == NULL)) {
+                continue;
+            }
+            ret = xmlSecOpenSSLX509Asn1TimeToTime(X509_get0_notAfter(chainCert), &notAfter);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecOpenSSLX509Asn1TimeToTime(notAfter)", NULL);
+                goto done;
+            }
+            if(((*chainExpires) == 0) || (notAfter < (*chainExpires))) {
+                (*chainExpires) = notAfter;
+            }
+        }
+    }
+
     /* success: verified */
     res = 1;
 
@@ -887,6 +1145,42 @@ xmlSecOpenSSLX509FilterCrlsByTime(STACK_OF(X509_CRL)* crls, xmlSecKeyInfoCtx* ke
     return(0);
 }
 
+/* Filters the store CRLs by time validity. The result is reused until the verification
+ * time crosses the next thisUpdate/nextUpdate boundary of the store CRLs.
+ */
+static int
+xmlSecOpenSSLX509StoreFilterCrlsByTime(xmlSecOpenSSLX509StoreCtxPtr ctx, xmlSecKeyInfoCtx* keyInfoCtx, STACK_OF(X509_CRL)** out_crls) {
+    time_t verification_time;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(keyInfoCtx != NULL, -1);
+    xmlSecAssert2(out_crls != NULL, -1);
+
+    verification_time = (keyInfoCtx->certsVerificationTime > 0) ?
+                        keyInfoCtx->certsVerificationTime : time(NULL);
+    ret = xmlSecOpenSSLX509CrlsCacheGetFiltered(&(ctx->crlsCache), verification_time, out_crls);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509CrlsCacheGetFiltered", NULL);
+        return(-1);
+    } else if(ret == 1) {
+        return(0);
+    }
+
+    ret = xmlSecOpenSSLX509FilterCrlsByTime(ctx->crls, keyInfoCtx, out_crls);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509FilterCrlsByTime", NULL);
+        return(-1);
+    }
+
+    ret = xmlSecOpenSSLX509CrlsCacheSetFiltered(&(ctx->crlsCache), ctx->crls, (*out_crls), verification_time);
+    if(ret < 0) {
+        /* the CRLs are filtered, the cache is just an optimization */
+        xmlSecInternalError("xmlSecOpenSSLX509CrlsCacheSetFiltered", NULL);
+    }
+    return(0);
+}
+
 /**
  * @brief Verifies @p certs list.
  * @param store the pointer to X509 key data store klass.
@@ -904,6 +1198,8 @@ xmlSecOpenSSLX509StoreVerify(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509*
     X509 * res = NULL;
     X509 * cert;
     X509_STORE_CTX *xsc = NULL;
+    xmlChar* cache_key = NULL;
+    time_t verification_time, expires, crls_expires;
     xmlSecOpenSSLSizeT ii, num;
     int ret;
 
@@ -915,6 +1211,24 @@ xmlSecOpenSSLX509StoreVerify(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509*
     xmlSecAssert2(ctx != NULL, NULL);
     xmlSecAssert2(ctx->xst != NULL, NULL);
 
+    /* check if the same certs were already verified with the same parameters */
+    verification_time = (keyInfoCtx->certsVerificationTime > 0) ?
+                        keyInfoCtx->certsVerificationTime : time(NULL);
+    if(((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_X509DATA_DONT_VERIFY_CERTS) == 0) &&
+       (xmlSecOpenSSLX509VerifyCacheIsEnabled(&(ctx->verifyCache)) == 1))
+    {
+        cache_key = xmlSecOpenSSLX509VerifyCacheKey(certs, crls, keyInfoCtx);
+        if(cache_key == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLX509VerifyCacheKey", xmlSecKeyDataStoreGetName(store));
+            goto done;
+        }
+        ret = xmlSecOpenSSLX509VerifyCacheLookup(&(ctx->verifyCache), cache_key, verification_time, &ii);
+        if((ret == 1) && (ii < sk_X509_num(certs))) {
+            res = sk_X509_value(certs, ii);
+            goto done;
+        }
+    }
+
     /* reuse xsc for both crls and certs verification */
     xsc = X509_STORE_CTX_new_ex(xmlSecOpenSSLGetLibCtx(), NULL);
     if(xsc == NULL) {
@@ -952,16 +1266,16 @@ xmlSecOpenSSLX509StoreVerify(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509*
     }
 
     /* copy crls list but remove all non-verified (we assume that CRLs in the store are already verified) */
-    ret = xmlSecOpenSSLX509StoreVerifyAndCopyCrls(ctx->xst, xsc, all_untrusted_certs, crls, keyInfoCtx, &verified_crls);
+    ret = xmlSecOpenSSLX509StoreVerifyAndCopyCrls(ctx, xsc, certs, all_untrusted_certs, crls, keyInfoCtx, &verified_crls);
     if(ret < 0) {
         xmlSecInternalError("xmlSecOpenSSLX509StoreVerifyAndCopyCrls", xmlSecKeyDataStoreGetName(store));
         goto done;
     }
 
     /* filter store crls by time validity (signatures already trusted) */
-    ret = xmlSecOpenSSLX509FilterCrlsByTime(ctx->crls, keyInfoCtx, &time_filtered_crls);
+    ret = xmlSecOpenSSLX509StoreFilterCrlsByTime(ctx, keyInfoCtx, &time_filtered_crls);
     if(ret < 0) {
-        xmlSecInternalError("xmlSecOpenSSLX509FilterCrlsByTime", xmlSecKeyDataStoreGetName(store));
+        xmlSecInternalError("xmlSecOpenSSLX509StoreFilterCrlsByTime", xmlSecKeyDataStoreGetName(store));
         goto done;
     }
 
@@ -978,7 +1292,7 @@ xmlSecOpenSSLX509StoreVerify(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509*
             continue;
         }
 
-        ret = xmlSecOpenSSLX509StoreVerifyCert(ctx->xst, xsc, cert, all_untrusted_certs, verified_crls, time_filtered_crls, keyInfoCtx);
+        ret = xmlSecOpenSSLX509StoreVerifyCert(ctx->xst, xsc, cert, all_untrusted_certs, verified_crls, time_filtered_crls, ctx->crlIndexes, keyInfoCtx, &expires);
         if(ret < 0) {
             xmlSecInternalError("xmlSecOpenSSLX509StoreVerifyCert", xmlSecKeyDataStoreGetName(store));
             goto done;
@@ -988,6 +1302,22 @@ xmlSecOpenSSLX509StoreVerify(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509*
 
         /* success! */
         res = cert;
+
+        /* the result might change once a cert or a CRL expires or a CRL becomes valid */
+        if(cache_key != NULL) {
+            crls_expires = expires;
+            ret = xmlSecOpenSSLX509VerifyCacheCrlsExpires(crls, verification_time, &crls_expires);
+            if(ret == 0) {
+                ret = xmlSecOpenSSLX509VerifyCacheCrlsExpires(ctx->crls, verification_time, &crls_expires);
+            }
+            if(ret == 0) {
+                ret = xmlSecOpenSSLX509VerifyCacheAdd(&(ctx->verifyCache), cache_key, ii, crls_expires);
+            }
+            if(ret < 0) {
+                /* the cert is verified, the cache is just an optimization */
+                xmlSecInternalError("xmlSecOpenSSLX509VerifyCacheAdd", xmlSecKeyDataStoreGetName(store));
+            }
+        }
         break;
     }
 
@@ -1007,6 +1337,9 @@ done:
     if(xsc != NULL) {
         X509_STORE_CTX_free(xsc);
     }
+    if(cache_key != NULL) {
+        xmlFree(cache_key);
+    }
     return(res);
 }
 
@@ -1085,21 +1418,21 @@ xmlSecOpenSSLX509StoreVerifyKey(xmlSecKeyDataStorePtr store, xmlSecKeyPtr key, x
     }
 
     /* copy crls list but remove all non-verified (we assume that CRLs in the store are already verified) */
-    ret = xmlSecOpenSSLX509StoreVerifyAndCopyCrls(ctx->xst, xsc, all_untrusted_certs, crls, keyInfoCtx, &verified_crls);
+    ret = xmlSecOpenSSLX509StoreVerifyAndCopyCrls(ctx, xsc, certs, all_untrusted_certs, crls, keyInfoCtx, &verified_crls);
     if(ret < 0) {
         xmlSecInternalError("xmlSecOpenSSLX509StoreVerifyAndCopyCrls", xmlSecKeyDataStoreGetName(store));
         goto done;
     }
 
     /* filter store crls by time validity (signatures already trusted) */
-    ret = xmlSecOpenSSLX509FilterCrlsByTime(ctx->crls, keyInfoCtx, &time_filtered_crls);
+    ret = xmlSecOpenSSLX509StoreFilterCrlsByTime(ctx, keyInfoCtx, &time_filtered_crls);
     if(ret < 0) {
-        xmlSecInternalError("xmlSecOpenSSLX509FilterCrlsByTime", xmlSecKeyDataStoreGetName(store));
+        xmlSecInternalError("xmlSecOpenSSLX509StoreFilterCrlsByTime", xmlSecKeyDataStoreGetName(store));
         goto done;
     }
 
     /* verify */
-    ret = xmlSecOpenSSLX509StoreVerifyCert(ctx->xst, xsc, keyCert, all_untrusted_certs, verified_crls, time_filtered_crls, keyInfoCtx);
+    ret = xmlSecOpenSSLX509StoreVerifyCert(ctx->xst, xsc, keyCert, all_untrusted_certs, verified_crls, time_filtered_crls, ctx->crlIndexes, keyInfoCtx, NULL);
     if(ret < 0) {
         xmlSecInternalError("xmlSecOpenSSLX509StoreVerifyCert", xmlSecKeyDataStoreGetName(store));
         goto done;
@@ -1171,7 +1504,7 @@ xmlSecOpenSSLX509StoreVerifyCrl(xmlSecKeyDataStorePtr store, X509_CRL* crl,
     }
 
     /* Verify CRL signature, issuer, and time validity */
-    ret = xmlSecOpenSSLX509VerifyCRL(ctx->xst, xsc, ctx->untrusted, crl, keyInfoCtx);
+    ret = xmlSecOpenSSLX509VerifyCRL(ctx, xsc, NULL, ctx->untrusted, crl, keyInfoCtx);
     if(ret < 0) {
         xmlSecInternalError("xmlSecOpenSSLX509VerifyCRL", xmlSecKeyDataStoreGetName(store));
         goto done;
@@ -1222,6 +1555,7 @@ xmlSecOpenSSLX509StoreAdoptCert(xmlSecKeyDataStorePtr store, X509* cert, xmlSecK
         }
         /* add cert increments the reference */
         X509_free(cert);
+        xmlSecOpenSSLX509VerifyCacheClear(&(ctx->verifyCache));
     } else {
         xmlSecOpenSSLSizeT ret;
 
@@ -1232,6 +1566,18 @@ xmlSecOpenSSLX509StoreAdoptCert(xmlSecKeyDataStorePtr store, X509* cert, xmlSecK
             xmlSecOpenSSLError("sk_X509_push", xmlSecKeyDataStoreGetName(store));
             return(-1);
         }
+
+        /* keep the indexes in sync with the untrusted certs list */
+        if(xmlSecOpenSSLX509StoreIndexIsValid(ctx) != 0) {
+            if(xmlSecOpenSSLX509StoreIndexAdd(ctx, cert) < 0) {
+                xmlSecInternalError("xmlSecOpenSSLX509StoreIndexAdd", xmlSecKeyDataStoreGetName(store));
+                (void)sk_X509_pop(ctx->untrusted);
+                /* lookups fall back to the full scan */
+                xmlSecOpenSSLX509StoreIndexFinalize(ctx);
+                return(-1);
+            }
+        }
+        xmlSecOpenSSLX509VerifyCacheClear(&(ctx->verifyCache));
     }
     return(0);
 }
@@ -1246,6 +1592,7 @@ xmlSecOpenSSLX509StoreAdoptCert(xmlSecKeyDataStorePtr store, X509* cert, xmlSecK
 int
 xmlSecOpenSSLX509StoreAdoptCrl(xmlSecKeyDataStorePtr store, X509_CRL* crl) {
     xmlSecOpenSSLX509StoreCtxPtr ctx;
+    xmlSecOpenSSLX509CrlIndexPtr crlIndex;
     xmlSecOpenSSLSizeT ret;
 
     xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecOpenSSLX509StoreId), -1);
@@ -1255,15 +1602,93 @@ xmlSecOpenSSLX509StoreAdoptCrl(xmlSecKeyDataStorePtr store, X509_CRL* crl) {
     xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(ctx->crls != NULL, -1);
 
+    crlIndex = xmlSecOpenSSLX509CrlIndexCreate(crl);
+    if(crlIndex == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509CrlIndexCreate", xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
     ret = sk_X509_CRL_push(ctx->crls, crl);
     if(ret <= 0) {
         xmlSecOpenSSLError("sk_X509_CRL_push", xmlSecKeyDataStoreGetName(store));
+        xmlSecOpenSSLX509CrlIndexesDestroy(crlIndex);
         return(-1);
     }
+    crlIndex->next = ctx->crlIndexes;
+    ctx->crlIndexes = crlIndex;
+    xmlSecOpenSSLX509VerifyCacheClear(&(ctx->verifyCache));
+    xmlSecOpenSSLX509CrlsCacheClearFiltered(&(ctx->crlsCache));
 
     return (0);
 }
 
+/**
+ * @brief Sets the max size of the certificates verification results cache.
+ * @details The store can remember the successful results of
+ * #xmlSecOpenSSLX509StoreVerify for the same certificates, CRLs and
+ * verification parameters in a bounded LRU cache. A cached result expires
+ * at the earliest "not valid after" time of the verified chain certificates
+ * or the CRLs "next update" time, and all the results are dropped when
+ * certificates or CRLs are added to the store. The cache is disabled by
+ * default. Note that the results do not reflect the changes in the trusted
+ * certificates folders after the result was cached.
+ * @param store the pointer to X509 key data store klass.
+ * @param size the max number of the cached results (0 disables the cache).
+ * @return 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecOpenSSLX509StoreSetVerifyCacheSize(xmlSecKeyDataStorePtr store, xmlSecSize size) {
+    xmlSecOpenSSLX509StoreCtxPtr ctx;
+    xmlSecOpenSSLX509VerifyCachePtr cache;
+
+    xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecOpenSSLX509StoreId), -1);
+
+    ctx = xmlSecOpenSSLX509StoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+    cache = &(ctx->verifyCache);
+    xmlSecAssert2(cache->mutex != NULL, -1);
+
+    xmlSecOpenSSLX509VerifyCacheClear(cache);
+
+    xmlMutexLock(cache->mutex);
+    cache->maxSize = size;
+    cache->hits = 0;
+    cache->misses = 0;
+    xmlMutexUnlock(cache->mutex);
+    return(0);
+}
+
+/**
+ * @brief Gets the certificates verification results cache statistics.
+ * @details Gets the number of the certificates verification results cache
+ * hits and misses since the cache was enabled with
+ * #xmlSecOpenSSLX509StoreSetVerifyCacheSize.
+ * @param store the pointer to X509 key data store klass.
+ * @param hits the optional pointer to the cache hits number.
+ * @param misses the optional pointer to the cache misses number.
+ */
+void
+xmlSecOpenSSLX509StoreGetVerifyCacheStats(xmlSecKeyDataStorePtr store, xmlSecSize* hits, xmlSecSize* misses) {
+    xmlSecOpenSSLX509StoreCtxPtr ctx;
+    xmlSecOpenSSLX509VerifyCachePtr cache;
+
+    xmlSecAssert(xmlSecKeyDataStoreCheckId(store, xmlSecOpenSSLX509StoreId));
+
+    ctx = xmlSecOpenSSLX509StoreGetCtx(store);
+    xmlSecAssert(ctx != NULL);
+    cache = &(ctx->verifyCache);
+    xmlSecAssert(cache->mutex != NULL);
+
+    xmlMutexLock(cache->mutex);
+    if(hits != NULL) {
+        (*hits) = cache->hits;
+    }
+    if(misses != NULL) {
+        (*misses) = cache->misses;
+    }
+    xmlMutexUnlock(cache->mutex);
+}
+
 /**
  * @brief Adds all certs in the @p path to the list of trusted certs
  * @param store the pointer to OpenSSL x509 store.
@@ -1298,6 +1723,7 @@ xmlSecOpenSSLX509StoreAddCertsPath(xmlSecKeyDataStorePtr store, const char *path
                             xmlSecErrorsSafeString(path));
         return(-1);
     }
+    xmlSecOpenSSLX509VerifyCacheClear(&(ctx->verifyCache));
     return(0);
 }
 
@@ -1335,6 +1761,7 @@ xmlSecOpenSSLX509StoreAddCertsFile(xmlSecKeyDataStorePtr store, const char *file
                             xmlSecErrorsSafeString(filename));
         return(-1);
     }
+    xmlSecOpenSSLX509VerifyCacheClear(&(ctx->verifyCache));
     return(0);
 }
 
@@ -1398,6 +1825,13 @@ xmlSecOpenSSLX509StoreInitialize(xmlSecKeyDataStorePtr store) {
         return(-1);
     }
 
+    ret = xmlSecOpenSSLX509StoreIndexInitialize(ctx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509StoreIndexInitialize",
+                            xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
     ctx->crls = sk_X509_CRL_new_null();
     if(ctx->crls == NULL) {
         xmlSecOpenSSLError("sk_X509_CRL_new_null",
@@ -1414,6 +1848,20 @@ xmlSecOpenSSLX509StoreInitialize(xmlSecKeyDataStorePtr store) {
     X509_VERIFY_PARAM_set_depth(ctx->vpm, 9); /* the default cert verification path in openssl */
     X509_STORE_set1_param(ctx->xst, ctx->vpm);
 
+    ret = xmlSecOpenSSLX509VerifyCacheInitialize(&(ctx->verifyCache));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509VerifyCacheInitialize",
+                            xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
+    ret = xmlSecOpenSSLX509CrlsCacheInitialize(&(ctx->crlsCache));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509CrlsCacheInitialize",
+                            xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
 
     return(0);
 }
@@ -1430,15 +1878,21 @@ xmlSecOpenSSLX509StoreFinalize(xmlSecKeyDataStorePtr store) {
     if(ctx->xst != NULL) {
         X509_STORE_free(ctx->xst);
     }
+    xmlSecOpenSSLX509StoreIndexFinalize(ctx);
     if(ctx->untrusted != NULL) {
         sk_X509_pop_free(ctx->untrusted, X509_free);
     }
+    if(ctx->crlIndexes != NULL) {
+        xmlSecOpenSSLX509CrlIndexesDestroy(ctx->crlIndexes);
+    }
     if(ctx->crls != NULL) {
         sk_X509_CRL_pop_free(ctx->crls, X509_CRL_free);
     }
     if(ctx->vpm != NULL) {
         X509_VERIFY_PARAM_free(ctx->vpm);
     }
+    xmlSecOpenSSLX509VerifyCacheFinalize(&(ctx->verifyCache));
+    xmlSecOpenSSLX509CrlsCacheFinalize(&(ctx->crlsCache));
 
     OPENSSL_cleanse(ctx, sizeof(xmlSecOpenSSLX509StoreCtx));
 }
@@ -1446,165 +1900,1844 @@ xmlSecOpenSSLX509StoreFinalize(xmlSecKeyDataStorePtr store) {
 
 /******************************************************************************
  *
- * Low-level x509 functions
+ * Untrusted certificates indexes: the keys are built to match exactly the same
+ * certificates as xmlSecOpenSSLX509FindCertCtxMatch() does. If the indexes
+ * are not in sync with the untrusted certificates list (e.g. an error occured
+ * while adding a certificate), the lookups fall back to the full scan.
  *
   *****************************************************************************/
-static X509*
-xmlSecOpenSSLX509FindTrustedIssuer(X509_STORE* xst, XMLSEC_OPENSSL400_CONST X509_NAME* issuer) {
-    STACK_OF(X509_OBJECT)* objects = NULL;
-    xmlSecOpenSSLSizeT ii, num;
-    X509* issuer_cert = NULL;
-
-    xmlSecAssert2(xst != NULL, NULL);
-    xmlSecAssert2(issuer != NULL, NULL);
+static const char xmlSecOpenSSLX509IndexHexDigits[] = "0123456789abcdef";
 
-    /* Get all objects from the trusted store */
-#if defined(XMLSEC_OPENSSL_API_350)
-    objects = X509_STORE_get1_objects(xst);
-    if(objects == NULL) {
-        return(NULL);
-    }
-#else   /* defined(XMLSEC_OPENSSL_API_350) */
-    objects = X509_STORE_get0_objects(xst);
-    if(objects == NULL) {
-        return(NULL);
-    }
-#endif /* defined(XMLSEC_OPENSSL_API_350) */
+static int
+xmlSecOpenSSLX509IndexAppendHex(xmlSecBufferPtr buf, const xmlSecByte* data, xmlSecSize size) {
+    xmlSecByte hex[2];
+    xmlSecSize ii;
+    int ret;
 
-    /* Search for a certificate with matching subject */
-    num = sk_X509_OBJECT_num(objects);
-    for(ii = 0; ii < num; ++ii) {
-        X509_OBJECT* obj = sk_X509_OBJECT_value(objects, ii);
-        X509* cert;
-        XMLSEC_OPENSSL400_CONST X509_NAME* cert_subject;
+    xmlSecAssert2(buf != NULL, -1);
 
-        if(obj == NULL) {
-            continue;
+    for(ii = 0; ii < size; ++ii) {
+        hex[0] = (xmlSecByte)xmlSecOpenSSLX509IndexHexDigits[(data[ii] >> 4) & 0x0F];
+        hex[1] = (xmlSecByte)xmlSecOpenSSLX509IndexHexDigits[data[ii] & 0x0F];
+        ret = xmlSecBufferAppend(buf, hex, sizeof(hex));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferAppend", NULL);
+            return(-1);
         }
+    }
+    return(0);
+}
 
-        /* Check if this object is a certificate */
-        if(X509_OBJECT_get_type(obj) != X509_LU_X509) {
-            continue;
-        }
+static int
+xmlSecOpenSSLX509IndexAppendAsn1String(xmlSecBufferPtr buf, XMLSEC_OPENSSL400_CONST ASN1_STRING* str) {
+    xmlSecSize size;
+    int len;
+    int ret;
 
-        cert = X509_OBJECT_get0_X509(obj);
-        if(cert == NULL) {
-            continue;
-        }
+    xmlSecAssert2(buf != NULL, -1);
 
-        cert_subject = X509_get_subject_name(cert);
-        if(cert_subject == NULL) {
-            continue;
-        }
+    if(str == NULL) {
+        return(0);
+    }
+    len = ASN1_STRING_length(str);
+    if(len <= 0) {
+        return(0);
+    }
+    XMLSEC_SAFE_CAST_INT_TO_SIZE(len, size, return(-1), NULL);
 
-        /* Check if subject matches the issuer we're looking for */
-        if(X509_NAME_cmp(cert_subject, issuer) == 0) {
-            /* Found a match, duplicate and return */
-            issuer_cert = X509_dup(cert);
-            if(issuer_cert == NULL) {
-                xmlSecOpenSSLError("X509_dup", NULL);
-            }
-            break;
+    /* ASN1_INTEGER_cmp() takes the sign into account */
+    if(ASN1_STRING_type(str) == V_ASN1_NEG_INTEGER) {
+        ret = xmlSecBufferAppend(buf, BAD_CAST "-", 1);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferAppend", NULL);
+            return(-1);
         }
     }
+    return(xmlSecOpenSSLX509IndexAppendHex(buf, ASN1_STRING_get0_data(str), size));
+}
 
-    /* list returned by X509_STORE_get1_objects needs to be freed */
-#if defined(XMLSEC_OPENSSL_API_350)
-    sk_X509_OBJECT_pop_free(objects, X509_OBJECT_free);
-#endif /* defined(XMLSEC_OPENSSL_API_350) */
+static xmlChar*
+xmlSecOpenSSLX509IndexBufferToKey(xmlSecBufferPtr buf) {
+    xmlChar* res;
+    int len;
 
-    /* done */
-    return(issuer_cert);
-}
+    xmlSecAssert2(buf != NULL, NULL);
 
-static X509*
-xmlSecOpenSSLX509FindUntrustedIssuer(XMLSEC_OPENSSL400_CONST X509_NAME* issuer, X509_STORE* xst, X509_STORE_CTX* xsc, STACK_OF(X509)* untrusted, xmlSecKeyInfoCtx* keyInfoCtx) {
-    X509* issuer_cert = NULL;
+    XMLSEC_SAFE_CAST_SIZE_TO_INT(xmlSecBufferGetSize(buf), len, return(NULL), NULL);
+    res = xmlStrndup(xmlSecBufferGetData(buf), len);
+    if(res == NULL) {
+        xmlSecStrdupError(xmlSecBufferGetData(buf), NULL);
+        return(NULL);
+    }
+    return(res);
+}
+
+static xmlChar*
+xmlSecOpenSSLX509IndexHexKey(const xmlSecByte* data, xmlSecSize size) {
+    xmlSecBuffer buf;
+    xmlChar* res;
+    int ret;
+
+    ret = xmlSecBufferInitialize(&buf, 2 * size + 1);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        return(NULL);
+    }
+    ret = xmlSecOpenSSLX509IndexAppendHex(&buf, data, size);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509IndexAppendHex", NULL);
+        xmlSecBufferFinalize(&buf);
+        return(NULL);
+    }
+    res = xmlSecOpenSSLX509IndexBufferToKey(&buf);
+    xmlSecBufferFinalize(&buf);
+    return(res);
+}
+
+static xmlChar*
+xmlSecOpenSSLX509IndexAsn1StringKey(XMLSEC_OPENSSL400_CONST ASN1_STRING* str) {
+    xmlSecBuffer buf;
+    xmlChar* res;
+    int ret;
+
+    xmlSecAssert2(str != NULL, NULL);
+
+    ret = xmlSecBufferInitialize(&buf, 64);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        return(NULL);
+    }
+    ret = xmlSecOpenSSLX509IndexAppendAsn1String(&buf, str);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509IndexAppendAsn1String", NULL);
+        xmlSecBufferFinalize(&buf);
+        return(NULL);
+    }
+    res = xmlSecOpenSSLX509IndexBufferToKey(&buf);
+    xmlSecBufferFinalize(&buf);
+    return(res);
+}
+
+/* the same entries (in any order) produce the same key, see xmlSecOpenSSLX509_NAME_ENTRY_cmp() */
+static xmlChar*
+xmlSecOpenSSLX509IndexNameKey(XMLSEC_OPENSSL400_CONST X509_NAME* name) {
+    STACK_OF(X509_NAME_ENTRY)* entries;
+    xmlSecBuffer buf;
+    xmlChar* res = NULL;
+    char oid[128];
+    xmlSecOpenSSLSizeT ii, num;
+    xmlSecSize oidSize;
+    int ret;
+
+    xmlSecAssert2(name != NULL, NULL);
+
+    entries = xmlSecOpenSSLX509_NAME_ENTRIES_copy(name);
+    if(entries == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509_NAME_ENTRIES_copy", NULL);
+        return(NULL);
+    }
+    (void)sk_X509_NAME_ENTRY_set_cmp_func(entries, xmlSecOpenSSLX509_NAME_ENTRY_cmp);
+    sk_X509_NAME_ENTRY_sort(entries);
+
+    ret = xmlSecBufferInitialize(&buf, 256);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        sk_X509_NAME_ENTRY_pop_free(entries, X509_NAME_ENTRY_free);
+        return(NULL);
+    }
+
+    num = sk_X509_NAME_ENTRY_num(entries);
+    for(ii = 0; ii < num; ++ii) {
+        X509_NAME_ENTRY* entry = sk_X509_NAME_ENTRY_value(entries, ii);
+        XMLSEC_OPENSSL400_CONST ASN1_OBJECT* obj;
+
+        if(entry == NULL) {
+            continue;
+        }
+
+        /* numeric OID: equal for equal objects */
+        obj = X509_NAME_ENTRY_get_object(entry);
+        if(obj != NULL) {
+            ret = OBJ_obj2txt(oid, sizeof(oid), obj, 1);
+            if((ret <= 0) || (ret >= (int)sizeof(oid))) {
+                xmlSecOpenSSLError("OBJ_obj2txt", NULL);
+                goto done;
+            }
+            XMLSEC_SAFE_CAST_INT_TO_SIZE(ret, oidSize, goto done, NULL);
+            ret = xmlSecBufferAppend(&buf, BAD_CAST oid, oidSize);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecBufferAppend", NULL);
+                goto done;
+            }
+        }
+        ret = xmlSecBufferAppend(&buf, BAD_CAST "=", 1);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferAppend", NULL);
+            goto done;
+        }
+        ret = xmlSecOpenSSLX509IndexAppendAsn1String(&buf, X509_NAME_ENTRY_get_data(entry));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509IndexAppendAsn1String", NULL);
+            goto done;
+        }
+        ret = xmlSecBufferAppend(&buf, BAD_CAST ";", 1);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferAppend", NULL);
+            goto done;
+        }
+    }
+
+    res = xmlSecOpenSSLX509IndexBufferToKey(&buf);
+
+done:
+    xmlSecBufferFinalize(&buf);
+    sk_X509_NAME_ENTRY_pop_free(entries, X509_NAME_ENTRY_free);
+    return(res);
+}
+
+/* returns 0 and NULL key if the cert doesn't have SKI */
+static int
+xmlSecOpenSSLX509IndexSkiKey(X509* cert, xmlChar** key) {
+    XMLSEC_OPENSSL400_CONST X509_EXTENSION* ext;
+    ASN1_OCTET_STRING* keyId;
+    int index;
+
+    xmlSecAssert2(cert != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    (*key) = NULL;
+    index = X509_get_ext_by_NID(cert, NID_subject_key_identifier, -1);
+    if(index < 0) {
+        return(0);
+    }
+    ext = X509_get_ext(cert, index);
+    if(ext == NULL) {
+        return(0);
+    }
+    keyId = (ASN1_OCTET_STRING *)X509V3_EXT_d2i(ext);
+    if(keyId == NULL) {
+        return(0);
+    }
+
+    (*key) = xmlSecOpenSSLX509IndexAsn1StringKey(keyId);
+    ASN1_OCTET_STRING_free(keyId);
+    if((*key) == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509IndexAsn1StringKey", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/* the items are added in the untrusted certs order, keep the first one */
+static int
+xmlSecOpenSSLX509IndexAddItem(xmlHashTablePtr table, const xmlChar* key, const xmlChar* key2, xmlSecOpenSSLX509IndexItemPtr item) {
+    int ret;
+
+    xmlSecAssert2(table != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(item != NULL, -1);
+
+    if(xmlHashLookup2(table, key, key2) != NULL) {
+        return(0);
+    }
+    ret = xmlHashAddEntry2(table, key, key2, item);
+    if(ret != 0) {
+        xmlSecXmlError2("xmlHashAddEntry2", NULL, "key=%s", xmlSecErrorsSafeString(key));
+        return(-1);
+    }
+    return(0);
+}
+
+static xmlSecOpenSSLX509IndexItemPtr
+xmlSecOpenSSLX509IndexLookup(xmlHashTablePtr table, const xmlChar* key, const xmlChar* key2, xmlSecOpenSSLX509IndexItemPtr best) {
+    xmlSecOpenSSLX509IndexItemPtr item;
+
+    xmlSecAssert2(table != NULL, best);
+    xmlSecAssert2(key != NULL, best);
+
+    item = (xmlSecOpenSSLX509IndexItemPtr)xmlHashLookup2(table, key, key2);
+    if((item == NULL) || ((best != NULL) && (best->pos < item->pos))) {
+        return(best);
+    }
+    return(item);
+}
+
+static int
+xmlSecOpenSSLX509StoreIndexAddDigest(xmlSecOpenSSLX509StoreCtxPtr ctx, const EVP_MD* md) {
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->byDigestSize < XMLSEC_OPENSSL_X509_INDEX_DIGESTS_MAX, -1);
+
+    if(md == NULL) {
+        return(0);
+    }
+    ctx->byDigest[ctx->byDigestSize].certs = xmlHashCreate(0);
+    if(ctx->byDigest[ctx->byDigestSize].certs == NULL) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        return(-1);
+    }
+    ctx->byDigest[ctx->byDigestSize].md = md;
+    ++ctx->byDigestSize;
+    return(0);
+}
+
+static int
+xmlSecOpenSSLX509StoreIndexInitialize(xmlSecOpenSSLX509StoreCtxPtr ctx) {
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->untrusted != NULL, -1);
+    xmlSecAssert2(sk_X509_num(ctx->untrusted) == 0, -1);
+
+    ctx->bySubject = xmlHashCreate(0);
+    ctx->byIssuerSerial = xmlHashCreate(0);
+    ctx->bySki = xmlHashCreate(0);
+    ctx->bySubjectHash = xmlHashCreate(0);
+    if((ctx->bySubject == NULL) || (ctx->byIssuerSerial == NULL) || (ctx->bySki == NULL) || (ctx->bySubjectHash == NULL)) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        xmlSecOpenSSLX509StoreIndexFinalize(ctx);
+        return(-1);
+    }
+
+    /* the digests supported in xmlSecOpenSSLX509GetDigestFromAlgorithm() */
+    ret = 0;
+#ifndef XMLSEC_NO_SHA1
+    ret = (ret < 0) ? ret : xmlSecOpenSSLX509StoreIndexAddDigest(ctx, EVP_sha1());
+#endif /* XMLSEC_NO_SHA1 */
+#ifndef XMLSEC_NO_SHA224
+    ret = (ret < 0) ? ret : xmlSecOpenSSLX509StoreIndexAddDigest(ctx, EVP_sha224());
+#endif /* XMLSEC_NO_SHA224 */
+#ifndef XMLSEC_NO_SHA256
+    ret = (ret < 0) ? ret : xmlSecOpenSSLX509StoreIndexAddDigest(ctx, EVP_sha256());
+#endif /* XMLSEC_NO_SHA256 */
+#ifndef XMLSEC_NO_SHA384
+    ret = (ret < 0) ? ret : xmlSecOpenSSLX509StoreIndexAddDigest(ctx, EVP_sha384());
+#endif /* XMLSEC_NO_SHA384 */
+#ifndef XMLSEC_NO_SHA512
+    ret = (ret < 0) ? ret : xmlSecOpenSSLX509StoreIndexAddDigest(ctx, EVP_sha512());
+#endif /* XMLSEC_NO_SHA512 */
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509StoreIndexAddDigest", NULL);
+        xmlSecOpenSSLX509StoreIndexFinalize(ctx);
+        return(-1);
+    }
+
+    ctx->indexValid = 1;
+    return(0);
+}
+
+static void
+xmlSecOpenSSLX509StoreIndexFinalize(xmlSecOpenSSLX509StoreCtxPtr ctx) {
+    xmlSecOpenSSLX509IndexItemPtr item;
+    xmlSecSize ii;
+
+    xmlSecAssert(ctx != NULL);
+
+    /* the tables don't own the items */
+    if(ctx->bySubject != NULL) {
+        xmlHashFree(ctx->bySubject, NULL);
+    }
+    if(ctx->byIssuerSerial != NULL) {
+        xmlHashFree(ctx->byIssuerSerial, NULL);
+    }
+    if(ctx->bySki != NULL) {
+        xmlHashFree(ctx->bySki, NULL);
+    }
+    if(ctx->bySubjectHash != NULL) {
+        xmlHashFree(ctx->bySubjectHash, NULL);
+    }
+    for(ii = 0; ii < ctx->byDigestSize; ++ii) {
+        if(ctx->byDigest[ii].certs != NULL) {
+            xmlHashFree(ctx->byDigest[ii].certs, NULL);
+        }
+    }
+    while(ctx->indexItems != NULL) {
+        item = ctx->indexItems;
+        ctx->indexItems = item->next;
+        xmlFree(item);
+    }
+
+    ctx->indexValid = 0;
+    ctx->indexSize = 0;
+    ctx->bySubject = NULL;
+    ctx->byIssuerSerial = NULL;
+    ctx->bySki = NULL;
+    ctx->bySubjectHash = NULL;
+    memset(ctx->byDigest, 0, sizeof(ctx->byDigest));
+    ctx->byDigestSize = 0;
+}
+
+/* returns 1 if the indexes are in sync with the untrusted certs list or 0 otherwise */
+static int
+xmlSecOpenSSLX509StoreIndexIsValid(xmlSecOpenSSLX509StoreCtxPtr ctx) {
+    xmlSecOpenSSLSizeT num;
+
+    xmlSecAssert2(ctx != NULL, 0);
+
+    if((ctx->indexValid == 0) || (ctx->untrusted == NULL)) {
+        return(0);
+    }
+    num = sk_X509_num(ctx->untrusted);
+    if((num < 0) || ((xmlSecSize)num != ctx->indexSize)) {
+        return(0);
+    }
+    return(1);
+}
+
+/* adds the last cert from the untrusted certs list to the indexes */
+static int
+xmlSecOpenSSLX509StoreIndexAdd(xmlSecOpenSSLX509StoreCtxPtr ctx, X509* cert) {
+    xmlSecOpenSSLX509IndexItemPtr item;
+    xmlSecOpenSSLX509IndexItemPtr tail;
+    XMLSEC_OPENSSL400_CONST X509_NAME* name;
+    ASN1_INTEGER* serial;
+    xmlChar* key = NULL;
+    xmlChar* key2 = NULL;
+    xmlSecByte md[EVP_MAX_MD_SIZE];
+    unsigned int mdLen;
+    unsigned long hash;
+    char hashKey[32];
+    xmlSecSize ii;
+    int ret;
+    int res = -1;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->indexValid != 0, -1);
+    xmlSecAssert2(cert != NULL, -1);
+
+    item = (xmlSecOpenSSLX509IndexItemPtr)xmlMalloc(sizeof(xmlSecOpenSSLX509IndexItem));
+    if(item == NULL) {
+        xmlSecMallocError(sizeof(xmlSecOpenSSLX509IndexItem), NULL);
+        return(-1);
+    }
+    memset(item, 0, sizeof(xmlSecOpenSSLX509IndexItem));
+    item->cert = cert;
+    item->pos = ctx->indexSize;
+    item->next = ctx->indexItems;
+    ctx->indexItems = item;
+
+    /* subject name */
+    name = X509_get_subject_name(cert);
+    if(name != NULL) {
+        key = xmlSecOpenSSLX509IndexNameKey(name);
+        if(key == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLX509IndexNameKey", NULL);
+            goto done;
+        }
+        ret = xmlSecOpenSSLX509IndexAddItem(ctx->bySubject, key, NULL, item);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509IndexAddItem(bySubject)", NULL);
+            goto done;
+        }
+        xmlFree(key);
+        key = NULL;
+
+        /* the issuers search uses X509_NAME_cmp() */
+        hash = xmlSecOpenSSLX509GetSubjectHash(cert);
+        if(hash == 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509GetSubjectHash", NULL);
+            goto done;
+        }
+        (void)snprintf(hashKey, sizeof(hashKey), "%08lx", hash);
+        tail = (xmlSecOpenSSLX509IndexItemPtr)xmlHashLookup(ctx->bySubjectHash, BAD_CAST hashKey);
+        if(tail == NULL) {
+            ret = xmlSecOpenSSLX509IndexAddItem(ctx->bySubjectHash, BAD_CAST hashKey, NULL, item);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecOpenSSLX509IndexAddItem(bySubjectHash)", NULL);
+                goto done;
+            }
+        } else {
+            while(tail->nextSameHash != NULL) {
+                tail = tail->nextSameHash;
+            }
+            tail->nextSameHash = item;
+        }
+    }
+
+    /* issuer name and serial */
+    name = X509_get_issuer_name(cert);
+    serial = X509_get_serialNumber(cert);
+    if((name != NULL) && (serial != NULL)) {
+        key = xmlSecOpenSSLX509IndexNameKey(name);
+        if(key == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLX509IndexNameKey", NULL);
+            goto done;
+        }
+        key2 = xmlSecOpenSSLX509IndexAsn1StringKey(serial);
+        if(key2 == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLX509IndexAsn1StringKey", NULL);
+            goto done;
+        }
+        ret = xmlSecOpenSSLX509IndexAddItem(ctx->byIssuerSerial, key, key2, item);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509IndexAddItem(byIssuerSerial)", NULL);
+            goto done;
+        }
+        xmlFree(key);
+        key = NULL;
+        xmlFree(key2);
+        key2 = NULL;
+    }
+
+    /* SKI */
+    ret = xmlSecOpenSSLX509IndexSkiKey(cert, &key);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509IndexSkiKey", NULL);
+        goto done;
+    }
+    if(key != NULL) {
+        ret = xmlSecOpenSSLX509IndexAddItem(ctx->bySki, key, NULL, item);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509IndexAddItem(bySki)", NULL);
+            goto done;
+        }
+        xmlFree(key);
+        key = NULL;
+    }
+
+    /* digests */
+    for(ii = 0; ii < ctx->byDigestSize; ++ii) {
+        mdLen = 0;
+        ret = X509_digest(cert, ctx->byDigest[ii].md, md, &mdLen);
+        if((ret != 1) || (mdLen <= 0)) {
+            xmlSecOpenSSLError("X509_digest", NULL);
+            goto done;
+        }
+        key = xmlSecOpenSSLX509IndexHexKey(md, mdLen);
+        if(key == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLX509IndexHexKey", NULL);
+            goto done;
+        }
+        ret = xmlSecOpenSSLX509IndexAddItem(ctx->byDigest[ii].certs, key, NULL, item);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509IndexAddItem(byDigest)", NULL);
+            goto done;
+        }
+        xmlFree(key);
+        key = NULL;
+    }
+
+    /* success */
+    ++ctx->indexSize;
+    res = 0;
+
+done:
+    if(key != NULL) {
+        xmlFree(key);
+    }
+    if(key2 != NULL) {
+        xmlFree(key2);
+    }
+    return(res);
+}
+
+/* returns 1 if the indexes were used, 0 if the full scan is required or a negative value if an error occurs */
+static int
+xmlSecOpenSSLX509StoreIndexFindCert(xmlSecOpenSSLX509StoreCtxPtr ctx, xmlSecOpenSSLX509FindCertCtxPtr findCertCtx, X509** res) {
+    xmlSecOpenSSLX509IndexItemPtr best = NULL;
+    xmlHashTablePtr digestCerts = NULL;
+    xmlChar* key = NULL;
+    xmlChar* key2 = NULL;
+    xmlSecSize ii;
+    int ret = -1;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(findCertCtx != NULL, -1);
+    xmlSecAssert2(res != NULL, -1);
+
+    (*res) = NULL;
+    if(xmlSecOpenSSLX509StoreIndexIsValid(ctx) != 1) {
+        return(0);
+    }
+
+    /* do we have the digests index for this algorithm? */
+    if((findCertCtx->digestValue != NULL) && (findCertCtx->digestLen > 0) && (findCertCtx->digestMd != NULL)) {
+        for(ii = 0; ii < ctx->byDigestSize; ++ii) {
+            if(EVP_MD_type(ctx->byDigest[ii].md) == EVP_MD_type(findCertCtx->digestMd)) {
+                digestCerts = ctx->byDigest[ii].certs;
+                break;
+            }
+        }
+        if(digestCerts == NULL) {
+            return(0);
+        }
+    }
+
+    if(findCertCtx->subjectNameKey != NULL) {
+        best = xmlSecOpenSSLX509IndexLookup(ctx->bySubject, findCertCtx->subjectNameKey, NULL, best);
+    }
+    if((findCertCtx->issuerNameKey != NULL) && (findCertCtx->issuerSerial != NULL)) {
+        key2 = xmlSecOpenSSLX509IndexAsn1StringKey(findCertCtx->issuerSerial);
+        if(key2 == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLX509IndexAsn1StringKey", NULL);
+            goto done;
+        }
+        best = xmlSecOpenSSLX509IndexLookup(ctx->byIssuerSerial, findCertCtx->issuerNameKey, key2, best);
+        xmlFree(key2);
+        key2 = NULL;
+    }
+    if(findCertCtx->ski != NULL) {
+        key = xmlSecOpenSSLX509IndexAsn1StringKey(findCertCtx->ski);
+        if(key == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLX509IndexAsn1StringKey", NULL);
+            goto done;
+        }
+        best = xmlSecOpenSSLX509IndexLookup(ctx->bySki, key, NULL, best);
+        xmlFree(key);
+        key = NULL;
+    }
+    if(digestCerts != NULL) {
+        key = xmlSecOpenSSLX509IndexHexKey(findCertCtx->digestValue, findCertCtx->digestLen);
+        if(key == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLX509IndexHexKey", NULL);
+            goto done;
+        }
+        best = xmlSecOpenSSLX509IndexLookup(digestCerts, key, NULL, best);
+        xmlFree(key);
+        key = NULL;
+    }
+
+    /* success */
+    if(best != NULL) {
+        (*res) = best->cert;
+    }
+    ret = 1;
+
+done:
+    if(key != NULL) {
+        xmlFree(key);
+    }
+    if(key2 != NULL) {
+        xmlFree(key2);
+    }
+    return(ret);
+}
+
+
+/******************************************************************************
+ *
+ * Canonical names cache: the X509 names are compared using the canonical keys
+ * (sorted entries, see xmlSecOpenSSLX509IndexNameKey()). The process-wide
+ * cache maps both the names strings from the documents and the DER encoded
+ * certificates names to the canonical keys so the names are parsed and sorted
+ * only once. The cache is flushed when it is full.
+ *
+  *****************************************************************************/
+#define XMLSEC_OPENSSL_X509_NAMES_CACHE_MAX_SIZE        256
+
+static const xmlChar xmlSecOpenSSLX509NamesCacheStr[] = "str";
+static const xmlChar xmlSecOpenSSLX509NamesCacheDer[] = "der";
+
+static xmlMutexPtr      xmlSecOpenSSLX509NamesCacheMutex = NULL;
+static xmlHashTablePtr  xmlSecOpenSSLX509NamesCacheHash = NULL;
+
+/**
+ * @brief Initializes the canonical names cache.
+ * @details Initializes the process-wide cache of the canonical X509 names keys.
+ * Called from #xmlSecOpenSSLInit.
+ * @return 0 on success or a negative value otherwise.
+ */
+int
+xmlSecOpenSSLX509NamesCacheInit(void) {
+    if(xmlSecOpenSSLX509NamesCacheMutex == NULL) {
+        xmlSecOpenSSLX509NamesCacheMutex = xmlNewMutex();
+        if(xmlSecOpenSSLX509NamesCacheMutex == NULL) {
+            xmlSecXmlError("xmlNewMutex", NULL);
+            return(-1);
+        }
+    }
+
+    xmlMutexLock(xmlSecOpenSSLX509NamesCacheMutex);
+    if(xmlSecOpenSSLX509NamesCacheHash == NULL) {
+        xmlSecOpenSSLX509NamesCacheHash = xmlHashCreate(XMLSEC_OPENSSL_X509_NAMES_CACHE_MAX_SIZE);
+        if(xmlSecOpenSSLX509NamesCacheHash == NULL) {
+            xmlMutexUnlock(xmlSecOpenSSLX509NamesCacheMutex);
+            xmlSecXmlError("xmlHashCreate", NULL);
+            return(-1);
+        }
+    }
+    xmlMutexUnlock(xmlSecOpenSSLX509NamesCacheMutex);
+    return(0);
+}
+
+/**
+ * @brief Shuts down the canonical names cache.
+ * @details Frees the process-wide cache of the canonical X509 names keys.
+ * Called from #xmlSecOpenSSLShutdown.
+ */
+void
+xmlSecOpenSSLX509NamesCacheShutdown(void) {
+    if(xmlSecOpenSSLX509NamesCacheMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecOpenSSLX509NamesCacheMutex);
+    if(xmlSecOpenSSLX509NamesCacheHash != NULL) {
+        xmlHashFree(xmlSecOpenSSLX509NamesCacheHash, xmlHashDefaultDeallocator);
+        xmlSecOpenSSLX509NamesCacheHash = NULL;
+    }
+    xmlMutexUnlock(xmlSecOpenSSLX509NamesCacheMutex);
+
+    xmlFreeMutex(xmlSecOpenSSLX509NamesCacheMutex);
+    xmlSecOpenSSLX509NamesCacheMutex = NULL;
+}
+
+/* returns a copy of the cached canonical key or NULL if not found */
+static xmlChar*
+xmlSecOpenSSLX509NamesCacheGet(const xmlChar* name, const xmlChar* kind) {
+    const xmlChar* key;
+    xmlChar* res = NULL;
+
+    xmlSecAssert2(name != NULL, NULL);
+    xmlSecAssert2(kind != NULL, NULL);
+
+    if(xmlSecOpenSSLX509NamesCacheMutex == NULL) {
+        return(NULL);
+    }
+    xmlMutexLock(xmlSecOpenSSLX509NamesCacheMutex);
+    if(xmlSecOpenSSLX509NamesCacheHash != NULL) {
+        key = (const xmlChar*)xmlHashLookup2(xmlSecOpenSSLX509NamesCacheHash, name, kind);
+        if(key != NULL) {
+            res = xmlStrdup(key);
+        }
+    }
+    xmlMutexUnlock(xmlSecOpenSSLX509NamesCacheMutex);
+    return(res);
+}
+
+/* not being able to cache the key is not an error */
+static void
+xmlSecOpenSSLX509NamesCacheAdd(const xmlChar* name, const xmlChar* kind, const xmlChar* key) {
+    xmlChar* keyCopy;
+    int ret;
+
+    xmlSecAssert(name != NULL);
+    xmlSecAssert(kind != NULL);
+    xmlSecAssert(key != NULL);
+
+    if(xmlSecOpenSSLX509NamesCacheMutex == NULL) {
+        return;
+    }
+    keyCopy = xmlStrdup(key);
+    if(keyCopy == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecOpenSSLX509NamesCacheMutex);
+    if(xmlSecOpenSSLX509NamesCacheHash == NULL) {
+        xmlMutexUnlock(xmlSecOpenSSLX509NamesCacheMutex);
+        xmlFree(keyCopy);
+        return;
+    }
+    if(xmlHashSize(xmlSecOpenSSLX509NamesCacheHash) >= XMLSEC_OPENSSL_X509_NAMES_CACHE_MAX_SIZE) {
+        xmlHashFree(xmlSecOpenSSLX509NamesCacheHash, xmlHashDefaultDeallocator);
+        xmlSecOpenSSLX509NamesCacheHash = xmlHashCreate(XMLSEC_OPENSSL_X509_NAMES_CACHE_MAX_SIZE);
+        if(xmlSecOpenSSLX509NamesCacheHash == NULL) {
+            xmlMutexUnlock(xmlSecOpenSSLX509NamesCacheMutex);
+            xmlSecXmlError("xmlHashCreate", NULL);
+            xmlFree(keyCopy);
+            return;
+        }
+    }
+    /* fails if another thread did it already */
+    ret = xmlHashAddEntry2(xmlSecOpenSSLX509NamesCacheHash, name, kind, keyCopy);
+    if(ret != 0) {
+        xmlFree(keyCopy);
+    }
+    xmlMutexUnlock(xmlSecOpenSSLX509NamesCacheMutex);
+}
+
+/* returns the canonical key for the name string (e.g. X509IssuerName) */
+static xmlChar*
+xmlSecOpenSSLX509NameStringKey(const xmlChar* str) {
+    X509_NAME* nm;
+    xmlChar* res;
+
+    xmlSecAssert2(str != NULL, NULL);
+
+    res = xmlSecOpenSSLX509NamesCacheGet(str, xmlSecOpenSSLX509NamesCacheStr);
+    if(res != NULL) {
+        return(res);
+    }
+
+    nm = xmlSecOpenSSLX509NameRead(str);
+    if(nm == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509NameRead", NULL);
+        return(NULL);
+    }
+    res = xmlSecOpenSSLX509IndexNameKey(nm);
+    X509_NAME_free(nm);
+    if(res == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509IndexNameKey", NULL);
+        return(NULL);
+    }
+
+    xmlSecOpenSSLX509NamesCacheAdd(str, xmlSecOpenSSLX509NamesCacheStr, res);
+    return(res);
+}
+
+/* returns the canonical key for the name from a certificate or a CRL */
+static xmlChar*
+xmlSecOpenSSLX509NameKey(XMLSEC_OPENSSL400_CONST X509_NAME* name) {
+    const unsigned char* der = NULL;
+    size_t derLen = 0;
+    xmlSecSize derSize;
+    xmlChar* derKey;
+    xmlChar* res;
+    int ret;
+
+    xmlSecAssert2(name != NULL, NULL);
+
+    /* the DER encoding is cached by OpenSSL */
+    ret = X509_NAME_get0_der((X509_NAME*)name, &der, &derLen);
+    if((ret != 1) || (der == NULL) || (derLen <= 0)) {
+        xmlSecOpenSSLError("X509_NAME_get0_der", NULL);
+        return(NULL);
+    }
+    XMLSEC_SAFE_CAST_SIZE_T_TO_SIZE(derLen, derSize, return(NULL), NULL);
+
+    derKey = xmlSecOpenSSLX509IndexHexKey(der, derSize);
+    if(derKey == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509IndexHexKey", NULL);
+        return(NULL);
+    }
+    res = xmlSecOpenSSLX509NamesCacheGet(derKey, xmlSecOpenSSLX509NamesCacheDer);
+    if(res != NULL) {
+        xmlFree(derKey);
+        return(res);
+    }
+
+    res = xmlSecOpenSSLX509IndexNameKey(name);
+    if(res == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509IndexNameKey", NULL);
+        xmlFree(derKey);
+        return(NULL);
+    }
+    xmlSecOpenSSLX509NamesCacheAdd(derKey, xmlSecOpenSSLX509NamesCacheDer, res);
+    xmlFree(derKey);
+    return(res);
+}
+
+/* returns 1 if the name has the canonical key, 0 if not or a negative value if an error occurs */
+static int
+xmlSecOpenSSLX509NameMatchesKey(XMLSEC_OPENSSL400_CONST X509_NAME* name, const xmlChar* key) {
+    xmlChar* nameKey;
+    int res;
+
+    xmlSecAssert2(name != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    nameKey = xmlSecOpenSSLX509NameKey(name);
+    if(nameKey == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509NameKey", NULL);
+        return(-1);
+    }
+    res = xmlStrEqual(nameKey, key);
+    xmlFree(nameKey);
+    return(res);
+}
+
+/******************************************************************************
+ *
+ * Certificates verification results cache: remembers the verified cert
+ * position in the certs stack for the given certs, CRLs and verification
+ * parameters. Only the successful results are cached.
+ *
+  *****************************************************************************/
+static int
+xmlSecOpenSSLX509VerifyCacheInitialize(xmlSecOpenSSLX509VerifyCachePtr cache) {
+    xmlSecAssert2(cache != NULL, -1);
+
+    memset(cache, 0, sizeof(xmlSecOpenSSLX509VerifyCache));
+    cache->mutex = xmlNewMutex();
+    if(cache->mutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        return(-1);
+    }
+    cache->items = xmlHashCreate(0);
+    if(cache->items == NULL) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        xmlSecOpenSSLX509VerifyCacheFinalize(cache);
+        return(-1);
+    }
+    return(0);
+}
+
+/* called with the cache mutex locked */
+static void
+xmlSecOpenSSLX509VerifyCacheRemoveItem(xmlSecOpenSSLX509VerifyCachePtr cache, xmlSecOpenSSLX509VerifyCacheItemPtr item) {
+    xmlSecAssert(cache != NULL);
+    xmlSecAssert(cache->items != NULL);
+    xmlSecAssert(cache->size > 0);
+    xmlSecAssert(item != NULL);
+
+    if(item->prev != NULL) {
+        item->prev->next = item->next;
+    } else {
+        cache->head = item->next;
+    }
+    if(item->next != NULL) {
+        item->next->prev = item->prev;
+    } else {
+        cache->tail = item->prev;
+    }
+    (void)xmlHashRemoveEntry(cache->items, item->key, NULL);
+    --cache->size;
+
+    xmlFree(item->key);
+    xmlFree(item);
+}
+
+/* called with the cache mutex locked */
+static void
+xmlSecOpenSSLX509VerifyCacheClearItems(xmlSecOpenSSLX509VerifyCachePtr cache) {
+    xmlSecAssert(cache != NULL);
+
+    while(cache->head != NULL) {
+        xmlSecOpenSSLX509VerifyCacheRemoveItem(cache, cache->head);
+    }
+}
+
+static void
+xmlSecOpenSSLX509VerifyCacheFinalize(xmlSecOpenSSLX509VerifyCachePtr cache) {
+    xmlSecAssert(cache != NULL);
+
+    if(cache->items != NULL) {
+        xmlSecOpenSSLX509VerifyCacheClearItems(cache);
+        xmlHashFree(cache->items, NULL);
+    }
+    if(cache->mutex != NULL) {
+        xmlFreeMutex(cache->mutex);
+    }
+    memset(cache, 0, sizeof(xmlSecOpenSSLX509VerifyCache));
+}
+
+static void
+xmlSecOpenSSLX509VerifyCacheClear(xmlSecOpenSSLX509VerifyCachePtr cache) {
+    xmlSecAssert(cache != NULL);
+
+    if(cache->mutex == NULL) {
+        return;
+    }
+    xmlMutexLock(cache->mutex);
+    xmlSecOpenSSLX509VerifyCacheClearItems(cache);
+    xmlMutexUnlock(cache->mutex);
+}
+
+/* returns 1 if the cache is enabled or 0 otherwise */
+static int
+xmlSecOpenSSLX509VerifyCacheIsEnabled(xmlSecOpenSSLX509VerifyCachePtr cache) {
+    xmlSecSize maxSize;
+
+    xmlSecAssert2(cache != NULL, 0);
+
+    if(cache->mutex == NULL) {
+        return(0);
+    }
+    xmlMutexLock(cache->mutex);
+    maxSize = cache->maxSize;
+    xmlMutexUnlock(cache->mutex);
+    return((maxSize > 0) ? 1 : 0);
+}
+
+static int
+xmlSecOpenSSLX509VerifyCacheKeyUpdate(EVP_MD_CTX* digestCtx, const void* data, size_t size) {
+    int ret;
+
+    xmlSecAssert2(digestCtx != NULL, -1);
+    xmlSecAssert2(data != NULL, -1);
+
+    ret = EVP_DigestUpdate(digestCtx, data, size);
+    if(ret != 1) {
+        xmlSecOpenSSLError("EVP_DigestUpdate", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/* the SHA256 digest of the certs and CRLs digests and the verification parameters */
+static xmlChar*
+xmlSecOpenSSLX509VerifyCacheKey(STACK_OF(X509)* certs, STACK_OF(X509_CRL)* crls, xmlSecKeyInfoCtx* keyInfoCtx) {
+    EVP_MD_CTX* digestCtx = NULL;
+    xmlSecByte md[EVP_MAX_MD_SIZE];
+    unsigned int mdLen = 0;
+    xmlSecOpenSSLSizeT ii, num;
+    xmlSecSize mdSize;
+    xmlChar* res = NULL;
+    int ret;
+
+    xmlSecAssert2(certs != NULL, NULL);
+    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+
+    digestCtx = EVP_MD_CTX_new();
+    if(digestCtx == NULL) {
+        xmlSecOpenSSLError("EVP_MD_CTX_new", NULL);
+        goto done;
+    }
+    ret = EVP_DigestInit_ex(digestCtx, EVP_sha256(), NULL);
+    if(ret != 1) {
+        xmlSecOpenSSLError("EVP_DigestInit_ex", NULL);
+        goto done;
+    }
+
+    /* the order of the certs matters: the result is the cert position */
+    num = sk_X509_num(certs);
+    if(xmlSecOpenSSLX509VerifyCacheKeyUpdate(digestCtx, &num, sizeof(num)) < 0) {
+        goto done;
+    }
+    for(ii = 0; ii < num; ++ii) {
+        X509* cert = sk_X509_value(certs, ii);
+        if(cert == NULL) {
+            continue;
+        }
+        ret = X509_digest(cert, EVP_sha256(), md, &mdLen);
+        if(ret != 1) {
+            xmlSecOpenSSLError("X509_digest", NULL);
+            goto done;
+        }
+        if(xmlSecOpenSSLX509VerifyCacheKeyUpdate(digestCtx, md, mdLen) < 0) {
+            goto done;
+        }
+    }
+
+    num = (crls != NULL) ? sk_X509_CRL_num(crls) : 0;
+    if(xmlSecOpenSSLX509VerifyCacheKeyUpdate(digestCtx, &num, sizeof(num)) < 0) {
+        goto done;
+    }
+    for(ii = 0; ii < num; ++ii) {
+        X509_CRL* crl = sk_X509_CRL_value(crls, ii);
+        if(crl == NULL) {
+            continue;
+        }
+        ret = X509_CRL_digest(crl, EVP_sha1(), md, &mdLen);
+        if(ret != 1) {
+            xmlSecOpenSSLError("X509_CRL_digest", NULL);
+            goto done;
+        }
+        if(xmlSecOpenSSLX509VerifyCacheKeyUpdate(digestCtx, md, mdLen) < 0) {
+            goto done;
+        }
+    }
+
+    /* verification parameters */
+    if((xmlSecOpenSSLX509VerifyCacheKeyUpdate(digestCtx, &(keyInfoCtx->flags), sizeof(keyInfoCtx->flags)) < 0) ||
+       (xmlSecOpenSSLX509VerifyCacheKeyUpdate(digestCtx, &(keyInfoCtx->flags2), sizeof(keyInfoCtx->flags2)) < 0) ||
+       (xmlSecOpenSSLX509VerifyCacheKeyUpdate(digestCtx, &(keyInfoCtx->certsVerificationTime), sizeof(keyInfoCtx->certsVerificationTime)) < 0) ||
+       (xmlSecOpenSSLX509VerifyCacheKeyUpdate(digestCtx, &(keyInfoCtx->certsVerificationDepth), sizeof(keyInfoCtx->certsVerificationDepth)) < 0))
+    {
+        goto done;
+    }
+
+    ret = EVP_DigestFinal_ex(digestCtx, md, &mdLen);
+    if(ret != 1) {
+        xmlSecOpenSSLError("EVP_DigestFinal_ex", NULL);
+        goto done;
+    }
+    XMLSEC_SAFE_CAST_UINT_TO_SIZE(mdLen, mdSize, goto done, NULL);
+
+    res = xmlSecOpenSSLX509IndexHexKey(md, mdSize);
+    if(res == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509IndexHexKey", NULL);
+        goto done;
+    }
+
+done:
+    if(digestCtx != NULL) {
+        EVP_MD_CTX_free(digestCtx);
+    }
+    return(res);
+}
+
+/* returns 1 and the verified cert position if found or 0 otherwise */
+static int
+xmlSecOpenSSLX509VerifyCacheLookup(xmlSecOpenSSLX509VerifyCachePtr cache, const xmlChar* key, time_t verificationTime,
+    xmlSecOpenSSLSizeT* pos
+) {
+    xmlSecOpenSSLX509VerifyCacheItemPtr item;
+    int res = 0;
+
+    xmlSecAssert2(cache != NULL, 0);
+    xmlSecAssert2(cache->mutex != NULL, 0);
+    xmlSecAssert2(key != NULL, 0);
+    xmlSecAssert2(pos != NULL, 0);
+
+    xmlMutexLock(cache->mutex);
+    item = (xmlSecOpenSSLX509VerifyCacheItemPtr)xmlHashLookup(cache->items, key);
+    if((item != NULL) && (item->expires > 0) && (item->expires <= verificationTime)) {
+        xmlSecOpenSSLX509VerifyCacheRemoveItem(cache, item);
+        item = NULL;
+    }
+    if(item != NULL) {
+        /* move to the front */
+        if(item->prev != NULL) {
+            item->prev->next = item->next;
+            if(item->next != NULL) {
+                item->next->prev = item->prev;
+            } else {
+                cache->tail = item->prev;
+            }
+            item->prev = NULL;
+            item->next = cache->head;
+            cache->head->prev = item;
+            cache->head = item;
+        }
+        (*pos) = item->pos;
+        ++cache->hits;
+        res = 1;
+    } else {
+        ++cache->misses;
+    }
+    xmlMutexUnlock(cache->mutex);
+    return(res);
+}
+
+static int
+xmlSecOpenSSLX509VerifyCacheAdd(xmlSecOpenSSLX509VerifyCachePtr cache, const xmlChar* key, xmlSecOpenSSLSizeT pos,
+    time_t expires
+) {
+    xmlSecOpenSSLX509VerifyCacheItemPtr item;
+    int ret;
+
+    xmlSecAssert2(cache != NULL, -1);
+    xmlSecAssert2(cache->mutex != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    item = (xmlSecOpenSSLX509VerifyCacheItemPtr)xmlMalloc(sizeof(xmlSecOpenSSLX509VerifyCacheItem));
+    if(item == NULL) {
+        xmlSecMallocError(sizeof(xmlSecOpenSSLX509VerifyCacheItem), NULL);
+        return(-1);
+    }
+    memset(item, 0, sizeof(xmlSecOpenSSLX509VerifyCacheItem));
+    item->pos = pos;
+    item->expires = expires;
+    item->key = xmlStrdup(key);
+    if(item->key == NULL) {
+        xmlSecStrdupError(key, NULL);
+        xmlFree(item);
+        return(-1);
+    }
+
+    xmlMutexLock(cache->mutex);
+
+    /* the cache might be disabled or another thread added the same result */
+    if((cache->maxSize <= 0) || (xmlHashLookup(cache->items, key) != NULL)) {
+        xmlMutexUnlock(cache->mutex);
+        xmlFree(item->key);
+        xmlFree(item);
+        return(0);
+    }
+    ret = xmlHashAddEntry(cache->items, item->key, item);
+    if(ret != 0) {
+        xmlMutexUnlock(cache->mutex);
+        xmlSecXmlError("xmlHashAddEntry", NULL);
+        xmlFree(item->key);
+        xmlFree(item);
+        return(-1);
+    }
+    item->next = cache->head;
+    if(cache->head != NULL) {
+        cache->head->prev = item;
+    } else {
+        cache->tail = item;
+    }
+    cache->head = item;
+    ++cache->size;
+
+    /* drop the least recently used results */
+    while((cache->size > cache->maxSize) && (cache->tail != NULL)) {
+        xmlSecOpenSSLX509VerifyCacheRemoveItem(cache, cache->tail);
+    }
+    xmlMutexUnlock(cache->mutex);
+    return(0);
+}
+
+static int
+xmlSecOpenSSLX509VerifyCacheUpdateExpires(const ASN1_TIME* tm, time_t* expires) {
+    time_t tt;
+    int ret;
+
+    xmlSecAssert2(expires != NULL, -1);
+
+    if(tm == NULL) {
+        return(0);
+    }
+    ret = xmlSecOpenSSLX509Asn1TimeToTime(tm, &tt);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509Asn1TimeToTime", NULL);
+        return(-1);
+    }
+    if(((*expires) == 0) || (tt < (*expires))) {
+        (*expires) = tt;
+    }
+    return(0);
+}
+
+/* the CRLs change the verification result when they expire or become valid */
+static int
+xmlSecOpenSSLX509VerifyCacheCrlsExpires(STACK_OF(X509_CRL)* crls, time_t verificationTime, time_t* expires) {
+    const ASN1_TIME* thisUpdate;
+    xmlSecOpenSSLSizeT ii, num;
+    int ret;
+
+    xmlSecAssert2(expires != NULL, -1);
+
+    if(crls == NULL) {
+        return(0);
+    }
+    num = sk_X509_CRL_num(crls);
+    for(ii = 0; ii < num; ++ii) {
+        X509_CRL* crl = sk_X509_CRL_value(crls, ii);
+        if(crl == NULL) {
+            continue;
+        }
+
+        thisUpdate = X509_CRL_get0_lastUpdate(crl);
+        if(thisUpdate != NULL) {
+            ret = xmlSecOpenSSLAsn1TimeIsAfter(thisUpdate, &verificationTime);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecOpenSSLAsn1TimeIsAfter(thisUpdate)", NULL);
+                return(-1);
+            } else if(ret > 0) {
+                ret = xmlSecOpenSSLX509VerifyCacheUpdateExpires(thisUpdate, expires);
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecOpenSSLX509VerifyCacheUpdateExpires(thisUpdate)", NULL);
+                    return(-1);
+                }
+            }
+        }
+        ret = xmlSecOpenSSLX509VerifyCacheUpdateExpires(X509_CRL_get0_nextUpdate(crl), expires);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509VerifyCacheUpdateExpires(nextUpdate)", NULL);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+
+/******************************************************************************
+ *
+ * Store CRLs indexes: the revoked entries of each store CRL sorted by the serial
+ * number (and by the position in the CRL for the same serial numbers) to find
+ * the entries for a cert with a binary search instead of the full scan.
+ *
+  *****************************************************************************/
+static int
+xmlSecOpenSSLX509CrlIndexItemCompare(const void* a, const void* b) {
+    const xmlSecOpenSSLX509CrlIndexItem* itemA = (const xmlSecOpenSSLX509CrlIndexItem*)a;
+    const xmlSecOpenSSLX509CrlIndexItem* itemB = (const xmlSecOpenSSLX509CrlIndexItem*)b;
+    int ret;
+
+    ret = ASN1_INTEGER_cmp(itemA->serial, itemB->serial);
+    if(ret != 0) {
+        return(ret);
+    }
+    if(itemA->pos < itemB->pos) {
+        return(-1);
+    } else if(itemA->pos > itemB->pos) {
+        return(1);
+    }
+    return(0);
+}
+
+static xmlSecOpenSSLX509CrlIndexPtr
+xmlSecOpenSSLX509CrlIndexCreate(X509_CRL* crl) {
+    xmlSecOpenSSLX509CrlIndexPtr index;
+    STACK_OF(X509_REVOKED) * revoked_certs;
+    X509_REVOKED * revoked_cert;
+    const ASN1_INTEGER * serial;
+    xmlSecOpenSSLSizeT ii, num;
+    xmlSecSize size;
+
+    xmlSecAssert2(crl != NULL, NULL);
+
+    index = (xmlSecOpenSSLX509CrlIndexPtr)xmlMalloc(sizeof(xmlSecOpenSSLX509CrlIndex));
+    if(index == NULL) {
+        xmlSecMallocError(sizeof(xmlSecOpenSSLX509CrlIndex), NULL);
+        return(NULL);
+    }
+    memset(index, 0, sizeof(xmlSecOpenSSLX509CrlIndex));
+    index->crl = crl;
+
+    /* the CRL without revoked entries has an empty index */
+    revoked_certs = X509_CRL_get_REVOKED(crl);
+    num = (revoked_certs != NULL) ? sk_X509_REVOKED_num(revoked_certs) : 0;
+    if(num <= 0) {
+        return(index);
+    }
+    XMLSEC_OPENSSL_SAFE_CAST_SIZE_T_TO_SIZE(num, size, xmlSecOpenSSLX509CrlIndexesDestroy(index); return(NULL), NULL);
+
+    index->items = (xmlSecOpenSSLX509CrlIndexItemPtr)xmlMalloc(size * sizeof(xmlSecOpenSSLX509CrlIndexItem));
+    if(index->items == NULL) {
+        xmlSecMallocError(size * sizeof(xmlSecOpenSSLX509CrlIndexItem), NULL);
+        xmlSecOpenSSLX509CrlIndexesDestroy(index);
+        return(NULL);
+    }
+    for(ii = 0; ii < num; ++ii) {
+        revoked_cert = sk_X509_REVOKED_value(revoked_certs, ii);
+        if(revoked_cert == NULL) {
+            continue;
+        }
+        serial = X509_REVOKED_get0_serialNumber(revoked_cert);
+        if(serial == NULL) {
+            xmlSecOpenSSLError("X509_REVOKED_get0_serialNumber(revoked_cert)", NULL);
+            xmlSecOpenSSLX509CrlIndexesDestroy(index);
+            return(NULL);
+        }
+        index->items[index->size].serial = serial;
+        index->items[index->size].revoked = revoked_cert;
+        index->items[index->size].pos = index->size;
+        ++index->size;
+    }
+    qsort(index->items, index->size, sizeof(xmlSecOpenSSLX509CrlIndexItem), xmlSecOpenSSLX509CrlIndexItemCompare);
+
+    return(index);
+}
+
+static void
+xmlSecOpenSSLX509CrlIndexesDestroy(xmlSecOpenSSLX509CrlIndexPtr indexes) {
+    xmlSecOpenSSLX509CrlIndexPtr index;
+
+    while(indexes != NULL) {
+        index = indexes;
+        indexes = index->next;
+        if(index->items != NULL) {
+            xmlFree(index->items);
+        }
+        xmlFree(index);
+    }
+}
+
+static xmlSecOpenSSLX509CrlIndexPtr
+xmlSecOpenSSLX509CrlIndexesFind(xmlSecOpenSSLX509CrlIndexPtr indexes, X509_CRL* crl) {
+    xmlSecOpenSSLX509CrlIndexPtr index;
+
+    xmlSecAssert2(crl != NULL, NULL);
+
+    for(index = indexes; index != NULL; index = index->next) {
+        if(index->crl == crl) {
+            return(index);
+        }
+    }
+    return(NULL);
+}
+
+/* returns the position of the first item with the serial number greater than or equal to @serial */
+static xmlSecSize
+xmlSecOpenSSLX509CrlIndexLowerBound(xmlSecOpenSSLX509CrlIndexPtr index, const ASN1_INTEGER* serial) {
+    xmlSecSize lo, hi, mid;
+
+    xmlSecAssert2(index != NULL, 0);
+    xmlSecAssert2(serial != NULL, 0);
+
+    lo = 0;
+    hi = index->size;
+    while(lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if(ASN1_INTEGER_cmp(index->items[mid].serial, serial) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return(lo);
+}
+
+
+/******************************************************************************
+ *
+ * CRLs cache: remembers the CRLs signatures verified with the issuer certs
+ * keys (keyed by the CRL and the issuer cert digests, the result never
+ * changes) and the store CRLs filtered by time together with the time window
+ * when the filtered CRLs set stays the same.
+ *
+  *****************************************************************************/
+static int
+xmlSecOpenSSLX509CrlsCacheInitialize(xmlSecOpenSSLX509CrlsCachePtr cache) {
+    xmlSecAssert2(cache != NULL, -1);
+
+    memset(cache, 0, sizeof(xmlSecOpenSSLX509CrlsCache));
+    cache->mutex = xmlNewMutex();
+    if(cache->mutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        return(-1);
+    }
+    cache->verified = xmlHashCreate(0);
+    if(cache->verified == NULL) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        xmlSecOpenSSLX509CrlsCacheFinalize(cache);
+        return(-1);
+    }
+    return(0);
+}
+
+static void
+xmlSecOpenSSLX509CrlsCacheFinalize(xmlSecOpenSSLX509CrlsCachePtr cache) {
+    xmlSecAssert(cache != NULL);
+
+    if(cache->verified != NULL) {
+        xmlHashFree(cache->verified, NULL);
+    }
+    if(cache->filtered != NULL) {
+        sk_X509_CRL_free(cache->filtered);
+    }
+    if(cache->mutex != NULL) {
+        xmlFreeMutex(cache->mutex);
+    }
+    memset(cache, 0, sizeof(xmlSecOpenSSLX509CrlsCache));
+}
+
+/* called with the cache mutex locked */
+static void
+xmlSecOpenSSLX509CrlsCacheResetFiltered(xmlSecOpenSSLX509CrlsCachePtr cache) {
+    xmlSecAssert(cache != NULL);
+
+    if(cache->filtered != NULL) {
+        sk_X509_CRL_free(cache->filtered);
+        cache->filtered = NULL;
+    }
+    cache->filteredValid = 0;
+    cache->filteredFrom = 0;
+    cache->filteredUntil = 0;
+}
+
+static void
+xmlSecOpenSSLX509CrlsCacheClearFiltered(xmlSecOpenSSLX509CrlsCachePtr cache) {
+    xmlSecAssert(cache != NULL);
+
+    if(cache->mutex == NULL) {
+        return;
+    }
+    xmlMutexLock(cache->mutex);
+    xmlSecOpenSSLX509CrlsCacheResetFiltered(cache);
+    xmlMutexUnlock(cache->mutex);
+}
+
+/* OpenSSL computes the SHA1 digests of the whole CRL and cert DER when these
+ * are parsed and X509_CRL_digest() / X509_digest() just copy these digests:
+ * the key doesn't re-encode and re-hash the (potentially large) CRL. */
+static xmlChar*
+xmlSecOpenSSLX509CrlsCacheSignatureKey(X509_CRL* crl, X509* issuer_cert) {
+    xmlSecByte md[2 * EVP_MAX_MD_SIZE];
+    unsigned int mdLen = 0;
+    unsigned int mdLen2 = 0;
+    xmlSecSize mdSize;
+    xmlChar* res;
+    int ret;
+
+    xmlSecAssert2(crl != NULL, NULL);
+    xmlSecAssert2(issuer_cert != NULL, NULL);
+
+    ret = X509_CRL_digest(crl, EVP_sha1(), md, &mdLen);
+    if((ret != 1) || (mdLen <= 0) || (mdLen > EVP_MAX_MD_SIZE)) {
+        xmlSecOpenSSLError("X509_CRL_digest", NULL);
+        return(NULL);
+    }
+    ret = X509_digest(issuer_cert, EVP_sha1(), md + mdLen, &mdLen2);
+    if((ret != 1) || (mdLen2 <= 0) || (mdLen2 > EVP_MAX_MD_SIZE)) {
+        xmlSecOpenSSLError("X509_digest", NULL);
+        return(NULL);
+    }
+
+    XMLSEC_SAFE_CAST_UINT_TO_SIZE(mdLen + mdLen2, mdSize, return(NULL), NULL);
+    res = xmlSecOpenSSLX509IndexHexKey(md, mdSize);
+    if(res == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509IndexHexKey", NULL);
+        return(NULL);
+    }
+    return(res);
+}
+
+/* returns 1 if the CRL signature was already verified with the issuer cert key or 0 otherwise */
+static int
+xmlSecOpenSSLX509CrlsCacheIsVerified(xmlSecOpenSSLX509CrlsCachePtr cache, const xmlChar* key) {
+    int res = 0;
+
+    xmlSecAssert2(cache != NULL, 0);
+    xmlSecAssert2(key != NULL, 0);
+
+    if(cache->mutex == NULL) {
+        return(0);
+    }
+    xmlMutexLock(cache->mutex);
+    if((cache->verified != NULL) && (xmlHashLookup(cache->verified, key) != NULL)) {
+        res = 1;
+    }
+    xmlMutexUnlock(cache->mutex);
+    return(res);
+}
+
+static int
+xmlSecOpenSSLX509CrlsCacheAddVerified(xmlSecOpenSSLX509CrlsCachePtr cache, const xmlChar* key) {
+    int ret;
+
+    xmlSecAssert2(cache != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    if(cache->mutex == NULL) {
+        return(0);
+    }
+    xmlMutexLock(cache->mutex);
+    if((cache->verified == NULL) || (xmlHashLookup(cache->verified, key) != NULL)) {
+        xmlMutexUnlock(cache->mutex);
+        return(0);
+    }
+    if(xmlHashSize(cache->verified) >= XMLSEC_OPENSSL_X509_CRLS_CACHE_VERIFIED_MAX_SIZE) {
+        xmlHashFree(cache->verified, NULL);
+        cache->verified = xmlHashCreate(0);
+        if(cache->verified == NULL) {
+            xmlMutexUnlock(cache->mutex);
+            xmlSecXmlError("xmlHashCreate", NULL);
+            return(-1);
+        }
+    }
+    /* only the key matters */
+    ret = xmlHashAddEntry(cache->verified, key, (void*)cache);
+    if(ret != 0) {
+        xmlMutexUnlock(cache->mutex);
+        xmlSecXmlError("xmlHashAddEntry", NULL);
+        return(-1);
+    }
+    xmlMutexUnlock(cache->mutex);
+    return(0);
+}
+
+/* returns 1 and the copy of the filtered CRLs stack (NULL if there are no CRLs) if the
+ * filtered CRLs are valid at the verification time, 0 if not found, or a negative value
+ * if an error occurs */
+static int
+xmlSecOpenSSLX509CrlsCacheGetFiltered(xmlSecOpenSSLX509CrlsCachePtr cache, time_t verificationTime,
+    STACK_OF(X509_CRL)** out_crls
+) {
+    int res = 0;
+
+    xmlSecAssert2(cache != NULL, -1);
+    xmlSecAssert2(out_crls != NULL, -1);
+
+    (*out_crls) = NULL;
+    if(cache->mutex == NULL) {
+        return(0);
+    }
+
+    xmlMutexLock(cache->mutex);
+    if((cache->filteredValid != 0) && (cache->filteredFrom <= verificationTime) &&
+       ((cache->filteredUntil == 0) || (verificationTime < cache->filteredUntil)))
+    {
+        if(cache->filtered != NULL) {
+            (*out_crls) = sk_X509_CRL_dup(cache->filtered);
+            if((*out_crls) == NULL) {
+                xmlMutexUnlock(cache->mutex);
+                xmlSecOpenSSLError("sk_X509_CRL_dup", NULL);
+                return(-1);
+            }
+        }
+        res = 1;
+    }
+    xmlMutexUnlock(cache->mutex);
+    return(res);
+}
+
+/* updates the [from, until) window around the verification time with one CRL time boundary:
+ * the CRL validity is checked with seconds precision thus the boundary second itself is
+ * ambiguous and limits the window to this second */
+static int
+xmlSecOpenSSLX509CrlsCacheUpdateWindow(const ASN1_TIME* tm, time_t verificationTime, time_t* from, time_t* until) {
+    time_t tt;
+    int ret;
+
+    xmlSecAssert2(from != NULL, -1);
+    xmlSecAssert2(until != NULL, -1);
+
+    if(tm == NULL) {
+        return(0);
+    }
+    ret = xmlSecOpenSSLX509Asn1TimeToTime(tm, &tt);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509Asn1TimeToTime", NULL);
+        return(-1);
+    }
+    if(tt < verificationTime) {
+        if((tt + 1) > (*from)) {
+            (*from) = tt + 1;
+        }
+    } else if(tt > verificationTime) {
+        if(((*until) == 0) || (tt < (*until))) {
+            (*until) = tt;
+        }
+    } else {
+        (*from) = tt;
+        (*until) = tt + 1;
+    }
+    return(0);
+}
+
+static int
+xmlSecOpenSSLX509CrlsCacheSetFiltered(xmlSecOpenSSLX509CrlsCachePtr cache, STACK_OF(X509_CRL)* crls,
+    STACK_OF(X509_CRL)* filtered, time_t verificationTime
+) {
+    STACK_OF(X509_CRL)* copy = NULL;
+    time_t from = 0;
+    time_t until = 0;
     xmlSecOpenSSLSizeT ii, num;
     int ret;
-    int ctx_initialized = 0;
+
+    xmlSecAssert2(cache != NULL, -1);
+
+    if(cache->mutex == NULL) {
+        return(0);
+    }
+
+    /* the filtered set changes only when the verification time crosses a CRL boundary */
+    num = (crls != NULL) ? sk_X509_CRL_num(crls) : 0;
+    for(ii = 0; ii < num; ++ii) {
+        X509_CRL* crl = sk_X509_CRL_value(crls, ii);
+        if(crl == NULL) {
+            continue;
+        }
+        ret = xmlSecOpenSSLX509CrlsCacheUpdateWindow(X509_CRL_get0_lastUpdate(crl), verificationTime, &from, &until);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509CrlsCacheUpdateWindow(thisUpdate)", NULL);
+            return(-1);
+        }
+        ret = xmlSecOpenSSLX509CrlsCacheUpdateWindow(X509_CRL_get0_nextUpdate(crl), verificationTime, &from, &until);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509CrlsCacheUpdateWindow(nextUpdate)", NULL);
+            return(-1);
+        }
+    }
+
+    if(filtered != NULL) {
+        copy = sk_X509_CRL_dup(filtered);
+        if(copy == NULL) {
+            xmlSecOpenSSLError("sk_X509_CRL_dup", NULL);
+            return(-1);
+        }
+    }
+
+    xmlMutexLock(cache->mutex);
+    xmlSecOpenSSLX509CrlsCacheResetFiltered(cache);
+    cache->filtered = copy;
+    cache->filteredFrom = from;
+    cache->filteredUntil = until;
+    cache->filteredValid = 1;
+    xmlMutexUnlock(cache->mutex);
+    return(0);
+}
+
+
+/******************************************************************************
+ *
+ * Low-level x509 functions
+ *
+  *****************************************************************************/
+static X509*
+xmlSecOpenSSLX509FindTrustedIssuer(X509_STORE* xst, XMLSEC_OPENSSL400_CONST X509_NAME* issuer) {
+    STACK_OF(X509_OBJECT)* objects = NULL;
+    xmlSecOpenSSLSizeT ii, num;
+    X509* issuer_cert = NULL;
 
     xmlSecAssert2(xst != NULL, NULL);
-    xmlSecAssert2(xsc != NULL, NULL);
     xmlSecAssert2(issuer != NULL, NULL);
-    xmlSecAssert2(keyInfoCtx != NULL, NULL);
 
-    if(untrusted == NULL) {
+    /* Get all objects from the trusted store */
+#if defined(XMLSEC_OPENSSL_API_350)
+    objects = X509_STORE_get1_objects(xst);
+    if(objects == NULL) {
+        return(NULL);
+    }
+#else   /* defined(XMLSEC_OPENSSL_API_350) */
+    objects = X509_STORE_get0_objects(xst);
+    if(objects == NULL) {
         return(NULL);
     }
+#endif /* defined(XMLSEC_OPENSSL_API_350) */
 
-    num = sk_X509_num(untrusted);
+    /* Search for a certificate with matching subject */
+    num = sk_X509_OBJECT_num(objects);
     for(ii = 0; ii < num; ++ii) {
-        X509* cert = sk_X509_value(untrusted, ii);
+        X509_OBJECT* obj = sk_X509_OBJECT_value(objects, ii);
+        X509* cert;
         XMLSEC_OPENSSL400_CONST X509_NAME* cert_subject;
 
-        if(cert == NULL) {
+        if(obj == NULL) {
             continue;
         }
 
-        cert_subject = X509_get_subject_name(cert);
-        if(cert_subject == NULL) {
+        /* Check if this object is a certificate */
+        if(X509_OBJECT_get_type(obj) != X509_LU_X509) {
             continue;
         }
 
-        /* Check if subject matches the issuer we're looking for */
-        if(X509_NAME_cmp(cert_subject, issuer) != 0) {
+        cert = X509_OBJECT_get0_X509(obj);
+        if(cert == NULL) {
             continue;
         }
 
-        /* Found a candidate, verify the chain to a trusted root using passed xsc */
-        ret = X509_STORE_CTX_init(xsc, xst, cert, untrusted);
-        if(ret != 1) {
-            xmlSecOpenSSLError("X509_STORE_CTX_init", NULL);
-            goto done;
-        }
-        ctx_initialized = 1;
-
-        ret = xmlSecOpenSSLX509StoreSetCtx(xsc, keyInfoCtx);
-        if(ret < 0) {
-            xmlSecInternalError("xmlSecOpenSSLX509StoreSetCtx", NULL);
-            goto done;
+        cert_subject = X509_get_subject_name(cert);
+        if(cert_subject == NULL) {
+            continue;
         }
 
-        ret = X509_verify_cert(xsc);
-        if(ret == 1) {
-            /* Chain verified successfully, return a copy */
+        /* Check if subject matches the issuer we're looking for */
+        if(X509_NAME_cmp(cert_subject, issuer) == 0) {
+            /* Found a match, duplicate and return */
             issuer_cert = X509_dup(cert);
             if(issuer_cert == NULL) {
                 xmlSecOpenSSLError("X509_dup", NULL);
             }
-            goto done;
+            break;
         }
+    }
 
-        /* Chain verification failed, try next candidate */
-        X509_STORE_CTX_cleanup(xsc);
-        ctx_initialized = 0;
+    /* list returned by X509_STORE_get1_objects needs to be freed */
+#if defined(XMLSEC_OPENSSL_API_350)
+    sk_X509_OBJECT_pop_free(objects, X509_OBJECT_free);
+#endif /* defined(XMLSEC_OPENSSL_API_350) */
+
+    /* done */
+    return(issuer_cert);
+}
+
+/* returns 1 if @cert is the verified @issuer (the copy is returned in @issuer_cert), 0 if not, or a negative value if an error occurs */
+static int
+xmlSecOpenSSLX509CheckUntrustedIssuer(X509* cert, XMLSEC_OPENSSL400_CONST X509_NAME* issuer, X509_STORE* xst, X509_STORE_CTX* xsc,
+    STACK_OF(X509)* untrusted, xmlSecKeyInfoCtx* keyInfoCtx, X509** issuer_cert
+) {
+    XMLSEC_OPENSSL400_CONST X509_NAME* cert_subject;
+    int ret;
+
+    xmlSecAssert2(cert != NULL, -1);
+    xmlSecAssert2(issuer != NULL, -1);
+    xmlSecAssert2(xst != NULL, -1);
+    xmlSecAssert2(xsc != NULL, -1);
+    xmlSecAssert2(keyInfoCtx != NULL, -1);
+    xmlSecAssert2(issuer_cert != NULL, -1);
+
+    cert_subject = X509_get_subject_name(cert);
+    if(cert_subject == NULL) {
+        return(0);
     }
 
-done:
-    if(ctx_initialized != 0) {
+    /* Check if subject matches the issuer we're looking for */
+    if(X509_NAME_cmp(cert_subject, issuer) != 0) {
+        return(0);
+    }
+
+    /* Found a candidate, verify the chain to a trusted root using passed xsc */
+    ret = X509_STORE_CTX_init(xsc, xst, cert, untrusted);
+    if(ret != 1) {
+        xmlSecOpenSSLError("X509_STORE_CTX_init", NULL);
+        return(-1);
+    }
+
+    ret = xmlSecOpenSSLX509StoreSetCtx(xsc, keyInfoCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509StoreSetCtx", NULL);
         X509_STORE_CTX_cleanup(xsc);
+        return(-1);
     }
-    return(issuer_cert);
+
+    ret = X509_verify_cert(xsc);
+    X509_STORE_CTX_cleanup(xsc);
+    if(ret != 1) {
+        /* Chain verification failed, try next candidate */
+        return(0);
+    }
+
+    /* Chain verified successfully, return a copy */
+    (*issuer_cert) = X509_dup(cert);
+    if((*issuer_cert) == NULL) {
+        xmlSecOpenSSLError("X509_dup", NULL);
+        return(-1);
+    }
+    return(1);
 }
 
+/* searches @certs and the store untrusted certs (both are in the @untrusted list) */
 static X509*
-xmlSecOpenSSLX509FindIssuer(XMLSEC_OPENSSL400_CONST X509_NAME* issuer, X509_STORE* xst, X509_STORE_CTX* xsc, STACK_OF(X509)* untrusted, xmlSecKeyInfoCtx* keyInfoCtx) {
+xmlSecOpenSSLX509FindUntrustedIssuer(XMLSEC_OPENSSL400_CONST X509_NAME* issuer, xmlSecOpenSSLX509StoreCtxPtr ctx, X509_STORE_CTX* xsc,
+    STACK_OF(X509)* certs, STACK_OF(X509)* untrusted, xmlSecKeyInfoCtx* keyInfoCtx
+) {
+    xmlSecOpenSSLX509IndexItemPtr item;
     X509* issuer_cert = NULL;
+    xmlSecOpenSSLSizeT ii, num;
+    unsigned long hash;
+    char key[32];
+    int ret;
 
-    xmlSecAssert2(xst != NULL, NULL);
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(ctx->xst != NULL, NULL);
+    xmlSecAssert2(xsc != NULL, NULL);
+    xmlSecAssert2(issuer != NULL, NULL);
+    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+
+    if(untrusted == NULL) {
+        return(NULL);
+    }
+
+    /* no indexes (or unknown name hash): check all the certs */
+    hash = X509_NAME_hash_ex(issuer, xmlSecOpenSSLGetLibCtx(), NULL, NULL);
+    if((xmlSecOpenSSLX509StoreIndexIsValid(ctx) != 1) || (hash == 0)) {
+        num = sk_X509_num(untrusted);
+        for(ii = 0; ii < num; ++ii) {
+            X509* cert = sk_X509_value(untrusted, ii);
+            if(cert == NULL) {
+                continue;
+            }
+            ret = xmlSecOpenSSLX509CheckUntrustedIssuer(cert, issuer, ctx->xst, xsc, untrusted, keyInfoCtx, &issuer_cert);
+            if(ret != 0) {
+                return(issuer_cert);
+            }
+        }
+        return(NULL);
+    }
+
+    /* the certs from the document are checked first, same as in the @untrusted list */
+    if(certs != NULL) {
+        num = sk_X509_num(certs);
+        for(ii = 0; ii < num; ++ii) {
+            X509* cert = sk_X509_value(certs, ii);
+            if(cert == NULL) {
+                continue;
+            }
+            ret = xmlSecOpenSSLX509CheckUntrustedIssuer(cert, issuer, ctx->xst, xsc, untrusted, keyInfoCtx, &issuer_cert);
+            if(ret != 0) {
+                return(issuer_cert);
+            }
+        }
+    }
+
+    /* and then only the store certs with the same subject name hash */
+    (void)snprintf(key, sizeof(key), "%08lx", hash);
+    item = (xmlSecOpenSSLX509IndexItemPtr)xmlHashLookup(ctx->bySubjectHash, BAD_CAST key);
+    for( ; item != NULL; item = item->nextSameHash) {
+        ret = xmlSecOpenSSLX509CheckUntrustedIssuer(item->cert, issuer, ctx->xst, xsc, untrusted, keyInfoCtx, &issuer_cert);
+        if(ret != 0) {
+            return(issuer_cert);
+        }
+    }
+    return(NULL);
+}
+
+static X509*
+xmlSecOpenSSLX509FindIssuer(XMLSEC_OPENSSL400_CONST X509_NAME* issuer, xmlSecOpenSSLX509StoreCtxPtr ctx, X509_STORE_CTX* xsc,
+    STACK_OF(X509)* certs, STACK_OF(X509)* untrusted, xmlSecKeyInfoCtx* keyInfoCtx
+) {
+    X509* issuer_cert = NULL;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(ctx->xst != NULL, NULL);
     xmlSecAssert2(xsc != NULL, NULL);
     xmlSecAssert2(issuer != NULL, NULL);
     xmlSecAssert2(keyInfoCtx != NULL, NULL);
 
     /* First, search in the untrusted certificates */
-    issuer_cert = xmlSecOpenSSLX509FindUntrustedIssuer(issuer, xst, xsc, untrusted, keyInfoCtx);
+    issuer_cert = xmlSecOpenSSLX509FindUntrustedIssuer(issuer, ctx, xsc, certs, untrusted, keyInfoCtx);
     if(issuer_cert != NULL) {
         return(issuer_cert);
     }
 
     /* Not found in untrusted certs, search in trusted store */
-    issuer_cert = xmlSecOpenSSLX509FindTrustedIssuer(xst, issuer);
+    issuer_cert = xmlSecOpenSSLX509FindTrustedIssuer(ctx->xst, issuer);
     if(issuer_cert != NULL) {
         return(issuer_cert);
     }
@@ -1667,19 +3800,22 @@ xmlSecOpenSSLX509VerifyCRLTimeValidity(X509_CRL *crl, xmlSecKeyInfoCtx* keyInfoC
 }
 
 static int
-xmlSecOpenSSLX509VerifyCRLSignature(X509_STORE* xst, X509_STORE_CTX* xsc, STACK_OF(X509)* untrusted, X509_CRL *crl, xmlSecKeyInfoCtx* keyInfoCtx) {
+xmlSecOpenSSLX509VerifyCRLSignature(xmlSecOpenSSLX509StoreCtxPtr ctx, X509_STORE_CTX* xsc, STACK_OF(X509)* certs,
+    STACK_OF(X509)* untrusted, X509_CRL *crl, xmlSecKeyInfoCtx* keyInfoCtx
+) {
     X509 *issuer_cert = NULL;
     EVP_PKEY *pKey = NULL;
+    xmlChar* key = NULL;
     int ret;
     int res = -1;
 
-    xmlSecAssert2(xst != NULL, -1);
+    xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(xsc != NULL, -1);
     xmlSecAssert2(crl != NULL, -1);
     xmlSecAssert2(keyInfoCtx != NULL, -1);
 
     /* Find the CRL issuer certificate (searches untrusted first, then trusted) */
-    issuer_cert = xmlSecOpenSSLX509FindIssuer(X509_CRL_get_issuer(crl), xst, xsc, untrusted, keyInfoCtx);
+    issuer_cert = xmlSecOpenSSLX509FindIssuer(X509_CRL_get_issuer(crl), ctx, xsc, certs, untrusted, keyInfoCtx);
     if(issuer_cert == NULL) {
         char issuer[256];
         xmlSecOpenSSLX509NameToString(X509_CRL_get_issuer(crl), issuer, sizeof(issuer));
@@ -1687,6 +3823,17 @@ xmlSecOpenSSLX509VerifyCRLSignature(X509_STORE* xst, X509_STORE_CTX* xsc, STACK_
         goto done;
     }
 
+    /* was this CRL already verified with this issuer cert key? */
+    key = xmlSecOpenSSLX509CrlsCacheSignatureKey(crl, issuer_cert);
+    if(key == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509CrlsCacheSignatureKey", NULL);
+        goto done;
+    }
+    if(xmlSecOpenSSLX509CrlsCacheIsVerified(&(ctx->crlsCache), key) == 1) {
+        res = 1;
+        goto done;
+    }
+
     pKey = X509_get_pubkey(issuer_cert);
     if(pKey == NULL) {
         xmlSecOpenSSLError("X509_get_pubkey", NULL);
@@ -1709,10 +3856,19 @@ xmlSecOpenSSLX509VerifyCRLSignature(X509_STORE* xst, X509_STORE_CTX* xsc, STACK_
         goto done;
     }
 
+    ret = xmlSecOpenSSLX509CrlsCacheAddVerified(&(ctx->crlsCache), key);
+    if(ret < 0) {
+        /* the CRL is verified, the cache is just an optimization */
+        xmlSecInternalError("xmlSecOpenSSLX509CrlsCacheAddVerified", NULL);
+    }
+
     /* success: verified */
     res = 1;
 
 done:
+    if(key != NULL) {
+        xmlFree(key);
+    }
     if(pKey != NULL) {
         EVP_PKEY_free(pKey);
     }
@@ -1723,10 +3879,12 @@ done:
 }
 
 static int
-xmlSecOpenSSLX509VerifyCRL(X509_STORE* xst, X509_STORE_CTX* xsc, STACK_OF(X509)* untrusted, X509_CRL *crl, xmlSecKeyInfoCtx* keyInfoCtx) {
+xmlSecOpenSSLX509VerifyCRL(xmlSecOpenSSLX509StoreCtxPtr ctx, X509_STORE_CTX* xsc, STACK_OF(X509)* certs,
+    STACK_OF(X509)* untrusted, X509_CRL *crl, xmlSecKeyInfoCtx* keyInfoCtx
+) {
     int ret;
 
-    xmlSecAssert2(xst != NULL, -1);
+    xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(xsc != NULL, -1);
     xmlSecAssert2(crl != NULL, -1);
     xmlSecAssert2(keyInfoCtx != NULL, -1);
@@ -1742,7 +3900,7 @@ xmlSecOpenSSLX509VerifyCRL(X509_STORE* xst, X509_STORE_CTX* xsc, STACK_OF(X509)*
     }
 
     /* Verify CRL signature (slower check) */
-    ret = xmlSecOpenSSLX509VerifyCRLSignature(xst, xsc, untrusted, crl, keyInfoCtx);
+    ret = xmlSecOpenSSLX509VerifyCRLSignature(ctx, xsc, certs, untrusted, crl, keyInfoCtx);
     if(ret < 0) {
         xmlSecInternalError("xmlSecOpenSSLX509VerifyCRLSignature", NULL);
         return(-1);
@@ -1773,9 +3931,9 @@ xmlSecOpenSSLX509FindCertCtxInitialize(xmlSecOpenSSLX509FindCertCtxPtr ctx,
 
     /* Subject name */
     if(subjectName != NULL) {
-        ctx->subjectName = xmlSecOpenSSLX509NameRead(subjectName);
-        if(ctx->subjectName == NULL) {
-            xmlSecInternalError2("xmlSecOpenSSLX509NameRead", NULL,
+        ctx->subjectNameKey = xmlSecOpenSSLX509NameStringKey(subjectName);
+        if(ctx->subjectNameKey == NULL) {
+            xmlSecInternalError2("xmlSecOpenSSLX509NameStringKey", NULL,
                 "subject=%s", xmlSecErrorsSafeString(subjectName));
             xmlSecOpenSSLX509FindCertCtxFinalize(ctx);
             return(-1);
@@ -1786,9 +3944,9 @@ xmlSecOpenSSLX509FindCertCtxInitialize(xmlSecOpenSSLX509FindCertCtxPtr ctx,
     if((issuerName != NULL) && (issuerSerial != NULL)) {
         BIGNUM *bn = NULL;
 
-        ctx->issuerName = xmlSecOpenSSLX509NameRead(issuerName);
-        if(ctx->issuerName == NULL) {
-            xmlSecInternalError2("xmlSecOpenSSLX509NameRead", NULL,
+        ctx->issuerNameKey = xmlSecOpenSSLX509NameStringKey(issuerName);
+        if(ctx->issuerNameKey == NULL) {
+            xmlSecInternalError2("xmlSecOpenSSLX509NameStringKey", NULL,
                 "issuer=%s", xmlSecErrorsSafeString(issuerName));
             xmlSecOpenSSLX509FindCertCtxFinalize(ctx);
             return(-1);
@@ -1876,11 +4034,11 @@ xmlSecOpenSSLX509FindCertCtxInitializeFromValue(xmlSecOpenSSLX509FindCertCtxPtr
 void xmlSecOpenSSLX509FindCertCtxFinalize(xmlSecOpenSSLX509FindCertCtxPtr ctx) {
     xmlSecAssert(ctx != NULL);
 
-    if(ctx->subjectName != NULL) {
-        X509_NAME_free(ctx->subjectName);
+    if(ctx->subjectNameKey != NULL) {
+        xmlFree(ctx->subjectNameKey);
     }
-    if(ctx->issuerName != NULL) {
-        X509_NAME_free(ctx->issuerName);
+    if(ctx->issuerNameKey != NULL) {
+        xmlFree(ctx->issuerNameKey);
     }
     if(ctx->issuerSerial != NULL) {
         ASN1_INTEGER_free(ctx->issuerSerial);
@@ -1893,13 +4051,13 @@ void xmlSecOpenSSLX509FindCertCtxFinalize(xmlSecOpenSSLX509FindCertCtxPtr ctx) {
 
 
 static int
-xmlSecOpenSSLX509MatchBySubjectName(X509* cert, XMLSEC_OPENSSL400_CONST X509_NAME* subjectName) {
+xmlSecOpenSSLX509MatchBySubjectName(X509* cert, const xmlChar* subjectNameKey) {
     XMLSEC_OPENSSL400_CONST X509_NAME * certSubjectName;
     int ret;
 
     xmlSecAssert2(cert != NULL, -1);
 
-    if(subjectName == NULL) {
+    if(subjectNameKey == NULL) {
         return(0);
     }
 
@@ -1908,24 +4066,23 @@ xmlSecOpenSSLX509MatchBySubjectName(X509* cert, XMLSEC_OPENSSL400_CONST X509_NAM
         return(0);
     }
 
-    /* returns 0 if equal */
-    ret = xmlSecOpenSSLX509NamesCompare(subjectName, certSubjectName);
-    if(ret != 0) {
-        return(0);
+    ret = xmlSecOpenSSLX509NameMatchesKey(certSubjectName, subjectNameKey);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509NameMatchesKey", NULL);
+        return(-1);
     }
-
-    /* success */
-    return(1);
+    return(ret);
 }
 
 static int
-xmlSecOpenSSLX509MatchByIssuer(X509* cert, XMLSEC_OPENSSL400_CONST X509_NAME* issuerName, ASN1_INTEGER* issuerSerial) {
+xmlSecOpenSSLX509MatchByIssuer(X509* cert, const xmlChar* issuerNameKey, ASN1_INTEGER* issuerSerial) {
     ASN1_INTEGER* certSerial;
     XMLSEC_OPENSSL400_CONST X509_NAME* certName;
+    int ret;
 
     xmlSecAssert2(cert != NULL, -1);
 
-    if((issuerName == NULL) || (issuerSerial == NULL)) {
+    if((issuerNameKey == NULL) || (issuerSerial == NULL)) {
         return(0);
     }
 
@@ -1934,12 +4091,16 @@ xmlSecOpenSSLX509MatchByIssuer(X509* cert, XMLSEC_OPENSSL400_CONST X509_NAME* is
         return(0);
     }
     certName = X509_get_issuer_name(cert);
-    if((certName == NULL) || (xmlSecOpenSSLX509NamesCompare(certName, issuerName) != 0)) {
+    if(certName == NULL) {
         return(0);
     }
 
-    /* success */
-    return(1);
+    ret = xmlSecOpenSSLX509NameMatchesKey(certName, issuerNameKey);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509NameMatchesKey", NULL);
+        return(-1);
+    }
+    return(ret);
 }
 
 static int
@@ -2013,7 +4174,7 @@ xmlSecOpenSSLX509FindCertCtxMatch(xmlSecOpenSSLX509FindCertCtxPtr ctx, X509* cer
     xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(cert != NULL, -1);
 
-    ret = xmlSecOpenSSLX509MatchBySubjectName(cert, ctx->subjectName);
+    ret = xmlSecOpenSSLX509MatchBySubjectName(cert, ctx->subjectNameKey);
     if(ret < 0) {
         xmlSecInternalError("xmlSecOpenSSLX509MatchBySubjectName", NULL);
         return(-1);
@@ -2022,7 +4183,7 @@ xmlSecOpenSSLX509FindCertCtxMatch(xmlSecOpenSSLX509FindCertCtxPtr ctx, X509* cer
         return(1);
     }
 
-    ret = xmlSecOpenSSLX509MatchByIssuer(cert, ctx->issuerName, ctx->issuerSerial);
+    ret = xmlSecOpenSSLX509MatchByIssuer(cert, ctx->issuerNameKey, ctx->issuerSerial);
     if(ret < 0) {
         xmlSecInternalError("xmlSecOpenSSLX509MatchByIssuer", NULL);
         return(-1);
@@ -2346,81 +4507,49 @@ xmlSecOpenSSLX509_NAME_ENTRIES_copy(XMLSEC_OPENSSL400_CONST X509_NAME * a) {
     return (res);
 }
 
-/* returns 0 if equal */
-static
-int xmlSecOpenSSLX509_NAME_ENTRIES_cmp(STACK_OF(X509_NAME_ENTRY)* a,  STACK_OF(X509_NAME_ENTRY)* b) {
-    const X509_NAME_ENTRY *na;
-    const X509_NAME_ENTRY *nb;
-    xmlSecOpenSSLSizeT ii;
-    xmlSecOpenSSLSizeT num_a, num_b;
-    int ret;
-
-    xmlSecAssert2(a != NULL, -1);
-    xmlSecAssert2(b != NULL, 1);
-
-    num_a = sk_X509_NAME_ENTRY_num(a);
-    num_b = sk_X509_NAME_ENTRY_num(b);
-    if (num_a > num_b) {
-        return(1);
-    } else if (num_a < num_b) {
-        return(-1);
-    }
-
-    /* num_a == num_b */
-    for (ii = 0; ii < num_a; ++ii) {
-        na = sk_X509_NAME_ENTRY_value(a, ii);
-        nb = sk_X509_NAME_ENTRY_value(b, ii);
-
-        ret = xmlSecOpenSSLX509_NAME_ENTRY_cmp(&na, &nb);
-        if(ret != 0) {
-            return(ret);
-        }
-    }
-
-    /* same */
-    return(0);
-}
-
-
 /**
- * @brief We have to sort X509_NAME entries to get correct results.
- * This is ugly but OpenSSL does not support it
+ * @brief Compares the names using the canonical keys (sorted entries).
+ * @details OpenSSL's X509_NAME_cmp() takes the entries order into account.
  *
  * Returns 0 if equal
  */
 static int
 xmlSecOpenSSLX509NamesCompare(XMLSEC_OPENSSL400_CONST X509_NAME *a, XMLSEC_OPENSSL400_CONST X509_NAME *b) {
-    STACK_OF(X509_NAME_ENTRY) *a1 = NULL;
-    STACK_OF(X509_NAME_ENTRY) *b1 = NULL;
+    const unsigned char *aDer = NULL, *bDer = NULL;
+    size_t aDerLen = 0, bDerLen = 0;
+    xmlChar *aKey, *bKey;
     int ret;
 
     xmlSecAssert2(a != NULL, -1);
     xmlSecAssert2(b != NULL, 1);
 
-    a1 = xmlSecOpenSSLX509_NAME_ENTRIES_copy(a);
-    if(a1 == NULL) {
-        xmlSecInternalError("xmlSecOpenSSLX509_NAME_ENTRIES_copy", NULL);
+    /* the same DER encoding is the same name */
+    if((X509_NAME_get0_der((X509_NAME*)a, &aDer, &aDerLen) == 1) &&
+       (X509_NAME_get0_der((X509_NAME*)b, &bDer, &bDerLen) == 1) &&
+       (aDer != NULL) && (bDer != NULL) && (aDerLen == bDerLen) &&
+       (memcmp(aDer, bDer, aDerLen) == 0)
+    ) {
+        return(0);
+    }
+
+    aKey = xmlSecOpenSSLX509NameKey(a);
+    if(aKey == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509NameKey", NULL);
         return(-1);
     }
-    b1 = xmlSecOpenSSLX509_NAME_ENTRIES_copy(b);
-    if(b1 == NULL) {
-        xmlSecInternalError("xmlSecOpenSSLX509_NAME_ENTRIES_copy", NULL);
-        sk_X509_NAME_ENTRY_pop_free(a1, X509_NAME_ENTRY_free);
+    bKey = xmlSecOpenSSLX509NameKey(b);
+    if(bKey == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509NameKey", NULL);
+        xmlFree(aKey);
         return(-1);
     }
 
-    /* sort both */
-    (void)sk_X509_NAME_ENTRY_set_cmp_func(a1, xmlSecOpenSSLX509_NAME_ENTRY_cmp);
-    sk_X509_NAME_ENTRY_sort(a1);
-    (void)sk_X509_NAME_ENTRY_set_cmp_func(b1, xmlSecOpenSSLX509_NAME_ENTRY_cmp);
-    sk_X509_NAME_ENTRY_sort(b1);
-
     /* actually compare, returns 0 if equal */
-    ret = xmlSecOpenSSLX509_NAME_ENTRIES_cmp(a1, b1);
+    ret = xmlStrcmp(aKey, bKey);
 
     /* cleanup */
-    sk_X509_NAME_ENTRY_pop_free(a1, X509_NAME_ENTRY_free);
-    sk_X509_NAME_ENTRY_pop_free(b1, X509_NAME_ENTRY_free);
+    xmlFree(aKey);
+    xmlFree(bKey);
     return(ret);
 }
 
@@ -33,6 +33,17 @@ XMLSEC_EXPORT int           xmlSecTransformWriteKeyInfoNode      (xmlSecKeyPtr k
                                                                   xmlSecTransformPtr transform,
                                                                   xmlSecTransformCtxPtr transformCtx);
 
+/* Internal helper used by the "#id" URIs processing: checks if the bare name XPointer transform can be used */
+XMLSEC_EXPORT int           xmlSecTransformBareNameCheckId       (const xmlChar* id);
+
+/* Internal helpers used by xmlSecInit() / xmlSecShutdown(): the compiled XPath expressions cache */
+XMLSEC_EXPORT int           xmlSecTransformXPathCacheInit        (void);
+XMLSEC_EXPORT void          xmlSecTransformXPathCacheShutdown    (void);
+
+/* Internal transform flag: set by xmlSecTransformDefaultPopBin() while the previous
+ * transform writes into the free space right after the data in the transform's input buffer */
+#define XMLSEC_TRANSFORM_FLAGS_POP_BIN_INTO_IN_BUF          0x00010000
+
 
 /******************************************************************************
  *
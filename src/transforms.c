@@ -881,6 +881,7 @@ xmlSecTransformCtxSetUri(xmlSecTransformCtxPtr ctx, const xmlChar* uri, xmlNodeP
     xmlChar* buf = NULL;
     int uriLen;
     int useVisa3DHack = 0;
+    int useBareName = 0;
     int ret;
     int res = -1;
 
@@ -946,6 +947,11 @@ xmlSecTransformCtxSetUri(xmlSecTransformCtxPtr ctx, const xmlChar* uri, xmlNodeP
         ++xptr;
         nodeSetType = xmlSecNodeSetTreeWithoutComments;
         useVisa3DHack = 1;
+    } else if(xmlSecTransformBareNameCheckId(xptr + 1) == 1) {
+        /* the same as "xpointer(id('..'))" but without XPointer engine */
+        ++xptr;
+        nodeSetType = xmlSecNodeSetTreeWithoutComments;
+        useBareName = 1;
     } else {
         xmlSecSize size;
         int len;
@@ -968,7 +974,21 @@ xmlSecTransformCtxSetUri(xmlSecTransformCtxPtr ctx, const xmlChar* uri, xmlNodeP
         nodeSetType = xmlSecNodeSetTreeWithoutComments;
     }
 
-    if(useVisa3DHack == 0) {
+    if(useBareName != 0) {
+        xmlSecTransformPtr transform;
+
+        transform = xmlSecTransformCtxCreateAndPrepend(ctx, xmlSecTransformBareNameId);
+        if(!xmlSecTransformIsValid(transform)) {
+            xmlSecInternalError("xmlSecTransformCtxCreateAndPrepend(xmlSecTransformBareNameId)", NULL);
+            goto done;
+        }
+
+        ret = xmlSecTransformBareNameSetId(transform, xptr, nodeSetType, hereNode);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformBareNameSetId", xmlSecTransformGetName(transform));
+            goto done;
+        }
+    } else if(useVisa3DHack == 0) {
         xmlSecTransformPtr transform;
 
         /* we need to create XPonter transform to execute expr */
@@ -2171,9 +2191,11 @@ xmlSecTransformDefaultPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
             }
 
             /* get data from previous transform */
+            transform->flags |= XMLSEC_TRANSFORM_FLAGS_POP_BIN_INTO_IN_BUF;
             ret = xmlSecTransformPopBin(transform->prev,
                             xmlSecBufferGetData(&(transform->inBuf)) + inSize,
                             chunkSize, &chunkSize, transformCtx);
+            transform->flags &= ~((uintptr_t)XMLSEC_TRANSFORM_FLAGS_POP_BIN_INTO_IN_BUF);
             if(ret < 0) {
                 xmlSecInternalError("xmlSecTransformPopBin", xmlSecTransformGetName(transform->prev));
                 return(-1);
@@ -32,6 +32,7 @@
 #include <xmlsec/errors.h>
 
 #include "cast_helpers.h"
+#include "xmltree_helpers.h"
 
 /******************************************************************************
  *
@@ -58,6 +59,11 @@ static void     xmlSecDSigCtxMarkAsSucceeded            (xmlSecDSigCtxPtr dsigCt
 static void     xmlSecDSigCtxMarkAsFailed               (xmlSecDSigCtxPtr dsigCtx,
                                                          xmlSecDSigFailureReason failureReason);
 
+static int      xmlSecDSigCtxSignInternal               (xmlSecDSigCtxPtr dsigCtx,
+                                                         xmlNodePtr tmpl);
+static int      xmlSecDSigCtxVerifyInternal             (xmlSecDSigCtxPtr dsigCtx,
+                                                         xmlNodePtr node);
+
 /* The ID attribute in XMLDSig is 'Id' */
 static const xmlChar*           xmlSecDSigIds[] = { xmlSecAttrId, NULL };
 
@@ -263,6 +269,35 @@ xmlSecDSigCtxGetPreSignBuffer(xmlSecDSigCtxPtr dsigCtx) {
  */
 int
 xmlSecDSigCtxSign(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr tmpl) {
+    xmlSecIdsRegistryPtr registry;
+    int res;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(tmpl != NULL, -1);
+    xmlSecAssert2(tmpl->doc != NULL, -1);
+
+    /* the registry lives for this operation only and is shared with the nested
+     * <enc:EncryptedKey/> contexts through the key info contexts */
+    registry = xmlSecIdsRegistryCreate(tmpl->doc);
+    if(registry == NULL) {
+        xmlSecInternalError("xmlSecIdsRegistryCreate", NULL);
+        return(-1);
+    }
+    dsigCtx->reserved0 = registry;
+    dsigCtx->keyInfoReadCtx.reserved0 = registry;
+    dsigCtx->keyInfoWriteCtx.reserved0 = registry;
+
+    res = xmlSecDSigCtxSignInternal(dsigCtx, tmpl);
+
+    dsigCtx->keyInfoReadCtx.reserved0 = NULL;
+    dsigCtx->keyInfoWriteCtx.reserved0 = NULL;
+    dsigCtx->reserved0 = NULL;
+    xmlSecIdsRegistryDestroy(registry);
+    return(res);
+}
+
+static int
+xmlSecDSigCtxSignInternal(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr tmpl) {
     xmlSecByte* outBuf;
     xmlSecSize outSize;
     int outLen;
@@ -278,7 +313,7 @@ xmlSecDSigCtxSign(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr tmpl) {
     dsigCtx->status     = xmlSecDSigStatusUnknown;
     dsigCtx->keyInfoReadCtx.operation  = xmlSecTransformOperationSign;
     dsigCtx->keyInfoWriteCtx.operation = xmlSecTransformOperationSign;
-    xmlSecAddIDs(tmpl->doc, tmpl, xmlSecDSigIds);
+    xmlSecIdsRegistryAddIDs((xmlSecIdsRegistryPtr)dsigCtx->reserved0, tmpl->doc, tmpl, xmlSecDSigIds);
 
     /* read signature template */
     ret = xmlSecDSigCtxProcessSignatureNode(dsigCtx, tmpl);
@@ -332,6 +367,35 @@ xmlSecDSigCtxSign(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr tmpl) {
  */
 int
 xmlSecDSigCtxVerify(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
+    xmlSecIdsRegistryPtr registry;
+    int res;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(node->doc != NULL, -1);
+
+    /* the registry lives for this operation only and is shared with the nested
+     * <enc:EncryptedKey/> contexts through the key info contexts */
+    registry = xmlSecIdsRegistryCreate(node->doc);
+    if(registry == NULL) {
+        xmlSecInternalError("xmlSecIdsRegistryCreate", NULL);
+        return(-1);
+    }
+    dsigCtx->reserved0 = registry;
+    dsigCtx->keyInfoReadCtx.reserved0 = registry;
+    dsigCtx->keyInfoWriteCtx.reserved0 = registry;
+
+    res = xmlSecDSigCtxVerifyInternal(dsigCtx, node);
+
+    dsigCtx->keyInfoReadCtx.reserved0 = NULL;
+    dsigCtx->keyInfoWriteCtx.reserved0 = NULL;
+    dsigCtx->reserved0 = NULL;
+    xmlSecIdsRegistryDestroy(registry);
+    return(res);
+}
+
+static int
+xmlSecDSigCtxVerifyInternal(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
     int ret;
 
     xmlSecAssert2(dsigCtx != NULL, -1);
@@ -343,7 +407,7 @@ xmlSecDSigCtxVerify(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
     dsigCtx->status     = xmlSecDSigStatusUnknown;
     dsigCtx->keyInfoReadCtx.operation  = xmlSecTransformOperationVerify;
     dsigCtx->keyInfoWriteCtx.operation = xmlSecTransformOperationVerify;
-    xmlSecAddIDs(node->doc, node, xmlSecDSigIds);
+    xmlSecIdsRegistryAddIDs((xmlSecIdsRegistryPtr)dsigCtx->reserved0, node->doc, node, xmlSecDSigIds);
 
     /* read signature info */
     ret = xmlSecDSigCtxProcessSignatureNode(dsigCtx, node);
@@ -32,6 +32,7 @@
 #include <xmlsec/errors.h>
 
 #include "cast_helpers.h"
+#include "xmltree_helpers.h"
 
 static int      xmlSecEncCtxEncDataNodeRead             (xmlSecEncCtxPtr encCtx,
                                                          xmlNodePtr node);
@@ -44,6 +45,25 @@ static int      xmlSecEncCtxCipherReferenceNodeRead     (xmlSecEncCtxPtr encCtx,
 static void     xmlSecEncCtxMarkAsFailed                (xmlSecEncCtxPtr encCtx,
                                                          xmlSecEncFailureReason failureReason);
 
+static int      xmlSecEncCtxBinaryEncryptInternal       (xmlSecEncCtxPtr encCtx,
+                                                         xmlNodePtr tmpl,
+                                                         const xmlSecByte* data,
+                                                         xmlSecSize dataSize);
+static int      xmlSecEncCtxXmlEncryptInternal          (xmlSecEncCtxPtr encCtx,
+                                                         xmlNodePtr tmpl,
+                                                         xmlNodePtr node);
+static int      xmlSecEncCtxUriEncryptInternal          (xmlSecEncCtxPtr encCtx,
+                                                         xmlNodePtr tmpl,
+                                                         const xmlChar *uri);
+static int      xmlSecEncCtxDecryptInternal             (xmlSecEncCtxPtr encCtx,
+                                                         xmlNodePtr node);
+static xmlSecBufferPtr xmlSecEncCtxDecryptToBufferInternal(xmlSecEncCtxPtr encCtx,
+                                                         xmlNodePtr node);
+static int      xmlSecEncCtxIdsRegistryAcquire          (xmlSecEncCtxPtr encCtx,
+                                                         xmlDocPtr doc);
+static void     xmlSecEncCtxIdsRegistryRelease          (xmlSecEncCtxPtr encCtx,
+                                                         int owned);
+
 /* The ID attribute in XMLEnc is 'Id' */
 static const xmlChar*           xmlSecEncIds[] = { BAD_CAST "Id", NULL };
 
@@ -102,6 +122,47 @@ xmlSecEncCtxSetDefaults(xmlSecEncCtxPtr encCtx) {
     encCtx->keyInfoWriteCtx.keyReq.keyType = xmlSecKeyDataTypePublic;
 }
 
+/*
+ * The IDs registry is kept in encCtx->reserved1 for the duration of the operation.
+ * It is either inherited from the key info context that owns this <enc:EncryptedKey/>
+ * context or created here. Returns 1 if the registry was created and must be released
+ * by the caller, 0 if it was inherited or a negative value if an error occurs.
+ */
+static int
+xmlSecEncCtxIdsRegistryAcquire(xmlSecEncCtxPtr encCtx, xmlDocPtr doc) {
+    xmlSecIdsRegistryPtr registry;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(doc != NULL, -1);
+
+    if(encCtx->reserved1 != NULL) {
+        return(0);
+    }
+
+    registry = xmlSecIdsRegistryCreate(doc);
+    if(registry == NULL) {
+        xmlSecInternalError("xmlSecIdsRegistryCreate", NULL);
+        return(-1);
+    }
+    encCtx->reserved1 = registry;
+    encCtx->keyInfoReadCtx.reserved0 = registry;
+    encCtx->keyInfoWriteCtx.reserved0 = registry;
+    return(1);
+}
+
+static void
+xmlSecEncCtxIdsRegistryRelease(xmlSecEncCtxPtr encCtx, int owned) {
+    xmlSecAssert(encCtx != NULL);
+
+    if(owned == 0) {
+        return;
+    }
+    xmlSecIdsRegistryDestroy((xmlSecIdsRegistryPtr)encCtx->reserved1);
+    encCtx->reserved1 = NULL;
+    encCtx->keyInfoReadCtx.reserved0 = NULL;
+    encCtx->keyInfoWriteCtx.reserved0 = NULL;
+}
+
 /**
  * @brief Initializes an enc:EncryptedData processing context.
  * @details Initializes &lt;enc:EncryptedData/&gt; element processing context.
@@ -278,6 +339,26 @@ xmlSecEncCtxCopyUserPref(xmlSecEncCtxPtr dst, xmlSecEncCtxPtr src) {
 int
 xmlSecEncCtxBinaryEncrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl,
                           const xmlSecByte* data, xmlSecSize dataSize) {
+    int res;
+    int owned;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(tmpl != NULL, -1);
+    xmlSecAssert2(tmpl->doc != NULL, -1);
+
+    owned = xmlSecEncCtxIdsRegistryAcquire(encCtx, tmpl->doc);
+    if(owned < 0) {
+        xmlSecInternalError("xmlSecEncCtxIdsRegistryAcquire", NULL);
+        return(-1);
+    }
+    res = xmlSecEncCtxBinaryEncryptInternal(encCtx, tmpl, data, dataSize);
+    xmlSecEncCtxIdsRegistryRelease(encCtx, owned);
+    return(res);
+}
+
+static int
+xmlSecEncCtxBinaryEncryptInternal(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl,
+                                  const xmlSecByte* data, xmlSecSize dataSize) {
     int ret;
 
     xmlSecAssert2(encCtx != NULL, -1);
@@ -287,7 +368,7 @@ xmlSecEncCtxBinaryEncrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl,
 
       /* initialize context and add ID attributes to the list of known ids */
     encCtx->operation = xmlSecTransformOperationEncrypt;
-    xmlSecAddIDs(tmpl->doc, tmpl, xmlSecEncIds);
+    xmlSecIdsRegistryAddIDs((xmlSecIdsRegistryPtr)encCtx->reserved1, tmpl->doc, tmpl, xmlSecEncIds);
 
     /* read the template and set encryption method, key, etc. */
     ret = xmlSecEncCtxEncDataNodeRead(encCtx, tmpl);
@@ -326,6 +407,25 @@ xmlSecEncCtxBinaryEncrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl,
  */
 int
 xmlSecEncCtxXmlEncrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl, xmlNodePtr node) {
+    int res;
+    int owned;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(tmpl != NULL, -1);
+    xmlSecAssert2(tmpl->doc != NULL, -1);
+
+    owned = xmlSecEncCtxIdsRegistryAcquire(encCtx, tmpl->doc);
+    if(owned < 0) {
+        xmlSecInternalError("xmlSecEncCtxIdsRegistryAcquire", NULL);
+        return(-1);
+    }
+    res = xmlSecEncCtxXmlEncryptInternal(encCtx, tmpl, node);
+    xmlSecEncCtxIdsRegistryRelease(encCtx, owned);
+    return(res);
+}
+
+static int
+xmlSecEncCtxXmlEncryptInternal(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl, xmlNodePtr node) {
     xmlOutputBufferPtr output;
     int ret;
 
@@ -337,7 +437,7 @@ xmlSecEncCtxXmlEncrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl, xmlNodePtr node)
 
       /* initialize context and add ID attributes to the list of known ids */
     encCtx->operation = xmlSecTransformOperationEncrypt;
-    xmlSecAddIDs(tmpl->doc, tmpl, xmlSecEncIds);
+    xmlSecIdsRegistryAddIDs((xmlSecIdsRegistryPtr)encCtx->reserved1, tmpl->doc, tmpl, xmlSecEncIds);
 
     /* read the template and set encryption method, key, etc. */
     ret = xmlSecEncCtxEncDataNodeRead(encCtx, tmpl);
@@ -399,16 +499,16 @@ xmlSecEncCtxXmlEncrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl, xmlNodePtr node)
     if((encCtx->type != NULL) && xmlStrEqual(encCtx->type, xmlSecTypeEncElement)) {
         /* check if we need to return the replaced node */
         if((encCtx->flags & XMLSEC_ENC_RETURN_REPLACED_NODE) != 0) {
-            ret = xmlSecReplaceNodeAndReturn(node, tmpl, &(encCtx->replacedNodeList));
+            ret = xmlSecIdsRegistryReplaceNode((xmlSecIdsRegistryPtr)encCtx->reserved1, node, tmpl, &(encCtx->replacedNodeList));
             if(ret < 0) {
-                xmlSecInternalError("xmlSecReplaceNodeAndReturn",
+                xmlSecInternalError("xmlSecIdsRegistryReplaceNode",
                                     xmlSecNodeGetName(node));
                 return(-1);
             }
         } else {
-            ret = xmlSecReplaceNode(node, tmpl);
+            ret = xmlSecIdsRegistryReplaceNode((xmlSecIdsRegistryPtr)encCtx->reserved1, node, tmpl, NULL);
             if(ret < 0) {
-                xmlSecInternalError("xmlSecReplaceNode",
+                xmlSecInternalError("xmlSecIdsRegistryReplaceNode",
                                     xmlSecNodeGetName(node));
                 return(-1);
             }
@@ -417,16 +517,16 @@ xmlSecEncCtxXmlEncrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl, xmlNodePtr node)
     } else if((encCtx->type != NULL) && xmlStrEqual(encCtx->type, xmlSecTypeEncContent)) {
         /* check if we need to return the replaced node */
         if((encCtx->flags & XMLSEC_ENC_RETURN_REPLACED_NODE) != 0) {
-            ret = xmlSecReplaceContentAndReturn(node, tmpl, &(encCtx->replacedNodeList));
+            ret = xmlSecIdsRegistryReplaceContent((xmlSecIdsRegistryPtr)encCtx->reserved1, node, tmpl, &(encCtx->replacedNodeList));
             if(ret < 0) {
-                xmlSecInternalError("xmlSecReplaceContentAndReturn",
+                xmlSecInternalError("xmlSecIdsRegistryReplaceContent",
                                     xmlSecNodeGetName(node));
                 return(-1);
             }
         } else {
-            ret = xmlSecReplaceContent(node, tmpl);
+            ret = xmlSecIdsRegistryReplaceContent((xmlSecIdsRegistryPtr)encCtx->reserved1, node, tmpl, NULL);
             if(ret < 0) {
-                xmlSecInternalError("xmlSecReplaceContent",
+                xmlSecInternalError("xmlSecIdsRegistryReplaceContent",
                                     xmlSecNodeGetName(node));
                 return(-1);
             }
@@ -452,6 +552,25 @@ xmlSecEncCtxXmlEncrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl, xmlNodePtr node)
  */
 int
 xmlSecEncCtxUriEncrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl, const xmlChar *uri) {
+    int res;
+    int owned;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(tmpl != NULL, -1);
+    xmlSecAssert2(tmpl->doc != NULL, -1);
+
+    owned = xmlSecEncCtxIdsRegistryAcquire(encCtx, tmpl->doc);
+    if(owned < 0) {
+        xmlSecInternalError("xmlSecEncCtxIdsRegistryAcquire", NULL);
+        return(-1);
+    }
+    res = xmlSecEncCtxUriEncryptInternal(encCtx, tmpl, uri);
+    xmlSecEncCtxIdsRegistryRelease(encCtx, owned);
+    return(res);
+}
+
+static int
+xmlSecEncCtxUriEncryptInternal(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl, const xmlChar *uri) {
     int ret;
 
     xmlSecAssert2(encCtx != NULL, -1);
@@ -461,7 +580,7 @@ xmlSecEncCtxUriEncrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl, const xmlChar *u
 
       /* initialize context and add ID attributes to the list of known ids */
     encCtx->operation = xmlSecTransformOperationEncrypt;
-    xmlSecAddIDs(tmpl->doc, tmpl, xmlSecEncIds);
+    xmlSecIdsRegistryAddIDs((xmlSecIdsRegistryPtr)encCtx->reserved1, tmpl->doc, tmpl, xmlSecEncIds);
 
     /* we need to add input uri transform first, make sure to enable local and remote URIs */
     encCtx->transformCtx.enabledUris |= xmlSecTransformUriTypeLocal | xmlSecTransformUriTypeRemote;
@@ -507,6 +626,25 @@ xmlSecEncCtxUriEncrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl, const xmlChar *u
  */
 int
 xmlSecEncCtxDecrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
+    int res;
+    int owned;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(node->doc != NULL, -1);
+
+    owned = xmlSecEncCtxIdsRegistryAcquire(encCtx, node->doc);
+    if(owned < 0) {
+        xmlSecInternalError("xmlSecEncCtxIdsRegistryAcquire", NULL);
+        return(-1);
+    }
+    res = xmlSecEncCtxDecryptInternal(encCtx, node);
+    xmlSecEncCtxIdsRegistryRelease(encCtx, owned);
+    return(res);
+}
+
+static int
+xmlSecEncCtxDecryptInternal(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
     xmlSecBufferPtr buffer;
     int ret;
 
@@ -527,16 +665,16 @@ xmlSecEncCtxDecrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
     if((encCtx->type != NULL) && xmlStrEqual(encCtx->type, xmlSecTypeEncElement)) {
         /* check if we need to return the replaced node */
         if((encCtx->flags & XMLSEC_ENC_RETURN_REPLACED_NODE) != 0) {
-                ret = xmlSecReplaceNodeBufferAndReturn(node, xmlSecBufferGetData(buffer),  xmlSecBufferGetSize(buffer), &(encCtx->replacedNodeList));
+                ret = xmlSecIdsRegistryReplaceNodeBuffer((xmlSecIdsRegistryPtr)encCtx->reserved1, node, xmlSecBufferGetData(buffer),  xmlSecBufferGetSize(buffer), &(encCtx->replacedNodeList));
                 if(ret < 0) {
-                    xmlSecInternalError("xmlSecReplaceNodeBufferAndReturn",
+                    xmlSecInternalError("xmlSecIdsRegistryReplaceNodeBuffer",
                                         xmlSecNodeGetName(node));
                     return(-1);
                 }
         } else {
-                ret = xmlSecReplaceNodeBuffer(node, xmlSecBufferGetData(buffer),  xmlSecBufferGetSize(buffer));
+                ret = xmlSecIdsRegistryReplaceNodeBuffer((xmlSecIdsRegistryPtr)encCtx->reserved1, node, xmlSecBufferGetData(buffer),  xmlSecBufferGetSize(buffer), NULL);
                 if(ret < 0) {
-                    xmlSecInternalError("xmlSecReplaceNodeBuffer",
+                    xmlSecInternalError("xmlSecIdsRegistryReplaceNodeBuffer",
                                         xmlSecNodeGetName(node));
                     return(-1);
                 }
@@ -548,16 +686,16 @@ xmlSecEncCtxDecrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
 
         /* check if we need to return the replaced node */
         if((encCtx->flags & XMLSEC_ENC_RETURN_REPLACED_NODE) != 0) {
-                ret = xmlSecReplaceNodeBufferAndReturn(node, xmlSecBufferGetData(buffer), xmlSecBufferGetSize(buffer), &(encCtx->replacedNodeList));
+                ret = xmlSecIdsRegistryReplaceNodeBuffer((xmlSecIdsRegistryPtr)encCtx->reserved1, node, xmlSecBufferGetData(buffer), xmlSecBufferGetSize(buffer), &(encCtx->replacedNodeList));
                 if(ret < 0) {
-                    xmlSecInternalError("xmlSecReplaceNodeBufferAndReturn",
+                    xmlSecInternalError("xmlSecIdsRegistryReplaceNodeBuffer",
                                         xmlSecNodeGetName(node));
                     return(-1);
                 }
         } else {
-            ret = xmlSecReplaceNodeBuffer(node, xmlSecBufferGetData(buffer), xmlSecBufferGetSize(buffer));
+            ret = xmlSecIdsRegistryReplaceNodeBuffer((xmlSecIdsRegistryPtr)encCtx->reserved1, node, xmlSecBufferGetData(buffer), xmlSecBufferGetSize(buffer), NULL);
                 if(ret < 0) {
-                    xmlSecInternalError("xmlSecReplaceNodeBuffer",
+                    xmlSecInternalError("xmlSecIdsRegistryReplaceNodeBuffer",
                                         xmlSecNodeGetName(node));
                     return(-1);
                 }
@@ -576,6 +714,25 @@ xmlSecEncCtxDecrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
  */
 xmlSecBufferPtr
 xmlSecEncCtxDecryptToBuffer(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
+    xmlSecBufferPtr res;
+    int owned;
+
+    xmlSecAssert2(encCtx != NULL, NULL);
+    xmlSecAssert2(node != NULL, NULL);
+    xmlSecAssert2(node->doc != NULL, NULL);
+
+    owned = xmlSecEncCtxIdsRegistryAcquire(encCtx, node->doc);
+    if(owned < 0) {
+        xmlSecInternalError("xmlSecEncCtxIdsRegistryAcquire", NULL);
+        return(NULL);
+    }
+    res = xmlSecEncCtxDecryptToBufferInternal(encCtx, node);
+    xmlSecEncCtxIdsRegistryRelease(encCtx, owned);
+    return(res);
+}
+
+static xmlSecBufferPtr
+xmlSecEncCtxDecryptToBufferInternal(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
     xmlSecBufferPtr res = NULL;
     xmlChar* data = NULL;
     int ret;
@@ -586,7 +743,7 @@ xmlSecEncCtxDecryptToBuffer(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
 
       /* initialize context and add ID attributes to the list of known ids */
     encCtx->operation = xmlSecTransformOperationDecrypt;
-    xmlSecAddIDs(node->doc, node, xmlSecEncIds);
+    xmlSecIdsRegistryAddIDs((xmlSecIdsRegistryPtr)encCtx->reserved1, node->doc, node, xmlSecEncIds);
 
     ret = xmlSecEncCtxEncDataNodeRead(encCtx, node);
     if(ret < 0) {
@@ -1244,7 +1401,7 @@ xmlSecEncCtxDerivedKeyGenerate(xmlSecEncCtxPtr encCtx, xmlSecKeyDataId keyId, xm
 
       /* initialize context and add ID attributes to the list of known ids */
     encCtx->operation = keyInfoCtx->operation;
-    xmlSecAddIDs(node->doc, node, xmlSecEncIds);
+    xmlSecIdsRegistryAddIDs((xmlSecIdsRegistryPtr)encCtx->reserved1, node->doc, node, xmlSecEncIds);
 
     /* first read the children */
     cur = xmlSecGetNextElementNode(node->children);
@@ -1388,7 +1545,7 @@ xmlSecEncCtxAgreementMethodGenerate(xmlSecEncCtxPtr encCtx, xmlSecKeyDataId keyI
 
       /* initialize context and add ID attributes to the list of known ids */
     encCtx->operation = keyInfoCtx->operation;
-    xmlSecAddIDs(node->doc, node, xmlSecEncIds);
+    xmlSecIdsRegistryAddIDs((xmlSecIdsRegistryPtr)encCtx->reserved1, node->doc, node, xmlSecEncIds);
 
     /* the AgreementMethod node is the transform node itself */
     encCtx->transformCtx.parentKeyInfoCtx = keyInfoCtx;
@@ -1436,7 +1593,7 @@ xmlSecEncCtxAgreementMethodXmlWrite(xmlSecEncCtxPtr encCtx, xmlNodePtr node, xml
 
       /* initialize context and add ID attributes to the list of known ids */
     encCtx->operation = keyInfoCtx->operation;
-    xmlSecAddIDs(node->doc, node, xmlSecEncIds);
+    xmlSecIdsRegistryAddIDs((xmlSecIdsRegistryPtr)encCtx->reserved1, node->doc, node, xmlSecEncIds);
 
     /* the AgreementMethod node is the transform node itself */
     encCtx->transformCtx.parentKeyInfoCtx = keyInfoCtx;
@@ -1542,7 +1699,7 @@ xmlSecEncCtxEncapsulationMechanismXmlWrite(xmlSecEncCtxPtr encCtx, xmlNodePtr no
 
     /* initialize context and add ID attributes to the list of known ids */
     encCtx->operation = keyInfoCtx->operation;
-    xmlSecAddIDs(node->doc, node, xmlSecEncIds);
+    xmlSecIdsRegistryAddIDs((xmlSecIdsRegistryPtr)encCtx->reserved1, node->doc, node, xmlSecEncIds);
 
     /* the EncapsulationMechanism node is the transform node itself */
     encCtx->transformCtx.parentKeyInfoCtx = keyInfoCtx;
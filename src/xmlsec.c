@@ -28,6 +28,7 @@
 #include <xmlsec/errors.h>
 
 #include "cast_helpers.h"
+#include "transform_helpers.h"
 
 
 /* default external entity loader, pointer saved during xmlInit */
@@ -112,6 +113,11 @@ xmlSecInit(void) {
         return(-1);
     }
 
+    if(xmlSecTransformXPathCacheInit() < 0) {
+        xmlSecInternalError("xmlSecTransformXPathCacheInit", NULL);
+        return(-1);
+    }
+
     /* initialise safe external entity loader */
     if (!xmlSecDefaultExternalEntityLoader) {
         xmlSecDefaultExternalEntityLoader = xmlGetExternalEntityLoader();
@@ -139,6 +145,7 @@ int
 xmlSecShutdown(void) {
     int res = -1;
 
+    xmlSecTransformXPathCacheShutdown();
     xmlSecTransformIdsShutdown();
     xmlSecKeyDataIdsShutdown();
 
@@ -31,7 +31,14 @@
 #include <xmlsec/errors.h>
 
 #include "cast_helpers.h"
+#include "xmltree_helpers.h"
 
+static void             xmlSecIdsRegistryRemoveNodes            (xmlSecIdsRegistryPtr registry,
+                                                                 xmlNodePtr node,
+                                                                 int withSelf);
+static void             xmlSecIdsRegistryAddNodes               (xmlSecIdsRegistryPtr registry,
+                                                                 xmlNodePtr first,
+                                                                 xmlNodePtr last);
 
 static const xmlChar*    g_xmlsec_xmltree_default_linefeed = xmlSecStringLF;
 
@@ -674,6 +681,21 @@ xmlSecReplaceNode(xmlNodePtr node, xmlNodePtr newNode) {
  */
 int
 xmlSecReplaceNodeAndReturn(xmlNodePtr node, xmlNodePtr newNode, xmlNodePtr* replaced) {
+    return(xmlSecIdsRegistryReplaceNode(NULL, node, newNode, replaced));
+}
+
+/**
+ * @brief Swaps a node with another during an xmlsec operation.
+ * @details Same as #xmlSecReplaceNodeAndReturn but also updates the IDs registry
+ * of the current operation.
+ * @param registry the IDs registry of the current operation (optional).
+ * @param node the current node.
+ * @param newNode the new node.
+ * @param replaced the replaced node, or release it if NULL is given
+ * @return 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecIdsRegistryReplaceNode(xmlSecIdsRegistryPtr registry, xmlNodePtr node, xmlNodePtr newNode, xmlNodePtr* replaced) {
     xmlNodePtr oldNode;
     int restoreRoot = 0;
     xmlNodePtr origNodeDocChildren = NULL;
@@ -691,6 +713,9 @@ xmlSecReplaceNodeAndReturn(xmlNodePtr node, xmlNodePtr newNode, xmlNodePtr* repl
         newNode->doc->children = newNode->next;
     }
 
+    /* the scanned subtrees inside the old node are going away */
+    xmlSecIdsRegistryRemoveNodes(registry, node, 1);
+
     oldNode = xmlReplaceNode(node, newNode);
     if(oldNode == NULL) {
         /* restore the document children we mutated above so the tree is not left corrupted */
@@ -704,6 +729,7 @@ xmlSecReplaceNodeAndReturn(xmlNodePtr node, xmlNodePtr newNode, xmlNodePtr* repl
     if(restoreRoot != 0) {
         xmlDocSetRootElement(oldNode->doc, newNode);
     }
+    xmlSecIdsRegistryAddNodes(registry, newNode, newNode);
 
     /* return the old node if requested */
     if(replaced != NULL) {
@@ -735,9 +761,27 @@ xmlSecReplaceContent(xmlNodePtr node, xmlNodePtr newNode) {
  */
 int
 xmlSecReplaceContentAndReturn(xmlNodePtr node, xmlNodePtr newNode, xmlNodePtr *replaced) {
+    return(xmlSecIdsRegistryReplaceContent(NULL, node, newNode, replaced));
+}
+
+/**
+ * @brief Swaps the content of @p node and @p newNode during an xmlsec operation.
+ * @details Same as #xmlSecReplaceContentAndReturn but also updates the IDs registry
+ * of the current operation.
+ * @param registry the IDs registry of the current operation (optional).
+ * @param node the current node.
+ * @param newNode the new node.
+ * @param replaced the replaced nodes, or release them if NULL is given
+ * @return 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecIdsRegistryReplaceContent(xmlSecIdsRegistryPtr registry, xmlNodePtr node, xmlNodePtr newNode, xmlNodePtr *replaced) {
     xmlSecAssert2(node != NULL, -1);
     xmlSecAssert2(newNode != NULL, -1);
 
+    /* the scanned subtrees inside the old content are going away */
+    xmlSecIdsRegistryRemoveNodes(registry, node, 0);
+
     /* return the old nodes if requested */
     if(replaced != NULL) {
         xmlNodePtr cur, next, tail;
@@ -771,6 +815,9 @@ xmlSecReplaceContentAndReturn(xmlNodePtr node, xmlNodePtr newNode, xmlNodePtr *r
     /* swap nodes */
     xmlUnlinkNode(newNode);
     xmlAddChildList(node, newNode);
+    if(node->children != NULL) {
+        xmlSecIdsRegistryAddNodes(registry, node->children, NULL);
+    }
 
     return(0);
 }
@@ -799,8 +846,26 @@ xmlSecReplaceNodeBuffer(xmlNodePtr node, const xmlSecByte *buffer, xmlSecSize si
  */
 int
 xmlSecReplaceNodeBufferAndReturn(xmlNodePtr node, const xmlSecByte *buffer, xmlSecSize size, xmlNodePtr *replaced) {
+    return(xmlSecIdsRegistryReplaceNodeBuffer(NULL, node, buffer, size, replaced));
+}
+
+/**
+ * @brief Replaces a node with parsed XML data from a buffer during an xmlsec operation.
+ * @details Same as #xmlSecReplaceNodeBufferAndReturn but also updates the IDs registry
+ * of the current operation.
+ * @param registry the IDs registry of the current operation (optional).
+ * @param node the current node.
+ * @param buffer the XML data.
+ * @param size the XML data size.
+ * @param replaced the replaced nodes, or release them if NULL is given
+ * @return 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecIdsRegistryReplaceNodeBuffer(xmlSecIdsRegistryPtr registry, xmlNodePtr node,
+                                   const xmlSecByte *buffer, xmlSecSize size, xmlNodePtr *replaced) {
     xmlNodePtr results = NULL;
     xmlNodePtr next = NULL;
+    xmlNodePtr prev;
 #if (LIBXML_VERSION >= 21500)
     xmlChar *oldenc;
 #else  /* (LIBXML_VERSION >= 21500) */
@@ -824,12 +889,20 @@ xmlSecReplaceNodeBufferAndReturn(xmlNodePtr node, const xmlSecByte *buffer, xmlS
         return(-1);
     }
 
-    /* add new nodes */
+    /* the scanned subtrees inside the old node are going away */
+    xmlSecIdsRegistryRemoveNodes(registry, node, 1);
+
+    /* add new nodes (the text nodes might be merged, remember the previous sibling) */
+    prev = node->prev;
     while (results != NULL) {
         next = results->next;
         xmlAddPrevSibling(node, results);
         results = next;
     }
+    next = (prev != NULL) ? prev->next : node->parent->children;
+    if(next != node) {
+        xmlSecIdsRegistryAddNodes(registry, next, node->prev);
+    }
 
     /* remove old node */
     xmlUnlinkNode(node);
@@ -890,6 +963,291 @@ xmlSecNodeEncodeAndSetContent(xmlNodePtr node, const xmlChar * buffer) {
 }
 
 
+/******************************************************************************
+ *
+ * IDs registry
+ *
+ * The xmlSecAddIDs() function is called for every signature, encrypted data,
+ * encrypted key, derived key, etc. node, and the nested nodes are scanned again
+ * and again. While an xmlsec operation is in progress, the document is modified
+ * only by xmlsec itself, thus we can remember the scanned subtrees and skip them.
+ * The replaced nodes (e.g. decrypted data) are removed from the registry and the
+ * new nodes are scanned right away.
+ *
+ * The registry belongs to the outermost operation context (see xmlSecDSigCtx
+ * and xmlSecEncCtx) and is passed to the nested contexts (e.g. the encrypted key
+ * in the key info) thru the key info context. A context is used by one thread
+ * at a time, thus the registry needs no locking.
+ *
+  *****************************************************************************/
+typedef struct _xmlSecIdsScan {
+    xmlNodePtr                  root;       /* the scanned subtree root or the document */
+    xmlChar**                   ids;        /* the ID attributes names */
+} xmlSecIdsScan, *xmlSecIdsScanPtr;
+
+struct _xmlSecIdsRegistry {
+    xmlDocPtr                   doc;
+    xmlSecIdsScanPtr            scans;
+    xmlSecSize                  scansSize;
+    xmlSecSize                  scansMaxSize;
+};
+
+static int                      xmlSecAddIDsWalk                (xmlDocPtr doc,
+                                                                 xmlNodePtr node,
+                                                                 const xmlChar** ids);
+
+static void
+xmlSecIdsListDestroy(xmlChar** ids) {
+    xmlSecSize ii;
+
+    xmlSecAssert(ids != NULL);
+
+    for(ii = 0; ids[ii] != NULL; ++ii) {
+        xmlFree(ids[ii]);
+    }
+    xmlFree(ids);
+}
+
+static xmlChar**
+xmlSecIdsListDuplicate(const xmlChar** ids) {
+    xmlChar** res;
+    xmlSecSize size, ii;
+
+    xmlSecAssert2(ids != NULL, NULL);
+
+    for(size = 0; ids[size] != NULL; ++size);
+    res = (xmlChar**)xmlMalloc((size + 1) * sizeof(xmlChar*));
+    if(res == NULL) {
+        xmlSecMallocError((size + 1) * sizeof(xmlChar*), NULL);
+        return(NULL);
+    }
+    memset(res, 0, (size + 1) * sizeof(xmlChar*));
+
+    for(ii = 0; ii < size; ++ii) {
+        res[ii] = xmlStrdup(ids[ii]);
+        if(res[ii] == NULL) {
+            xmlSecStrdupError(ids[ii], NULL);
+            xmlSecIdsListDestroy(res);
+            return(NULL);
+        }
+    }
+    return(res);
+}
+
+static int
+xmlSecIdsListEqual(const xmlChar* const* ids1, const xmlChar* const* ids2) {
+    xmlSecSize ii;
+
+    xmlSecAssert2(ids1 != NULL, 0);
+    xmlSecAssert2(ids2 != NULL, 0);
+
+    for(ii = 0; (ids1[ii] != NULL) && (ids2[ii] != NULL); ++ii) {
+        if(!xmlStrEqual(ids1[ii], ids2[ii])) {
+            return(0);
+        }
+    }
+    return(((ids1[ii] == NULL) && (ids2[ii] == NULL)) ? 1 : 0);
+}
+
+/* returns 1 if the node is in the subtree (the document covers everything) */
+static int
+xmlSecIdsScanCovers(xmlSecIdsScanPtr scan, xmlDocPtr doc, xmlNodePtr node) {
+    xmlNodePtr cur;
+
+    xmlSecAssert2(scan != NULL, 0);
+
+    if(scan->root == (xmlNodePtr)doc) {
+        return(1);
+    }
+    for(cur = node; cur != NULL; cur = cur->parent) {
+        if(cur == scan->root) {
+            return(1);
+        }
+    }
+    return(0);
+}
+
+static void
+xmlSecIdsRegistryRemoveScan(xmlSecIdsRegistryPtr registry, xmlSecSize pos) {
+    xmlSecAssert(registry != NULL);
+    xmlSecAssert(pos < registry->scansSize);
+
+    xmlSecIdsListDestroy(registry->scans[pos].ids);
+    registry->scans[pos] = registry->scans[--registry->scansSize];
+    memset(&(registry->scans[registry->scansSize]), 0, sizeof(xmlSecIdsScan));
+}
+
+/**
+ * @brief Creates the IDs registry for an xmlsec operation on the document.
+ * @details Creates the IDs registry for an xmlsec operation (sign, verify, encrypt
+ * or decrypt) on the @p doc: the subtrees scanned by #xmlSecIdsRegistryAddIDs
+ * with this registry are not scanned again. The application can change the
+ * document after the operation, thus the registry must be destroyed with
+ * #xmlSecIdsRegistryDestroy when the operation finishes.
+ * @param doc the pointer to an XML document.
+ * @return the pointer to the newly created registry or NULL if an error occurs.
+ */
+xmlSecIdsRegistryPtr
+xmlSecIdsRegistryCreate(xmlDocPtr doc) {
+    xmlSecIdsRegistryPtr registry;
+
+    xmlSecAssert2(doc != NULL, NULL);
+
+    registry = (xmlSecIdsRegistryPtr)xmlMalloc(sizeof(xmlSecIdsRegistry));
+    if(registry == NULL) {
+        xmlSecMallocError(sizeof(xmlSecIdsRegistry), NULL);
+        return(NULL);
+    }
+    memset(registry, 0, sizeof(xmlSecIdsRegistry));
+    registry->doc = doc;
+    return(registry);
+}
+
+/**
+ * @brief Destroys the IDs registry.
+ * @details Destroys the IDs registry created with #xmlSecIdsRegistryCreate.
+ * @param registry the pointer to the IDs registry.
+ */
+void
+xmlSecIdsRegistryDestroy(xmlSecIdsRegistryPtr registry) {
+    xmlSecAssert(registry != NULL);
+
+    while(registry->scansSize > 0) {
+        xmlSecIdsRegistryRemoveScan(registry, registry->scansSize - 1);
+    }
+    if(registry->scans != NULL) {
+        xmlFree(registry->scans);
+    }
+    memset(registry, 0, sizeof(xmlSecIdsRegistry));
+    xmlFree(registry);
+}
+
+/* returns 1 if the node (or the whole document if node is NULL) was already scanned */
+static int
+xmlSecIdsRegistryIsScanned(xmlSecIdsRegistryPtr registry, xmlDocPtr doc, xmlNodePtr node, const xmlChar** ids) {
+    xmlSecSize ii;
+    int res = 0;
+
+    xmlSecAssert2(registry != NULL, 0);
+    xmlSecAssert2(doc != NULL, 0);
+    xmlSecAssert2(ids != NULL, 0);
+
+    for(ii = 0; ii < registry->scansSize; ++ii) {
+        if((xmlSecIdsListEqual((const xmlChar* const*)(registry->scans[ii].ids), ids) == 1) &&
+           (xmlSecIdsScanCovers(&(registry->scans[ii]), doc, node) == 1)
+        ) {
+            res = 1;
+            break;
+        }
+    }
+    return(res);
+}
+
+/* remembers the scanned node (or the whole document if node is NULL) */
+static void
+xmlSecIdsRegistryAddScan(xmlSecIdsRegistryPtr registry, xmlDocPtr doc, xmlNodePtr node, const xmlChar** ids) {
+    xmlSecIdsScanPtr scans;
+    xmlChar** idsCopy;
+    xmlSecSize newSize;
+
+    xmlSecAssert(registry != NULL);
+    xmlSecAssert(doc != NULL);
+    xmlSecAssert(ids != NULL);
+
+    if(registry->scansSize >= registry->scansMaxSize) {
+        newSize = (registry->scansMaxSize > 0) ? (2 * registry->scansMaxSize) : 8;
+        scans = (xmlSecIdsScanPtr)xmlRealloc(registry->scans, newSize * sizeof(xmlSecIdsScan));
+        if(scans == NULL) {
+            /* the registry is just an optimization, ignore the error */
+            xmlSecMallocError(newSize * sizeof(xmlSecIdsScan), NULL);
+            return;
+        }
+        registry->scans = scans;
+        registry->scansMaxSize = newSize;
+    }
+
+    idsCopy = xmlSecIdsListDuplicate(ids);
+    if(idsCopy == NULL) {
+        /* the registry is just an optimization, ignore the error */
+        xmlSecInternalError("xmlSecIdsListDuplicate", NULL);
+        return;
+    }
+    registry->scans[registry->scansSize].root = (node != NULL) ? node : (xmlNodePtr)doc;
+    registry->scans[registry->scansSize].ids = idsCopy;
+    ++registry->scansSize;
+}
+
+/* forgets the scanned subtrees inside the node (and the node itself if requested)
+ * before the node is removed from the document */
+static void
+xmlSecIdsRegistryRemoveNodes(xmlSecIdsRegistryPtr registry, xmlNodePtr node, int withSelf) {
+    xmlNodePtr cur;
+    xmlSecSize ii;
+
+    xmlSecAssert(node != NULL);
+
+    if((registry == NULL) || (node->doc == NULL) || (node->doc != registry->doc)) {
+        return;
+    }
+
+    for(ii = 0; ii < registry->scansSize; ) {
+        cur = registry->scans[ii].root;
+        if(cur == (xmlNodePtr)node->doc) {
+            ++ii;
+            continue;
+        }
+        for(cur = (withSelf != 0) ? cur : cur->parent; (cur != NULL) && (cur != node); cur = cur->parent);
+        if(cur == node) {
+            xmlSecIdsRegistryRemoveScan(registry, ii);
+        } else {
+            ++ii;
+        }
+    }
+}
+
+/* scans the new nodes from first to last (inclusive) if they are inserted into
+ * the already scanned subtree */
+static void
+xmlSecIdsRegistryAddNodes(xmlSecIdsRegistryPtr registry, xmlNodePtr first, xmlNodePtr last) {
+    xmlNodePtr cur;
+    xmlSecSize ii, jj;
+
+    xmlSecAssert(first != NULL);
+
+    if((registry == NULL) || (first->doc == NULL) || (first->doc != registry->doc)) {
+        return;
+    }
+
+    for(ii = 0; ii < registry->scansSize; ++ii) {
+        if(xmlSecIdsScanCovers(&(registry->scans[ii]), first->doc, first->parent) != 1) {
+            continue;
+        }
+
+        /* the same IDs list might be in the registry more than once */
+        for(jj = 0; jj < ii; ++jj) {
+            if((xmlSecIdsListEqual((const xmlChar* const*)(registry->scans[ii].ids),
+                                   (const xmlChar* const*)(registry->scans[jj].ids)) == 1) &&
+               (xmlSecIdsScanCovers(&(registry->scans[jj]), first->doc, first->parent) == 1)
+            ) {
+                break;
+            }
+        }
+        if(jj < ii) {
+            continue;
+        }
+
+        for(cur = first; cur != NULL; cur = cur->next) {
+            if(cur->type == XML_ELEMENT_NODE) {
+                (void)xmlSecAddIDsWalk(first->doc, cur,
+                    (const xmlChar**)(registry->scans[ii].ids));
+            }
+            if(cur == last) {
+                break;
+            }
+        }
+    }
+}
+
 typedef struct {
     xmlDocPtr doc;
     const xmlChar** ids;
@@ -943,23 +1301,66 @@ xmlSecAddIDsCallback(xmlNodePtr cur, void* data) {
  */
 void
 xmlSecAddIDs(xmlDocPtr doc, xmlNodePtr node, const xmlChar** ids) {
-    xmlSecAddIDsCtx ctx;
-    xmlNodePtr cur;
+    xmlSecIdsRegistryAddIDs(NULL, doc, node, ids);
+}
+
+/**
+ * @brief Registers ID attributes from a node subtree during an xmlsec operation.
+ * @details Same as #xmlSecAddIDs but skips the subtrees already scanned during
+ * the current operation and remembers the scanned subtree in the @p registry.
+ * @param registry the IDs registry of the current operation (optional).
+ * @param doc the pointer to an XML document.
+ * @param node the pointer to an XML node.
+ * @param ids the pointer to a NULL terminated list of ID attributes.
+ */
+void
+xmlSecIdsRegistryAddIDs(xmlSecIdsRegistryPtr registry, xmlDocPtr doc, xmlNodePtr node, const xmlChar** ids) {
     int ret;
 
     xmlSecAssert(doc != NULL);
     xmlSecAssert(ids != NULL);
 
+    if((node != NULL) && (node->type != XML_ELEMENT_NODE)) {
+        return;
+    }
+    if((registry != NULL) && (registry->doc != doc)) {
+        registry = NULL;
+    }
+
+    /* the subtree might be already scanned during the current operation */
+    if((registry != NULL) && (xmlSecIdsRegistryIsScanned(registry, doc, node, ids) == 1)) {
+        return;
+    }
+
+    ret = xmlSecAddIDsWalk(doc, node, ids);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecAddIDsWalk", NULL);
+        return;
+    }
+    if(registry != NULL) {
+        xmlSecIdsRegistryAddScan(registry, doc, node, ids);
+    }
+}
+
+static int
+xmlSecAddIDsWalk(xmlDocPtr doc, xmlNodePtr node, const xmlChar** ids) {
+    xmlSecAddIDsCtx ctx;
+    xmlNodePtr cur;
+    int ret;
+
+    xmlSecAssert2(doc != NULL, -1);
+    xmlSecAssert2(ids != NULL, -1);
+
     ctx.doc = doc;
     ctx.ids = ids;
 
-    if((node != NULL) && (node->type == XML_ELEMENT_NODE)) {
+    if(node != NULL) {
         ret = xmlSecDepthFirstTreeWalk(node, xmlSecAddIDsCallback, &ctx);
         if(ret < 0) {
             xmlSecInternalError("xmlSecDepthFirstTreeWalk", NULL);
-            return;
+            return(-1);
         }
-    } else if(node == NULL) {
+    } else {
         for(cur = doc->children; cur != NULL; cur = cur->next) {
             if(cur->type != XML_ELEMENT_NODE) {
                 continue;
@@ -967,10 +1368,11 @@ xmlSecAddIDs(xmlDocPtr doc, xmlNodePtr node, const xmlChar** ids) {
             ret = xmlSecDepthFirstTreeWalk(cur, xmlSecAddIDsCallback, &ctx);
             if(ret < 0) {
                 xmlSecInternalError("xmlSecDepthFirstTreeWalk", NULL);
-                return;
+                return(-1);
             }
         }
     }
+    return(0);
 }
 
 /**
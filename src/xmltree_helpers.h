@@ -0,0 +1,61 @@
+/**
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * This is free software; see the Copyright file in the source distribution for precise wording.
+ *
+ * Copyright (C) 2002-2026 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+/**
+ * @brief Internal helper functions for XML tree processing.
+ */
+#ifndef __XMLSEC_XMLTREE_HELPERS_H__
+#define __XMLSEC_XMLTREE_HELPERS_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "xmltree_helpers.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#include <libxml/tree.h>
+
+#include <xmlsec/xmlsec.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/******************************************************************************
+ *
+ * The document IDs registry: while an xmlsec operation (sign, verify, encrypt
+ * or decrypt) is in progress, xmlSecIdsRegistryAddIDs() remembers the subtrees
+ * it has already scanned and skips them for the nested calls. The registry
+ * is owned by the operation context.
+ *
+  *****************************************************************************/
+typedef struct _xmlSecIdsRegistry                               xmlSecIdsRegistry,
+                                                                *xmlSecIdsRegistryPtr;
+
+XMLSEC_EXPORT xmlSecIdsRegistryPtr  xmlSecIdsRegistryCreate             (xmlDocPtr doc);
+XMLSEC_EXPORT void          xmlSecIdsRegistryDestroy            (xmlSecIdsRegistryPtr registry);
+XMLSEC_EXPORT void          xmlSecIdsRegistryAddIDs             (xmlSecIdsRegistryPtr registry,
+                                                                 xmlDocPtr doc,
+                                                                 xmlNodePtr node,
+                                                                 const xmlChar** ids);
+XMLSEC_EXPORT int           xmlSecIdsRegistryReplaceNode        (xmlSecIdsRegistryPtr registry,
+                                                                 xmlNodePtr node,
+                                                                 xmlNodePtr newNode,
+                                                                 xmlNodePtr* replaced);
+XMLSEC_EXPORT int           xmlSecIdsRegistryReplaceContent     (xmlSecIdsRegistryPtr registry,
+                                                                 xmlNodePtr node,
+                                                                 xmlNodePtr newNode,
+                                                                 xmlNodePtr* replaced);
+XMLSEC_EXPORT int           xmlSecIdsRegistryReplaceNodeBuffer  (xmlSecIdsRegistryPtr registry,
+                                                                 xmlNodePtr node,
+                                                                 const xmlSecByte *buffer,
+                                                                 xmlSecSize size,
+                                                                 xmlNodePtr* replaced);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_XMLTREE_HELPERS_H__ */
@@ -18,6 +18,9 @@
 #include <libxml/xpath.h>
 #include <libxml/xpathInternals.h>
 #include <libxml/xpointer.h>
+#include <libxml/hash.h>
+#include <libxml/chvalid.h>
+#include <libxml/threads.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/xmltree.h>
@@ -25,8 +28,10 @@
 #include <xmlsec/list.h>
 #include <xmlsec/transforms.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/private.h>
 
 #include "cast_helpers.h"
+#include "transform_helpers.h"
 
 /**
  * @brief Implements the XPath here() function.
@@ -52,6 +57,294 @@ xmlSecXPathHereFunction(xmlXPathParserContextPtr ctxt, int nargs) {
     valuePush(ctxt, obj);
 }
 
+/******************************************************************************
+ *
+ * Compiled XPath expressions cache
+ *
+ * The process-wide cache of the compiled XPath expressions keyed by the
+ * expression type, the namespaces bindings and the expression text.
+ * The cache is flushed when it is full: the entries are reference counted
+ * and stay valid while used by the transforms.
+ *
+ * LibXML2 updates the compiled expression while evaluating it, thus
+ * only one transform at a time evaluates the cached expression and
+ * the concurrent users evaluate a fresh compile of the same expression.
+ *
+  *****************************************************************************/
+#define XMLSEC_XPATH_CACHE_MAX_SIZE                     256
+
+/* control characters are not allowed in XML thus can't be in the key parts */
+#define XMLSEC_XPATH_CACHE_KEY_SEPARATOR                "\x01"
+
+/* The XPointer "xpointer(...)" scheme is evaluated as XPath expression
+ * unless LibXML2 supports XPointer locations (ranges and points) */
+#if defined(LIBXML_XPTR_ENABLED) && (LIBXML_VERSION >= 21300) && !defined(LIBXML_XPTR_LOCS_ENABLED)
+#define XMLSEC_XPATH_CACHE_XPOINTER                     1
+#endif /* defined(LIBXML_XPTR_ENABLED) && (LIBXML_VERSION >= 21300) && !defined(LIBXML_XPTR_LOCS_ENABLED) */
+
+typedef struct _xmlSecXPathCacheEntry {
+    xmlXPathCompExprPtr                 comp;
+    xmlChar*                            expr;       /* the compiled expression text */
+    int                                 refCount;   /* protected by the cache mutex */
+    int                                 busy;       /* protected by the cache mutex */
+} xmlSecXPathCacheEntry, *xmlSecXPathCacheEntryPtr;
+
+static xmlMutexPtr      xmlSecXPathCacheMutex = NULL;
+static xmlHashTablePtr  xmlSecXPathCacheHash = NULL;
+static xmlSecSize       xmlSecXPathCacheHits = 0;
+static xmlSecSize       xmlSecXPathCacheMisses = 0;
+
+static void
+xmlSecXPathCacheEntryRelease(xmlSecXPathCacheEntryPtr entry) {
+    int refCount;
+
+    xmlSecAssert(entry != NULL);
+
+    if(xmlSecXPathCacheMutex != NULL) {
+        xmlMutexLock(xmlSecXPathCacheMutex);
+    }
+    xmlSecAssert(entry->refCount > 0);
+    refCount = --(entry->refCount);
+    if(xmlSecXPathCacheMutex != NULL) {
+        xmlMutexUnlock(xmlSecXPathCacheMutex);
+    }
+    if(refCount > 0) {
+        return;
+    }
+
+    if(entry->comp != NULL) {
+        xmlXPathFreeCompExpr(entry->comp);
+    }
+    if(entry->expr != NULL) {
+        xmlFree(entry->expr);
+    }
+    memset(entry, 0, sizeof(xmlSecXPathCacheEntry));
+    xmlFree(entry);
+}
+
+/* called with the cache mutex locked */
+static void
+xmlSecXPathCacheEntryDeallocator(void* payload, const xmlChar* name XMLSEC_ATTRIBUTE_UNUSED) {
+    xmlSecXPathCacheEntryPtr entry = (xmlSecXPathCacheEntryPtr)payload;
+
+    UNREFERENCED_PARAMETER(name);
+    xmlSecAssert(entry != NULL);
+    xmlSecAssert(entry->refCount > 0);
+
+    if(--(entry->refCount) > 0) {
+        return;
+    }
+    if(entry->comp != NULL) {
+        xmlXPathFreeCompExpr(entry->comp);
+    }
+    if(entry->expr != NULL) {
+        xmlFree(entry->expr);
+    }
+    memset(entry, 0, sizeof(xmlSecXPathCacheEntry));
+    xmlFree(entry);
+}
+
+/**
+ * @brief Initializes the compiled XPath expressions cache.
+ * @details Initializes the process-wide cache of the compiled XPath expressions
+ * used by the XPath, XPath2 and XPointer transforms. Called from #xmlSecInit.
+ * @return 0 on success or a negative value otherwise.
+ */
+int
+xmlSecTransformXPathCacheInit(void) {
+    if(xmlSecXPathCacheMutex == NULL) {
+        xmlSecXPathCacheMutex = xmlNewMutex();
+        if(xmlSecXPathCacheMutex == NULL) {
+            xmlSecXmlError("xmlNewMutex", NULL);
+            return(-1);
+        }
+    }
+
+    xmlMutexLock(xmlSecXPathCacheMutex);
+    if(xmlSecXPathCacheHash == NULL) {
+        xmlSecXPathCacheHash = xmlHashCreate(XMLSEC_XPATH_CACHE_MAX_SIZE);
+        if(xmlSecXPathCacheHash == NULL) {
+            xmlMutexUnlock(xmlSecXPathCacheMutex);
+            xmlSecXmlError("xmlHashCreate", NULL);
+            return(-1);
+        }
+    }
+    xmlSecXPathCacheHits = 0;
+    xmlSecXPathCacheMisses = 0;
+    xmlMutexUnlock(xmlSecXPathCacheMutex);
+    return(0);
+}
+
+/**
+ * @brief Shuts down the compiled XPath expressions cache.
+ * @details Frees the process-wide cache of the compiled XPath expressions.
+ * The expressions still used by the existing transforms are freed when
+ * these transforms are destroyed. Called from #xmlSecShutdown.
+ */
+void
+xmlSecTransformXPathCacheShutdown(void) {
+    if(xmlSecXPathCacheMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecXPathCacheMutex);
+    if(xmlSecXPathCacheHash != NULL) {
+        xmlHashFree(xmlSecXPathCacheHash, xmlSecXPathCacheEntryDeallocator);
+        xmlSecXPathCacheHash = NULL;
+    }
+    xmlMutexUnlock(xmlSecXPathCacheMutex);
+
+    /* entries that are still in use don't need the mutex anymore */
+    xmlFreeMutex(xmlSecXPathCacheMutex);
+    xmlSecXPathCacheMutex = NULL;
+}
+
+/**
+ * @brief Gets the compiled XPath expressions cache statistics.
+ * @details Gets the number of the compiled XPath expressions cache hits and
+ * misses since the cache was initialized.
+ * @param hits the optional pointer to the cache hits number.
+ * @param misses the optional pointer to the cache misses number.
+ */
+void
+xmlSecTransformXPathCacheGetStats(xmlSecSize* hits, xmlSecSize* misses) {
+    if(xmlSecXPathCacheMutex != NULL) {
+        xmlMutexLock(xmlSecXPathCacheMutex);
+    }
+    if(hits != NULL) {
+        (*hits) = xmlSecXPathCacheHits;
+    }
+    if(misses != NULL) {
+        (*misses) = xmlSecXPathCacheMisses;
+    }
+    if(xmlSecXPathCacheMutex != NULL) {
+        xmlMutexUnlock(xmlSecXPathCacheMutex);
+    }
+}
+
+/* returns the compiled expression with the reference added or NULL if an error occurs */
+static xmlSecXPathCacheEntryPtr
+xmlSecXPathCacheGet(const xmlChar* key, const xmlChar* expr, xmlXPathContextPtr ctx) {
+    xmlSecXPathCacheEntryPtr entry;
+    xmlSecXPathCacheEntryPtr cached;
+    int ret;
+
+    xmlSecAssert2(key != NULL, NULL);
+    xmlSecAssert2(expr != NULL, NULL);
+    xmlSecAssert2(ctx != NULL, NULL);
+
+    if(xmlSecXPathCacheMutex != NULL) {
+        xmlMutexLock(xmlSecXPathCacheMutex);
+        if(xmlSecXPathCacheHash != NULL) {
+            entry = (xmlSecXPathCacheEntryPtr)xmlHashLookup(xmlSecXPathCacheHash, key);
+            if(entry != NULL) {
+                ++(entry->refCount);
+                ++xmlSecXPathCacheHits;
+                xmlMutexUnlock(xmlSecXPathCacheMutex);
+                return(entry);
+            }
+        }
+        ++xmlSecXPathCacheMisses;
+        xmlMutexUnlock(xmlSecXPathCacheMutex);
+    }
+
+    /* compile outside of the lock */
+    entry = (xmlSecXPathCacheEntryPtr)xmlMalloc(sizeof(xmlSecXPathCacheEntry));
+    if(entry == NULL) {
+        xmlSecMallocError(sizeof(xmlSecXPathCacheEntry), NULL);
+        return(NULL);
+    }
+    memset(entry, 0, sizeof(xmlSecXPathCacheEntry));
+    entry->refCount = 1;
+
+    entry->expr = xmlStrdup(expr);
+    if(entry->expr == NULL) {
+        xmlSecStrdupError(expr, NULL);
+        xmlSecXPathCacheEntryRelease(entry);
+        return(NULL);
+    }
+    entry->comp = xmlXPathCtxtCompile(ctx, expr);
+    if(entry->comp == NULL) {
+        xmlSecXmlError2("xmlXPathCtxtCompile", NULL,
+                        "expr=%s", xmlSecErrorsSafeString(expr));
+        xmlSecXPathCacheEntryRelease(entry);
+        return(NULL);
+    }
+
+    /* add to the cache (unless another thread did it already) */
+    if(xmlSecXPathCacheMutex == NULL) {
+        return(entry);
+    }
+    xmlMutexLock(xmlSecXPathCacheMutex);
+    if(xmlSecXPathCacheHash == NULL) {
+        xmlMutexUnlock(xmlSecXPathCacheMutex);
+        return(entry);
+    }
+    cached = (xmlSecXPathCacheEntryPtr)xmlHashLookup(xmlSecXPathCacheHash, key);
+    if(cached != NULL) {
+        ++(cached->refCount);
+        xmlMutexUnlock(xmlSecXPathCacheMutex);
+        xmlSecXPathCacheEntryRelease(entry);
+        return(cached);
+    }
+    if(xmlHashSize(xmlSecXPathCacheHash) >= XMLSEC_XPATH_CACHE_MAX_SIZE) {
+        xmlHashFree(xmlSecXPathCacheHash, xmlSecXPathCacheEntryDeallocator);
+        xmlSecXPathCacheHash = xmlHashCreate(XMLSEC_XPATH_CACHE_MAX_SIZE);
+        if(xmlSecXPathCacheHash == NULL) {
+            xmlMutexUnlock(xmlSecXPathCacheMutex);
+            xmlSecXmlError("xmlHashCreate", NULL);
+            return(entry);
+        }
+    }
+    ret = xmlHashAddEntry(xmlSecXPathCacheHash, key, entry);
+    if(ret == 0) {
+        ++(entry->refCount);
+    }
+    xmlMutexUnlock(xmlSecXPathCacheMutex);
+
+    /* not being able to cache the expression is not an error */
+    return(entry);
+}
+
+/* evaluates the compiled expression or a fresh compile if it is being evaluated by another thread */
+static xmlXPathObjectPtr
+xmlSecXPathCacheEntryEval(xmlSecXPathCacheEntryPtr entry, xmlXPathContextPtr ctx) {
+    xmlXPathCompExprPtr comp;
+    xmlXPathObjectPtr res;
+    int busy = 0;
+
+    xmlSecAssert2(entry != NULL, NULL);
+    xmlSecAssert2(entry->comp != NULL, NULL);
+    xmlSecAssert2(entry->expr != NULL, NULL);
+    xmlSecAssert2(ctx != NULL, NULL);
+
+    if(xmlSecXPathCacheMutex != NULL) {
+        xmlMutexLock(xmlSecXPathCacheMutex);
+        busy = entry->busy;
+        entry->busy = 1;
+        xmlMutexUnlock(xmlSecXPathCacheMutex);
+    }
+    if(busy != 0) {
+        comp = xmlXPathCtxtCompile(ctx, entry->expr);
+        if(comp == NULL) {
+            xmlSecXmlError2("xmlXPathCtxtCompile", NULL,
+                            "expr=%s", xmlSecErrorsSafeString(entry->expr));
+            return(NULL);
+        }
+        res = xmlXPathCompiledEval(comp, ctx);
+        xmlXPathFreeCompExpr(comp);
+        return(res);
+    }
+
+    res = xmlXPathCompiledEval(entry->comp, ctx);
+    if(xmlSecXPathCacheMutex != NULL) {
+        xmlMutexLock(xmlSecXPathCacheMutex);
+        entry->busy = 0;
+        xmlMutexUnlock(xmlSecXPathCacheMutex);
+    }
+    return(res);
+}
+
 /******************************************************************************
  *
  * XPath/XPointer data
@@ -62,15 +355,30 @@ typedef struct _xmlSecXPathData                 xmlSecXPathData,
 typedef enum {
     xmlSecXPathDataTypeXPath,
     xmlSecXPathDataTypeXPath2,
-    xmlSecXPathDataTypeXPointer
+    xmlSecXPathDataTypeXPointer,
+    xmlSecXPathDataTypeId
 } xmlSecXPathDataType;
 
+/* the simple XPath filter expressions evaluated without LibXML2 */
+typedef enum {
+    xmlSecXPathPatternNone = 0,
+    xmlSecXPathPatternAncestorOrSelf,           /* ancestor-or-self::prefix:name */
+    xmlSecXPathPatternNotAncestorOrSelf,        /* not(ancestor-or-self::prefix:name) */
+    xmlSecXPathPatternAttrEqual                 /* @name='value' */
+} xmlSecXPathPatternType;
+
 struct _xmlSecXPathData {
     xmlSecXPathDataType                 type;
     xmlXPathContextPtr                  ctx;
     xmlChar*                            expr;
     xmlSecNodeSetOp                     nodeSetOp;
     xmlSecNodeSetType                   nodeSetType;
+    xmlBufferPtr                        nsBindings;     /* the registered namespaces (for the cache key) */
+    xmlSecXPathCacheEntryPtr            compiled;       /* the compiled expression (if available) */
+    xmlSecXPathPatternType              patternType;    /* the recognized filter expression (if any) */
+    xmlChar*                            patternName;
+    xmlChar*                            patternNs;
+    xmlChar*                            patternValue;
 };
 
 static xmlSecXPathDataPtr       xmlSecXPathDataCreate           (xmlSecXPathDataType type);
@@ -81,6 +389,12 @@ static int                      xmlSecXPathDataRegisterNamespaces(xmlSecXPathDat
                                                                  xmlNodePtr node);
 static int                      xmlSecXPathDataNodeRead         (xmlSecXPathDataPtr data,
                                                                  xmlNodePtr node);
+static int                      xmlSecXPathDataCompile          (xmlSecXPathDataPtr data);
+static int                      xmlSecXPathDataParsePattern     (xmlSecXPathDataPtr data);
+static xmlNodeSetPtr            xmlSecXPathDataPatternExecute   (xmlSecXPathDataPtr data,
+                                                                 xmlDocPtr doc);
+static xmlNodeSetPtr            xmlSecXPathDataIdExecute        (xmlSecXPathDataPtr data,
+                                                                 xmlDocPtr doc);
 static xmlSecNodeSetPtr         xmlSecXPathDataExecute          (xmlSecXPathDataPtr data,
                                                                  xmlDocPtr doc,
                                                                  xmlNodePtr hereNode);
@@ -118,6 +432,9 @@ xmlSecXPathDataCreate(xmlSecXPathDataType type) {
             return(NULL);
         }
         break;
+    case xmlSecXPathDataTypeId:
+        /* the ID lookup doesn't need XPath context */
+        break;
     }
 
     return(data);
@@ -127,6 +444,21 @@ static void
 xmlSecXPathDataDestroy(xmlSecXPathDataPtr data) {
     xmlSecAssert(data != NULL);
 
+    if(data->compiled != NULL) {
+        xmlSecXPathCacheEntryRelease(data->compiled);
+    }
+    if(data->patternName != NULL) {
+        xmlFree(data->patternName);
+    }
+    if(data->patternNs != NULL) {
+        xmlFree(data->patternNs);
+    }
+    if(data->patternValue != NULL) {
+        xmlFree(data->patternValue);
+    }
+    if(data->nsBindings != NULL) {
+        xmlBufferFree(data->nsBindings);
+    }
     if(data->expr != NULL) {
         xmlFree(data->expr);
     }
@@ -161,8 +493,15 @@ xmlSecXPathDataRegisterNamespaces(xmlSecXPathDataPtr data, xmlNodePtr node) {
 
     xmlSecAssert2(data != NULL, -1);
     xmlSecAssert2(data->ctx != NULL, -1);
+    xmlSecAssert2(data->nsBindings == NULL, -1);
     xmlSecAssert2(node != NULL, -1);
 
+    data->nsBindings = xmlBufferCreate();
+    if(data->nsBindings == NULL) {
+        xmlSecXmlError("xmlBufferCreate", NULL);
+        return(-1);
+    }
+
     /* register namespaces */
     for(cur = node; cur != NULL; cur = cur->parent) {
         for(ns = cur->nsDef; ns != NULL; ns = ns->next) {
@@ -174,6 +513,16 @@ xmlSecXPathDataRegisterNamespaces(xmlSecXPathDataPtr data, xmlNodePtr node) {
                                     "prefix=%s", xmlSecErrorsSafeString(ns->prefix));
                     return(-1);
                 }
+
+                /* remember the binding for the compiled expressions cache key */
+                if((xmlBufferCat(data->nsBindings, ns->prefix) != 0) ||
+                   (xmlBufferCCat(data->nsBindings, XMLSEC_XPATH_CACHE_KEY_SEPARATOR) != 0) ||
+                   (xmlBufferCat(data->nsBindings, (ns->href != NULL) ? ns->href : BAD_CAST "") != 0) ||
+                   (xmlBufferCCat(data->nsBindings, XMLSEC_XPATH_CACHE_KEY_SEPARATOR) != 0)
+                ) {
+                    xmlSecXmlError("xmlBufferCat", NULL);
+                    return(-1);
+                }
             }
         }
     }
@@ -206,18 +555,562 @@ xmlSecXPathDataNodeRead(xmlSecXPathDataPtr data, xmlNodePtr node) {
     return(0);
 }
 
+#ifdef XMLSEC_XPATH_CACHE_XPOINTER
+/* returns the XPath expression from the single "xpointer(...)" part or NULL
+ * if the XPointer expression is not that simple */
+static xmlChar*
+xmlSecXPathDataGetXPointerXPath(const xmlChar* expr) {
+    const xmlChar* start;
+    const xmlChar* end;
+    const xmlChar* cur;
+    int level;
+
+    xmlSecAssert2(expr != NULL, NULL);
+
+    for(cur = expr; xmlIsBlank_ch(*cur); ++cur);
+    if(xmlStrncmp(cur, BAD_CAST "xpointer(", 9) != 0) {
+        return(NULL);
+    }
+    cur += 9;
+
+    /* same as in LibXML2: parenthesis are counted regardless of the quotes
+     * (we don't handle the '^' escapes) */
+    for(start = cur, level = 1; (*cur) != '\0'; ++cur) {
+        if((*cur) == '^') {
+            return(NULL);
+        } else if((*cur) == '(') {
+            ++level;
+        } else if(((*cur) == ')') && (--level == 0)) {
+            break;
+        }
+    }
+    if((*cur) != ')') {
+        return(NULL);
+    }
+    if(cur == start) {
+        return(NULL);
+    }
+    end = cur;
+
+    /* nothing else is allowed */
+    for(++cur; xmlIsBlank_ch(*cur); ++cur);
+    if((*cur) != '\0') {
+        return(NULL);
+    }
+    return(xmlStrndup(start, (int)(end - start)));
+}
+#endif /* XMLSEC_XPATH_CACHE_XPOINTER */
+
+/* compiles the expression (or gets it from the cache) if possible */
+static int
+xmlSecXPathDataCompile(xmlSecXPathDataPtr data) {
+    xmlChar* expr = NULL;
+    xmlBufferPtr key = NULL;
+    int res = -1;
+
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(data->expr != NULL, -1);
+    xmlSecAssert2(data->ctx != NULL, -1);
+
+    if(data->compiled != NULL) {
+        return(0);
+    }
+
+    switch(data->type) {
+    case xmlSecXPathDataTypeXPath:
+    case xmlSecXPathDataTypeXPath2:
+        expr = xmlStrdup(data->expr);
+        if(expr == NULL) {
+            xmlSecStrdupError(data->expr, NULL);
+            goto done;
+        }
+        break;
+    case xmlSecXPathDataTypeXPointer:
+#ifdef XMLSEC_XPATH_CACHE_XPOINTER
+        expr = xmlSecXPathDataGetXPointerXPath(data->expr);
+#endif /* XMLSEC_XPATH_CACHE_XPOINTER */
+        if(expr == NULL) {
+            /* will be evaluated by xmlXPtrEval() */
+            res = 0;
+            goto done;
+        }
+        break;
+    case xmlSecXPathDataTypeId:
+        /* nothing to compile */
+        res = 0;
+        goto done;
+    }
+    xmlSecAssert2(expr != NULL, -1);
+
+    /* the key: type, namespaces and the expression */
+    key = xmlBufferCreate();
+    if(key == NULL) {
+        xmlSecXmlError("xmlBufferCreate", NULL);
+        goto done;
+    }
+    if((xmlBufferCCat(key, (data->type == xmlSecXPathDataTypeXPointer) ? "xpointer" : "xpath") != 0) ||
+       (xmlBufferCCat(key, XMLSEC_XPATH_CACHE_KEY_SEPARATOR) != 0) ||
+       ((data->nsBindings != NULL) && (xmlBufferCat(key, xmlBufferContent(data->nsBindings)) != 0)) ||
+       (xmlBufferCCat(key, XMLSEC_XPATH_CACHE_KEY_SEPARATOR) != 0) ||
+       (xmlBufferCat(key, expr) != 0)
+    ) {
+        xmlSecXmlError("xmlBufferCat", NULL);
+        goto done;
+    }
+
+    data->compiled = xmlSecXPathCacheGet(xmlBufferContent(key), expr, data->ctx);
+    if(data->compiled == NULL) {
+        xmlSecInternalError2("xmlSecXPathCacheGet", NULL,
+                            "expr=%s", xmlSecErrorsSafeString(data->expr));
+        goto done;
+    }
+
+    /* success */
+    res = 0;
+
+done:
+    if(key != NULL) {
+        xmlBufferFree(key);
+    }
+    if(expr != NULL) {
+        xmlFree(expr);
+    }
+    return(res);
+}
+
+/******************************************************************************
+ *
+ * XPath filter patterns
+ *
+ * The XPath filter expression is evaluated for every node, attribute and
+ * namespace in the document. The most common expressions only check the
+ * element itself or its ancestors and can be converted into a tree nodes
+ * set with a single pass over the document elements:
+ *
+ *   ancestor-or-self::prefix:name          -> xmlSecNodeSetTree
+ *   not(ancestor-or-self::prefix:name)     -> xmlSecNodeSetTreeInvert
+ *   @name='value'                          -> xmlSecNodeSetNormal
+ *
+ * Everything else is evaluated by LibXML2.
+ *
+  *****************************************************************************/
+#define XMLSEC_XPATH_PATTERN_DELIMITERS    " \t\r\n()[]:=@'\"/|,*<>!$+"
+
+static const xmlChar*
+xmlSecXPathPatternSkipBlanks(const xmlChar* cur) {
+    xmlSecAssert2(cur != NULL, NULL);
+
+    while(xmlIsBlank_ch(*cur)) {
+        ++cur;
+    }
+    return(cur);
+}
+
+/* returns the pointer after the token or NULL if the token doesn't match */
+static const xmlChar*
+xmlSecXPathPatternMatchToken(const xmlChar* cur, const char* token) {
+    int len;
+
+    xmlSecAssert2(cur != NULL, NULL);
+    xmlSecAssert2(token != NULL, NULL);
+
+    cur = xmlSecXPathPatternSkipBlanks(cur);
+    len = xmlStrlen(BAD_CAST token);
+    if(xmlStrncmp(cur, BAD_CAST token, len) != 0) {
+        return(NULL);
+    }
+    return(cur + len);
+}
+
+/* returns 1 if the NCName was read, 0 if it doesn't match, or -1 if an error occurs */
+static int
+xmlSecXPathPatternReadNCName(const xmlChar** cur, xmlChar** name) {
+    const xmlChar* start;
+    const xmlChar* end;
+
+    xmlSecAssert2(cur != NULL, -1);
+    xmlSecAssert2((*cur) != NULL, -1);
+    xmlSecAssert2(name != NULL, -1);
+    xmlSecAssert2((*name) == NULL, -1);
+
+    for(start = end = (*cur); (*end) != '\0'; ++end) {
+        if(xmlStrchr(BAD_CAST XMLSEC_XPATH_PATTERN_DELIMITERS, (*end)) != NULL) {
+            break;
+        }
+    }
+    if(end == start) {
+        return(0);
+    }
+
+    (*name) = xmlStrndup(start, (int)(end - start));
+    if((*name) == NULL) {
+        xmlSecStrdupError(start, NULL);
+        return(-1);
+    }
+    if(xmlValidateNCName((*name), 0) != 0) {
+        xmlFree(*name);
+        (*name) = NULL;
+        return(0);
+    }
+
+    (*cur) = end;
+    return(1);
+}
+
+/* parses "[prefix:]name" name test, returns 1 if it was read, 0 if it doesn't
+ * match (or the prefix is not registered), or -1 if an error occurs */
+static int
+xmlSecXPathDataPatternReadQName(xmlSecXPathDataPtr data, const xmlChar** cur) {
+    xmlChar* prefix = NULL;
+    const xmlChar* href;
+    int ret;
+
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(data->ctx != NULL, -1);
+    xmlSecAssert2(data->patternName == NULL, -1);
+    xmlSecAssert2(data->patternNs == NULL, -1);
+    xmlSecAssert2(cur != NULL, -1);
+    xmlSecAssert2((*cur) != NULL, -1);
+
+    ret = xmlSecXPathPatternReadNCName(cur, &(data->patternName));
+    if(ret <= 0) {
+        return(ret);
+    }
+    if((**cur) != ':') {
+        /* no prefix: the name is in the null namespace */
+        return(1);
+    }
+
+    ++(*cur);
+    prefix = data->patternName;
+    data->patternName = NULL;
+    ret = xmlSecXPathPatternReadNCName(cur, &(data->patternName));
+    if(ret <= 0) {
+        xmlFree(prefix);
+        return(ret);
+    }
+
+    /* unknown prefix is an error reported by LibXML2 */
+    href = xmlXPathNsLookup(data->ctx, prefix);
+    xmlFree(prefix);
+    if(href == NULL) {
+        return(0);
+    }
+    data->patternNs = xmlStrdup(href);
+    if(data->patternNs == NULL) {
+        xmlSecStrdupError(href, NULL);
+        return(-1);
+    }
+    return(1);
+}
+
+/* parses "@name='value'" expression */
+static int
+xmlSecXPathDataParseAttrPattern(xmlSecXPathDataPtr data, const xmlChar* cur) {
+    const xmlChar* start;
+    xmlChar quote;
+    int ret;
+
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(data->patternName == NULL, -1);
+    xmlSecAssert2(data->patternValue == NULL, -1);
+    xmlSecAssert2(cur != NULL, -1);
+
+    cur = xmlSecXPathPatternSkipBlanks(cur);
+    ret = xmlSecXPathPatternReadNCName(&cur, &(data->patternName));
+    if(ret <= 0) {
+        return(ret);
+    }
+
+    cur = xmlSecXPathPatternMatchToken(cur, "=");
+    if(cur == NULL) {
+        return(0);
+    }
+    cur = xmlSecXPathPatternSkipBlanks(cur);
+    if(((*cur) != '\'') && ((*cur) != '\"')) {
+        return(0);
+    }
+    quote = (*cur);
+    for(start = ++cur; ((*cur) != '\0') && ((*cur) != quote); ++cur);
+    if((*cur) != quote) {
+        return(0);
+    }
+    if((*xmlSecXPathPatternSkipBlanks(cur + 1)) != '\0') {
+        return(0);
+    }
+
+    data->patternValue = xmlStrndup(start, (int)(cur - start));
+    if(data->patternValue == NULL) {
+        xmlSecStrdupError(start, NULL);
+        return(-1);
+    }
+
+    data->patternType = xmlSecXPathPatternAttrEqual;
+    data->nodeSetType = xmlSecNodeSetNormal;
+    return(1);
+}
+
+/* returns 1 if the expression was recognized, 0 if it should be evaluated by
+ * LibXML2, or -1 if an error occurs */
+static int
+xmlSecXPathDataParsePattern(xmlSecXPathDataPtr data) {
+    const xmlChar* cur;
+    const xmlChar* tmp;
+    int negate = 0;
+    int ret;
+
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(data->expr != NULL, -1);
+    xmlSecAssert2(data->patternType == xmlSecXPathPatternNone, -1);
+
+    cur = xmlSecXPathPatternSkipBlanks(data->expr);
+    if((*cur) == '@') {
+        ret = xmlSecXPathDataParseAttrPattern(data, cur + 1);
+        goto done;
+    }
+
+    /* [not(] ancestor-or-self :: [prefix:]name [)] */
+    tmp = xmlSecXPathPatternMatchToken(cur, "not");
+    if(tmp != NULL) {
+        tmp = xmlSecXPathPatternMatchToken(tmp, "(");
+        if(tmp != NULL) {
+            negate = 1;
+            cur = tmp;
+        }
+    }
+    cur = xmlSecXPathPatternMatchToken(cur, "ancestor-or-self");
+    if(cur != NULL) {
+        cur = xmlSecXPathPatternMatchToken(cur, "::");
+    }
+    if(cur == NULL) {
+        ret = 0;
+        goto done;
+    }
+
+    cur = xmlSecXPathPatternSkipBlanks(cur);
+    ret = xmlSecXPathDataPatternReadQName(data, &cur);
+    if(ret <= 0) {
+        goto done;
+    }
+    if(negate != 0) {
+        cur = xmlSecXPathPatternMatchToken(cur, ")");
+    }
+    if((cur == NULL) || ((*xmlSecXPathPatternSkipBlanks(cur)) != '\0')) {
+        ret = 0;
+        goto done;
+    }
+
+    if(negate != 0) {
+        data->patternType = xmlSecXPathPatternNotAncestorOrSelf;
+        data->nodeSetType = xmlSecNodeSetTreeInvert;
+    } else {
+        data->patternType = xmlSecXPathPatternAncestorOrSelf;
+        data->nodeSetType = xmlSecNodeSetTree;
+    }
+    ret = 1;
+
+done:
+    if(ret <= 0) {
+        /* cleanup the partially parsed pattern */
+        if(data->patternName != NULL) {
+            xmlFree(data->patternName);
+            data->patternName = NULL;
+        }
+        if(data->patternNs != NULL) {
+            xmlFree(data->patternNs);
+            data->patternNs = NULL;
+        }
+        if(data->patternValue != NULL) {
+            xmlFree(data->patternValue);
+            data->patternValue = NULL;
+        }
+        data->patternType = xmlSecXPathPatternNone;
+    }
+    return(ret);
+}
+
+/* returns 1 if the element matches the pattern, 0 if not, or -1 if an error occurs */
+static int
+xmlSecXPathDataPatternMatch(xmlSecXPathDataPtr data, xmlNodePtr cur) {
+    xmlAttrPtr attr;
+    xmlChar* value;
+    int res;
+
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(data->patternName != NULL, -1);
+    xmlSecAssert2(cur != NULL, -1);
+    xmlSecAssert2(cur->type == XML_ELEMENT_NODE, -1);
+
+    switch(data->patternType) {
+    case xmlSecXPathPatternAncestorOrSelf:
+    case xmlSecXPathPatternNotAncestorOrSelf:
+        if(!xmlStrEqual(cur->name, data->patternName)) {
+            return(0);
+        }
+        if(data->patternNs == NULL) {
+            return((cur->ns == NULL) ? 1 : 0);
+        }
+        return(((cur->ns != NULL) && xmlStrEqual(cur->ns->href, data->patternNs)) ? 1 : 0);
+
+    case xmlSecXPathPatternAttrEqual:
+        xmlSecAssert2(data->patternValue != NULL, -1);
+
+        /* don't use xmlHasProp() since it also checks DTD default attributes */
+        for(attr = cur->properties; attr != NULL; attr = attr->next) {
+            if((attr->ns == NULL) && xmlStrEqual(attr->name, data->patternName)) {
+                break;
+            }
+        }
+        if(attr == NULL) {
+            return(0);
+        }
+
+        /* the most common case: single text node */
+        if((attr->children != NULL) && (attr->children->next == NULL) &&
+           (attr->children->type == XML_TEXT_NODE)
+        ) {
+            return(xmlStrEqual(attr->children->content, data->patternValue) ? 1 : 0);
+        }
+        value = xmlNodeGetContent((xmlNodePtr)attr);
+        if(value == NULL) {
+            xmlSecXmlError2("xmlNodeGetContent", NULL,
+                            "attr=%s", xmlSecErrorsSafeString(attr->name));
+            return(-1);
+        }
+        res = xmlStrEqual(value, data->patternValue) ? 1 : 0;
+        xmlFree(value);
+        return(res);
+
+    default:
+        xmlSecInternalError("Invalid XPath pattern type", NULL);
+        return(-1);
+    }
+}
+
+/* walks all the elements in the document (same as "descendant::*" in LibXML2) and collects
+ * the matching ones */
+static xmlNodeSetPtr
+xmlSecXPathDataPatternExecute(xmlSecXPathDataPtr data, xmlDocPtr doc) {
+    xmlNodeSetPtr nodes;
+    xmlNodePtr cur;
+    int descend;
+    int ret;
+
+    xmlSecAssert2(data != NULL, NULL);
+    xmlSecAssert2(data->patternType != xmlSecXPathPatternNone, NULL);
+    xmlSecAssert2(doc != NULL, NULL);
+
+    nodes = xmlXPathNodeSetCreate(NULL);
+    if(nodes == NULL) {
+        xmlSecXmlError("xmlXPathNodeSetCreate", NULL);
+        return(NULL);
+    }
+
+    cur = doc->children;
+    while(cur != NULL) {
+        descend = 0;
+        if(cur->type == XML_ELEMENT_NODE) {
+            ret = xmlSecXPathDataPatternMatch(data, cur);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecXPathDataPatternMatch", NULL);
+                xmlXPathFreeNodeSet(nodes);
+                return(NULL);
+            }
+            if((ret > 0) && (xmlXPathNodeSetAddUnique(nodes, cur) < 0)) {
+                xmlSecXmlError("xmlXPathNodeSetAddUnique", NULL);
+                xmlXPathFreeNodeSet(nodes);
+                return(NULL);
+            }
+
+            /* the subtree is already included into the tree nodes set */
+            descend = ((ret == 0) || (data->nodeSetType == xmlSecNodeSetNormal)) ? 1 : 0;
+        }
+
+        if((descend != 0) && (cur->children != NULL)) {
+            cur = cur->children;
+            continue;
+        }
+        while((cur->next == NULL) && (cur->parent != NULL) && (cur->parent != (xmlNodePtr)doc)) {
+            cur = cur->parent;
+        }
+        cur = cur->next;
+    }
+
+    return(nodes);
+}
+
+/* same as id() XPath function for a single ID: returns the element with the given ID */
+static xmlNodeSetPtr
+xmlSecXPathDataIdExecute(xmlSecXPathDataPtr data, xmlDocPtr doc) {
+    xmlAttrPtr attr;
+    xmlNodePtr elem = NULL;
+    xmlNodeSetPtr nodes;
+
+    xmlSecAssert2(data != NULL, NULL);
+    xmlSecAssert2(data->type == xmlSecXPathDataTypeId, NULL);
+    xmlSecAssert2(data->expr != NULL, NULL);
+    xmlSecAssert2(doc != NULL, NULL);
+
+    attr = xmlGetID(doc, data->expr);
+    if(attr != NULL) {
+        if(attr->type == XML_ATTRIBUTE_NODE) {
+            elem = attr->parent;
+        } else if(attr->type == XML_ELEMENT_NODE) {
+            elem = (xmlNodePtr)attr;
+        }
+    }
+
+    /* xmlXPtrEval() fails on empty result */
+    if(elem == NULL) {
+        xmlSecXmlError2("xmlGetID", NULL,
+                        "id=\"%s\"", xmlSecErrorsSafeString(data->expr));
+        return(NULL);
+    }
+
+    nodes = xmlXPathNodeSetCreate(elem);
+    if(nodes == NULL) {
+        xmlSecXmlError2("xmlXPathNodeSetCreate", NULL,
+                        "id=\"%s\"", xmlSecErrorsSafeString(data->expr));
+        return(NULL);
+    }
+    return(nodes);
+}
+
 static xmlSecNodeSetPtr
 xmlSecXPathDataExecute(xmlSecXPathDataPtr data, xmlDocPtr doc, xmlNodePtr hereNode) {
     xmlXPathObjectPtr xpathObj = NULL;
+    xmlNodeSetPtr nodeSet;
     xmlSecNodeSetPtr nodes;
 
     xmlSecAssert2(data != NULL, NULL);
     xmlSecAssert2(data->expr != NULL, NULL);
-    xmlSecAssert2(data->ctx != NULL, NULL);
     xmlSecAssert2(doc != NULL, NULL);
     xmlSecAssert2(hereNode != NULL, NULL);
 
+    /* the recognized filter expressions and IDs don't need LibXML2 XPath engine */
+    if((data->patternType != xmlSecXPathPatternNone) || (data->type == xmlSecXPathDataTypeId)) {
+        if(data->type == xmlSecXPathDataTypeId) {
+            nodeSet = xmlSecXPathDataIdExecute(data, doc);
+        } else {
+            nodeSet = xmlSecXPathDataPatternExecute(data, doc);
+        }
+        if(nodeSet == NULL) {
+            xmlSecInternalError2("xmlSecXPathDataExecute", NULL,
+                                "expr=%s", xmlSecErrorsSafeString(data->expr));
+            return(NULL);
+        }
+        nodes = xmlSecNodeSetCreate(doc, nodeSet, data->nodeSetType);
+        if(nodes == NULL) {
+            xmlSecInternalError2("xmlSecNodeSetCreate", NULL,
+                "type=" XMLSEC_ENUM_FMT, XMLSEC_ENUM_CAST(data->nodeSetType));
+            xmlXPathFreeNodeSet(nodeSet);
+            return(NULL);
+        }
+        return(nodes);
+    }
+
     /* do not forget to set the doc */
+    xmlSecAssert2(data->ctx != NULL, NULL);
     data->ctx->doc = doc;
 
     /* here function works only on the same document */
@@ -232,18 +1125,46 @@ xmlSecXPathDataExecute(xmlSecXPathDataPtr data, xmlDocPtr doc, xmlNodePtr hereNo
         xmlXPathRegisterFunc(data->ctx, (xmlChar *)"here", NULL);
     }
 
+    /* compile the expression if it wasn't done yet */
+    if(xmlSecXPathDataCompile(data) < 0) {
+        xmlSecInternalError2("xmlSecXPathDataCompile", NULL,
+                            "expr=%s", xmlSecErrorsSafeString(data->expr));
+        return(NULL);
+    }
+
     /* execute xpath or xpointer expression */
     switch(data->type) {
     case xmlSecXPathDataTypeXPath:
     case xmlSecXPathDataTypeXPath2:
-        xpathObj = xmlXPathEvalExpression(data->expr, data->ctx);
+        xmlSecAssert2(data->compiled != NULL, NULL);
+        xpathObj = xmlSecXPathCacheEntryEval(data->compiled, data->ctx);
         if(xpathObj == NULL) {
-            xmlSecXmlError2("xmlXPathEvalExpression", NULL,
+            xmlSecXmlError2("xmlXPathCompiledEval", NULL,
                             "expr=%s", xmlSecErrorsSafeString(data->expr));
             return(NULL);
         }
         break;
     case xmlSecXPathDataTypeXPointer:
+        /* use the compiled "xpointer(...)" expression if we have one, but keep
+         * xmlXPtrEval() errors reporting for everything except non-empty node sets */
+        if(data->compiled != NULL) {
+            /* the same context as xmlXPtrEval() sets up for the "xpointer(...)" scheme;
+             * the "here" node and function are set above for both paths */
+            data->ctx->node = (xmlNodePtr)doc;
+            data->ctx->contextSize = 1;
+            data->ctx->proximityPosition = 1;
+
+            xpathObj = xmlSecXPathCacheEntryEval(data->compiled, data->ctx);
+            if((xpathObj != NULL) && ((xpathObj->type != XPATH_NODESET) ||
+               (xpathObj->nodesetval == NULL) || (xpathObj->nodesetval->nodeNr <= 0))
+            ) {
+                xmlXPathFreeObject(xpathObj);
+                xpathObj = NULL;
+            }
+            if(xpathObj != NULL) {
+                break;
+            }
+        }
         xpathObj = xmlXPtrEval(data->expr, data->ctx);
         if(xpathObj == NULL) {
             xmlSecXmlError2("xmlXPtrEval", NULL,
@@ -370,7 +1291,8 @@ XMLSEC_TRANSFORM_DECLARE(XPath, xmlSecPtrList)
 #define xmlSecTransformXPathCheckId(transform) \
     (xmlSecTransformCheckId((transform), xmlSecTransformXPathId) || \
      xmlSecTransformCheckId((transform), xmlSecTransformXPath2Id) || \
-     xmlSecTransformCheckId((transform), xmlSecTransformXPointerId))
+     xmlSecTransformCheckId((transform), xmlSecTransformXPointerId) || \
+     xmlSecTransformCheckId((transform), xmlSecTransformBareNameId))
 
 static int              xmlSecTransformXPathInitialize  (xmlSecTransformPtr transform);
 static void             xmlSecTransformXPathFinalize    (xmlSecTransformPtr transform);
@@ -539,29 +1461,47 @@ xmlSecTransformXPathNodeRead(xmlSecTransformPtr transform, xmlNodePtr node, xmlS
         return(-1);
     }
 
-    /* create full XPath expression */
-    xmlSecAssert2(data->expr != NULL, -1);
-    tmpLen = xmlStrlen(data->expr) + xmlStrlen(BAD_CAST XMLSEC_TRANSFORM_XPATH_TMPL) + 1;
-    XMLSEC_SAFE_CAST_INT_TO_SIZE(tmpLen, tmpSize, return(-1), NULL);
-
-    tmp = (xmlChar*) xmlMalloc(sizeof(xmlChar) * tmpSize);
-    if(tmp == NULL) {
-        xmlSecMallocError(sizeof(xmlChar) * tmpSize,
-                          xmlSecTransformGetName(transform));
-        return(-1);
-    }
-    ret = xmlStrPrintf(tmp, tmpLen, XMLSEC_TRANSFORM_XPATH_TMPL, (char*)data->expr);
+    /* the most common expressions are converted into nodes sets directly */
+    ret = xmlSecXPathDataParsePattern(data);
     if(ret < 0) {
-       xmlSecXmlError("xmlStrPrintf", xmlSecTransformGetName(transform));
-       xmlFree(tmp);
-       return(-1);
+        xmlSecInternalError("xmlSecXPathDataParsePattern",
+                            xmlSecTransformGetName(transform));
+        return(-1);
+    } else if(ret == 0) {
+        /* create full XPath expression */
+        xmlSecAssert2(data->expr != NULL, -1);
+        tmpLen = xmlStrlen(data->expr) + xmlStrlen(BAD_CAST XMLSEC_TRANSFORM_XPATH_TMPL) + 1;
+        XMLSEC_SAFE_CAST_INT_TO_SIZE(tmpLen, tmpSize, return(-1), NULL);
+
+        tmp = (xmlChar*) xmlMalloc(sizeof(xmlChar) * tmpSize);
+        if(tmp == NULL) {
+            xmlSecMallocError(sizeof(xmlChar) * tmpSize,
+                              xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        ret = xmlStrPrintf(tmp, tmpLen, XMLSEC_TRANSFORM_XPATH_TMPL, (char*)data->expr);
+        if(ret < 0) {
+           xmlSecXmlError("xmlStrPrintf", xmlSecTransformGetName(transform));
+           xmlFree(tmp);
+           return(-1);
+        }
+        xmlFree(data->expr);
+        data->expr = tmp;
+
+        /* compile the full expression */
+        ret = xmlSecXPathDataCompile(data);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecXPathDataCompile",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+
+        /* set correct node set type */
+        data->nodeSetType   = xmlSecNodeSetNormal;
     }
-    xmlFree(data->expr);
-    data->expr = tmp;
 
-    /* set correct node set type and operation */
+    /* set correct node set operation */
     data->nodeSetOp     = xmlSecNodeSetIntersection;
-    data->nodeSetType   = xmlSecNodeSetNormal;
 
     /* check that we have nothing else */
     cur = xmlSecGetNextElementNode(cur->next);
@@ -652,6 +1592,14 @@ xmlSecTransformXPath2NodeRead(xmlSecTransformPtr transform, xmlNodePtr node, xml
             return(-1);
         }
 
+        ret = xmlSecXPathDataCompile(data);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecXPathDataCompile",
+                                xmlSecTransformGetName(transform));
+            xmlSecXPathDataDestroy(data);
+            return(-1);
+        }
+
         /* append it to the list */
         ret = xmlSecPtrListAdd(dataList, data);
         if(ret < 0) {
@@ -796,6 +1744,14 @@ xmlSecTransformXPointerSetExpr(xmlSecTransformPtr transform, const xmlChar* expr
         return(-1);
     }
 
+    ret = xmlSecXPathDataCompile(data);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecXPathDataCompile",
+                            xmlSecTransformGetName(transform));
+        xmlSecXPathDataDestroy(data);
+        return(-1);
+    }
+
     /* append it to the list */
     ret = xmlSecPtrListAdd(dataList, data);
     if(ret < 0) {
@@ -855,6 +1811,14 @@ xmlSecTransformXPointerNodeRead(xmlSecTransformPtr transform, xmlNodePtr node, x
         return(-1);
     }
 
+    ret = xmlSecXPathDataCompile(data);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecXPathDataCompile",
+                            xmlSecTransformGetName(transform));
+        xmlSecXPathDataDestroy(data);
+        return(-1);
+    }
+
     /* append it to the list */
     ret = xmlSecPtrListAdd(dataList, data);
     if(ret < 0) {
@@ -878,6 +1842,139 @@ xmlSecTransformXPointerNodeRead(xmlSecTransformPtr transform, xmlNodePtr node, x
 }
 
 
+/******************************************************************************
+ *
+ * Bare name XPointer ("#id") transform
+ *
+ * xmlSecTransform + xmlSecXPathDataList
+ *
+  *****************************************************************************/
+static xmlSecTransformKlass xmlSecTransformBareNameKlass = {
+    /* klass/object sizes */
+    sizeof(xmlSecTransformKlass),               /* xmlSecSize klassSize */
+    xmlSecXPathSize,                            /* xmlSecSize objSize */
+
+    BAD_CAST "BareNameTransform",               /* const xmlChar* name; */
+    NULL,                                       /* const xmlChar* href; */
+    xmlSecTransformUsageDSigTransform,          /* xmlSecTransformUsage usage; */
+
+    xmlSecTransformXPathInitialize,             /* xmlSecTransformInitializeMethod initialize; */
+    xmlSecTransformXPathFinalize,               /* xmlSecTransformFinalizeMethod finalize; */
+    NULL,                                       /* xmlSecTransformNodeReadMethod readNode; */
+    NULL,                                       /* xmlSecTransformNodeWriteMethod writeNode; */
+    NULL,                                       /* xmlSecTransformSetKeyReqMethod setKeyReq; */
+    NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
+    NULL,                                       /* xmlSecTransformValidateMethod validate; */
+    xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
+    NULL,                                       /* xmlSecTransformPushBinMethod pushBin; */
+    NULL,                                       /* xmlSecTransformPopBinMethod popBin; */
+    xmlSecTransformDefaultPushXml,              /* xmlSecTransformPushXmlMethod pushXml; */
+    xmlSecTransformDefaultPopXml,               /* xmlSecTransformPopXmlMethod popXml; */
+    xmlSecTransformXPathExecute,                /* xmlSecTransformExecuteMethod execute; */
+
+    NULL,                                       /* void* reserved0; */
+    NULL,                                       /* void* reserved1; */
+};
+
+/**
+ * @brief Gets the bare name XPointer transform klass.
+ * @details The bare name XPointer transform selects the element with the
+ * given ID, same as the "xpointer(id('...'))" expression for the XPointer
+ * transform, but without going thru the LibXML2 XPointer engine.
+ * @return bare name XPointer transform klass.
+ */
+xmlSecTransformId
+xmlSecTransformBareNameGetKlass(void) {
+    return(&xmlSecTransformBareNameKlass);
+}
+
+/**
+ * @brief Checks if the ID can be used with bare name XPointer transform.
+ * @details The IDs that would be split or rejected by the "xpointer(id('...'))"
+ * expression (empty, with whitespaces, quotes, parenthesis or XPointer escapes)
+ * can't be used with the bare name XPointer transform.
+ * @param id the ID value.
+ * @return 1 if the ID can be used, 0 if not, or a negative value if an error occurs.
+ */
+int
+xmlSecTransformBareNameCheckId(const xmlChar* id) {
+    const xmlChar* cur;
+
+    xmlSecAssert2(id != NULL, -1);
+
+    for(cur = id; (*cur) != '\0'; ++cur) {
+        if(xmlIsBlank_ch(*cur) || (xmlStrchr(BAD_CAST "'()^", (*cur)) != NULL)) {
+            return(0);
+        }
+    }
+    return((cur != id) ? 1 : 0);
+}
+
+/**
+ * @brief Sets the ID for a bare name XPointer transform.
+ * @details Sets the ID for a bare name XPointer @p transform. The ID must
+ * pass xmlSecTransformBareNameCheckId() check.
+ * @param transform the pointer to bare name XPointer transform.
+ * @param id the ID value.
+ * @param nodeSetType the type of the result nodes set.
+ * @param hereNode the pointer to "here" node.
+ * @return 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecTransformBareNameSetId(xmlSecTransformPtr transform, const xmlChar* id,
+                            xmlSecNodeSetType  nodeSetType, xmlNodePtr hereNode) {
+    xmlSecPtrListPtr dataList;
+    xmlSecXPathDataPtr data;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformBareNameId), -1);
+    xmlSecAssert2(transform->hereNode == NULL, -1);
+    xmlSecAssert2(id != NULL, -1);
+    xmlSecAssert2(hereNode != NULL, -1);
+
+    dataList = xmlSecXPathGetCtx(transform);
+    xmlSecAssert2(xmlSecPtrListCheckId(dataList, xmlSecXPathDataListId), -1);
+    xmlSecAssert2(xmlSecPtrListGetSize(dataList) == 0, -1);
+
+    /* check the id */
+    if(xmlSecTransformBareNameCheckId(id) != 1) {
+        xmlSecInvalidStringDataError("id", id, "non empty ID without whitespaces, quotes, parenthesis and '^'",
+                                     xmlSecTransformGetName(transform));
+        return(-1);
+    }
+
+    data = xmlSecXPathDataCreate(xmlSecXPathDataTypeId);
+    if(data == NULL) {
+        xmlSecInternalError("xmlSecXPathDataCreate",
+                            xmlSecTransformGetName(transform));
+        return(-1);
+    }
+
+    data->expr = xmlStrdup(id);
+    if(data->expr == NULL) {
+        xmlSecStrdupError(id, xmlSecTransformGetName(transform));
+        xmlSecXPathDataDestroy(data);
+        return(-1);
+    }
+
+    /* append it to the list */
+    ret = xmlSecPtrListAdd(dataList, data);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
+                            xmlSecTransformGetName(transform));
+        xmlSecXPathDataDestroy(data);
+        return(-1);
+    }
+
+    /* set correct node set type and operation */
+    data->nodeSetOp     = xmlSecNodeSetIntersection;
+    data->nodeSetType   = nodeSetType;
+
+    transform->hereNode = hereNode;
+    return(0);
+}
+
+
 /******************************************************************************
  *
  * Visa3DHack transform
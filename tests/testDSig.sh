@@ -987,6 +987,17 @@ execDSigTest $res_success \
     "$priv_key_option:TestKeyName-rsa-2048 $topfolder/keys/rsa/rsa-2048-key.$priv_key_format --pwd secret123" \
     "--trusted-$cert_format $topfolder/keys/cacert.$cert_format --enabled-key-data x509"
 
+# OpenSSL: the certificates repeated in X509Data come from the parsed certificates
+# cache as the same X509 objects and are added to the X509 key data again
+if [ "z$crypto" = "zopenssl" ] ; then
+    execDSigTest $res_success \
+        "" \
+        "aleksey-xmldsig-01/enveloping-rsa-x509chain-duplicate-certs" \
+        "sha1 rsa-sha1" \
+        "rsa x509" \
+        "--trusted-$cert_format $topfolder/keys/cacert.$cert_format --enabled-key-data x509"
+fi
+
 execDSigTest $res_success \
     "" \
     "aleksey-xmldsig-01/enveloping-md5-hmac-md5" \